@@ -0,0 +1,173 @@
+#include "benchmark.h"
+#include "heartbeater.h"
+#include "hb_messages.h"
+#include "serialization.h"
+#include "mock_udp.h"
+#include "environment.h"
+#include "configuration.h"
+#include "locking.h"
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::unique_ptr;
+
+namespace {
+const unsigned group_sizes[] = {10, 50, 200};
+const unsigned intro_group_sizes[] = {10, 100, 1000};
+const double drop_probability = 0.05;
+// How long the group is watched for false positives after the last member joins
+const unsigned stable_period_ms = 10000;
+// How long to wait for every member to notice the failure before giving up
+const unsigned detection_timeout_ms = 30000;
+
+struct detection_result {
+    double first_detection_ms;
+    double last_detection_ms;
+    // The number of distinct live members that were declared failed before the real failure
+    unsigned false_positives;
+    // The number of remaining members that still listed the failed member when the benchmark gave up
+    unsigned missed_detections;
+};
+
+auto knows_of(heartbeater *hb, string const& hostname) -> bool {
+    for (member const& m : hb->get_members()) {
+        if (m.hostname == hostname) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Forms a group of the given size and watches it for false positives, then fails one member without it leaving
+// and measures the time until the first and the last of the remaining members remove it
+auto measure_detection(unsigned group_size, bool use_swim, logger::log_level level) -> detection_result {
+    detection_result result = {0, 0, 0, 0};
+
+    environment_group env_group(true);
+    std::vector<unique_ptr<environment>> envs = env_group.get_envs(group_size);
+
+    std::vector<heartbeater*> hbs;
+    for (unsigned i = 0; i < group_size; i++) {
+        configuration *config = envs[i]->get<configuration>();
+        config->set_hostname("h" + std::to_string(i));
+        config->set_hb_port(1234);
+        config->set_first_node(i == 0);
+        config->set_swim_heartbeater(use_swim);
+
+        dynamic_cast<mock_udp_factory*>(envs[i]->get<udp_factory>())->configure(false, drop_probability);
+        envs[i]->get<logger_factory>()->configure(level);
+        hbs.push_back(envs[i]->get<heartbeater>());
+    }
+
+    // Members reported failed by anyone, from the heartbeater threads, which may outlive this function
+    auto failed_hostnames_lock = std::make_shared<locked<std::set<string>>>();
+    for (heartbeater *hb : hbs) {
+        hb->on_fail([failed_hostnames_lock] (member const& m) {
+            (*failed_hostnames_lock)()->insert(m.hostname);
+        });
+    }
+
+    hbs[0]->start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+    for (unsigned i = 1; i < group_size; i++) {
+        hbs[i]->start();
+        hbs[i]->join_group("h0");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(stable_period_ms));
+    result.false_positives = (*failed_hostnames_lock)()->size();
+
+    // Stopping takes a while, so it happens in the background while the rest of the group is watched
+    string failed_hostname = "h" + std::to_string(group_size - 1);
+    std::thread stop_thread([failed = hbs[group_size - 1]] {
+        failed->stop();
+    });
+    stop_thread.detach();
+
+    auto fail_time = std::chrono::steady_clock::now();
+    auto deadline = fail_time + std::chrono::milliseconds(detection_timeout_ms);
+    std::set<unsigned> detected;
+    while (detected.size() < group_size - 1 && std::chrono::steady_clock::now() < deadline) {
+        for (unsigned i = 0; i < group_size - 1; i++) {
+            if (detected.find(i) == detected.end() && !knows_of(hbs[i], failed_hostname)) {
+                double elapsed_ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - fail_time).count();
+                if (detected.empty()) {
+                    result.first_detection_ms = elapsed_ms;
+                }
+                result.last_detection_ms = elapsed_ms;
+                detected.insert(i);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    result.missed_detections = group_size - 1 - detected.size();
+
+    for (unsigned i = 0; i < group_size - 1; i++) {
+        std::thread stop_thread([hb = hbs[i]] {
+            hb->stop();
+        });
+        stop_thread.detach();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(3000));
+
+    return result;
+}
+}
+
+benchmarking::register_benchmark failure_detection("heartbeater.failure_detection",
+    "Measures the time for the group to remove a failed member and the number of false positives, for neighbor heartbeating and SWIM",
+    [] (logger::log_level level)
+{
+    for (unsigned group_size : group_sizes) {
+        for (bool use_swim : {false, true}) {
+            detection_result result = measure_detection(group_size, use_swim, level);
+
+            string suffix = string(use_swim ? " (SWIM)" : " (neighbors)") + " with " + std::to_string(group_size) + " members";
+            benchmarking::report("first detection" + suffix, result.first_detection_ms, "ms");
+            benchmarking::report("last detection" + suffix, result.last_detection_ms, "ms");
+            benchmarking::report("members missing the failure" + suffix, result.missed_detections, "members");
+            benchmarking::report("members falsely declared failed" + suffix, result.false_positives, "members");
+        }
+    }
+});
+
+benchmarking::register_benchmark intro_size("heartbeater.intro_size",
+    "Measures the bytes sent to introduce a new member to the group, in the old format and the compact chunked format",
+    [] (logger::log_level level)
+{
+    for (unsigned group_size : intro_group_sizes) {
+        std::vector<member> members;
+        for (unsigned i = 0; i < group_size; i++) {
+            member m;
+            m.id = std::hash<string>()(std::to_string(i)) & 0xFFFFFFFF;
+            m.hostname = "fa19-cs425-g01-" + std::to_string(i) + ".cs.illinois.edu";
+            members.push_back(m);
+        }
+
+        // The old introduction was a single heartbeat carrying every member's full hostname and ID
+        size_t legacy_size = serializer::fixed_size<uint32_t, uint32_t, uint32_t, uint32_t, uint32_t>;
+        for (member const& m : members) {
+            legacy_size += serializer::serialized_size(m.hostname, m.id);
+        }
+
+        hb_message intro(1);
+        intro.make_members_message(members);
+        size_t compact_size = 0;
+        std::vector<string> chunks = intro.serialize_chunks();
+        for (string const& chunk : chunks) {
+            compact_size += chunk.size();
+        }
+
+        string suffix = " with " + std::to_string(group_size) + " members";
+        benchmarking::report("old introduction" + suffix, legacy_size, "bytes");
+        benchmarking::report("compact introduction" + suffix, compact_size, "bytes");
+        benchmarking::report("compact introduction datagrams" + suffix, chunks.size(), "datagrams");
+    }
+});
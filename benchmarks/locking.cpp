@@ -0,0 +1,120 @@
+#include "benchmark.h"
+#include "locking.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+
+namespace {
+const unsigned thread_counts[] = {1, 4, 16};
+const unsigned ops_per_thread = 200000;
+
+// Runs op(thread index, op index) ops_per_thread times on each of num_threads threads, returning total ops per second
+auto measure_throughput(unsigned num_threads, std::function<void(unsigned, unsigned)> const& op) -> double {
+    std::atomic<bool> go = false;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; t++) {
+        threads.push_back(std::thread([&, t] {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (unsigned i = 0; i < ops_per_thread; i++) {
+                op(t, i);
+            }
+        }));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return num_threads * ops_per_thread / elapsed_s;
+}
+
+// Stands in for the membership list, which is copied out by every get_members call
+struct members {
+    std::vector<string> hostnames;
+};
+
+auto make_members() -> members {
+    members m;
+    for (int i = 1; i <= 10; i++) {
+        m.hostnames.push_back("fa19-cs425-g01-" + std::to_string(i) + ".cs.illinois.edu");
+    }
+    return m;
+}
+}
+
+benchmarking::register_benchmark locking_read_mostly("locking.read_mostly",
+    "Compares locked<T> and rw_locked<T> on a membership list that is read 99% of the time",
+    [] (logger::log_level level)
+{
+    for (unsigned num_threads : thread_counts) {
+        locked<members> mutex_members(make_members());
+        double mutex_ops = measure_throughput(num_threads, [&] (unsigned t, unsigned i) {
+            if (i % 100 == 0) {
+                mutex_members()->hostnames[t % 10] = "fa19-cs425-g01-" + std::to_string(i % 10) + ".cs.illinois.edu";
+            } else {
+                std::vector<string> copy = mutex_members()->hostnames;
+                asm volatile("" : : "r"(copy.data()) : "memory");
+            }
+        });
+
+        rw_locked<members> rw_members(make_members());
+        double rw_ops = measure_throughput(num_threads, [&] (unsigned t, unsigned i) {
+            if (i % 100 == 0) {
+                rw_members.write()->hostnames[t % 10] = "fa19-cs425-g01-" + std::to_string(i % 10) + ".cs.illinois.edu";
+            } else {
+                std::vector<string> copy = rw_members.read()->hostnames;
+                asm volatile("" : : "r"(copy.data()) : "memory");
+            }
+        });
+
+        string suffix = " with " + std::to_string(num_threads) + " threads";
+        benchmarking::report("locked" + suffix, mutex_ops, "ops/s");
+        benchmarking::report("rw_locked" + suffix, rw_ops, "ops/s");
+    }
+});
+
+benchmarking::register_benchmark locking_sharded_map("locking.sharded_map",
+    "Compares locked<T> and sharded_locked<T> on a map of jobs updated by many threads at random keys",
+    [] (logger::log_level level)
+{
+    using job_map = std::unordered_map<int, std::unordered_map<string, unsigned>>;
+    const int num_jobs = 64;
+
+    for (unsigned num_threads : thread_counts) {
+        std::vector<std::mt19937> rngs;
+        for (unsigned t = 0; t < num_threads; t++) {
+            rngs.emplace_back(t);
+        }
+
+        locked<job_map> single_jobs;
+        double single_ops = measure_throughput(num_threads, [&] (unsigned t, unsigned i) {
+            int job_id = rngs[t]() % num_jobs;
+            unlocked<job_map> jobs = single_jobs();
+            (*jobs)[job_id]["file_" + std::to_string(i % 16)]++;
+        });
+
+        sharded_locked<job_map> sharded_jobs;
+        double sharded_ops = measure_throughput(num_threads, [&] (unsigned t, unsigned i) {
+            int job_id = rngs[t]() % num_jobs;
+            unlocked<job_map> jobs = sharded_jobs(job_id);
+            (*jobs)[job_id]["file_" + std::to_string(i % 16)]++;
+        });
+
+        string suffix = " with " + std::to_string(num_threads) + " threads";
+        benchmarking::report("locked" + suffix, single_ops, "ops/s");
+        benchmarking::report("sharded_locked" + suffix, sharded_ops, "ops/s");
+    }
+});
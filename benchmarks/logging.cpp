@@ -0,0 +1,161 @@
+#include "benchmark.h"
+#include "logging.h"
+#include "environment.h"
+
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+
+using std::string;
+
+namespace {
+const unsigned num_threads = 32;
+const unsigned calls_per_thread = 20000;
+
+// Logs the way loggers did before lines were buffered: formatting the time with ctime, taking a global lock, and
+// flushing the stream after every line
+class synchronous_logger {
+public:
+    synchronous_logger(string const& path, string const& prefix_)
+        : prefix(prefix_), log_stream(path) {}
+
+    void trace(string const& data) {
+        std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+        time_t tt = std::chrono::system_clock::to_time_t(now);
+        string time = string(ctime(&tt));
+
+        std::lock_guard<std::mutex> guard(log_mutex);
+        string msg = string("[") + time.substr(0, time.length() - 1) + string("] ") + "T " + prefix + string(": ") + data;
+        log_stream << msg << std::endl;
+    }
+
+private:
+    static std::mutex log_mutex;
+    string prefix;
+    std::ofstream log_stream;
+};
+std::mutex synchronous_logger::log_mutex;
+
+// Calls log from num_threads threads at once, returning the number of seconds until every call has returned
+auto run_threads(std::function<void(unsigned, unsigned)> const& log) -> double {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < num_threads; t++) {
+        threads.push_back(std::thread([&, t] {
+            for (unsigned i = 0; i < calls_per_thread; i++) {
+                log(t, i);
+            }
+        }));
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Counts the trace lines in the file, leaving out the lines that report how many were dropped
+auto count_trace_lines(string const& path) -> unsigned {
+    std::ifstream stream(path);
+    unsigned lines = 0;
+    for (string line; std::getline(stream, line);) {
+        if (line.find("] T ") != string::npos) {
+            lines++;
+        }
+    }
+    return lines;
+}
+}
+
+benchmarking::register_benchmark logging_threads("logging.threads",
+    "Measures trace calls per second from 32 threads logging to a file, compared to a synchronous logger",
+    [] (logger::log_level level)
+{
+    char path[] = "/tmp/logging_benchmarkXXXXXX";
+    int fd = mkstemp(path);
+    close(fd);
+
+    double total_calls = num_threads * calls_per_thread;
+    auto message = [] (unsigned t, unsigned i) {
+        return "Appending line " + std::to_string(i) + " from thread " + std::to_string(t) + " to the output file";
+    };
+
+    {
+        synchronous_logger lg(path, "benchmark");
+        double elapsed_s = run_threads([&] (unsigned t, unsigned i) {
+            lg.trace(message(t, i));
+        });
+        benchmarking::report("synchronous calls/sec", total_calls / elapsed_s, "calls/s");
+    }
+
+    std::unique_ptr<environment> env = std::make_unique<environment>(true);
+    env->get<logger_factory>()->configure(logger::log_level::level_trace, path);
+    std::unique_ptr<logger> lg = env->get<logger_factory>()->get_logger("benchmark");
+
+    auto start = std::chrono::steady_clock::now();
+    double elapsed_s = run_threads([&] (unsigned t, unsigned i) {
+        lg->trace(message(t, i));
+    });
+    benchmarking::report("buffered calls/sec", total_calls / elapsed_s, "calls/s");
+
+    // Destroying the environment waits for everything to be written out
+    lg.reset();
+    env.reset();
+    double written_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    benchmarking::report("buffered calls/sec including writing", total_calls / written_s, "calls/s");
+
+    unsigned lines = count_trace_lines(path);
+    benchmarking::report("buffered lines written", lines, "lines");
+    benchmarking::report("buffered calls dropped", total_calls - lines, "calls");
+
+    unlink(path);
+});
+
+benchmarking::register_benchmark logging_disabled("logging.disabled",
+    "Measures the cost of a trace call that is not logged when the message is built eagerly and when it is built lazily",
+    [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(logger::log_level::level_off);
+    std::unique_ptr<logger> lg = env.get<logger_factory>()->get_logger("benchmark");
+
+    const unsigned num_calls = 1000000;
+    string output_file = "wc_hitchhiker/output_file";
+    string input_file = "wc_hitchhiker/input_file";
+
+    std::pair<string, std::function<void(int)>> styles[] = {
+        {"eager concatenation", [&] (int job_id) {
+            lg->trace("[Job " + std::to_string(job_id) + "] Appended values to output file " + output_file +
+                " from input file " + input_file);
+        }},
+        {"lazy arguments", [&] (int job_id) {
+            lg->trace("[Job ", job_id, "] Appended values to output file ", output_file, " from input file ", input_file);
+        }},
+        {"lazy function", [&] (int job_id) {
+            lg->trace([&] {
+                return "[Job " + std::to_string(job_id) + "] Appended values to output file " + output_file +
+                    " from input file " + input_file;
+            });
+        }}
+    };
+
+    for (auto const& [name, log] : styles) {
+        uint64_t allocations_before = benchmarking::allocations();
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < num_calls; i++) {
+            log(i);
+        }
+        double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t allocations = benchmarking::allocations() - allocations_before;
+
+        benchmarking::report(name + " time per call", elapsed_s * 1e9 / num_calls, "ns");
+        benchmarking::report(name + " allocations per call", static_cast<double>(allocations) / num_calls, "allocs");
+    }
+});
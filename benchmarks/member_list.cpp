@@ -0,0 +1,124 @@
+#include "benchmark.h"
+#include "member_list.h"
+#include "environment.h"
+#include "configuration.h"
+
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::string;
+
+namespace {
+const unsigned group_sizes[] = {10, 100, 1000, 5000};
+const unsigned heartbeats_per_measurement = 20000;
+
+auto hostname_for(unsigned i) -> string {
+    return "fa19-cs425-g01-" + std::to_string(i) + ".cs.illinois.edu";
+}
+
+// The linked list that member_list used to be, with just the operations used to process a heartbeat
+class linked_member_list {
+public:
+    ~linked_member_list() {
+        node *next;
+        for (node *cur = head; cur != nullptr; cur = next) {
+            next = cur->next;
+            delete cur;
+        }
+    }
+
+    void add_member(string const& hostname, uint32_t id) {
+        node **cur = &head;
+        while (*cur != nullptr && (*cur)->m.id <= id) {
+            cur = &(*cur)->next;
+        }
+        node *new_node = new node();
+        new_node->m.id = id;
+        new_node->m.hostname = hostname;
+        new_node->next = *cur;
+        *cur = new_node;
+    }
+
+    auto get_member_by_id(uint32_t id) const -> member {
+        for (node *cur = head; cur != nullptr; cur = cur->next) {
+            if (cur->m.id == id) {
+                return cur->m;
+            }
+        }
+        return member();
+    }
+
+    void update_heartbeat(uint32_t id) {
+        for (node *cur = head; cur != nullptr; cur = cur->next) {
+            if (cur->m.id == id) {
+                cur->m.last_heartbeat = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+                return;
+            }
+        }
+    }
+
+private:
+    struct node {
+        member m;
+        node *next;
+    };
+    node *head = nullptr;
+};
+
+// Times process(sender ID) for heartbeats from random members, returning nanoseconds per heartbeat
+auto measure(std::vector<uint32_t> const& ids, std::function<void(uint32_t)> const& process) -> double {
+    std::mt19937 mt(0);
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < heartbeats_per_measurement; i++) {
+        process(ids[mt() % ids.size()]);
+    }
+    double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed_ns / heartbeats_per_measurement;
+}
+}
+
+benchmarking::register_benchmark heartbeat_processing("member_list.heartbeat_processing",
+    "Measures the membership list work done for each heartbeat received, for the old linked list and the sorted vector",
+    [] (logger::log_level level)
+{
+    environment env(false);
+    env.get<configuration>()->set_hostname(hostname_for(0));
+    env.get<logger_factory>()->configure(level);
+
+    for (unsigned group_size : group_sizes) {
+        member_list ml(env);
+        linked_member_list linked;
+        std::vector<uint32_t> ids;
+        for (unsigned i = 0; i < group_size; i++) {
+            uint32_t id = std::hash<string>()(hostname_for(i)) & 0x7FFFFFFF;
+            ml.add_member(hostname_for(i), id);
+            linked.add_member(hostname_for(i), id);
+            ids.push_back(id);
+        }
+        uint32_t our_id = ids[0];
+
+        // Processing a heartbeat checks that we and the sender are in the group, then updates the sender's heartbeat
+        double linked_ns = measure(ids, [&] (uint32_t sender) {
+            if (linked.get_member_by_id(our_id).id == our_id && linked.get_member_by_id(sender).id == sender) {
+                linked.update_heartbeat(sender);
+            }
+        });
+        double vector_ns = measure(ids, [&] (uint32_t sender) {
+            if (ml.has_member(our_id) && ml.has_member(sender)) {
+                ml.update_heartbeat(sender);
+            }
+        });
+        double neighbors_ns = measure(ids, [&] (uint32_t sender) {
+            std::vector<member> neighbors = ml.get_neighbors();
+            asm volatile("" : : "r"(neighbors.data()) : "memory");
+        });
+
+        string suffix = " with " + std::to_string(group_size) + " members";
+        benchmarking::report("linked list heartbeat" + suffix, linked_ns, "ns");
+        benchmarking::report("sorted vector heartbeat" + suffix, vector_ns, "ns");
+        benchmarking::report("get_neighbors" + suffix, neighbors_ns, "ns");
+    }
+});
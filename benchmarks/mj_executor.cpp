@@ -0,0 +1,94 @@
+#include "benchmark.h"
+#include "mj_executor.h"
+#include "processor.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using std::string;
+
+namespace {
+const unsigned num_files = 2000;
+
+// Runs the executable on a file the way workers do without persistent executors, reading its output through a pipe
+auto run_exe(string const& exe, string const& path, processor *proc) -> bool {
+    FILE *stream = popen((exe + " " + path + " " + path).c_str(), "r");
+    if (!stream) {
+        return false;
+    }
+    char *line = nullptr;
+    size_t capacity = 0;
+    for (ssize_t len; (len = getline(&line, &capacity, stream)) > 0;) {
+        proc->process_line(std::string_view(line, line[len - 1] == '\n' ? len - 1 : len));
+    }
+    free(line);
+    return pclose(stream) == 0;
+}
+
+auto count_keys(processor *proc) -> size_t {
+    size_t num_keys = 0;
+    for (auto it = proc->begin(); it != proc->end(); ++it) {
+        num_keys++;
+    }
+    return num_keys;
+}
+}
+
+benchmarking::register_benchmark mj_executor_small_files("mj_executor.small_files",
+    "Measures Maple word count over 2000 small files with an executable run per file and with one persistent executor",
+    [] (logger::log_level level)
+{
+    char dir_template[] = "/tmp/mj_executor_benchmarkXXXXXX";
+    string dir = string(mkdtemp(dir_template)) + "/";
+
+    std::vector<string> paths;
+    for (unsigned i = 0; i < num_files; i++) {
+        paths.push_back(dir + "file_" + std::to_string(i));
+        std::ofstream file(paths.back());
+        file << "the quick brown fox " << i << "\njumps over the lazy dog\n";
+    }
+
+    size_t exe_keys = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (string const& path : paths) {
+        std::unique_ptr<processor> proc = processor_factory::get_processor(processor::type::maple);
+        bool succeeded = run_exe("./mje/wc_maple", path, proc.get());
+        assert(succeeded);
+        exe_keys += count_keys(proc.get());
+    }
+    double exe_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    benchmarking::report("executable total time", exe_s * 1000, "ms");
+    benchmarking::report("executable files/sec", num_files / exe_s, "files/s");
+
+    size_t executor_keys = 0;
+    start = std::chrono::steady_clock::now();
+    {
+        std::unique_ptr<mj_executor> executor = mj_executor::start("./mje/wc_maple_executor");
+        assert(executor);
+        for (string const& path : paths) {
+            std::unique_ptr<processor> proc = processor_factory::get_processor(processor::type::maple);
+            bool succeeded = executor->run_file(path, path, [&] (std::string_view key, std::string_view value) {
+                proc->process_pair(key, value);
+            });
+            assert(succeeded);
+            executor_keys += count_keys(proc.get());
+        }
+    }
+    double executor_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    benchmarking::report("persistent executor total time", executor_s * 1000, "ms");
+    benchmarking::report("persistent executor files/sec", num_files / executor_s, "files/s");
+
+    // Both should have produced the same output
+    assert(exe_keys == executor_keys);
+
+    for (string const& path : paths) {
+        unlink(path.c_str());
+    }
+    rmdir(dir.c_str());
+});
@@ -0,0 +1,142 @@
+#include "benchmark.h"
+#include "mj_plugin.h"
+#include "processor.h"
+
+#include <chrono>
+#include <dirent.h>
+#include <functional>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using std::string;
+
+namespace {
+const string input_dir = "./mje/test_files/wc_hitchhiker_full/";
+
+auto list_inputs() -> std::vector<string> {
+    std::vector<string> files;
+    DIR *d = opendir(input_dir.c_str());
+    for (struct dirent *entry = readdir(d); entry != nullptr; entry = readdir(d)) {
+        if (entry->d_type == DT_REG) {
+            files.push_back(entry->d_name);
+        }
+    }
+    closedir(d);
+    return files;
+}
+
+// Runs the executable on a file the way workers did before plugins, reading its output through a pipe
+auto run_exe(string const& exe, string const& file, processor *proc) -> bool {
+    FILE *stream = popen((exe + " " + input_dir + file + " " + file).c_str(), "r");
+    if (!stream) {
+        return false;
+    }
+    char *line = nullptr;
+    size_t capacity = 0;
+    for (ssize_t len; (len = getline(&line, &capacity, stream)) > 0;) {
+        proc->process_line(std::string_view(line, line[len - 1] == '\n' ? len - 1 : len));
+    }
+    free(line);
+    return pclose(stream) == 0;
+}
+
+// Returns the number of seconds taken to run fn on every file, and the number of keys it produced
+auto time_files(std::vector<string> const& files, std::function<bool(string const&, processor*)> const& fn)
+    -> std::pair<double, size_t>
+{
+    size_t num_keys = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (string const& file : files) {
+        std::unique_ptr<processor> proc = processor_factory::get_processor(processor::type::maple);
+        bool succeeded = fn(file, proc.get());
+        assert(succeeded);
+        for (auto it = proc->begin(); it != proc->end(); ++it) {
+            num_keys++;
+        }
+    }
+    return {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), num_keys};
+}
+}
+
+benchmarking::register_benchmark mj_plugin_word_count("mj_plugin.word_count",
+    "Measures Maple word count over wc_hitchhiker_full with an executable run per file and with a plugin loaded once",
+    [] (logger::log_level level)
+{
+    std::vector<string> files = list_inputs();
+
+    auto [exe_s, exe_keys] = time_files(files, [] (string const& file, processor *proc) {
+        return run_exe("./mje/wc_maple", file, proc);
+    });
+    benchmarking::report("executable total time", exe_s * 1000, "ms");
+    benchmarking::report("executable files/sec", files.size() / exe_s, "files/s");
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<mj_plugin> plugin = mj_plugin::load("./mje/wc_maple.so");
+    assert(plugin);
+    double load_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto [plugin_s, plugin_keys] = time_files(files, [&] (string const& file, processor *proc) {
+        return plugin->run_file(file, input_dir + file, [&] (std::string_view key, std::string_view value) {
+            proc->process_pair(key, value);
+        });
+    });
+    benchmarking::report("plugin load time", load_s * 1000, "ms");
+    benchmarking::report("plugin total time", plugin_s * 1000, "ms");
+    benchmarking::report("plugin files/sec", files.size() / plugin_s, "files/s");
+
+    // Both should have produced the same output
+    assert(exe_keys == plugin_keys);
+});
+
+benchmarking::register_benchmark mj_plugin_combiner("mj_plugin.combiner",
+    "Measures the Maple output of word count over wc_hitchhiker_full that is appended with and without a combiner",
+    [] (logger::log_level level)
+{
+    std::vector<string> files = list_inputs();
+    std::unique_ptr<mj_plugin> maple = mj_plugin::load("./mje/wc_maple.so");
+    std::unique_ptr<mj_plugin> combiner = mj_plugin::load("./mje/wc_juice.so");
+    assert(maple && combiner);
+
+    uint64_t values = 0, value_bytes = 0;
+    uint64_t combined_values = 0, combined_bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (string const& file : files) {
+        // Emit a 1 for each word rather than counts, the way a Maple without any combining would
+        std::unique_ptr<processor> proc = processor_factory::get_processor(processor::type::maple);
+        maple->run_file(file, input_dir + file, [&] (std::string_view key, std::string_view value) {
+            for (int i = std::stoi(string(value)); i > 0; i--) {
+                proc->process_pair(key, "1");
+            }
+        });
+
+        // Then combine the values of each key the same way mj_worker does
+        std::unique_ptr<processor> combined = processor_factory::get_processor(processor::type::maple);
+        string joined;
+        for (auto const& [key, vals] : *proc) {
+            joined.clear();
+            for (string const& val : vals) {
+                joined.append(val).append("\n");
+                values++;
+                value_bytes += val.size() + 1;
+            }
+            combiner->run(key, joined, [&] (std::string_view key, std::string_view value) {
+                combined->process_pair(key, value);
+            });
+        }
+        for (auto const& [key, vals] : *combined) {
+            combined_values += vals.size();
+            for (string const& val : vals) {
+                combined_bytes += val.size() + 1;
+            }
+        }
+    }
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    benchmarking::report("values appended without combiner", values, "values");
+    benchmarking::report("bytes appended without combiner", value_bytes, "bytes");
+    benchmarking::report("values appended with combiner", combined_values, "values");
+    benchmarking::report("bytes appended with combiner", combined_bytes, "bytes");
+    benchmarking::report("total time with combiner", elapsed_s * 1000, "ms");
+});
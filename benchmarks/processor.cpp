@@ -0,0 +1,82 @@
+#include "benchmark.h"
+#include "processor.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+using std::string;
+
+namespace {
+// The synthetic Maple output, which is scaled down from a 10GB input to fit in the sandbox
+const uint64_t output_bytes = 256ull << 20;
+const unsigned num_keys = 1000000;
+const uint64_t memory_budget = 16ull << 20;
+
+// Reads the peak resident set size of the process in KB
+auto peak_rss_kb() -> uint64_t {
+    std::ifstream status("/proc/self/status");
+    for (string line; std::getline(status, line);) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stoull(line.substr(6));
+        }
+    }
+    return 0;
+}
+
+// Resets the peak resident set size to the current one, returning false if the kernel does not support it
+auto reset_peak_rss() -> bool {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return clear_refs.good();
+}
+
+// Feeds the synthetic output through a processor and reads it back, reporting the time taken and the peak RSS
+void measure(string const& name, uint64_t budget, string const& spill_dir) {
+    bool reset = reset_peak_rss();
+    uint64_t rss_before = peak_rss_kb();
+    auto start = std::chrono::steady_clock::now();
+
+    uint64_t values_out = 0;
+    unsigned runs;
+    {
+        std::unique_ptr<processor> proc = processor_factory::get_processor(processor::type::maple, budget, spill_dir);
+        string value(100, 'v');
+        uint64_t values_in = output_bytes / value.size();
+        for (uint64_t i = 0; i < values_in; i++) {
+            proc->process_pair("key_" + std::to_string((i * 7919) % num_keys), value);
+        }
+        runs = dynamic_cast<maple_processor*>(proc.get())->num_spilled_runs();
+
+        for (auto const& [key, vals] : *proc) {
+            values_out += vals.size();
+        }
+        assert(values_out == values_in);
+    }
+
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    benchmarking::report(name + " total time", elapsed_s * 1000, "ms");
+    benchmarking::report(name + " runs spilled", runs, "runs");
+    if (reset) {
+        benchmarking::report(name + " peak RSS increase", (peak_rss_kb() - rss_before) / 1024.0, "MB");
+    }
+}
+}
+
+benchmarking::register_benchmark processor_spill_rss("processor.spill_rss",
+    "Measures the peak RSS of grouping 256MB of Maple output in memory and with a 16MB budget that spills to disk",
+    [] (logger::log_level level)
+{
+    char dir_template[] = "/tmp/processor_benchmarkXXXXXX";
+    string dir = string(mkdtemp(dir_template)) + "/";
+
+    // Spilling goes first so that memory freed by the unlimited run can't hide its peak if the reset is unsupported
+    measure("16MB budget", memory_budget, dir);
+    measure("unlimited", 0, dir);
+
+    rmdir(dir.c_str());
+});
@@ -0,0 +1,183 @@
+#include "benchmark.h"
+#include "hb_messages.h"
+#include "election_messages.h"
+#include "mj_messages.h"
+#include "sdfs_message.h"
+#include "serialization.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+using std::string;
+
+namespace {
+const int num_iterations = 200000;
+
+// Runs fn iterations times, reporting the mean time and number of heap allocations per call
+void measure(string const& name, std::function<void()> const& fn, int iterations = num_iterations) {
+    // Warm up caches and any buffers that fn reuses
+    for (int i = 0; i < std::min(iterations, 1000); i++) {
+        fn();
+    }
+
+    uint64_t start_allocations = benchmarking::allocations();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    uint64_t total_allocations = benchmarking::allocations() - start_allocations;
+
+    benchmarking::report(name + " time", elapsed_ns / iterations, "ns/msg");
+    benchmarking::report(name + " allocations", static_cast<double>(total_allocations) / iterations, "allocs/msg");
+}
+
+// Measures serializing msg into a new string, serializing it into a reused buffer, and parsing it back
+template <typename Message>
+void measure_message(string const& name, Message const& msg) {
+    measure(name + " serialize", [&] {
+        string str = msg.serialize();
+        asm volatile("" : : "r"(str.data()) : "memory");
+    });
+
+    string buf;
+    measure(name + " serialize into buffer", [&] {
+        buf.clear();
+        msg.serialize(buf);
+        asm volatile("" : : "r"(buf.data()) : "memory");
+    });
+
+    string serialized = msg.serialize();
+    measure(name + " parse", [&] {
+        Message parsed(serialized.data(), serialized.length());
+        asm volatile("" : : "r"(&parsed) : "memory");
+    });
+}
+
+// Field by field encoding of ASSIGN_JOB, as mj_message did before the encoding was generated from the field list
+void encode_assign_job_by_hand(uint32_t id, mj_assign_job const& d, string &buf) {
+    serializer ser(buf);
+    size_t size = serializer::serialized_size(id, mj_message::ASSIGN_JOB, d.job_id, d.exe, d.sdfs_src_dir,
+        d.input_files.size(), d.processor_type, d.sdfs_output_dir, d.num_files_parallel, d.num_appends_parallel);
+    for (string const& file : d.input_files) {
+        size += serializer::serialized_size(file);
+    }
+    buf.reserve(buf.size() + size);
+
+    ser.add_fields(id, mj_message::ASSIGN_JOB, d.job_id, d.exe, d.sdfs_src_dir, d.input_files.size());
+    for (string const& file : d.input_files) {
+        ser.add_field(file);
+    }
+    ser.add_fields(d.processor_type, d.sdfs_output_dir, d.num_files_parallel, d.num_appends_parallel);
+}
+
+auto decode_assign_job_by_hand(string const& buf) -> mj_assign_job {
+    deserializer des(buf);
+    des.get_int(); // id
+    des.get_int(); // msg_type
+
+    mj_assign_job d;
+    d.job_id = des.get_int();
+    d.exe = des.get_string();
+    d.sdfs_src_dir = des.get_string();
+    int num_input_files = des.get_int();
+    for (int i = 0; i < num_input_files; i++) {
+        d.input_files.emplace_back(des.get_string());
+    }
+    d.processor_type = static_cast<processor::type>(des.get_int());
+    d.sdfs_output_dir = des.get_string();
+    d.num_files_parallel = des.get_int();
+    d.num_appends_parallel = des.get_int();
+    des.done();
+    return d;
+}
+}
+
+benchmarking::register_benchmark serialization_messages("serialization.messages",
+    "Measures the time and heap allocations needed to serialize and parse each kind of message",
+    [] (logger::log_level level)
+{
+    hb_message hb_msg(1234);
+    std::vector<member> joined;
+    for (int i = 1; i <= 10; i++) {
+        member m;
+        m.hostname = "fa19-cs425-g01-" + std::to_string(i) + ".cs.illinois.edu";
+        m.id = 1000 + i;
+        joined.push_back(m);
+    }
+    hb_msg.set_joined_nodes(joined);
+    hb_msg.set_failed_nodes({11, 12});
+    hb_msg.set_left_nodes({13});
+    measure_message("heartbeat with 10 joins", hb_msg);
+
+    election_message election_msg(1234, 5678);
+    election_msg.set_type_election(1234, 4321);
+    measure_message("election", election_msg);
+
+    mj_message append_perm_msg(1234, mj_request_append_perm{1, "fa19-cs425-g01-01.cs.illinois.edu",
+        "wc_hitchhiker/hitchhiker_1", "intermediate_prefix_the"});
+    measure_message("mj REQUEST_APPEND_PERM", append_perm_msg);
+
+    std::vector<string> input_files;
+    for (int i = 0; i < 20; i++) {
+        input_files.push_back("wc_hitchhiker/hitchhiker_" + std::to_string(i));
+    }
+    mj_message assign_msg(1234, mj_assign_job{1, "wc_maple", "wc_hitchhiker", input_files,
+        processor::type::maple, "intermediate_prefix", 5, 10, 0, "", 0});
+    measure_message("mj ASSIGN_JOB with 20 files", assign_msg);
+
+    sdfs_message sdfs_msg;
+    sdfs_msg.set_type_append("intermediate_prefix_the", "maplejuice metadata");
+    measure_message("sdfs append", sdfs_msg);
+});
+
+benchmarking::register_benchmark serialization_mj_assign_job_codec("serialization.mj_assign_job_codec",
+    "Compares the generated mj_message codec against hand written field by field code on ASSIGN_JOB with thousands of files",
+    [] (logger::log_level level)
+{
+    for (int num_files : {1000, 5000}) {
+        std::vector<string> input_files;
+        for (int i = 0; i < num_files; i++) {
+            input_files.push_back("wc_hitchhiker/hitchhiker_" + std::to_string(i));
+        }
+        mj_assign_job assign{1, "wc_maple", "wc_hitchhiker", input_files, processor::type::maple,
+            "intermediate_prefix", 5, 10};
+        mj_message msg(1234, assign);
+        int iterations = 2000000 / num_files;
+        string prefix = "ASSIGN_JOB with " + std::to_string(num_files) + " files ";
+
+        // The generated codec must produce exactly the same bytes as the hand written one
+        string by_hand;
+        encode_assign_job_by_hand(1234, assign, by_hand);
+        string generated = msg.serialize();
+        assert(by_hand == generated);
+        mj_message parsed(by_hand.data(), by_hand.length());
+        assert(parsed.is_well_formed());
+        assert(parsed.get_msg_data<mj_assign_job>().input_files == input_files);
+
+        string buf;
+        measure(prefix + "encode by hand", [&] {
+            buf.clear();
+            encode_assign_job_by_hand(1234, assign, buf);
+            asm volatile("" : : "r"(buf.data()) : "memory");
+        }, iterations);
+        measure(prefix + "encode generated", [&] {
+            buf.clear();
+            msg.serialize(buf);
+            asm volatile("" : : "r"(buf.data()) : "memory");
+        }, iterations);
+
+        measure(prefix + "decode by hand", [&] {
+            mj_assign_job d = decode_assign_job_by_hand(generated);
+            asm volatile("" : : "r"(&d) : "memory");
+        }, iterations);
+        measure(prefix + "decode generated", [&] {
+            mj_message m(generated.data(), generated.length());
+            asm volatile("" : : "r"(&m) : "memory");
+        }, iterations);
+    }
+});
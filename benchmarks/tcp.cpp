@@ -0,0 +1,465 @@
+#include "benchmark.h"
+#include "tcp.h"
+#include "environment.h"
+#include "configuration.h"
+#include "mj_messages.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::unique_ptr;
+
+namespace {
+const int num_connections = 10000;
+const int round_trips_per_connection = 4;
+const int bench_timeout_s = 120;
+const string payload = "ping";
+
+struct load_result {
+    int completed = 0;
+    int failed = 0;
+    double elapsed_s = 0;
+};
+
+// Raises the open file limit as far as possible and returns the number of connections that can be opened,
+// given that both ends of every connection live in this process
+auto raise_fd_limit() -> int {
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+
+    return std::min<rlim_t>(num_connections, (limit.rlim_cur - 64) / 2);
+}
+
+// Opens n concurrent connections to the local port from a single epoll thread, and has each one
+// perform round_trips_per_connection echo round trips before closing
+auto run_load(int port, int n) -> load_result {
+    struct client {
+        int fd;
+        int rounds_left;
+        bool connected;
+        string recv_buf;
+    };
+
+    load_result result;
+    std::vector<client> clients(n);
+    int epoll_fd = epoll_create1(0);
+
+    uint32_t nsize = htonl(payload.length());
+    string frame = string(reinterpret_cast<char*>(&nsize), sizeof(uint32_t)) + payload;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    auto finish = [&] (int i, bool success) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, clients[i].fd, NULL);
+        close(clients[i].fd);
+        clients[i].fd = -1;
+        (success ? result.completed : result.failed)++;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        clients[i].fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        clients[i].rounds_left = round_trips_per_connection;
+        clients[i].connected = false;
+
+        if (clients[i].fd < 0) {
+            result.failed++;
+            continue;
+        }
+
+        connect(clients[i].fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+
+        struct epoll_event ev;
+        ev.events = EPOLLOUT | EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, clients[i].fd, &ev);
+    }
+
+    struct epoll_event events[256];
+    while (result.completed + result.failed < n) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed > std::chrono::seconds(bench_timeout_s)) {
+            break;
+        }
+
+        int num_events = epoll_wait(epoll_fd, events, 256, 100);
+        for (int e = 0; e < num_events; e++) {
+            int i = events[e].data.u32;
+            client &c = clients[i];
+            if (c.fd < 0) {
+                continue;
+            }
+
+            if (!c.connected && (events[e].events & EPOLLOUT)) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0) {
+                    finish(i, false);
+                    continue;
+                }
+
+                // Only wait for replies from now on
+                c.connected = true;
+                struct epoll_event ev;
+                ev.events = EPOLLIN;
+                ev.data.u32 = i;
+                epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+
+                if (send(c.fd, frame.c_str(), frame.length(), MSG_NOSIGNAL) != static_cast<ssize_t>(frame.length())) {
+                    finish(i, false);
+                }
+                continue;
+            }
+
+            if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                char buf[64];
+                ssize_t r = read(c.fd, buf, sizeof(buf));
+                if (r <= 0) {
+                    if (r < 0 && errno == EAGAIN) {
+                        continue;
+                    }
+                    finish(i, false);
+                    continue;
+                }
+
+                c.recv_buf.append(buf, r);
+                if (c.recv_buf.length() < frame.length()) {
+                    continue;
+                }
+
+                c.recv_buf.clear();
+                if (--c.rounds_left == 0) {
+                    finish(i, true);
+                } else if (send(c.fd, frame.c_str(), frame.length(), MSG_NOSIGNAL) != static_cast<ssize_t>(frame.length())) {
+                    finish(i, false);
+                }
+            }
+        }
+    }
+    result.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Anything still open timed out
+    for (int i = 0; i < n; i++) {
+        if (clients[i].fd >= 0) {
+            finish(i, false);
+        }
+    }
+    close(epoll_fd);
+
+    return result;
+}
+
+void report_load(string const& server_name, int n, load_result const& result) {
+    benchmarking::report(server_name + " connections completed", result.completed, "/ " + std::to_string(n));
+    benchmarking::report(server_name + " connections failed or timed out", result.failed, "");
+    benchmarking::report(server_name + " wall time", result.elapsed_s, "s");
+    benchmarking::report(server_name + " round trips per second",
+        result.completed * round_trips_per_connection / result.elapsed_s, "msg/s");
+}
+}
+
+benchmarking::register_benchmark event_server_connections("tcp.event_server_connections",
+    "Compares tcp_event_server against the thread per connection tcp_server with 10k concurrent echo clients",
+    [] (logger::log_level level)
+{
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    tcp_factory *fac = env.get<tcp_factory>();
+
+    int n = raise_fd_limit();
+    benchmarking::report("concurrent connections", n, "");
+
+    { // Event loop server with a small fixed pool of handler threads
+        unique_ptr<tcp_event_server> server = fac->get_tcp_event_server(15001, 4);
+        tcp_event_server *server_ptr = server.get();
+        server->start([server_ptr] (int client, string const& msg) {
+            server_ptr->write_to_client(client, msg);
+        });
+
+        report_load("tcp_event_server", n, run_load(15001, n));
+        server->stop();
+    }
+
+    { // Blocking server with one thread per accepted connection
+        unique_ptr<tcp_server> server = fac->get_tcp_server(15002);
+        std::atomic<bool> accepting(true);
+        std::atomic<int> active_threads(0);
+        std::atomic<int> failed_threads(0);
+
+        std::thread accept_thread([&] {
+            while (accepting.load()) {
+                int fd = server->accept_connection();
+                if (fd < 0) {
+                    continue;
+                }
+
+                active_threads++;
+                try {
+                    std::thread client_thread([&, fd] {
+                        for (string msg; (msg = server->read_from_client(fd)) != "";) {
+                            server->write_to_client(fd, msg);
+                        }
+                        server->close_connection(fd);
+                        active_threads--;
+                    });
+                    client_thread.detach();
+                } catch (std::system_error const&) {
+                    // We ran out of threads, which is exactly the failure mode being measured
+                    server->close_connection(fd);
+                    active_threads--;
+                    failed_threads++;
+                }
+            }
+        });
+
+        report_load("tcp_server", n, run_load(15002, n));
+        benchmarking::report("tcp_server threads that failed to spawn", failed_threads.load(), "");
+
+        // Wake up the accept thread with one last connection so that it notices it should exit
+        accepting = false;
+        unique_ptr<tcp_client> waker = fac->get_tcp_client("127.0.0.1", 15002);
+        accept_thread.join();
+        waker.reset();
+
+        while (active_threads.load() > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+});
+
+benchmarking::register_benchmark pooled_client_latency("tcp.pooled_client_latency",
+    "Compares the round trip latency of a new tcp_client per message against a pooled client",
+    [] (logger::log_level level)
+{
+    const int num_messages = 2000;
+
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    tcp_factory *fac = env.get<tcp_factory>();
+
+    unique_ptr<tcp_event_server> server = fac->get_tcp_event_server(15003, 4);
+    tcp_event_server *server_ptr = server.get();
+    server->start([server_ptr] (int client, string const& msg) {
+        server_ptr->write_to_client(client, msg);
+    });
+
+    auto measure = [&] (string const& name, std::function<unique_ptr<tcp_client>()> const& get_client) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < num_messages; i++) {
+            unique_ptr<tcp_client> client = get_client();
+            client->write_to_server(payload);
+            string reply = client->read_from_server();
+            assert(reply == payload);
+        }
+        double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        benchmarking::report(name + " mean round trip", elapsed_us / num_messages, "us");
+    };
+
+    measure("new connection per message", [&] {
+        return fac->get_tcp_client("127.0.0.1", 15003);
+    });
+    measure("pooled connection", [&] {
+        return fac->get_pooled_tcp_client("127.0.0.1", 15003);
+    });
+
+    server->stop();
+});
+
+namespace {
+// Sends the file the way SDFS did before zero-copy transfers, copying each CHUNK_SIZE slice into its own message
+void send_file_chunked(tcp_client *client, int fd, size_t size) {
+    char *contents = static_cast<char*>(mmap(0, size, PROT_READ, MAP_SHARED, fd, 0));
+    client->write_to_server(std::to_string(size));
+    for (size_t pos = 0; pos < size; pos += CHUNK_SIZE) {
+        client->write_to_server(string(contents + pos, std::min<size_t>(CHUNK_SIZE, size - pos)));
+    }
+    munmap(contents, size);
+}
+
+// Receives a file sent by send_file_chunked, copying each message into an mmapped region of the file
+auto receive_file_chunked(tcp_server *server, int client, int fd) -> size_t {
+    size_t size = std::stoul(server->read_from_client(client));
+    ftruncate(fd, size);
+    char *contents = static_cast<char*>(mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    for (size_t pos = 0; pos < size;) {
+        string data = server->read_from_client(client);
+        memcpy(contents + pos, data.c_str(), data.length());
+        pos += data.length();
+    }
+    munmap(contents, size);
+    return size;
+}
+
+// Returns an anonymous temporary file which disappears once closed
+auto make_temp_file() -> int {
+    char path[] = "/tmp/tcp_benchmarkXXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    return fd;
+}
+}
+
+benchmarking::register_benchmark file_transfer_throughput("tcp.file_transfer_throughput",
+    "Compares sending a 1 GB file over loopback as chunked messages against sendfile and splice",
+    [] (logger::log_level level)
+{
+    const size_t file_size = 1UL << 30;
+
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    tcp_factory *fac = env.get<tcp_factory>();
+
+    int src_fd = make_temp_file();
+    string block(1 << 20, 'x');
+    for (size_t pos = 0; pos < file_size; pos += block.length()) {
+        ssize_t written = pwrite(src_fd, block.c_str(), block.length(), pos);
+        assert(written == static_cast<ssize_t>(block.length()));
+    }
+
+    auto measure = [&] (string const& name, int port,
+        std::function<void(tcp_client*)> const& send, std::function<size_t(tcp_server*, int, int)> const& receive)
+    {
+        unique_ptr<tcp_server> server = fac->get_tcp_server(port);
+        int dest_fd = make_temp_file();
+        size_t received = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        std::thread server_thread([&] {
+            int client = server->accept_connection();
+            received = receive(server.get(), client, dest_fd);
+            server->close_connection(client);
+        });
+
+        unique_ptr<tcp_client> client = fac->get_tcp_client("127.0.0.1", port);
+        send(client.get());
+        server_thread.join();
+        double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        assert(received == file_size);
+        close(dest_fd);
+        benchmarking::report(name + " throughput", file_size / elapsed_s / (1 << 20), "MB/s");
+    };
+
+    measure("chunked messages", 15004,
+        [&] (tcp_client *client) {send_file_chunked(client, src_fd, file_size);},
+        [&] (tcp_server *server, int client, int fd) {return receive_file_chunked(server, client, fd);});
+    measure("sendfile and splice", 15005,
+        [&] (tcp_client *client) {client->write_file_to_server(src_fd, file_size);},
+        [&] (tcp_server *server, int client, int fd) -> size_t {return server->read_file_from_client(client, fd);});
+
+    close(src_fd);
+});
+
+namespace {
+// Reads a length prefixed message from the socket, returning an empty string if the connection failed
+auto read_raw_message(int fd) -> string {
+    uint32_t nsize;
+    if (recv(fd, &nsize, sizeof(nsize), MSG_WAITALL) != sizeof(nsize)) {
+        return "";
+    }
+
+    string msg(ntohl(nsize), '\0');
+    if (recv(fd, &msg[0], msg.length(), MSG_WAITALL) != static_cast<ssize_t>(msg.length())) {
+        return "";
+    }
+    return msg;
+}
+}
+
+benchmarking::register_benchmark append_perm_latency("tcp.append_perm_latency",
+    "Measures the REQUEST_APPEND_PERM / APPEND_PERM round trip with separate and gathered writes, with and without TCP_NODELAY",
+    [] (logger::log_level level)
+{
+    const int num_round_trips = 100;
+
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    tcp_factory *fac = env.get<tcp_factory>();
+
+    string request = mj_message(1, mj_request_append_perm{1, "127.0.0.1", "input_file", "output_file"}).serialize();
+    string reply = mj_message(2, mj_append_perm{1}).serialize();
+
+    // Runs a server that answers every request with an APPEND_PERM, measuring the round trips made by run_client
+    auto measure = [&] (string const& name, int port, bool nodelay, std::function<void()> const& run_client) {
+        fac->configure(nodelay, false);
+        unique_ptr<tcp_server> server = fac->get_tcp_server(port);
+        std::thread server_thread([&] {
+            int client = server->accept_connection();
+            for (string msg; (msg = server->read_from_client(client)) != "";) {
+                server->write_to_client(client, reply);
+            }
+            server->close_connection(client);
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        run_client();
+        double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        server_thread.join();
+
+        benchmarking::report(name + " mean round trip", elapsed_us / num_round_trips, "us");
+    };
+
+    // How tcp_client used to send messages, with the length prefix and body in separate write calls
+    measure("separate header and body writes with Nagle", 15006, false, [&] {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(15006);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+
+        uint32_t nsize = htonl(request.length());
+        for (int i = 0; i < num_round_trips; i++) {
+            write(fd, &nsize, sizeof(nsize));
+            write(fd, request.c_str(), request.length());
+            string received = read_raw_message(fd);
+            assert(received == reply);
+        }
+        close(fd);
+    });
+
+    auto run_tcp_client = [&] (int port) {
+        unique_ptr<tcp_client> client = fac->get_tcp_client("127.0.0.1", port);
+        for (int i = 0; i < num_round_trips; i++) {
+            client->write_to_server(request);
+            string received = client->read_from_server();
+            assert(received == reply);
+        }
+    };
+    measure("gathered writes with Nagle", 15007, false, [&] {run_tcp_client(15007);});
+    measure("gathered writes with TCP_NODELAY", 15008, true, [&] {run_tcp_client(15008);});
+
+    fac->configure(true, false);
+});
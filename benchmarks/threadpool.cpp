@@ -0,0 +1,69 @@
+#include "benchmark.h"
+#include "threadpool.h"
+#include "environment.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <string>
+
+using std::string;
+
+namespace {
+const unsigned thread_counts[] = {1, 4, 16, 64};
+
+// Enqueues num_tasks copies of task from a single thread and waits for all of them, returning tasks per second
+auto measure_throughput(std::function<std::unique_ptr<threadpool>(unsigned)> const& get_threadpool, unsigned num_threads,
+    unsigned num_tasks, std::function<void()> const& task) -> double
+{
+    std::unique_ptr<threadpool> tp = get_threadpool(num_threads);
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < num_tasks; i++) {
+        tp->enqueue(task);
+    }
+    tp->finish();
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return num_tasks / elapsed_s;
+}
+}
+
+benchmarking::register_benchmark threadpool_throughput("threadpool.throughput",
+    "Compares the task throughput of the locked queue and work stealing threadpools with tiny and large tasks",
+    [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(level);
+    threadpool_factory *tp_fac = env.get<threadpool_factory>();
+
+    std::atomic<unsigned> counter = 0;
+    auto tiny_task = [&] {
+        counter++;
+    };
+    // Roughly 50us of work on a modern CPU
+    auto large_task = [&] {
+        volatile double x = 1.0;
+        for (int i = 0; i < 20000; i++) {
+            x = std::sqrt(x + i);
+        }
+        counter++;
+    };
+
+    std::pair<string, std::function<std::unique_ptr<threadpool>(unsigned)>> impls[] = {
+        {"locked queue", [&] (unsigned n) {return tp_fac->get_threadpool(n);}},
+        {"work stealing", [&] (unsigned n) {return tp_fac->get_work_stealing_threadpool(n);}}
+    };
+
+    for (unsigned num_threads : thread_counts) {
+        for (auto const& [name, get_threadpool] : impls) {
+            string prefix = name + " with " + std::to_string(num_threads) + " threads";
+            benchmarking::report(prefix + " tiny tasks",
+                measure_throughput(get_threadpool, num_threads, 200000, tiny_task), "tasks/s");
+            benchmarking::report(prefix + " large tasks",
+                measure_throughput(get_threadpool, num_threads, 2000, large_task), "tasks/s");
+        }
+    }
+});
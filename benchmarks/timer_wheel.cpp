@@ -0,0 +1,80 @@
+#include "benchmark.h"
+#include "timer_wheel.h"
+#include "environment.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+benchmarking::register_benchmark timer_wheel_schedule_cancel("timer_wheel.schedule_cancel",
+    "Measures the cost of scheduling and cancelling timers as the number of pending timers grows",
+    [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(level);
+    timer_wheel *tw = env.get<timer_wheel>();
+
+    for (unsigned num_timers : {1000, 10000, 100000}) {
+        std::vector<timer_id> ids;
+        ids.reserve(num_timers);
+
+        // Spread the delays over every level of the wheel, far enough out that none of them fire
+        auto start = steady_clock::now();
+        for (unsigned i = 0; i < num_timers; i++) {
+            ids.push_back(tw->schedule(60000 + (i * 7919) % 3600000, [] {}));
+        }
+        double schedule_s = duration<double>(steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        for (timer_id id : ids) {
+            tw->cancel(id);
+        }
+        double cancel_s = duration<double>(steady_clock::now() - start).count();
+
+        std::string suffix = " (" + std::to_string(num_timers) + " timers)";
+        benchmarking::report("schedule" + suffix, schedule_s * 1e9 / num_timers, "ns/op");
+        benchmarking::report("cancel" + suffix, cancel_s * 1e9 / num_timers, "ns/op");
+    }
+});
+
+benchmarking::register_benchmark timer_wheel_lateness("timer_wheel.lateness",
+    "Measures how late one shot timers fire relative to their deadlines, compared to a thread polling every 100ms",
+    [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(level);
+    timer_wheel *tw = env.get<timer_wheel>();
+
+    const unsigned num_timers = 200;
+    std::vector<std::atomic<int64_t>> lateness_us(num_timers);
+    std::atomic<unsigned> fired = 0;
+
+    auto start = steady_clock::now();
+    for (unsigned i = 0; i < num_timers; i++) {
+        uint64_t delay_ms = 10 + (i * 37) % 2000;
+        tw->schedule(delay_ms, [&, i, delay_ms] {
+            auto deadline = start + milliseconds(delay_ms);
+            lateness_us[i] = duration_cast<microseconds>(steady_clock::now() - deadline).count();
+            fired++;
+        });
+    }
+    while (fired.load() < num_timers) {
+        std::this_thread::sleep_for(milliseconds(50));
+    }
+
+    std::vector<int64_t> sorted;
+    for (auto const& l : lateness_us) {
+        sorted.push_back(l.load());
+    }
+    std::sort(sorted.begin(), sorted.end());
+    benchmarking::report("median lateness", sorted[num_timers / 2] / 1000.0, "ms");
+    benchmarking::report("p99 lateness", sorted[num_timers * 99 / 100] / 1000.0, "ms");
+
+    // A thread that sleeps 100ms between checks is on average 50ms late, and up to 100ms late
+    benchmarking::report("expected lateness when polling every 100ms", 50.0, "ms");
+});
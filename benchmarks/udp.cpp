@@ -0,0 +1,157 @@
+#include "benchmark.h"
+#include "udp.h"
+#include "environment.h"
+#include "configuration.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using std::string;
+
+namespace {
+const unsigned member_counts[] = {5, 50, 500};
+// The number of heartbeat packets sent for each measurement, spread over as many intervals as it takes
+const unsigned packets_per_measurement = 20000;
+
+// Sends a packet the way udp_client_impl used to, resolving the host and opening a new socket for every packet
+void send_with_new_socket(string const& host, int port, string const& msg) {
+    struct addrinfo info, *res;
+    memset(&info, 0, sizeof(info));
+    info.ai_family = AF_INET;
+    info.ai_socktype = SOCK_DGRAM;
+    info.ai_protocol = IPPROTO_UDP;
+
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &info, &res) != 0) {
+        return;
+    }
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    sendto(fd, msg.c_str(), msg.length(), 0, res->ai_addr, res->ai_addrlen);
+    close(fd);
+    freeaddrinfo(res);
+}
+
+// Runs send_interval(hosts) enough times to send packets_per_measurement packets, returning microseconds per interval
+auto measure_interval(std::vector<string> const& hosts, std::function<void(std::vector<string> const&)> const& send_interval) -> double {
+    unsigned num_intervals = packets_per_measurement / hosts.size();
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < num_intervals; i++) {
+        send_interval(hosts);
+    }
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    return elapsed_us / num_intervals;
+}
+}
+
+benchmarking::register_benchmark heartbeat_fanout("udp.heartbeat_fanout",
+    "Measures the cost of sending one heartbeat to every member, with a new socket per packet, with a reused socket, and with sendmmsg",
+    [] (logger::log_level level)
+{
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    std::unique_ptr<udp_client> client = env.get<udp_factory>()->get_udp_client();
+
+    // Bind a socket to receive the heartbeats, so that they are delivered rather than answered with ICMP errors
+    int server_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in server_sa;
+    memset(&server_sa, 0, sizeof(server_sa));
+    server_sa.sin_family = AF_INET;
+    server_sa.sin_addr.s_addr = htonl(INADDR_ANY);
+    server_sa.sin_port = 0;
+    bind(server_fd, reinterpret_cast<struct sockaddr*>(&server_sa), sizeof(server_sa));
+    socklen_t sa_len = sizeof(server_sa);
+    getsockname(server_fd, reinterpret_cast<struct sockaddr*>(&server_sa), &sa_len);
+    int port = ntohs(server_sa.sin_port);
+
+    // A heartbeat carrying no updates is a few dozen bytes
+    string msg(40, 'h');
+
+    for (unsigned num_members : member_counts) {
+        // Every member gets its own loopback address, so that each one is resolved separately
+        std::vector<string> hosts;
+        for (unsigned i = 0; i < num_members; i++) {
+            hosts.push_back("127.0." + std::to_string(i / 250) + "." + std::to_string(i % 250 + 1));
+        }
+
+        double new_socket_us = measure_interval(hosts, [&] (std::vector<string> const& hosts) {
+            for (string const& host : hosts) {
+                send_with_new_socket(host, port, msg);
+            }
+        });
+        double send_us = measure_interval(hosts, [&] (std::vector<string> const& hosts) {
+            for (string const& host : hosts) {
+                client->send(host, port, msg);
+            }
+        });
+        double send_all_us = measure_interval(hosts, [&] (std::vector<string> const& hosts) {
+            client->send_all(hosts, port, msg);
+        });
+
+        string suffix = " with " + std::to_string(num_members) + " members";
+        benchmarking::report("new socket per packet" + suffix, new_socket_us, "us/interval");
+        benchmarking::report("reused socket" + suffix, send_us, "us/interval");
+        benchmarking::report("sendmmsg" + suffix, send_all_us, "us/interval");
+    }
+
+    close(server_fd);
+});
+
+benchmarking::register_benchmark batched_receive("udp.batched_receive",
+    "Compares receiving queued heartbeats one at a time with recv against receiving them in batches with recv_batch",
+    [] (logger::log_level level)
+{
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    std::unique_ptr<udp_client> client = env.get<udp_factory>()->get_udp_client();
+    std::unique_ptr<udp_server> server = env.get<udp_factory>()->get_udp_server();
+
+    const int port = 15327;
+    // Few enough packets per round that they all fit in the default socket receive buffer and none are dropped
+    const unsigned packets_per_round = 100;
+    const unsigned num_rounds = 1000;
+
+    server->start_server(port);
+    std::vector<string> hosts(packets_per_round, "127.0.0.1");
+    string msg(40, 'h');
+
+    char buf[1024];
+    std::chrono::duration<double> recv_time(0);
+    for (unsigned round = 0; round < num_rounds; round++) {
+        client->send_all(hosts, port, msg);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < packets_per_round; i++) {
+            server->recv(buf, 1024);
+        }
+        recv_time += std::chrono::steady_clock::now() - start;
+    }
+
+    std::vector<std::string_view> packets;
+    std::chrono::duration<double> recv_batch_time(0);
+    for (unsigned round = 0; round < num_rounds; round++) {
+        client->send_all(hosts, port, msg);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned received = 0; received < packets_per_round;) {
+            received += server->recv_batch(packets);
+        }
+        recv_batch_time += std::chrono::steady_clock::now() - start;
+    }
+
+    server->stop_server();
+
+    benchmarking::report("recv", packets_per_round * num_rounds / recv_time.count(), "packets/s");
+    benchmarking::report("recv_batch", packets_per_round * num_rounds / recv_batch_time.count(), "packets/s");
+});
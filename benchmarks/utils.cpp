@@ -0,0 +1,86 @@
+#include "benchmark.h"
+#include "utils.h"
+
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+
+using std::string;
+
+namespace {
+// Emits 100MB of Maple output as lines of "<key> <value>"
+const string maple_command = "yes 'the_quick_brown_fox 1' | head -c 100000000";
+
+// Splits lines the way run_command did before it used utils::read_lines: reading 1KB at a time, scanning the
+// whole pending string for a newline byte by byte, and copying the rest of the string after every line
+void fread_lines(FILE *stream, std::function<bool(string const&)> const& callback) {
+    char buffer[1024];
+    string cur_line = "";
+    while (!feof(stream)) {
+        size_t bytes_read = fread(static_cast<void*>(buffer), 1, 1024, stream);
+        if (bytes_read == 1024 || (feof(stream) && bytes_read > 0)) {
+            cur_line += string(buffer, bytes_read);
+
+            while (true) {
+                int newline_pos = -1;
+                for (size_t i = 0; i < cur_line.length(); i++) {
+                    if (cur_line.at(i) == '\n') {
+                        newline_pos = i;
+                        break;
+                    }
+                }
+
+                if (newline_pos >= 0) {
+                    if (!callback(cur_line.substr(0, newline_pos))) {
+                        return;
+                    }
+                    cur_line = cur_line.substr(newline_pos + 1);
+                } else {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Runs the command and splits its output with split_lines, reporting the throughput and allocations
+void measure(string const& name, std::function<void(FILE*, uint64_t&, uint64_t&)> const& split_lines) {
+    uint64_t lines = 0;
+    uint64_t bytes = 0;
+
+    FILE *stream = popen(maple_command.c_str(), "r");
+    uint64_t allocations_before = benchmarking::allocations();
+    auto start = std::chrono::steady_clock::now();
+    split_lines(stream, lines, bytes);
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t allocations = benchmarking::allocations() - allocations_before;
+    pclose(stream);
+
+    benchmarking::report(name + " lines", lines, "lines");
+    benchmarking::report(name + " throughput", (bytes + lines) / elapsed_s / (1 << 20), "MB/s");
+    benchmarking::report(name + " allocations per line", static_cast<double>(allocations) / lines, "allocs");
+}
+}
+
+benchmarking::register_benchmark utils_read_lines("utils.read_lines",
+    "Measures splitting 100MB of Maple output into lines as run_command did before and with utils::read_lines",
+    [] (logger::log_level level)
+{
+    measure("fread and substr", [] (FILE *stream, uint64_t &lines, uint64_t &bytes) {
+        fread_lines(stream, [&] (string const& line) {
+            lines++;
+            bytes += line.size();
+            return true;
+        });
+    });
+
+    measure("read_lines", [] (FILE *stream, uint64_t &lines, uint64_t &bytes) {
+        utils::read_lines(fileno(stream), [&] (std::string_view line) {
+            lines++;
+            bytes += line.size();
+            return true;
+        });
+    });
+});
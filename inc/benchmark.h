@@ -0,0 +1,30 @@
+#pragma once
+
+#include "logging.h"
+
+#include <vector>
+#include <tuple>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+class benchmarking {
+public:
+    // Runs all benchmarks with the given prefix one at a time with logging at the specified level
+    static void run_benchmarks(std::string const& prefix, logger::log_level level);
+
+    // Reports a single measurement made by the benchmark that is currently running
+    static void report(std::string const& metric, double value, std::string const& unit);
+
+    // Returns the number of heap allocations made by the calling thread so far
+    static auto allocations() -> uint64_t;
+
+    class register_benchmark {
+    public:
+        register_benchmark(std::string const& name, std::string const& description,
+            std::function<void(logger::log_level)> const& benchmark_fn);
+    };
+private:
+    using benchmark = std::tuple<std::string, std::string, std::function<void(logger::log_level)>>;
+    static std::vector<benchmark> benchmarks;
+};
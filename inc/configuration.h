@@ -6,6 +6,8 @@ class configuration {
 public:
     virtual void set_hostname(std::string const& hostname) = 0;
     virtual void set_first_node(bool is_first_node_) = 0;
+    // Chooses the SWIM gossip failure detector as the heartbeater instead of heartbeating neighbors
+    virtual void set_swim_heartbeater(bool use_swim) = 0;
     virtual void set_hb_port(int port) = 0;
     virtual void set_election_port(int port) = 0;
     virtual void set_sdfs_internal_port(int port) = 0;
@@ -19,6 +21,7 @@ public:
 
     virtual auto get_hostname() const -> std::string = 0;
     virtual auto is_first_node() const -> bool = 0;
+    virtual auto uses_swim_heartbeater() const -> bool = 0;
     virtual auto get_hb_port() const -> int = 0;
     virtual auto get_election_port() const -> int = 0;
     virtual auto get_sdfs_internal_port() const -> int = 0;
@@ -11,7 +11,7 @@ public:
     };
 
     // Creates a message from a buffer
-    election_message(char *buf, unsigned length);
+    election_message(const char *buf, unsigned length);
 
     // Creates a message that will be empty by default
     election_message(uint32_t id_, uint32_t uuid_) : id(id_), type(), uuid(uuid_) {}
@@ -82,6 +82,8 @@ public:
 
     // Serializes the message and returns a string containing the message
     auto serialize() const -> std::string;
+    // Appends the serialized message to the end of buf, so that the buffer can be reused between messages
+    void serialize(std::string &buf) const;
 
 private:
     uint32_t id; // The ID of the node that produced the message
@@ -4,11 +4,12 @@
 
 #include <vector>
 #include <memory>
+#include <string>
 
 class hb_message {
 public:
     // Creates a message from a buffer (safe)
-    hb_message(char *buf, unsigned length);
+    hb_message(const char *buf, unsigned length);
 
     // Creates an message that will be empty by default
     hb_message(uint32_t id_) : id(id_) {}
@@ -20,6 +21,24 @@ public:
     // Get the member that is requesting to join the group
     auto get_join_request() const -> member;
 
+    // Makes this message carry a membership list for the recipient to add (an introduction or a sync reply)
+    // The list is read with get_joined_nodes, and is split across datagrams by serialize_chunks
+    void make_members_message(std::vector<member> const& members);
+    // Returns true if this message carries a membership list
+    auto is_members_message() const -> bool;
+
+    // Makes this message a request for the members the recipient knows of that are not in ids
+    void make_sync_request(std::vector<uint32_t> const& ids);
+    // Returns true if this message is a sync request
+    auto is_sync_request() const -> bool;
+    // Gets the IDs of the members that the sender of a sync request already knows of
+    auto get_sync_ids() const -> std::vector<uint32_t> const&;
+
+    // Sets the digest of the sender's membership list, which is carried by regular heartbeats
+    void set_digest(membership_digest const& d);
+    // Gets the digest of the sender's membership list
+    auto get_digest() const -> membership_digest;
+
     // Sets the list of failed nodes to the given list of nodes
     void set_failed_nodes(std::vector<uint32_t> const& nodes);
     // Sets the list of joined nodes to the given list of nodes
@@ -41,15 +60,23 @@ public:
 
     // Serializes the message and returns a string containing the message
     auto serialize() const -> std::string;
+    // Appends the serialized message to the end of buf, so that the buffer can be reused between messages
+    void serialize(std::string &buf) const;
+    // Serializes a members message into as many datagrams as the list takes, each of which can be parsed alone
+    auto serialize_chunks() const -> std::vector<std::string>;
 
 private:
     const int JOIN_REQUEST_ID = 0;
     const int NORMAL_HEARTBEAT_ID = 1;
+    const int MEMBERS_ID = 2;
+    const int SYNC_REQUEST_ID = 3;
 
-    bool join_request = false;
+    int msg_type = NORMAL_HEARTBEAT_ID;
     member join_request_member; // The member that is requesting to join the group
     uint32_t id; // The ID of the node that produced the message
+    membership_digest digest;
     std::vector<uint32_t> failed_nodes;
     std::vector<uint32_t> left_nodes;
     std::vector<member> joined_nodes;
+    std::vector<uint32_t> sync_ids;
 };
@@ -8,6 +8,9 @@ class juice_client {
 public:
     virtual auto get_error() const -> std::string = 0;
 
+    // If persistent_exe is set, the exe is started once per worker thread and fed every key over the protocol in
+    // mj_executor.h, rather than being run once per key
     virtual auto run_job(std::string const& juice_node, std::string const& local_exe, std::string const& juice_exe, int num_juices,
-        partitioner::type partitioner_type, std::string const& sdfs_src_dir, std::string const& sdfs_output_dir) -> bool = 0;
+        partitioner::type partitioner_type, std::string const& sdfs_src_dir, std::string const& sdfs_output_dir,
+        bool persistent_exe = false) -> bool = 0;
 };
\ No newline at end of file
@@ -1,9 +1,77 @@
 #pragma once
 
 #include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <array>
+#include <functional>
 #include <utility>
 #include <iostream>
 #include <memory>
+#include <string>
+#include <cstdint>
+
+#ifdef LOCK_PROFILING
+#include <chrono>
+#endif
+
+// Lock contention profiling, which is compiled in only when LOCK_PROFILING is defined (make LOCK_PROFILING=1)
+// Every lock records its acquisitions, time spent waiting for it, a histogram of how long it was held, and the call
+// sites where threads had to wait for it, and report() lists the locks that threads spent the most time waiting on
+// A lock is identified by the name passed to profile_as, or otherwise by the call site where it was first locked
+namespace lock_profiling {
+    // Returns a report of the num_locks locks with the highest total wait time
+    auto report(unsigned num_locks = 10) -> std::string;
+    // Clears all recorded statistics
+    void reset();
+
+#ifdef LOCK_PROFILING
+    struct call_site {
+        char const* file;
+        unsigned line;
+    };
+
+    struct lock_stats;
+
+    inline auto now_ns() -> uint64_t {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // The statistics of a single lock, which are shared by every lock with the same name
+    class lock_profile {
+    public:
+        void set_name(char const* name_) {
+            name = name_;
+        }
+
+        // Acquires the lock with try_lock or lock, returning the time that it was acquired
+        template <typename TryLock, typename Lock>
+        auto acquire(call_site site, TryLock const& try_lock, Lock const& lock) -> uint64_t {
+            uint64_t start = now_ns();
+            bool contended = !try_lock();
+            if (contended) {
+                lock();
+            }
+            uint64_t acquired = now_ns();
+            record_acquire(site, contended, acquired - start);
+            return acquired;
+        }
+
+        void release(uint64_t acquired_ns);
+
+    private:
+        void record_acquire(call_site site, bool contended, uint64_t wait_ns);
+
+        char const* name = nullptr;
+        std::atomic<lock_stats*> stats = nullptr;
+    };
+
+    // A default argument that captures the file and line of the caller
+    #define LOCK_CALL_SITE lock_profiling::call_site site = {__builtin_FILE(), __builtin_LINE()}
+#endif
+}
 
 class locked_base {
 private:
@@ -29,16 +97,23 @@ public:
         std::swap(m, value.m);
         std::swap(data, value.data);
         std::swap(base, value.base);
+#ifdef LOCK_PROFILING
+        std::swap(profile, value.profile);
+        std::swap(acquired_ns, value.acquired_ns);
+#endif
     }
     ~unlocked() {
-        if (m) {
-            m->unlock();
-        }
+        release();
     }
 
     template <typename U>
     static auto dyn_cast(unlocked<U> &&value) -> unlocked<T> {
         unlocked<T> retval(value.m, dynamic_cast<T*>(value.data), value.base);
+#ifdef LOCK_PROFILING
+        retval.profile = value.profile;
+        retval.acquired_ns = value.acquired_ns;
+        value.profile = nullptr;
+#endif
         value.m = nullptr;
         value.data = nullptr;
         value.base = nullptr;
@@ -47,15 +122,18 @@ public:
 
     auto operator=(unlocked const&) -> unlocked& = delete;
     inline auto operator=(unlocked &&other) -> unlocked& {
-        if (m) {
-            m->unlock();
-        }
+        release();
         m = other.m;
         data = other.data;
         base = other.base;
         other.m = nullptr;
         other.data = nullptr;
         other.base = nullptr;
+#ifdef LOCK_PROFILING
+        profile = other.profile;
+        acquired_ns = other.acquired_ns;
+        other.profile = nullptr;
+#endif
         return *this;
     }
 
@@ -85,15 +163,38 @@ public:
     }
 
 private:
+#ifdef LOCK_PROFILING
+    unlocked(locked<T> &ref, lock_profiling::call_site site)
+        : m(&ref.m), data(ref.data.get()), base(&ref), profile(&ref.profile)
+    {
+        acquired_ns = profile->acquire(site, [&] {return m->try_lock();}, [&] {m->lock();});
+    }
+#else
     unlocked(locked<T> &ref) : m(&ref.m), data(ref.data.get()), base(&ref) {
         m->lock();
     }
+#endif
 
     unlocked(std::recursive_mutex *m_, T *data_, locked_base *base_) : m(m_), data(data_), base(base_) {}
 
+    void release() {
+        if (m) {
+#ifdef LOCK_PROFILING
+            if (profile) {
+                profile->release(acquired_ns);
+            }
+#endif
+            m->unlock();
+        }
+    }
+
     std::recursive_mutex *m = nullptr;
     T *data = nullptr;
     locked_base *base = nullptr;
+#ifdef LOCK_PROFILING
+    lock_profiling::lock_profile *profile = nullptr;
+    uint64_t acquired_ns = 0;
+#endif
 
     template <typename U>
     friend class locked;
@@ -116,9 +217,22 @@ public:
     locked(std::unique_ptr<T> &&data_) : data(std::move(data_)) {}
 
     // Returns an object of type unlocked<T>, whose lifetime cannot exceed that of this locked<T>
+#ifdef LOCK_PROFILING
+    inline auto operator()(LOCK_CALL_SITE) const -> unlocked<T> {
+        return unlocked(*const_cast<locked<T>*>(this), site);
+    }
+#else
     inline auto operator()() const -> unlocked<T> {
         return unlocked(*const_cast<locked<T>*>(this));
     }
+#endif
+
+    // Sets the name that this lock is reported under when profiling, which must be a string literal
+    void profile_as(char const* name) {
+#ifdef LOCK_PROFILING
+        profile.set_name(name);
+#endif
+    }
 
     auto unsafe_get_mutex() -> std::recursive_mutex& {
         return m;
@@ -135,7 +249,260 @@ private:
 
     std::recursive_mutex m;
     std::unique_ptr<T> data;
+#ifdef LOCK_PROFILING
+    lock_profiling::lock_profile profile;
+#endif
 
     template <typename U>
     friend class unlocked;
 };
+
+// A shared mutex which the thread holding it exclusively can lock again, either exclusively or shared, so that code
+// holding the write lock can call functions that take the read lock, as it could with locked<T>
+// A thread holding only the shared lock must not try to lock it exclusively
+class rw_mutex {
+public:
+    void lock() {
+        if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            depth++;
+            return;
+        }
+        m.lock();
+        owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        depth = 1;
+    }
+
+    auto try_lock() -> bool {
+        if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            depth++;
+            return true;
+        }
+        if (!m.try_lock()) {
+            return false;
+        }
+        owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+        depth = 1;
+        return true;
+    }
+
+    void unlock() {
+        if (--depth == 0) {
+            owner.store(std::thread::id(), std::memory_order_relaxed);
+            m.unlock();
+        }
+    }
+
+    void lock_shared() {
+        if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            depth++;
+            return;
+        }
+        m.lock_shared();
+    }
+
+    auto try_lock_shared() -> bool {
+        if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            depth++;
+            return true;
+        }
+        return m.try_lock_shared();
+    }
+
+    void unlock_shared() {
+        if (owner.load(std::memory_order_relaxed) == std::this_thread::get_id()) {
+            depth--;
+            return;
+        }
+        m.unlock_shared();
+    }
+
+private:
+    std::shared_mutex m;
+    // The thread holding m exclusively, which only that thread can set to its own ID
+    std::atomic<std::thread::id> owner;
+    unsigned depth = 0;
+};
+
+template <typename T>
+class rw_locked;
+
+// Holds either the shared lock (if T is const) or the exclusive lock of an rw_locked until it is destroyed
+template <typename T>
+class rw_unlocked {
+public:
+    rw_unlocked(rw_unlocked const&) = delete;
+    rw_unlocked(rw_unlocked &&value) {
+        std::swap(m, value.m);
+        std::swap(data, value.data);
+#ifdef LOCK_PROFILING
+        std::swap(profile, value.profile);
+        std::swap(acquired_ns, value.acquired_ns);
+#endif
+    }
+    ~rw_unlocked() {
+        release();
+    }
+
+    auto operator=(rw_unlocked const&) -> rw_unlocked& = delete;
+    inline auto operator=(rw_unlocked &&other) -> rw_unlocked& {
+        release();
+        m = other.m;
+        data = other.data;
+        other.m = nullptr;
+        other.data = nullptr;
+#ifdef LOCK_PROFILING
+        profile = other.profile;
+        acquired_ns = other.acquired_ns;
+#endif
+        return *this;
+    }
+
+    explicit operator bool() const {
+        return data != nullptr;
+    }
+
+    inline auto operator*() const -> T& {
+        return *data;
+    }
+
+    inline auto operator->() const -> T* {
+        return data;
+    }
+
+private:
+#ifdef LOCK_PROFILING
+    rw_unlocked(rw_mutex *m_, T *data_, lock_profiling::lock_profile *profile_, lock_profiling::call_site site)
+        : m(m_), data(data_), profile(profile_)
+    {
+        if constexpr (std::is_const_v<T>) {
+            acquired_ns = profile->acquire(site, [&] {return m->try_lock_shared();}, [&] {m->lock_shared();});
+        } else {
+            acquired_ns = profile->acquire(site, [&] {return m->try_lock();}, [&] {m->lock();});
+        }
+    }
+#else
+    rw_unlocked(rw_mutex *m_, T *data_) : m(m_), data(data_) {
+        if constexpr (std::is_const_v<T>) {
+            m->lock_shared();
+        } else {
+            m->lock();
+        }
+    }
+#endif
+
+    void release() {
+        if (m) {
+#ifdef LOCK_PROFILING
+            profile->release(acquired_ns);
+#endif
+            if constexpr (std::is_const_v<T>) {
+                m->unlock_shared();
+            } else {
+                m->unlock();
+            }
+            m = nullptr;
+        }
+    }
+
+    rw_mutex *m = nullptr;
+    T *data = nullptr;
+#ifdef LOCK_PROFILING
+    lock_profiling::lock_profile *profile = nullptr;
+    uint64_t acquired_ns = 0;
+#endif
+
+    template <typename U>
+    friend class rw_locked;
+};
+
+// Like locked<T>, but allows any number of threads to read the data at once with read(), while write() gives one
+// thread exclusive access, for data that is read much more often than it is written
+template <typename T>
+class rw_locked {
+public:
+    rw_locked() : data(std::make_unique<T>()) {}
+
+    template <typename ...U>
+    rw_locked(U&&... args) : data(std::make_unique<T>(std::forward<U>(args)...)) {}
+
+#ifdef LOCK_PROFILING
+    inline auto read(LOCK_CALL_SITE) const -> rw_unlocked<T const> {
+        return rw_unlocked<T const>(&m, data.get(), &profile, site);
+    }
+
+    inline auto write(LOCK_CALL_SITE) const -> rw_unlocked<T> {
+        return rw_unlocked<T>(&m, data.get(), &profile, site);
+    }
+#else
+    // Returns a handle with const access, whose lifetime cannot exceed that of this rw_locked<T>
+    inline auto read() const -> rw_unlocked<T const> {
+        return rw_unlocked<T const>(&m, data.get());
+    }
+
+    // Returns a handle with exclusive access, whose lifetime cannot exceed that of this rw_locked<T>
+    inline auto write() const -> rw_unlocked<T> {
+        return rw_unlocked<T>(&m, data.get());
+    }
+#endif
+
+    // Sets the name that this lock is reported under when profiling, which must be a string literal
+    void profile_as(char const* name) {
+#ifdef LOCK_PROFILING
+        profile.set_name(name);
+#endif
+    }
+
+    auto unsafe_get_mutex() -> rw_mutex& {
+        return m;
+    }
+
+private:
+    mutable rw_mutex m;
+    std::unique_ptr<T> data;
+#ifdef LOCK_PROFILING
+    mutable lock_profiling::lock_profile profile;
+#endif
+};
+
+// A hash map split across num_shards maps that each have their own lock, so that threads accessing different keys
+// rarely wait on each other
+// Each key always lives in the same shard, which is locked and returned as a whole by operator()
+template <typename Map, unsigned num_shards = 16>
+class sharded_locked {
+public:
+    using key_type = typename Map::key_type;
+
+    // Returns the locked shard that contains key, whose lifetime cannot exceed that of this sharded_locked
+#ifdef LOCK_PROFILING
+    inline auto operator()(key_type const& key, LOCK_CALL_SITE) const -> unlocked<Map> {
+        return shards[shard_index(key)](site);
+    }
+#else
+    inline auto operator()(key_type const& key) const -> unlocked<Map> {
+        return shards[shard_index(key)]();
+    }
+#endif
+
+    // Reports all of the shards together under the given name when profiling
+    void profile_as(char const* name) {
+        for (auto &shard : shards) {
+            shard.profile_as(name);
+        }
+    }
+
+    // Calls fn on each shard in turn while it is locked, without ever holding more than one shard's lock
+    void for_each_shard(std::function<void(Map&)> const& fn) const {
+        for (auto const& shard : shards) {
+            fn(*shard());
+        }
+    }
+
+    static auto shard_index(key_type const& key) -> unsigned {
+        // Mix the hash, since std::hash is the identity for integers
+        size_t h = typename Map::hasher()(key) * 0x9E3779B97F4A7C15ull;
+        return (h >> 32) % num_shards;
+    }
+
+private:
+    std::array<locked<Map>, num_shards> shards;
+};
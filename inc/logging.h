@@ -1,7 +1,11 @@
 #pragma once
 
+#include "tracing.h"
+
 #include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 class logger {
 public:
@@ -14,6 +18,59 @@ public:
     virtual void info(std::string const& data) const = 0;
     virtual void debug(std::string const& data) const = 0;
     virtual void trace(std::string const& data) const = 0;
+
+    // Returns whether or not lines at the given level are logged at all
+    virtual auto enabled(log_level level) const -> bool = 0;
+
+    // Logs the concatenation of the arguments, where numbers are converted with std::to_string
+    // Nothing is formatted or allocated unless the level is enabled, so these are free to call on hot paths
+    template <typename... Args, typename = std::enable_if_t<(sizeof...(Args) >= 2)>>
+    void info(Args const&... args) const {
+        if (enabled(level_info)) info(concat(args...));
+    }
+    template <typename... Args, typename = std::enable_if_t<(sizeof...(Args) >= 2)>>
+    void debug(Args const&... args) const {
+        if (enabled(level_debug)) debug(concat(args...));
+    }
+    template <typename... Args, typename = std::enable_if_t<(sizeof...(Args) >= 2)>>
+    void trace(Args const&... args) const {
+        if (enabled(level_trace)) trace(concat(args...));
+    }
+
+    // Logs the string returned by make_data, which is only called if the level is enabled
+    template <typename F, typename = std::enable_if_t<std::is_invocable_r_v<std::string, F const&>>>
+    void info(F const& make_data) const {
+        if (enabled(level_info)) info(make_data());
+    }
+    template <typename F, typename = std::enable_if_t<std::is_invocable_r_v<std::string, F const&>>>
+    void debug(F const& make_data) const {
+        if (enabled(level_debug)) debug(make_data());
+    }
+    template <typename F, typename = std::enable_if_t<std::is_invocable_r_v<std::string, F const&>>>
+    void trace(F const& make_data) const {
+        if (enabled(level_trace)) trace(make_data());
+    }
+
+private:
+    template <typename... Args>
+    static auto concat(Args const&... args) -> std::string {
+        std::string data;
+        data.reserve(128);
+        (append(data, args), ...);
+        return data;
+    }
+
+    template <typename T>
+    static void append(std::string &data, T const& value) {
+        if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, char>) {
+            data += std::to_string(value);
+        } else {
+            data += std::string_view(value);
+        }
+    }
+    static void append(std::string &data, char value) {
+        data += value;
+    }
 };
 
 class logger_factory {
@@ -22,4 +79,10 @@ public:
     virtual void configure(logger::log_level level_) = 0;
     virtual void include_hostname() = 0;
     virtual auto get_logger(std::string const& prefix) const -> std::unique_ptr<logger> = 0;
+
+    // Records the trace events of every component into binary files in dir named after our hostname, starting a new
+    // file once the current one reaches file_size bytes and deleting the oldest so there are at most num_files
+    virtual void configure_tracing(std::string const& dir, uint64_t file_size, unsigned num_files) = 0;
+    // Returns a tracer for the component, which does nothing if tracing has not been configured
+    virtual auto get_tracer(trace_component component) const -> std::unique_ptr<tracer> = 0;
 };
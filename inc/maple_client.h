@@ -6,6 +6,12 @@ class maple_client {
 public:
     virtual auto get_error() const -> std::string = 0;
 
+    // If persistent_exe is set, the exe is started once per worker thread and fed every file over the protocol in
+    // mj_executor.h, rather than being run once per file
+    // If local_combiner is given, it is a plugin or persistent executor that is run on the values of each key output
+    // from a file before they are appended, which must produce the same result in Juice as the original values
+    // If memory_budget_mb is nonzero, the output of each file beyond that many MB is spilled to disk
     virtual auto run_job(std::string const& maple_node, std::string const& local_exe, std::string const& maple_exe,
-        int num_maples, std::string const& sdfs_src_dir, std::string const& sdfs_output_dir) -> bool = 0;
+        int num_maples, std::string const& sdfs_src_dir, std::string const& sdfs_output_dir,
+        bool persistent_exe = false, std::string const& local_combiner = "", int memory_budget_mb = 0) -> bool = 0;
 };
\ No newline at end of file
@@ -21,7 +21,21 @@ typedef struct member {
     auto operator==(const member &m) const -> bool;
 } member;
 
-// A linked list of members sorted by ID
+// A summary of a membership list that two members can compare to tell whether their lists differ
+struct membership_digest {
+    uint32_t num_members = 0;
+    // The sum of a hash of every member ID, which does not depend on the order the members were added in
+    uint32_t hash = 0;
+
+    auto operator==(membership_digest const& other) const -> bool {
+        return num_members == other.num_members && hash == other.hash;
+    }
+    auto operator!=(membership_digest const& other) const -> bool {
+        return !(*this == other);
+    }
+};
+
+// A list of members sorted by ID, stored contiguously so that lookups by ID are binary searches
 class member_list {
 public:
     // Initialize the member list with the local hostname
@@ -29,24 +43,23 @@ public:
         local_hostname(env.get<configuration>()->get_hostname()),
         lg(env.get<logger_factory>()->get_logger("member_list")) {}
 
-    ~member_list() {
-        node *next;
-        for (node *cur = head; cur != nullptr; cur = next) {
-            next = cur->next;
-            delete cur;
-        }
-    }
-
     // Adds a member to the membership list using hostname and ID and returns the ID
     auto add_member(std::string const& hostname, uint32_t id) -> uint32_t;
     // Gets a member from the membership list by ID
     auto get_member_by_id(uint32_t id) const -> member;
+    // Gets a pointer to the member with the given ID without copying it, or nullptr if there is no such member
+    // The pointer is invalidated by any change to the list
+    auto find_member(uint32_t id) const -> member const*;
+    // Whether or not there is a member with the given ID
+    auto has_member(uint32_t id) const -> bool;
     // Removes a member from the membership list
     void remove_member(uint32_t id);
     // Updates the heartbeat for a member to the current time
     void update_heartbeat(uint32_t id);
     // Get the number of members total
     auto num_members() const -> uint32_t;
+    // Gets the digest of the membership list, which is kept up to date as members are added and removed
+    auto digest() const -> membership_digest;
     // Gets a list of the 2 successors and 2 predecessors (or fewer if there are <5 members)
     auto get_neighbors() const -> std::vector<member>;
     // Gets a list of all the members
@@ -57,13 +70,17 @@ public:
 private:
     // Whether or not we are in the member list
     auto joined_list() const -> bool;
+    // Returns the index of the first member with an ID of at least id
+    auto lower_bound(uint32_t id) const -> size_t;
+    // The hash of a single member ID that goes into the digest
+    static auto id_hash(uint32_t id) -> uint32_t;
 
-    typedef struct node {
-        member m;
-        node *next;
-    } node;
-
-    node *head = nullptr;
+    // Members sorted by ID
+    std::vector<member> members;
+    // The lowest ID of a member with our hostname, or 0 if we are not in the list
+    uint32_t local_id = 0;
+    // The sum of id_hash over all members
+    uint32_t ids_hash = 0;
 
     std::string local_hostname;
     std::unique_ptr<logger> lg;
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <vector>
+
+// The protocol spoken by a persistent executor, which is an executable that is started once per worker thread for a
+// whole job and handles many inputs instead of being run once per input file
+// The worker writes each input to the executor's stdin as a record:
+//   uint32 key length | uint64 value length | key | value
+// where, as for plugins, key is the name of the input file for Maple or the key being reduced for Juice, and value
+// is the contents of the file. The executor writes each key / value pair it outputs to stdout as a record of the
+// same layout, followed by a record with key length MJ_EXECUTOR_END_OF_INPUT and the exit status of the input in
+// place of the value length. All integers are in native byte order
+// The executor should exit once its stdin is closed
+#define MJ_EXECUTOR_END_OF_INPUT 0xFFFFFFFFu
+
+class mj_executor {
+public:
+    ~mj_executor();
+
+    // Starts the executable at the given path, returning nullptr if it could not be started
+    static auto start(std::string const& path) -> std::unique_ptr<mj_executor>;
+
+    // Sends one input to the executor, calling emit with each key / value pair it outputs
+    // If this returns false, the executor is in an unknown state and should not be used again
+    auto run(std::string_view key, std::string_view val,
+        std::function<void(std::string_view, std::string_view)> const& emit) -> bool;
+    // Sends the contents of a local file to the executor, which is mapped into memory rather than copied
+    auto run_file(std::string_view key, std::string const& path,
+        std::function<void(std::string_view, std::string_view)> const& emit) -> bool;
+
+private:
+    mj_executor(pid_t pid_, int in_fd_, int out_fd_)
+        : pid(pid_), in_fd(in_fd_), out_fd(out_fd_) {}
+
+    pid_t pid;
+    // The write end of the executor's stdin and the read end of its stdout
+    int in_fd;
+    int out_fd;
+    // Output that has been read from the executor, of which the bytes in [buf_start, buf_end) are not yet handled
+    // The buffer is reused across inputs and only grows to fit the largest record
+    std::vector<char> buffer;
+    size_t buf_start = 0;
+    size_t buf_end = 0;
+};
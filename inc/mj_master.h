@@ -1,7 +1,24 @@
 #pragma once
 
+#include <unordered_map>
+
+// How far along a job that the master node is running has gotten
+struct mj_job_progress {
+    // The number of input files in the job, and the number that have been processed
+    unsigned total_files = 0;
+    unsigned completed_files = 0;
+    bool failed = false;
+
+    auto outstanding_files() const -> unsigned {
+        return total_files - completed_files;
+    }
+};
+
 class mj_master {
 public:
     virtual void start() = 0;
     virtual void stop() = 0;
+
+    // Returns the progress of each job that is currently running by job ID, which is empty if we are not the master
+    virtual auto get_job_progress() const -> std::unordered_map<int, mj_job_progress> = 0;
 };
@@ -7,7 +7,10 @@
 #include <variant>
 #include <cassert>
 #include <vector>
+#include <tuple>
 
+// Each message declares its fields in the order they are serialized, which is used by serializer and
+// deserializer to generate the encoding and decoding of the message at compile time
 struct mj_start_job {
     std::string exe;
     int num_workers;
@@ -17,14 +20,32 @@ struct mj_start_job {
     std::string sdfs_output_dir;
     int num_files_parallel;
     int num_appends_parallel;
+    int persistent_exe; // Nonzero if exe is a persistent executor that speaks the protocol in mj_executor.h
+    std::string combiner_exe; // A plugin or persistent executor that combines each key's Maple output, or "" for none
+    int memory_budget_mb; // The MB of Maple output of each file to hold in memory before spilling it, or 0 for no limit
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_start_job::exe, &mj_start_job::num_workers, &mj_start_job::partitioner_type,
+            &mj_start_job::sdfs_src_dir, &mj_start_job::processor_type, &mj_start_job::sdfs_output_dir,
+            &mj_start_job::num_files_parallel, &mj_start_job::num_appends_parallel, &mj_start_job::persistent_exe,
+            &mj_start_job::combiner_exe, &mj_start_job::memory_budget_mb);
+    }
 };
 
 struct mj_not_master {
     std::string master_node; // When this is set to "", there is no master
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_not_master::master_node);
+    }
 };
 
 struct mj_job_end {
     int succeeded;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_job_end::succeeded);
+    }
 };
 
 struct mj_assign_job {
@@ -36,6 +57,16 @@ struct mj_assign_job {
     std::string sdfs_output_dir;
     int num_files_parallel;
     int num_appends_parallel;
+    int persistent_exe;
+    std::string combiner_exe;
+    int memory_budget_mb;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_assign_job::job_id, &mj_assign_job::exe, &mj_assign_job::sdfs_src_dir,
+            &mj_assign_job::input_files, &mj_assign_job::processor_type, &mj_assign_job::sdfs_output_dir,
+            &mj_assign_job::num_files_parallel, &mj_assign_job::num_appends_parallel, &mj_assign_job::persistent_exe,
+            &mj_assign_job::combiner_exe, &mj_assign_job::memory_budget_mb);
+    }
 };
 
 struct mj_request_append_perm {
@@ -43,24 +74,45 @@ struct mj_request_append_perm {
     std::string hostname; // The hostname of the node sending the message
     std::string input_file;
     std::string output_file;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_request_append_perm::job_id, &mj_request_append_perm::hostname,
+            &mj_request_append_perm::input_file, &mj_request_append_perm::output_file);
+    }
 };
 
 struct mj_append_perm {
     int allowed;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_append_perm::allowed);
+    }
 };
 
 struct mj_file_done {
     int job_id;
     std::string hostname;
     std::string file;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_file_done::job_id, &mj_file_done::hostname, &mj_file_done::file);
+    }
 };
 
 struct mj_job_failed {
     int job_id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_job_failed::job_id);
+    }
 };
 
 struct mj_job_end_worker {
     int job_id;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&mj_job_end_worker::job_id);
+    }
 };
 
 class mj_message {
@@ -69,6 +121,8 @@ public:
         mj_start_job, mj_not_master, mj_job_end,
         mj_assign_job, mj_request_append_perm, mj_append_perm, mj_file_done, mj_job_failed, mj_job_end_worker>;
 
+    // The message types are in the same order as the alternatives of msg_data, so that the type of a message is
+    // the index of its data in the variant
     enum mj_msg_type {
         START_JOB,
         NOT_MASTER,
@@ -81,6 +135,7 @@ public:
         JOB_END_WORKER,
         INVALID
     };
+    static_assert(std::variant_size_v<msg_data> == INVALID, "Every message type must have exactly one data type");
 
     // Creates a message from a buffer (safe)
     mj_message(const char *buf, unsigned length);
@@ -115,6 +170,8 @@ public:
 
     // Serializes the message and returns a string containing the message
     auto serialize() const -> std::string;
+    // Appends the serialized message to the end of buf, so that the buffer can be reused between messages
+    void serialize(std::string &buf) const;
 
 private:
     // Sets the message type based on the value stored in data
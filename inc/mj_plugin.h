@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <functional>
+
+// The C ABI of a Maple or Juice plugin, which is a shared object that is loaded once per job instead of an executable
+// that is run once per input file
+// For Maple, key is the name of the input file and val is its contents. For Juice, key is the key being reduced and
+// val is the contents of the file holding its values, one per line
+// The plugin calls emit once for each key / value pair it outputs, passing emit_ctx back as the first argument, and
+// returns 0 on success
+extern "C" {
+    typedef void (*mj_emit_fn)(void *emit_ctx, const char *key, size_t klen, const char *val, size_t vlen);
+    typedef int (*mj_map_fn)(const char *key, size_t klen, const char *val, size_t vlen, mj_emit_fn emit, void *emit_ctx);
+}
+
+// The name of the function that plugins export with the type mj_map_fn
+#define MJ_PLUGIN_ENTRY_POINT "mj_map"
+
+class mj_plugin {
+public:
+    ~mj_plugin();
+
+    // Loads the shared object at the given path, returning nullptr if it is not a plugin, such as for an executable
+    static auto load(std::string const& path) -> std::unique_ptr<mj_plugin>;
+
+    // Runs the plugin on one input, calling emit with each key / value pair it outputs
+    auto run(std::string_view key, std::string_view val,
+        std::function<void(std::string_view, std::string_view)> const& emit) const -> bool;
+    // Runs the plugin on the contents of a local file, which is mapped into memory rather than copied
+    auto run_file(std::string_view key, std::string const& path,
+        std::function<void(std::string_view, std::string_view)> const& emit) const -> bool;
+
+private:
+    mj_plugin(void *handle_, mj_map_fn map_fn_)
+        : handle(handle_), map_fn(map_fn_) {}
+
+    void *handle;
+    mj_map_fn map_fn;
+};
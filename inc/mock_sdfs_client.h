@@ -8,6 +8,7 @@
 #include "locking.h"
 
 #include <atomic>
+#include <condition_variable>
 #include <string>
 #include <functional>
 #include <set>
@@ -121,6 +122,8 @@ private:
         std::set<uint64_t> set;
     };
     locked<transaction_timestamps> tx_timestamps_lock;
+    // Notified with tx_timestamps_lock held whenever a transaction completes
+    mutable std::condition_variable_any tx_completed_cv;
 
     void on_event(master_callback_type const& callback);
 };
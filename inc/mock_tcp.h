@@ -12,6 +12,8 @@
 #include <queue>
 #include <functional>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <atomic>
 #include <tuple>
 #include <thread>
@@ -37,6 +39,14 @@ public:
     }
     auto get_tcp_client(std::string const& host, int port) -> std::unique_ptr<tcp_client>;
     auto get_tcp_server(int port) -> std::unique_ptr<tcp_server>;
+    auto get_tcp_event_server(int port, unsigned num_handlers) -> std::unique_ptr<tcp_event_server>;
+    // Mock connections are free to set up, so pooled clients are just regular mock clients
+    auto get_pooled_tcp_client(std::string const& host, int port) -> std::unique_ptr<tcp_client> {
+        return get_tcp_client(host, port);
+    }
+    void evict_pooled_connections(std::string const& host) {}
+    // Mock connections have no packets to coalesce
+    void configure(bool nodelay, bool cork) {}
 
     // Tests can call this method directly after safely casting tcp_factory to mock_tcp_factory
     void show_packets() {
@@ -56,6 +66,10 @@ private:
     // Closed connection messages are of the format <magic byte><ID>
     static const char close_magic_byte = 0x3;
 
+    // Mock file transfers send the size of the file and then its contents as two regular messages
+    static auto write_file(std::function<ssize_t(std::string const&)> const& write, int fd, size_t size) -> ssize_t;
+    static auto read_file(std::function<std::string()> const& read, int fd) -> ssize_t;
+
     // All messages will be prefixed with 5 bytes for additional socket information
     // The first byte will be a magic byte indicating the type of information being sent
     // The next 4 bytes will be a unique ID identifying the host
@@ -77,6 +91,8 @@ private:
         void close_connection(int client_socket);
         auto read_from_client(int client_fd) -> std::string;
         auto write_to_client(int client_fd, std::string const& data) -> ssize_t;
+        auto write_file_to_client(int client_fd, int fd, size_t size) -> ssize_t;
+        auto read_file_from_client(int client_fd, int fd) -> ssize_t;
     private:
         // Deletes all information stored about the specified client
         void delete_connection(int client_fd);
@@ -102,6 +118,32 @@ private:
         locked<server_state> serv_state_lock;
     };
 
+    // Mock TCP event server, which is a wrapper around a mock TCP server with one thread reading from each client
+    // Each client's messages are handled on its reading thread, so there is no bound on the number of handlers
+    class mock_tcp_event_server : public tcp_event_server {
+    public:
+        mock_tcp_event_server(std::unique_ptr<mock_tcp_server> server_)
+            : server(std::move(server_)), running(false) {}
+        ~mock_tcp_event_server() {
+            stop();
+        }
+
+        void start(message_handler const& handler_);
+        void stop();
+        void close_connection(int client);
+        auto write_to_client(int client, std::string const& data) -> ssize_t;
+    private:
+        std::unique_ptr<mock_tcp_server> server;
+        message_handler handler;
+
+        std::atomic<bool> running;
+        std::thread accept_thread;
+
+        // The clients that are currently connected, and the threads that read from each client
+        locked<std::unordered_set<int>> clients_lock;
+        locked<std::vector<std::thread>> client_threads_lock;
+    };
+
     // Mock TCP client, which is just a wrapper around a no-failure mock UDP client
     // close_connection MUST be called in the mock, and will cause a failure if not
     class mock_tcp_client : public tcp_client {
@@ -116,6 +158,8 @@ private:
         auto setup_connection(std::string const& host, int port) -> int;
         auto read_from_server() -> std::string;
         auto write_to_server(std::string const& data) -> ssize_t;
+        auto write_file_to_server(int fd, size_t size) -> ssize_t;
+        auto read_file_from_server(int fd) -> ssize_t;
         void close_connection();
     private:
         // Deletes all information stored about the specified socket
@@ -8,6 +8,8 @@
 #include "locking.h"
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include <unordered_map>
 #include <queue>
 #include <tuple>
@@ -74,6 +76,8 @@ private:
         void notify_waiting(host const& h, notify_state const& ns);
         // Reads a packet (non-blocking) after notify_waiting was called and flag was set to true
         auto recv(host const& h, char *buf, unsigned length) -> int;
+        // Moves the next packet for h into msg without blocking, returning false if there is none
+        auto try_recv(host const& h, std::string &msg) -> bool;
         // Sends a packet to the specified destination
         void send(host const& dest, char const* msg_buf, unsigned length);
         // Clears the message queue for this host and notifies with no message if recv is being called
@@ -101,6 +105,8 @@ private:
 
         // Sends a UDP packet to the specified destination
         void send(std::string const& host, int port, std::string const& msg);
+        // Sends the same UDP packet to each of the destinations
+        void send_all(std::vector<std::string> const& hosts, int port, std::string const& msg);
     private:
         bool show_packets;
         double drop_probability;
@@ -121,7 +127,16 @@ private:
         void stop_server();
         // Wrapper function around recvfrom that handles errors
         auto recv(char *buf, unsigned length) -> int;
+        // Waits for a packet, then receives it along with any others already queued
+        auto recv_batch(std::vector<std::string_view> &packets) -> int;
     private:
+        // The most packets received by a single call to recv_batch
+        static const unsigned max_batch_size = 64;
+
+        // Waits until there is a packet for this server or the server is stopped
+        // Returns the port the server is listening on, or 0 if it was stopped
+        auto wait_for_packet() -> int;
+
         struct server_state {
             int port = 0;
         };
@@ -131,6 +146,8 @@ private:
         std::string hostname;
         int port;
         mock_udp_coordinator *coordinator;
+        // The packets returned by the last call to recv_batch
+        std::vector<std::string> batch;
     };
 
     environment *env;
@@ -3,8 +3,12 @@
 #include "inputter.h"
 
 #include <string>
+#include <string_view>
 #include <memory>
 #include <cassert>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 class processor : public virtual inputter<std::pair<std::string, std::vector<std::string>>> {
 public:
@@ -20,8 +24,10 @@ public:
         }
     }
 
-    // Processes a single line of the output of the executable
-    virtual auto process_line(std::string const& line) -> bool = 0;
+    // Processes a single line of the output of the executable, which is only valid for the duration of the call
+    virtual auto process_line(std::string_view line) -> bool = 0;
+    // Processes a key / value pair emitted directly by a plugin, which would otherwise be the line "<key> <value>"
+    virtual void process_pair(std::string_view key, std::string_view value) = 0;
     // Resets any internal state accumulated from processing lines
     virtual void reset() = 0;
 
@@ -32,23 +38,51 @@ public:
 
 class processor_factory {
 public:
-    static auto get_processor(processor::type type) -> std::unique_ptr<processor>;
+    // For Maple, memory_budget is the number of bytes of output that may be held in memory before it is spilled to
+    // spill_dir, where 0 means there is no limit
+    static auto get_processor(processor::type type, uint64_t memory_budget = 0, std::string const& spill_dir = "")
+        -> std::unique_ptr<processor>;
 };
 
+// Groups the values output by Maple by key
+// If the values take up more than the memory budget, they are written to disk as a run sorted by key and cleared,
+// and the runs are merged one key at a time once the output is read
 class maple_processor : public processor {
 public:
-    maple_processor();
-    auto process_line(std::string const& line) -> bool;
+    maple_processor(uint64_t memory_budget_ = 0, std::string const& spill_dir_ = "");
+    ~maple_processor();
+    auto process_line(std::string_view line) -> bool;
+    void process_pair(std::string_view key, std::string_view value);
     void reset();
 
+    auto num_spilled_runs() const -> unsigned;
+
 private:
+    class run_reader;
+
+    // Writes the values in memory to a new run sorted by key and clears them
+    void spill();
+    // Returns the next key in the runs along with its values from every run
+    auto next_merged() -> std::optional<std::pair<std::string, std::vector<std::string>>>;
+    void remove_runs();
+
     std::unordered_map<std::string, std::vector<std::string>> kv_pairs;
+    // An estimate of the memory used by kv_pairs
+    uint64_t buffered_bytes = 0;
+    uint64_t memory_budget;
+    std::string spill_dir;
+
+    std::vector<std::string> run_paths;
+    // Open while the runs are being merged, ordered as a heap on each reader's current key
+    std::vector<std::unique_ptr<run_reader>> readers;
+    bool merging = false;
 };
 
 class juice_processor : public processor {
 public:
     juice_processor();
-    auto process_line(std::string const& line) -> bool;
+    auto process_line(std::string_view line) -> bool;
+    void process_pair(std::string_view key, std::string_view value);
     void reset();
 
 private:
@@ -14,7 +14,7 @@ public:
     };
 
     // Creates a message from a buffer
-    sdfs_message(char *buf, unsigned length);
+    sdfs_message(const char *buf, unsigned length);
 
     // Creates a message with no attributes or type
     sdfs_message() : type(), sdfs_hostname(), sdfs_filename() {}
@@ -149,6 +149,8 @@ public:
 
     // Serializes the message and returns a string containing the message
     auto serialize() const -> std::string;
+    // Appends the serialized message to the end of buf, so that the buffer can be reused between messages
+    void serialize(std::string &buf) const;
 
 private:
     msg_type type;
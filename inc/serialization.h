@@ -1,38 +1,162 @@
 #pragma once
 
 #include <cstdint>
-#include <memory>
-#include <variant>
-#include <vector>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
 
 #define MAX_DESERIALIZABLE_STRING_LEN 1024
 
+// Structs can be serialized as a whole by declaring their fields once, in the order they are serialized, with
+//   static constexpr auto fields() { return std::make_tuple(&my_struct::a, &my_struct::b); }
+// serializer and deserializer expand the list at compile time into one call per field
+namespace serialization_traits {
+    template <typename T>
+    constexpr bool is_int = std::is_integral_v<T> || std::is_enum_v<T>;
+
+    template <typename T>
+    constexpr bool is_string = std::is_convertible_v<T const&, std::string_view>;
+
+    template <typename T>
+    struct is_vector : std::false_type {};
+    template <typename T>
+    struct is_vector<std::vector<T>> : std::true_type {};
+
+    template <typename T, typename = void>
+    struct has_fields : std::false_type {};
+    template <typename T>
+    struct has_fields<T, std::void_t<decltype(T::fields())>> : std::true_type {};
+}
+
+// Writes fields directly onto the end of a buffer supplied by the caller, which keeps its capacity when it is
+// cleared and reused for the next message
+// Integers (and enums) are written as 4 bytes, strings as a 4 byte length followed by their contents, vectors as
+// a 4 byte count followed by their elements, and structs as their declared fields in order
 class serializer {
 public:
-    using field = std::variant<uint32_t, std::string>;
+    explicit serializer(std::string &buf_) : buf(buf_) {}
+
+    void add_field(uint32_t n);
+    void add_field(std::string_view str);
 
-    void add_field(field const& f);
-    auto serialize() const -> std::string;
+    // Adds all of the fields in order, growing the buffer at most once
+    template <typename... Fields>
+    void add_fields(Fields const&... fields) {
+        buf.reserve(buf.size() + serialized_size(fields...));
+        (add_value(fields), ...);
+    }
+
+    // The number of bytes taken up by the given fields once serialized
+    // Integers have a size known at compile time, so only strings and vectors are measured at runtime
+    template <typename... Fields>
+    static auto serialized_size(Fields const&... fields) -> size_t {
+        return (size_t(0) + ... + value_size(fields));
+    }
+
+    // The number of bytes taken up by the fixed width parts of the given types: all of an integer, and the length
+    // prefix of a string or vector
+    template <typename... Fields>
+    static constexpr size_t fixed_size = sizeof...(Fields) * sizeof(uint32_t);
 
     static void write_uint32_to_char_buf(uint32_t n, char *buf);
 
 private:
-    std::vector<field> fields;
+    template <typename T>
+    void add_value(T const& value) {
+        using namespace serialization_traits;
+        if constexpr (is_int<T>) {
+            add_field(static_cast<uint32_t>(value));
+        } else if constexpr (is_string<T>) {
+            add_field(std::string_view(value));
+        } else if constexpr (is_vector<T>::value) {
+            add_field(static_cast<uint32_t>(value.size()));
+            for (auto const& elem : value) {
+                add_value(elem);
+            }
+        } else {
+            static_assert(has_fields<T>::value, "Type cannot be serialized");
+            std::apply([&] (auto... members) {
+                (add_value(value.*members), ...);
+            }, T::fields());
+        }
+    }
+
+    template <typename T>
+    static auto value_size(T const& value) -> size_t {
+        using namespace serialization_traits;
+        if constexpr (is_int<T>) {
+            return sizeof(uint32_t);
+        } else if constexpr (is_string<T>) {
+            return sizeof(uint32_t) + std::string_view(value).size();
+        } else if constexpr (is_vector<T>::value) {
+            if constexpr (is_int<typename T::value_type>) {
+                return (1 + value.size()) * sizeof(uint32_t);
+            } else {
+                size_t size = sizeof(uint32_t);
+                for (auto const& elem : value) {
+                    size += value_size(elem);
+                }
+                return size;
+            }
+        } else {
+            static_assert(has_fields<T>::value, "Type cannot be serialized");
+            return std::apply([&] (auto... members) {
+                return (size_t(0) + ... + value_size(value.*members));
+            }, T::fields());
+        }
+    }
+
+    std::string &buf;
 };
 
+// Reads fields written by serializer without copying them out of the buffer
 class deserializer {
 public:
     deserializer(char const* buf_, unsigned length_)
         : buf(buf_), length(length_), pos(0) {}
+    explicit deserializer(std::string_view buf_)
+        : buf(buf_.data()), length(buf_.length()), pos(0) {}
 
     auto get_int() -> uint32_t;
-    auto get_string() -> std::string;
+    // The returned view points into the buffer, and must be copied if it needs to outlive it
+    auto get_string() -> std::string_view;
     void done();
 
+    // Reads each of the values in order, using the same encoding as serializer::add_fields
+    template <typename... Values>
+    void get_fields(Values&... values) {
+        (get_value(values), ...);
+    }
+
     static auto read_uint32_from_char_buf(char const* buf) -> uint32_t;
 
 private:
+    template <typename T>
+    void get_value(T &value) {
+        using namespace serialization_traits;
+        if constexpr (is_int<T>) {
+            value = static_cast<T>(get_int());
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            value = get_string();
+        } else if constexpr (is_vector<T>::value) {
+            uint32_t count = get_int();
+            // Every element takes up at least 4 bytes, which bounds how much a malformed count can reserve
+            value.reserve(std::min<size_t>(count, (length - pos) / sizeof(uint32_t)));
+            for (uint32_t i = 0; i < count; i++) {
+                value.emplace_back();
+                get_value(value.back());
+            }
+        } else {
+            static_assert(has_fields<T>::value, "Type cannot be deserialized");
+            std::apply([&] (auto... members) {
+                (get_value(value.*members), ...);
+            }, T::fields());
+        }
+    }
+
     char const* buf;
     unsigned length;
     unsigned pos;
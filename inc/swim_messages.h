@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <tuple>
+
+// A change to a single member's state, which is piggybacked on probe messages until it has spread to the group
+struct swim_update {
+    enum update_type : uint32_t {
+        ALIVE,   // The member is in the group, which also announces new members
+        SUSPECT, // The member did not answer a probe, and will be declared failed unless it refutes this in time
+        CONFIRM, // The member has been declared failed
+        LEFT     // The member left the group voluntarily
+    };
+
+    update_type type;
+    uint32_t id;
+    // Updates about a member only replace updates with a lower incarnation, and only the member itself increments it
+    uint32_t incarnation;
+    std::string hostname;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&swim_update::type, &swim_update::id, &swim_update::incarnation, &swim_update::hostname);
+    }
+};
+
+struct swim_message {
+    enum msg_type : uint32_t {
+        PING,     // Asks the recipient for an ACK
+        ACK,      // Answers a PING, carrying the seq of the PING
+        PING_REQ, // Asks the recipient to PING target_id on behalf of the sender and relay the ACK back
+        JOIN,     // Asks the recipient to introduce the sender, whose ALIVE update is in updates, to the group
+        INTRO     // Answers a JOIN with an ALIVE update for every member of the group
+    };
+
+    msg_type type;
+    uint32_t sender_id;
+    // Allows a recipient that has not heard of the sender yet to answer it
+    std::string sender_hostname;
+    uint32_t seq;
+    // The member being probed for a PING_REQ, and the member that answered for an ACK
+    uint32_t target_id;
+    // The member that a PING is being sent on behalf of, which its ACK must be relayed to, or 0 for a direct PING
+    uint32_t relay_for;
+    std::vector<swim_update> updates;
+
+    static constexpr auto fields() {
+        return std::make_tuple(&swim_message::type, &swim_message::sender_id, &swim_message::sender_hostname,
+            &swim_message::seq, &swim_message::target_id, &swim_message::relay_for, &swim_message::updates);
+    }
+
+    // Parses a message, returning false if it is malformed
+    auto parse(std::string_view buf) -> bool;
+    // Appends the serialized message to the end of buf
+    void serialize(std::string &buf) const;
+};
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <functional>
+#include <sys/types.h>
 
 #define MAX_CLIENTS 10
 #define CHUNK_SIZE 4096
@@ -19,6 +22,13 @@ public:
     // Writes the specified number of bytes to the given socket
     // Returns number of bytes written, 0 on socket disconnect, and -1 on failure
     virtual auto write_to_client(int client, std::string const& data) -> ssize_t = 0;
+    // Sends the first size bytes of the open file fd to the client behind a single length header,
+    // without copying the contents through user space
+    // Returns number of bytes of the file written, and -1 on failure or socket disconnect
+    virtual auto write_file_to_client(int client, int fd, size_t size) -> ssize_t = 0;
+    // Receives a file sent with write_file_to_server and writes it to the start of the open file fd
+    // Returns number of bytes of the file read, and -1 on failure or socket disconnect
+    virtual auto read_file_from_client(int client, int fd) -> ssize_t = 0;
 };
 
 class tcp_client {
@@ -30,10 +40,52 @@ public:
     // Writes the specified number of bytes to the given socket
     // Returns number of bytes written, 0 on socket disconnect, and -1 on failure
     virtual auto write_to_server(std::string const& data) -> ssize_t = 0;
+    // Sends the first size bytes of the open file fd to the server behind a single length header,
+    // without copying the contents through user space
+    // Returns number of bytes of the file written, and -1 on failure or socket disconnect
+    virtual auto write_file_to_server(int fd, size_t size) -> ssize_t = 0;
+    // Receives a file sent with write_file_to_client and writes it to the start of the open file fd
+    // Returns number of bytes of the file read, and -1 on failure or socket disconnect
+    virtual auto read_file_from_server(int fd) -> ssize_t = 0;
+};
+
+// A TCP server which multiplexes all of its connections onto a single event loop and hands each complete message
+// to a bounded pool of handler threads, instead of requiring a thread per connection
+// Messages from a single client are handled one at a time, in the order they were received
+// Each stream opened by a pooled client appears to the handler as a separate client
+class tcp_event_server {
+public:
+    // Called with the ID of the client that sent the message and the message itself
+    using message_handler = std::function<void(int client, std::string const& msg)>;
+
+    virtual ~tcp_event_server() {}
+    // Starts the event loop, calling handler for every complete message received from any client
+    virtual void start(message_handler const& handler) = 0;
+    // Stops the event loop and closes all remaining connections
+    virtual void stop() = 0;
+    // Closes the connection with the given client once all data written to it has been sent
+    // No further messages from the client will be handled after this is called
+    virtual void close_connection(int client) = 0;
+    // Queues the data to be sent to the given client as a single message
+    // Returns number of bytes queued, 0 if the client is not connected, and -1 on failure
+    virtual auto write_to_client(int client, std::string const& data) -> ssize_t = 0;
 };
 
 class tcp_factory {
 public:
     virtual auto get_tcp_client(std::string const& host, int port) -> std::unique_ptr<tcp_client> = 0;
     virtual auto get_tcp_server(int port) -> std::unique_ptr<tcp_server> = 0;
+    // Returns a server whose messages will be handled by at most num_handlers threads at once
+    virtual auto get_tcp_event_server(int port, unsigned num_handlers) -> std::unique_ptr<tcp_event_server> = 0;
+    // Returns a client for a tcp_event_server which sends its messages on its own stream over a persistent connection
+    // shared with all other pooled clients for the same host and port, or nullptr on failure
+    // Destroying the client ends its stream but leaves the shared connection open
+    // File transfers are not supported on pooled clients, since they would hold up every other stream
+    virtual auto get_pooled_tcp_client(std::string const& host, int port) -> std::unique_ptr<tcp_client> = 0;
+    // Closes all pooled connections to the given host, causing any clients using them to fail
+    virtual void evict_pooled_connections(std::string const& host) = 0;
+    // Sets the options for connections made or accepted by clients and servers created afterwards
+    // nodelay (the default) disables Nagle's algorithm so that small messages are never held back waiting for an ACK,
+    // and cork holds back partial packets while a multi-part send such as a file transfer is in progress
+    virtual void configure(bool nodelay, bool cork) = 0;
 };
@@ -2,16 +2,175 @@
 
 #include <functional>
 #include <memory>
+#include <future>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+#include <utility>
+#include <new>
+#include <cstddef>
+
+// A move-only void() callable, which unlike std::function can hold move-only callables such as lambdas that capture
+// a std::unique_ptr or a std::packaged_task
+// Callables of up to inline_size bytes are stored inside the task itself instead of being allocated on the heap
+class task {
+public:
+    static constexpr size_t inline_size = 64;
+
+    task() : ops(nullptr) {}
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, task>>>
+    task(F &&f) {
+        using fn_type = std::decay_t<F>;
+        if constexpr (fits_inline<fn_type>) {
+            new (&storage) fn_type(std::forward<F>(f));
+            ops = &inline_ops<fn_type>;
+        } else {
+            new (&storage) fn_type*(new fn_type(std::forward<F>(f)));
+            ops = &heap_ops<fn_type>;
+        }
+    }
+
+    task(task &&other) noexcept : ops(other.ops) {
+        if (ops) {
+            ops->move(&storage, &other.storage);
+            other.ops = nullptr;
+        }
+    }
+
+    auto operator=(task &&other) noexcept -> task& {
+        if (this != &other) {
+            reset();
+            ops = other.ops;
+            if (ops) {
+                ops->move(&storage, &other.storage);
+                other.ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    task(task const&) = delete;
+    auto operator=(task const&) -> task& = delete;
+
+    ~task() {
+        reset();
+    }
+
+    void operator()() {
+        ops->call(&storage);
+    }
+
+    explicit operator bool() const {
+        return ops != nullptr;
+    }
+
+private:
+    struct task_ops {
+        void (*call)(void *storage);
+        // Move constructs the callable in dest from src and destroys src
+        void (*move)(void *dest, void *src);
+        void (*destroy)(void *storage);
+    };
+
+    template <typename F>
+    static constexpr bool fits_inline = sizeof(F) <= inline_size && alignof(F) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<F>;
+
+    template <typename F>
+    static constexpr task_ops inline_ops = {
+        [] (void *storage) {(*static_cast<F*>(storage))();},
+        [] (void *dest, void *src) {
+            new (dest) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        },
+        [] (void *storage) {static_cast<F*>(storage)->~F();}
+    };
+
+    template <typename F>
+    static constexpr task_ops heap_ops = {
+        [] (void *storage) {(**static_cast<F**>(storage))();},
+        [] (void *dest, void *src) {*static_cast<F**>(dest) = *static_cast<F**>(src);},
+        [] (void *storage) {delete *static_cast<F**>(storage);}
+    };
+
+    void reset() {
+        if (ops) {
+            ops->destroy(&storage);
+            ops = nullptr;
+        }
+    }
+
+    std::aligned_storage_t<inline_size, alignof(std::max_align_t)> storage;
+    task_ops const* ops;
+};
 
 class threadpool {
 public:
     virtual ~threadpool() {}
-    virtual void enqueue(std::function<void()> const& task) = 0;
+    virtual void enqueue(task t) = 0;
     virtual void finish() = 0;
+
+    // Runs f in the threadpool, returning a future for its result
+    template <typename F>
+    auto submit(F &&f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        std::packaged_task<std::invoke_result_t<std::decay_t<F>>()> pt(std::forward<F>(f));
+        auto result = pt.get_future();
+        enqueue(std::move(pt));
+        return result;
+    }
+
+    // Calls fn(i) for every i in [begin, end) in the threadpool, and returns once all the calls have completed
+    // Must not be called from a task running in the same threadpool, which could otherwise wait on itself forever
+    template <typename F>
+    void parallel_for(size_t begin, size_t end, F const& fn) {
+        struct countdown {
+            std::mutex m;
+            std::condition_variable cv;
+            size_t remaining;
+        } done;
+        done.remaining = end - begin;
+
+        for (size_t i = begin; i < end; i++) {
+            enqueue([&fn, &done, i] {
+                fn(i);
+                std::lock_guard<std::mutex> guard(done.m);
+                if (--done.remaining == 0) {
+                    done.cv.notify_one();
+                }
+            });
+        }
+
+        std::unique_lock<std::mutex> guard(done.m);
+        done.cv.wait(guard, [&] {
+            return done.remaining == 0;
+        });
+    }
 };
 
+// Waits for all of the futures, returning their results in the same order
+template <typename T>
+auto when_all(std::vector<std::future<T>> &futures) -> std::vector<T> {
+    std::vector<T> results;
+    results.reserve(futures.size());
+    for (auto &f : futures) {
+        results.push_back(f.get());
+    }
+    return results;
+}
+
+// Waits for all of the futures, rethrowing the first exception thrown by any of them
+inline void when_all(std::vector<std::future<void>> &futures) {
+    for (auto &f : futures) {
+        f.get();
+    }
+}
+
 class threadpool_factory {
 public:
     virtual auto get_threadpool(unsigned num_threads) const -> std::unique_ptr<threadpool> = 0;
+    // Gets a threadpool where each thread has its own queue of tasks and steals from the others when it runs out,
+    // which scales better with many small tasks or tasks that enqueue more tasks
+    virtual auto get_work_stealing_threadpool(unsigned num_threads) const -> std::unique_ptr<threadpool> = 0;
 };
-
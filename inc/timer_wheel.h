@@ -0,0 +1,24 @@
+#pragma once
+
+#include "threadpool.h"
+
+#include <cstdint>
+
+// Identifies a scheduled callback so that it can be cancelled, where 0 is never a valid ID
+using timer_id = uint64_t;
+
+// Runs callbacks after a delay on a single thread shared by the whole environment, instead of each component
+// keeping a thread that sleeps and polls
+// Callbacks share the thread, so they must not block, and should hand any long running work off to another thread
+class timer_wheel {
+public:
+    virtual ~timer_wheel() {}
+
+    // Calls fn once on the timer thread after delay_ms, returning an ID that can be used to cancel the call
+    virtual auto schedule(uint64_t delay_ms, task fn) -> timer_id = 0;
+    // Calls fn on the timer thread every interval_ms, starting interval_ms from now, until it is cancelled
+    virtual auto schedule_repeating(uint64_t interval_ms, task fn) -> timer_id = 0;
+    // Prevents any further calls to the callback, returning false if there were none left to prevent
+    // A call that is already running is not waited for, so a callback can safely cancel itself
+    virtual auto cancel(timer_id id) -> bool = 0;
+};
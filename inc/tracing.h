@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+// The services that record trace events
+enum class trace_component : uint16_t {
+    heartbeater, election, mj_master, mj_worker, num_components
+};
+
+// Every event that can be traced, where the arguments of each event are described in trace_event_schemas
+enum class trace_event : uint16_t {
+    heartbeat_sent, heartbeat_received, member_timed_out, member_failed,
+    election_transition,
+    append_permission, file_done, job_started, job_ended,
+    file_processed,
+    num_events
+};
+
+struct trace_event_schema {
+    char const* name;
+    // The names of the arguments in the order they are recorded, followed by nullptr
+    char const* args[6];
+};
+
+inline constexpr char const* trace_component_names[] = {
+    "heartbeater", "election", "mj_master", "mj_worker"
+};
+
+inline constexpr trace_event_schema trace_event_schemas[] = {
+    {"heartbeat_sent", {"neighbors", "failed", "left", "joined", nullptr}},
+    {"heartbeat_received", {"sender", nullptr}},
+    {"member_timed_out", {"id", "hostname", nullptr}},
+    {"member_failed", {"id", "hostname", nullptr}},
+    {"election_transition", {"from", "to", nullptr}},
+    {"append_permission", {"job", "hostname", "output_file", "input_file", "granted", nullptr}},
+    {"file_done", {"job", "hostname", "file", "completed", "total", nullptr}},
+    {"job_started", {"job", "exe", "num_files", nullptr}},
+    {"job_ended", {"job", "succeeded", nullptr}},
+    {"file_processed", {"job", "file", "succeeded", nullptr}}
+};
+static_assert(sizeof(trace_event_schemas) / sizeof(trace_event_schema) == static_cast<size_t>(trace_event::num_events));
+
+// An argument of a trace event, which is either an integer or a string that must outlive the call that records it
+class trace_arg {
+public:
+    template <typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    trace_arg(T value) : is_string(false), int_value(static_cast<int64_t>(value)) {}
+    trace_arg(std::string const& value) : is_string(true), string_value(value) {}
+    trace_arg(std::string_view value) : is_string(true), string_value(value) {}
+    trace_arg(char const* value) : is_string(true), string_value(value) {}
+
+    bool is_string;
+    int64_t int_value = 0;
+    std::string_view string_value;
+};
+
+// Records fixed schema binary events for a single component, which are much cheaper to record than log lines
+// Events are written to rotating files that can be merged across nodes and printed with maplejuice decode
+class tracer {
+public:
+    virtual ~tracer() {}
+
+    // Returns false if tracing is not configured, in which case recording events does nothing
+    virtual auto enabled() const -> bool = 0;
+    virtual void event(trace_event ev, std::initializer_list<trace_arg> args) const = 0;
+};
+
+// An event read back from a trace file
+struct decoded_trace_event {
+    uint64_t timestamp_ns;
+    std::string hostname;
+    trace_component component;
+    trace_event event;
+    std::vector<std::variant<int64_t, std::string>> args;
+};
+
+class trace_decoder {
+public:
+    // Reads every trace file in the directory, from any number of nodes, and returns their events ordered by time
+    static auto read_dir(std::string const& dir) -> std::vector<decoded_trace_event>;
+    // Formats an event as a single line of text
+    static auto format(decoded_trace_event const& ev) -> std::string;
+};
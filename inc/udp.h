@@ -2,6 +2,8 @@
 
 #include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 class udp_server {
 public:
@@ -12,6 +14,11 @@ public:
     virtual void stop_server() = 0;
     // Wrapper function around recvfrom that handles errors
     virtual auto recv(char *buf, unsigned length) -> int = 0;
+    // Blocks until a packet arrives, then receives it along with any others that are already waiting, replacing
+    // the contents of packets with them. The packets point into buffers owned by the server which are reused by
+    // the next call, and are never truncated
+    // Returns the number of packets received, 0 if the server was stopped, or -1 on failure
+    virtual auto recv_batch(std::vector<std::string_view> &packets) -> int = 0;
 };
 
 class udp_client {
@@ -19,6 +26,8 @@ public:
     virtual ~udp_client() {}
     // Sends a UDP packet to the specified destination
     virtual void send(std::string const& host, int port, std::string const& msg) = 0;
+    // Sends the same UDP packet to each of the destinations, in as few system calls as possible
+    virtual void send_all(std::vector<std::string> const& hosts, int port, std::string const& msg) = 0;
 };
 
 class udp_factory {
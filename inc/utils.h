@@ -1,7 +1,13 @@
 #pragma once
 
 #include <functional>
+#include <string_view>
 
 namespace utils {
     bool backoff(std::function<bool()> const& callback, std::function<bool()> const& give_up = [] {return false;});
+
+    // Reads fd until EOF, calling callback with each line without its \n, where a final line without a \n is ignored
+    // Lines point into a buffer that is reused by the calling thread, so they are only valid during the callback
+    // Returns false if reading fails or the callback returns false, which stops reading
+    bool read_lines(int fd, std::function<bool(std::string_view)> const& callback);
 }
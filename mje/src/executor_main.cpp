@@ -0,0 +1,47 @@
+#include "mj_executor.h"
+#include "mj_plugin.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+// Provided by the plugin source this is linked with, so that the same code can run as a plugin or an executor
+extern "C" int mj_map(const char *key, size_t klen, const char *val, size_t vlen, mj_emit_fn emit, void *emit_ctx);
+
+namespace {
+void write_record(uint32_t klen, uint64_t vlen) {
+    fwrite(&klen, sizeof(klen), 1, stdout);
+    fwrite(&vlen, sizeof(vlen), 1, stdout);
+}
+
+void emit_record(void *emit_ctx, const char *key, size_t klen, const char *val, size_t vlen) {
+    write_record(klen, vlen);
+    fwrite(key, 1, klen, stdout);
+    fwrite(val, 1, vlen, stdout);
+}
+}
+
+int main(int argc, char **argv) {
+    static char out_buffer[1 << 16];
+    setvbuf(stdout, out_buffer, _IOFBF, sizeof(out_buffer));
+
+    string input;
+    while (true) {
+        uint32_t klen;
+        uint64_t vlen;
+        if (fread(&klen, sizeof(klen), 1, stdin) != 1 || fread(&vlen, sizeof(vlen), 1, stdin) != 1) {
+            return 0;
+        }
+
+        input.resize(klen + vlen);
+        if (fread(input.data(), 1, input.size(), stdin) != input.size()) {
+            return 1;
+        }
+
+        int status = mj_map(input.data(), klen, input.data() + klen, vlen, emit_record, nullptr);
+        write_record(MJ_EXECUTOR_END_OF_INPUT, status);
+        fflush(stdout);
+    }
+}
@@ -0,0 +1,37 @@
+#include "mj_plugin.h"
+
+#include <string>
+
+using namespace std;
+
+namespace {
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+}
+
+// Sums the counts for a word exactly as wc_juice does, but without running once per key
+extern "C" int mj_map(const char *key, size_t klen, const char *val, size_t vlen, mj_emit_fn emit, void *emit_ctx) {
+    // wc_juice is not given a key when it is empty, and outputs nothing
+    if (klen == 0) {
+        return 0;
+    }
+
+    unsigned count = 0;
+
+    string cur_num;
+    for (size_t i = 0; i <= vlen; i++) {
+        if (i < vlen && !is_space(val[i])) {
+            cur_num += val[i];
+        } else if (!cur_num.empty()) {
+            try {
+                count += std::stoi(cur_num);
+            } catch (...) {}
+            cur_num.clear();
+        }
+    }
+
+    string count_str = to_string(count);
+    emit(emit_ctx, key, klen, count_str.data(), count_str.size());
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "mj_plugin.h"
+
+#include <map>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+namespace {
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+bool is_alnum(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+}
+
+// Counts the words in the file exactly as wc_maple does, but without running once per file
+extern "C" int mj_map(const char *key, size_t klen, const char *val, size_t vlen, mj_emit_fn emit, void *emit_ctx) {
+    map<string, unsigned> counts;
+
+    string cur_word;
+    bool in_word = false;
+    for (size_t i = 0; i < vlen; i++) {
+        char c = val[i];
+        if (c == '\n') {
+            // wc_maple reads line by line, so unlike other whitespace a newline only counts a word if one was started
+            if (in_word) {
+                counts[cur_word]++;
+            }
+            cur_word.clear();
+            in_word = false;
+        } else if (is_space(c)) {
+            counts[cur_word]++;
+            cur_word.clear();
+            in_word = false;
+        } else {
+            if (is_alnum(c)) {
+                cur_word += c;
+            }
+            in_word = true;
+        }
+    }
+    if (in_word) {
+        counts[cur_word]++;
+    }
+
+    for (auto const& [word, count] : counts) {
+        string count_str = to_string(count);
+        emit(emit_ctx, word.data(), word.size(), count_str.data(), count_str.size());
+    }
+    return 0;
+}
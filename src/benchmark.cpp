@@ -0,0 +1,59 @@
+#include "benchmark.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <new>
+
+namespace {
+// Counted by the replacement operator new below, so that benchmarks can measure allocations without a profiler
+thread_local uint64_t num_allocations = 0;
+}
+
+void *operator new(size_t size) {
+    num_allocations++;
+    void *ptr = std::malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept {
+    std::free(ptr);
+}
+
+std::vector<std::tuple<std::string, std::string, std::function<void(logger::log_level)>>> benchmarking::benchmarks;
+
+benchmarking::register_benchmark::register_benchmark(std::string const& name, std::string const& description,
+    std::function<void(logger::log_level)> const& benchmark_fn)
+{
+    benchmarks.push_back({name, description, benchmark_fn});
+}
+
+void benchmarking::run_benchmarks(std::string const& prefix, logger::log_level level) {
+    // Benchmarks are always run serially so that they do not disturb each other's measurements
+    for (auto const& [name, description, benchmark_fn] : benchmarks) {
+        if (name.find(prefix) != 0) {
+            continue;
+        }
+
+        std::cout << "=== Running benchmark " << name << " ===" << std::endl;
+        std::cout << "=== " << description << " ===" << std::endl;
+        benchmark_fn(level);
+        std::cout << "Finished " << name << std::endl;
+    }
+}
+
+void benchmarking::report(std::string const& metric, double value, std::string const& unit) {
+    std::cout << "    " << std::left << std::setw(56) << metric << " "
+              << std::right << std::fixed << std::setprecision(2) << std::setw(14) << value << " " << unit << std::endl;
+}
+
+auto benchmarking::allocations() -> uint64_t {
+    return num_allocations;
+}
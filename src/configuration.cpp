@@ -18,6 +18,14 @@ auto configuration_impl::is_first_node() const -> bool {
     return first_node;
 }
 
+void configuration_impl::set_swim_heartbeater(bool use_swim) {
+    swim_heartbeater = use_swim;
+}
+
+auto configuration_impl::uses_swim_heartbeater() const -> bool {
+    return swim_heartbeater;
+}
+
 void configuration_impl::set_hb_port(int port_) {
     hb_port = port_;
 }
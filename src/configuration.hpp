@@ -18,6 +18,7 @@ public:
 
     void set_hostname(std::string const& hostname);
     void set_first_node(bool is_first_node_);
+    void set_swim_heartbeater(bool use_swim);
     void set_hb_port(int port);
     void set_election_port(int port);
     void set_sdfs_internal_port(int port);
@@ -31,6 +32,7 @@ public:
 
     auto get_hostname() const -> std::string;
     auto is_first_node() const -> bool;
+    auto uses_swim_heartbeater() const -> bool;
     auto get_hb_port() const -> int;
     auto get_election_port() const -> int;
     auto get_sdfs_internal_port() const -> int;
@@ -45,6 +47,7 @@ public:
 protected:
     std::string hostname;
     bool first_node;
+    bool swim_heartbeater = false;
     int hb_port;
     int election_port;
     int sdfs_internal_port;
@@ -14,11 +14,14 @@ using std::string;
 
 election_impl::election_impl(environment &env)
     : hb(env.get<heartbeater>()),
+      tw(env.get<timer_wheel>()),
       lg(env.get<logger_factory>()->get_logger("election")),
+      tr(env.get<logger_factory>()->get_tracer(trace_component::election)),
       client(env.get<udp_factory>()->get_udp_client()),
       server(env.get<udp_factory>()->get_udp_server()),
       config(env.get<configuration>()), running(false)
 {
+    el_state_lock.profile_as("election::el_state_lock");
     unlocked<election_state> el_state = el_state_lock();
     if (config->is_first_node()) {
         // Set ourselves as the master node
@@ -40,16 +43,15 @@ void election_impl::start() {
     lg->info("Starting election");
 
     running = true;
-    tm_state_lock()->timer_on = false;
 
     // Initialize RNG with a slight delay so that unit tests have different seeds
     el_state_lock()->mt_rand = std::mt19937(duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
     std::this_thread::sleep_for(std::chrono::milliseconds(5));
 
-    std::thread timer_thread([&] {
-        update_timer();
+    // Forget message IDs once UDP messages carrying them can no longer be arriving
+    seen_ids_timer = tw->schedule_repeating(60000, [this] {
+        el_state_lock()->seen_message_ids.pop();
     });
-    timer_thread.detach();
 
     std::thread server_thread([&] {
         server_thread_function();
@@ -88,7 +90,7 @@ void election_impl::start() {
         unlocked<election_state> el_state = el_state_lock();
 
         if (el_state->state == normal && el_state->master_node.id == hb->get_id()) {
-            lg->debug("Telling node at " + m.hostname + " that we are the master node");
+            lg->debug("Telling node at ", m.hostname, " that we are the master node");
 
             // Tell the new node we are the master node
             election_message intro_msg(hb->get_id(), el_state->mt_rand());
@@ -113,6 +115,8 @@ void election_impl::stop() {
 
     server->stop_server();
     running = false;
+    stop_timer();
+    tw->cancel(seen_ids_timer);
     std::this_thread::sleep_for(std::chrono::milliseconds(2000));
     hb->stop();
 }
@@ -142,7 +146,8 @@ void election_impl::transition(election_state_enum origin_state, election_state_
     stop_timer();
 
     el_state->state = dest_state;
-    lg->debug("Election state transition " + print_state(origin_state) + " -> " + print_state(el_state->state));
+    lg->debug("Election state transition ", print_state(origin_state), " -> ", print_state(el_state->state));
+    tr->event(trace_event::election_transition, {print_state(origin_state), print_state(el_state->state)});
 
     switch (dest_state) {
         case election_wait: {
@@ -192,82 +197,70 @@ void election_impl::transition(election_state_enum origin_state, election_state_
     }
 }
 
-// Starts the timer to run for the given number of milliseconds
+// Starts the timer to run for the given number of milliseconds, replacing any timer that is already running
 void election_impl::start_timer(uint32_t time) {
     unlocked<timer_state> tm_state = tm_state_lock();
 
-    tm_state->timer_on = true;
-    tm_state->timer = time;
-    tm_state->prev_time = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    if (tm_state->id != 0) {
+        tw->cancel(tm_state->id);
+    }
+    uint64_t generation = ++tm_state->generation;
+    tm_state->id = tw->schedule(time, [this, generation] {
+        timer_expired(generation);
+    });
 }
 
 // Stops the timer
 void election_impl::stop_timer() {
     unlocked<timer_state> tm_state = tm_state_lock();
 
-    tm_state->timer_on = false;
-    tm_state->timer = 0;
+    if (tm_state->id != 0) {
+        tw->cancel(tm_state->id);
+        tm_state->id = 0;
+    }
+    tm_state->generation++;
 }
 
-// Updates the timer and performs the appropriate action in the state machine if the timer reaches 0
-void election_impl::update_timer() {
-    uint64_t elapsed_time = 0;
-    for (; running.load(); std::this_thread::sleep_for(std::chrono::milliseconds(100))) {
-        unlocked<election_state> el_state = el_state_lock();
+// Performs the appropriate action in the state machine when the timer with the given generation expires
+void election_impl::timer_expired(uint64_t generation) {
+    unlocked<election_state> el_state = el_state_lock();
+    {
         unlocked<timer_state> tm_state = tm_state_lock();
 
-        if (tm_state->timer_on) {
-            // Update timer without letting it overflow (since it is unsigned)
-            uint32_t cur_time = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-            uint32_t diff = cur_time - tm_state->prev_time;
-            tm_state->prev_time = cur_time;
-            tm_state->timer = (tm_state->timer > diff) ? (tm_state->timer - diff) : 0;
-
-            if (tm_state->timer != 0) {
-                continue;
-            } else {
-                // Now that the timer has expired, turn the timer off before we perform the associated action
-                tm_state->timer_on = false;
-            }
-        } else {
-            continue;
+        // The timer may have been restarted or stopped after it was due but before we got the lock
+        if (!running.load() || tm_state->generation != generation) {
+            return;
         }
+        tm_state->id = 0;
+    }
 
-        switch (el_state->state) {
-            case election_wait: {
-                lg->debug("Membership list has stabilized, sending election initiation message");
-                transition(election_wait, election_init);
-                break;
-            }
-            case electing:
-            case elected: {
-                el_state->highest_initiator_id = 0;
-                lg->info("Election has timed out, restarting election by sending PROPOSAL message");
-
-                // Create a proposal message to send to the next node to start a new election
-                election_message proposal_msg(hb->get_id(), el_state->mt_rand());
-                proposal_msg.set_type_proposal();
-                enqueue_message(hb->get_successor().hostname, proposal_msg, message_redundancy, el_state);
-
-                // Transition to a waiting state while the proposal message makes the rounds and
-                //  the membership list stabilizes
-                transition(el_state->state, election_wait);
-                break;
-            }
-            case normal:
-            case election_init:
-            case no_master:
-                assert(false && "These states do not have timers associated with them");
-            default:
-                break;
+    switch (el_state->state) {
+        case election_wait: {
+            lg->debug("Membership list has stabilized, sending election initiation message");
+            transition(election_wait, election_init);
+            break;
         }
+        case electing:
+        case elected: {
+            el_state->highest_initiator_id = 0;
+            lg->info("Election has timed out, restarting election by sending PROPOSAL message");
+
+            // Create a proposal message to send to the next node to start a new election
+            election_message proposal_msg(hb->get_id(), el_state->mt_rand());
+            proposal_msg.set_type_proposal();
+            enqueue_message(hb->get_successor().hostname, proposal_msg, message_redundancy, el_state);
 
-        // Update seen_message_ids if 1 minute has passed
-        uint64_t new_time = elapsed_time + 100;
-        if (new_time / 60000 > elapsed_time / 60000) {
-            el_state->seen_message_ids.pop();
+            // Transition to a waiting state while the proposal message makes the rounds and
+            //  the membership list stabilizes
+            transition(el_state->state, election_wait);
+            break;
         }
-        elapsed_time = new_time;
+        case normal:
+        case election_init:
+        case no_master:
+            assert(false && "These states do not have timers associated with them");
+        default:
+            break;
     }
 }
 
@@ -309,23 +302,23 @@ void election_impl::enqueue_message(string const& dest, election_message const&
 {
     // Print log information first
     if (msg.get_type() == election_message::msg_type::introduction) {
-        lg->debug("Informing new node at " + dest + " that master node is " +
+        lg->debug("Informing new node at ", dest, " that master node is ",
             hb->get_member_by_id(msg.get_master_id()).hostname);
     }
 
     if (msg.get_type() == election_message::msg_type::election) {
-        lg->debug("Sending ELECTION message with initiator ID " + std::to_string(msg.get_initiator_id()) +
-            " and vote ID " + std::to_string(msg.get_vote_id()) + " to node at " + dest);
+        lg->debug("Sending ELECTION message with initiator ID ", msg.get_initiator_id(),
+            " and vote ID ", msg.get_vote_id(), " to node at ", dest);
     }
 
     if (msg.get_type() == election_message::msg_type::elected) {
-        lg->debug("Sending ELECTED message with master ID " + std::to_string(msg.get_master_id()) +
-            " to node at " + dest);
+        lg->debug("Sending ELECTED message with master ID ", msg.get_master_id(),
+            " to node at ", dest);
     }
 
     if (msg.get_type() == election_message::msg_type::proposal) {
-        lg->debug("Sending PROPOSAL message with UUID " + std::to_string(msg.get_uuid()) +
-            " to node at " + dest);
+        lg->debug("Sending PROPOSAL message with UUID ", msg.get_uuid(),
+            " to node at ", dest);
     }
 
     if (msg.get_type() == election_message::msg_type::empty) {
@@ -360,7 +353,7 @@ void election_impl::server_thread_function() {
 
             // Make sure that the message originates from within our group
             if (hb->get_member_by_id(msg.get_id()).id != msg.get_id()) {
-                lg->trace("Ignoring election message from " + std::to_string(msg.get_id()) + " because they are not in the group");
+                lg->trace("Ignoring election message from ", msg.get_id(), " because they are not in the group");
                 continue;
             }
 
@@ -368,7 +361,7 @@ void election_impl::server_thread_function() {
             std::vector<uint32_t> const& seen_ids = el_state->seen_message_ids.peek();
             if (std::find(seen_ids.begin(), seen_ids.end(), msg.get_uuid()) != seen_ids.end()) {
                 // Ignore the message
-                lg->trace("Received duplicate message of type " + msg.print_type() + " from host at " +
+                lg->trace("Received duplicate message of type ", msg.print_type(), " from host at ",
                     hb->get_member_by_id(msg.get_id()).hostname);
                 continue;
             }
@@ -381,23 +374,23 @@ void election_impl::server_thread_function() {
                     case election_wait: {
                         add_to_cache(msg, el_state);
                         propagate(msg, el_state);
-                        lg->debug("Received election message from " + hb->get_member_by_id(msg.get_id()).hostname +
-                            " with initiator ID " + std::to_string(msg.get_initiator_id()) +
-                            " and vote ID " + std::to_string(msg.get_vote_id()));
+                        lg->debug("Received election message from ", hb->get_member_by_id(msg.get_id()).hostname,
+                            " with initiator ID ", msg.get_initiator_id(),
+                            " and vote ID ", msg.get_vote_id());
                         transition(election_wait, electing);
                         break;
                     }
                     case electing: {
                         if (msg.get_vote_id() == hb->get_id()) {
-                            lg->debug("Received election message with our ID from " + hb->get_member_by_id(msg.get_id()).hostname);
+                            lg->debug("Received election message with our ID from ", hb->get_member_by_id(msg.get_id()).hostname);
 
                             transition(electing, elected);
                         } else {
                             add_to_cache(msg, el_state);
                             propagate(msg, el_state);
-                            lg->debug("Received election message from " + hb->get_member_by_id(msg.get_id()).hostname +
-                                " with initiator ID " + std::to_string(msg.get_initiator_id()) +
-                                " and vote ID " + std::to_string(msg.get_vote_id()));
+                            lg->debug("Received election message from ", hb->get_member_by_id(msg.get_id()).hostname,
+                                " with initiator ID ", msg.get_initiator_id(),
+                                " and vote ID ", msg.get_vote_id());
                         }
                         break;
                     }
@@ -409,9 +402,9 @@ void election_impl::server_thread_function() {
 
                         add_to_cache(msg, el_state);
                         propagate(msg, el_state);
-                        lg->debug("Received election message from " + hb->get_member_by_id(msg.get_id()).hostname +
-                            " with initiator ID " + std::to_string(msg.get_initiator_id()) +
-                            " and vote ID " + std::to_string(msg.get_vote_id()) +
+                        lg->debug("Received election message from ", hb->get_member_by_id(msg.get_id()).hostname,
+                            " with initiator ID ", msg.get_initiator_id(),
+                            " and vote ID ", msg.get_vote_id(),
                             " while in state ELECTED");
                         transition(elected, electing);
                         break;
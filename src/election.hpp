@@ -6,6 +6,7 @@
 #include "logging.h"
 #include "redundant_queue.h"
 #include "udp.h"
+#include "timer_wheel.h"
 #include "election_messages.h"
 #include "service.h"
 #include "environment.h"
@@ -66,15 +67,17 @@ private:
     // Passes on an ELECTION message as defined by the protocol
     void propagate(election_message const& msg, unlocked<election_state> const& el_state);
 
-    // Sets and updates the timer, and when the timer reaches 0, performs the appropriate action depending on the state
+    // Sets the timer, and when it expires, performs the appropriate action depending on the state
     struct timer_state {
-        bool timer_on;
-        uint32_t timer;
-        uint32_t prev_time;
+        // The timer currently scheduled on the timer wheel, or 0 if there is none
+        timer_id id = 0;
+        // Incremented whenever the timer is started or stopped, so that a callback that was already running when
+        // the timer changed can tell that it is stale
+        uint64_t generation = 0;
     };
     void start_timer(uint32_t time);
     void stop_timer();
-    void update_timer();
+    void timer_expired(uint64_t generation);
     locked<timer_state> tm_state_lock;
 
     // Debugging function to print a string value for the enum
@@ -82,7 +85,9 @@ private:
 
     // Services that we depend on
     heartbeater *hb;
+    timer_wheel *tw;
     std::unique_ptr<logger> lg;
+    std::unique_ptr<tracer> tr;
     std::unique_ptr<udp_client> client;
     std::unique_ptr<udp_server> server;
     configuration *config;
@@ -107,4 +112,6 @@ private:
 
     // Indicates whether or not the election is running
     std::atomic<bool> running;
+    // Pops seen_message_ids every minute
+    timer_id seen_ids_timer = 0;
 };
@@ -21,7 +21,7 @@ auto election_message::operator==(const election_message &m) -> bool {
 }
 
 // Creates a message from a buffer
-election_message::election_message(char *buf_, unsigned length_) {
+election_message::election_message(const char *buf_, unsigned length_) {
     deserializer des(buf_, length_);
 
     try {
@@ -59,29 +59,30 @@ election_message::election_message(char *buf_, unsigned length_) {
 
 // Serializes the message and returns a string containing the message
 auto election_message::serialize() const -> std::string {
+    std::string buf;
+    serialize(buf);
+    return buf;
+}
+
+// Appends the serialized message to the end of buf
+void election_message::serialize(std::string &buf) const {
     if (type == msg_type::empty) {
-        return "";
+        return;
     }
 
-    serializer ser;
-
-    ser.add_field(id);
-    ser.add_field(uuid);
-    ser.add_field(static_cast<uint32_t>(type));
+    serializer ser(buf);
 
     switch (type) {
         case msg_type::election:
-            ser.add_field(initiator_id);
-            ser.add_field(vote_id);
+            ser.add_fields(id, uuid, type, initiator_id, vote_id);
             break;
         case msg_type::elected:
         case msg_type::introduction:
-            ser.add_field(master_id);
+            ser.add_fields(id, uuid, type, master_id);
             break;
         case msg_type::proposal:
+            ser.add_fields(id, uuid, type);
             break;
         default: assert(false && "Memory corruption caused msg_type to be invalid");
     }
-
-    return ser.serialize();
 }
@@ -1,43 +1,220 @@
 #include "hb_messages.h"
 #include "serialization.h"
 
+#include <algorithm>
 #include <cassert>
+#include <string_view>
 
 using std::string;
+using std::string_view;
+
+namespace {
+    // Lists of members are encoded into blobs that each fit in a single string field of a message
+    // A blob starts with a dictionary of the domains (everything from the first '.' on) of its hostnames, followed
+    // by the members sorted by hostname. Each member is its ID, the index of its domain, and the rest of its hostname
+    // front coded against the previous member's, which is usually all but the last character or two
+    const size_t max_blob_size = MAX_DESERIALIZABLE_STRING_LEN;
+    // The most bytes a varint takes up
+    const size_t max_varint_size = 5;
+
+    void put_varint(string &buf, uint32_t n) {
+        while (n >= 0x80) {
+            buf.push_back(static_cast<char>((n & 0x7F) | 0x80));
+            n >>= 7;
+        }
+        buf.push_back(static_cast<char>(n));
+    }
+
+    auto get_varint(string_view blob, size_t &pos) -> uint32_t {
+        uint32_t n = 0;
+        for (unsigned shift = 0; shift < 35; shift += 7) {
+            if (pos >= blob.size()) {
+                throw "Could not extract varint from member list";
+            }
+            uint8_t byte = static_cast<uint8_t>(blob[pos++]);
+            n |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return n;
+            }
+        }
+        throw "Varint in member list is too long";
+    }
+
+    auto get_bytes(string_view blob, size_t &pos, size_t n) -> string_view {
+        if (blob.size() - pos < n) {
+            throw "Could not extract bytes from member list";
+        }
+        string_view bytes = blob.substr(pos, n);
+        pos += n;
+        return bytes;
+    }
+
+    // Splits a hostname into the label and the domain, which starts at the first '.'
+    auto split_hostname(string_view hostname) -> std::pair<string_view, string_view> {
+        size_t dot = std::min(hostname.find('.'), hostname.size());
+        return {hostname.substr(0, dot), hostname.substr(dot)};
+    }
+
+    auto shared_prefix_length(string_view a, string_view b) -> size_t {
+        size_t n = std::min(a.size(), b.size());
+        size_t i = 0;
+        while (i < n && a[i] == b[i]) {
+            i++;
+        }
+        return i;
+    }
+
+    // Encodes a single blob with the header and the entries that make it up
+    auto finish_blob(std::vector<string_view> const& domains, uint32_t num_members, string const& entries) -> string {
+        string blob;
+        put_varint(blob, domains.size());
+        for (string_view domain : domains) {
+            put_varint(blob, domain.size());
+            blob.append(domain);
+        }
+        put_varint(blob, num_members);
+        blob.append(entries);
+        return blob;
+    }
+
+    // Encodes the members into as few blobs as possible, each of which can be decoded on its own
+    auto encode_members(std::vector<member> const& members) -> std::vector<string> {
+        std::vector<member const*> sorted;
+        for (member const& m : members) {
+            sorted.push_back(&m);
+        }
+        std::sort(sorted.begin(), sorted.end(), [] (member const* a, member const* b) {
+            return a->hostname < b->hostname;
+        });
+
+        std::vector<string> blobs;
+        std::vector<string_view> domains;
+        size_t domains_size = 0;
+        string entries;
+        uint32_t num_members = 0;
+        string_view prev_label;
+
+        for (member const* m : sorted) {
+            auto [label, domain] = split_hostname(m->hostname);
+            // Every hostname fits in a blob of its own, since hostnames are far shorter than a blob
+            assert(2 * max_varint_size + (max_varint_size + domain.size()) +
+                (sizeof(uint32_t) + 3 * max_varint_size + label.size()) <= max_blob_size);
+
+            auto domain_it = std::find(domains.begin(), domains.end(), domain);
+            size_t shared = shared_prefix_length(prev_label, label);
+            size_t entry_size = sizeof(uint32_t) + 3 * max_varint_size + (label.size() - shared);
+            size_t new_domain_size = (domain_it == domains.end()) ? max_varint_size + domain.size() : 0;
+
+            // Start a new blob if this member would not fit in the current one, accounting for the counts
+            if (num_members > 0 &&
+                2 * max_varint_size + domains_size + new_domain_size + entries.size() + entry_size > max_blob_size)
+            {
+                blobs.push_back(finish_blob(domains, num_members, entries));
+                domains.clear();
+                domains_size = 0;
+                entries.clear();
+                num_members = 0;
+                prev_label = string_view();
+                shared = 0;
+                domain_it = domains.end();
+            }
+
+            if (domain_it == domains.end()) {
+                domains.push_back(domain);
+                domains_size += max_varint_size + domain.size();
+                domain_it = domains.end() - 1;
+            }
+
+            char id_buf[sizeof(uint32_t)];
+            serializer::write_uint32_to_char_buf(m->id, id_buf);
+            entries.append(id_buf, sizeof(uint32_t));
+            put_varint(entries, domain_it - domains.begin());
+            put_varint(entries, shared);
+            put_varint(entries, label.size() - shared);
+            entries.append(label.substr(shared));
+
+            prev_label = label;
+            num_members++;
+        }
+
+        if (num_members > 0) {
+            blobs.push_back(finish_blob(domains, num_members, entries));
+        }
+        return blobs;
+    }
+
+    // Decodes a blob written by encode_members, appending the members to members
+    void decode_members(string_view blob, std::vector<member> &members) {
+        size_t pos = 0;
+
+        std::vector<string_view> domains(get_varint(blob, pos));
+        if (domains.size() > blob.size()) {
+            throw "Too many domains in member list";
+        }
+        for (string_view &domain : domains) {
+            uint32_t length = get_varint(blob, pos);
+            domain = get_bytes(blob, pos, length);
+        }
+
+        uint32_t num_members = get_varint(blob, pos);
+        if (num_members > blob.size()) {
+            throw "Too many members in member list";
+        }
+
+        string label;
+        for (uint32_t i = 0; i < num_members; i++) {
+            uint32_t id = deserializer::read_uint32_from_char_buf(get_bytes(blob, pos, sizeof(uint32_t)).data());
+            uint32_t domain_index = get_varint(blob, pos);
+            uint32_t shared = get_varint(blob, pos);
+            uint32_t suffix_length = get_varint(blob, pos);
+            if (domain_index >= domains.size() || shared > label.size()) {
+                throw "Invalid member in member list";
+            }
+
+            label.resize(shared);
+            label.append(get_bytes(blob, pos, suffix_length));
+
+            member m;
+            m.id = id;
+            m.hostname = label;
+            m.hostname.append(domains[domain_index]);
+            if (m.id == 0 || m.hostname.empty()) {
+                throw "Invalid member in member list";
+            }
+            members.push_back(std::move(m));
+        }
+
+        if (pos != blob.size()) {
+            throw "Did not fully consume member list";
+        }
+    }
+}
 
 // Creates a message from a buffer
-hb_message::hb_message(char *buf_, unsigned length_) {
+hb_message::hb_message(const char *buf_, unsigned length_) {
     deserializer des(buf_, length_);
 
     try {
         id = des.get_int();
 
-        int msg_type = des.get_int();
+        msg_type = des.get_int();
         if (msg_type == JOIN_REQUEST_ID) {
-            join_request = true;
-
             join_request_member.hostname = des.get_string();
             join_request_member.id = des.get_int();
 
         } else if (msg_type == NORMAL_HEARTBEAT_ID) {
-            join_request = false;
+            des.get_fields(digest.num_members, digest.hash, failed_nodes, left_nodes);
 
-            uint32_t num_failed = des.get_int();
-            for (unsigned i = 0; i < num_failed; i++) {
-                failed_nodes.push_back(des.get_int());
+            uint32_t num_blobs = des.get_int();
+            for (unsigned i = 0; i < num_blobs; i++) {
+                decode_members(des.get_string(), joined_nodes);
             }
 
-            uint32_t num_left = des.get_int();
-            for (unsigned i = 0; i < num_left; i++) {
-                left_nodes.push_back(des.get_int());
-            }
+        } else if (msg_type == MEMBERS_ID) {
+            decode_members(des.get_string(), joined_nodes);
 
-            uint32_t num_joined = des.get_int();
-            for (unsigned i = 0; i < num_joined; i++) {
-                joined_nodes.push_back(member());
-                joined_nodes[i].hostname = des.get_string();
-                joined_nodes[i].id = des.get_int();
-            }
+        } else if (msg_type == SYNC_REQUEST_ID) {
+            des.get_fields(sync_ids);
 
         } else {
             throw "Invalid message type";
@@ -46,56 +223,62 @@ hb_message::hb_message(char *buf_, unsigned length_) {
         des.done();
     } catch (...) {
         id = 0;
-        join_request = false;
+        msg_type = NORMAL_HEARTBEAT_ID;
         failed_nodes.clear();
         left_nodes.clear();
         joined_nodes.clear();
+        sync_ids.clear();
     }
 }
 
 // Serializes the message and returns a string containing the message
 auto hb_message::serialize() const -> string {
-    serializer ser;
-
-    ser.add_field(id);
+    string buf;
+    serialize(buf);
+    return buf;
+}
 
-    if (join_request) {
-        ser.add_field(JOIN_REQUEST_ID);
+// Appends the serialized message to the end of buf
+void hb_message::serialize(string &buf) const {
+    serializer ser(buf);
 
-        ser.add_field(join_request_member.hostname);
-        ser.add_field(join_request_member.id);
+    if (msg_type == JOIN_REQUEST_ID) {
+        ser.add_fields(id, JOIN_REQUEST_ID, join_request_member.hostname, join_request_member.id);
+    } else if (msg_type == MEMBERS_ID) {
+        // A members message that does not fit in one datagram must be sent with serialize_chunks
+        std::vector<string> blobs = encode_members(joined_nodes);
+        assert(blobs.size() <= 1);
+        ser.add_fields(id, MEMBERS_ID, blobs.empty() ? finish_blob({}, 0, "") : blobs[0]);
+    } else if (msg_type == SYNC_REQUEST_ID) {
+        ser.add_fields(id, SYNC_REQUEST_ID, sync_ids);
     } else {
-        ser.add_field(NORMAL_HEARTBEAT_ID);
-
-        ser.add_field(failed_nodes.size());
-        for (uint32_t failed_id : failed_nodes) {
-            ser.add_field(failed_id);
-        }
+        std::vector<string> blobs = encode_members(joined_nodes);
+        ser.add_fields(id, NORMAL_HEARTBEAT_ID, digest.num_members, digest.hash, failed_nodes, left_nodes, blobs);
+    }
+}
 
-        ser.add_field(left_nodes.size());
-        for (uint32_t left_id : left_nodes) {
-            ser.add_field(left_id);
-        }
+// Serializes a members message into as many datagrams as the list takes, each of which can be parsed alone
+auto hb_message::serialize_chunks() const -> std::vector<string> {
+    assert(msg_type == MEMBERS_ID);
 
-        ser.add_field(joined_nodes.size());
-        for (member m : joined_nodes) {
-            ser.add_field(m.hostname);
-            ser.add_field(m.id);
-        }
+    std::vector<string> chunks;
+    for (string const& blob : encode_members(joined_nodes)) {
+        chunks.emplace_back();
+        serializer ser(chunks.back());
+        ser.add_fields(id, MEMBERS_ID, blob);
     }
-
-    return ser.serialize();
+    return chunks;
 }
 
 // Makes this message a join request, as opposed to a regular heartbeat message
 void hb_message::make_join_request(member const& us) {
-    join_request = true;
+    msg_type = JOIN_REQUEST_ID;
     join_request_member = us;
 }
 
 // Returns true if this message is a join request
 auto hb_message::is_join_request() const -> bool {
-    return join_request;
+    return msg_type == JOIN_REQUEST_ID;
 }
 
 // Get the member that is requesting to join the group
@@ -103,6 +286,43 @@ auto hb_message::get_join_request() const -> member {
     return join_request_member;
 }
 
+// Makes this message carry a membership list for the recipient to add
+void hb_message::make_members_message(std::vector<member> const& members) {
+    msg_type = MEMBERS_ID;
+    joined_nodes = members;
+}
+
+// Returns true if this message carries a membership list
+auto hb_message::is_members_message() const -> bool {
+    return msg_type == MEMBERS_ID;
+}
+
+// Makes this message a request for the members the recipient knows of that are not in ids
+void hb_message::make_sync_request(std::vector<uint32_t> const& ids) {
+    msg_type = SYNC_REQUEST_ID;
+    sync_ids = ids;
+}
+
+// Returns true if this message is a sync request
+auto hb_message::is_sync_request() const -> bool {
+    return msg_type == SYNC_REQUEST_ID;
+}
+
+// Gets the IDs of the members that the sender of a sync request already knows of
+auto hb_message::get_sync_ids() const -> std::vector<uint32_t> const& {
+    return sync_ids;
+}
+
+// Sets the digest of the sender's membership list
+void hb_message::set_digest(membership_digest const& d) {
+    digest = d;
+}
+
+// Gets the digest of the sender's membership list
+auto hb_message::get_digest() const -> membership_digest {
+    return digest;
+}
+
 // Sets the list of failed nodes to the given list of nodes
 void hb_message::set_failed_nodes(std::vector<uint32_t> const& nodes) {
     failed_nodes = nodes;
@@ -1,5 +1,6 @@
 #include "heartbeater.h"
 #include "heartbeater.hpp"
+#include "swim_heartbeater.hpp"
 #include "logging.h"
 
 #include <chrono>
@@ -15,12 +16,15 @@ using std::string;
 
 heartbeater_impl::heartbeater_impl(environment &env)
     : lg(env.get<logger_factory>()->get_logger("heartbeater")),
+      tr(env.get<logger_factory>()->get_tracer(trace_component::heartbeater)),
       config(env.get<configuration>()),
       client(env.get<udp_factory>()->get_udp_client()),
       server(env.get<udp_factory>()->get_udp_server()),
-      hb_state_lock(env), nodes_can_join(true), running(false)
+      tw(env.get<timer_wheel>()),
+      hb_state_lock(env), nodes_can_join(true), running(false), client_timer(0)
 {
-    unlocked<heartbeater_state> hb_state = hb_state_lock();
+    hb_state_lock.profile_as("heartbeater::hb_state_lock");
+    rw_unlocked<heartbeater_state> hb_state = hb_state_lock.write();
     our_id = 0;
 
     joined_group = false;
@@ -47,8 +51,7 @@ void heartbeater_impl::start() {
     std::thread server_thread([this] {server_thread_function();});
     server_thread.detach();
 
-    std::thread client_thread([this] {client_thread_function();});
-    client_thread.detach();
+    client_timer = tw->schedule_repeating(heartbeat_interval_ms, [this] {send_heartbeats();});
 }
 
 // Stops the heartbeater synchronously
@@ -61,6 +64,7 @@ void heartbeater_impl::stop() {
 
     server->stop_server();
     running = false;
+    tw->cancel(client_timer);
 
     // Sleep for enough time for the threads to stop and then delete them
     std::this_thread::sleep_for(std::chrono::milliseconds(2000));
@@ -68,74 +72,75 @@ void heartbeater_impl::stop() {
 
 // Returns the list of members of the group that this node is aware of
 auto heartbeater_impl::get_members() const -> std::vector<member> {
-    return hb_state_lock()->mem_list.get_members();
+    return hb_state_lock.read()->mem_list.get_members();
 }
 
 // Gets the member object corresponding to the provided ID
 auto heartbeater_impl::get_member_by_id(uint32_t id) const -> member {
-    return hb_state_lock()->mem_list.get_member_by_id(id);
+    return hb_state_lock.read()->mem_list.get_member_by_id(id);
 }
 
 // Returns the list of members of the group that this node is aware of
 auto heartbeater_impl::get_successor() const -> member {
-    return hb_state_lock()->mem_list.get_successor(our_id);
+    return hb_state_lock.read()->mem_list.get_successor(our_id);
 }
 
-// Client thread function
-void heartbeater_impl::client_thread_function() {
-    // Remaining client code here
-    while (true) {
-        // Exit the loop and the thread if the heartbeater is stopped
-        if (!running.load()) {
-            break;
-        }
-
-        { // Atomic block
-            unlocked<heartbeater_state> hb_state = hb_state_lock();
-
-            // Check neighbors list for failures
-            check_for_failed_neighbors();
-
-            // For each of fails / leaves / joins, send a message out to our neighbors
-            std::vector<uint32_t> const& failed_nodes = hb_state->failed_nodes_queue.pop();
-            std::vector<uint32_t> const& left_nodes = hb_state->left_nodes_queue.pop();
-            std::vector<member> const& joined_nodes = hb_state->joined_nodes_queue.pop();
-
-            // Create the message to send out
-            hb_message msg(our_id);
-            msg.set_failed_nodes(failed_nodes);
-            msg.set_left_nodes(left_nodes);
-            msg.set_joined_nodes(joined_nodes);
-            string msg_str = msg.serialize();
-            assert(msg_str.length() > 0);
-
-            // Send the message out to all the neighbors
-            for (auto const& mem : hb_state->mem_list.get_neighbors()) {
-                client->send(mem.hostname, config->get_hb_port(), msg_str);
-            }
+// Sends a heartbeat to each of our neighbors, called by the timer wheel every heartbeat_interval_ms
+void heartbeater_impl::send_heartbeats() {
+    if (!running.load()) {
+        return;
+    }
 
-            // Send the introduction messages
-            if (nodes_can_join.load() && hb_state->new_nodes_queue.size() > 0) {
-                send_introducer_msg();
-            }
+    { // Atomic block
+        rw_unlocked<heartbeater_state> hb_state = hb_state_lock.write();
+
+        // Check neighbors list for failures
+        check_for_failed_neighbors();
+
+        // For each of fails / leaves / joins, send a message out to our neighbors
+        std::vector<uint32_t> const& failed_nodes = hb_state->failed_nodes_queue.pop();
+        std::vector<uint32_t> const& left_nodes = hb_state->left_nodes_queue.pop();
+        std::vector<member> const& joined_nodes = hb_state->joined_nodes_queue.pop();
+
+        // Create the message to send out
+        hb_message msg(our_id);
+        msg.set_failed_nodes(failed_nodes);
+        msg.set_left_nodes(left_nodes);
+        msg.set_joined_nodes(joined_nodes);
+        msg.set_digest(hb_state->mem_list.digest());
+        msg_buf.clear();
+        msg.serialize(msg_buf);
+        assert(msg_buf.length() > 0);
+
+        neighbor_hostnames.clear();
+        for (auto const& mem : hb_state->mem_list.get_neighbors()) {
+            neighbor_hostnames.push_back(mem.hostname);
         }
+        tr->event(trace_event::heartbeat_sent,
+            {neighbor_hostnames.size(), failed_nodes.size(), left_nodes.size(), joined_nodes.size()});
 
-        // Sleep for heartbeat_interval milliseconds
-        std::this_thread::sleep_for(std::chrono::milliseconds(heartbeat_interval_ms));
+        // Send the introduction messages
+        if (nodes_can_join.load() && hb_state->new_nodes_queue.size() > 0) {
+            send_introducer_msg();
+        }
     }
+
+    // Send the message out to all the neighbors, without holding the lock
+    client->send_all(neighbor_hostnames, config->get_hb_port(), msg_buf);
 }
 
 // Scans through neighbors and marks those with a heartbeat past the timeout as failed
 void heartbeater_impl::check_for_failed_neighbors() {
     std::vector<std::function<void()>> handler_calls;
     {
-        unlocked<heartbeater_state> hb_state = hb_state_lock();
+        rw_unlocked<heartbeater_state> hb_state = hb_state_lock.write();
         std::vector<member> const& neighbors = hb_state->mem_list.get_neighbors();
 
         uint64_t current_time = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
         for (auto const& mem : neighbors) {
             if (current_time > mem.last_heartbeat + timeout_interval_ms) {
                 lg->info("Node at " + mem.hostname + " with id " + std::to_string(mem.id) + " timed out!");
+                tr->event(trace_event::member_timed_out, {mem.id, mem.hostname});
                 hb_state->mem_list.remove_member(mem.id);
 
                 // Only tell neighbors about failure if we are still in the group
@@ -160,20 +165,22 @@ void heartbeater_impl::check_for_failed_neighbors() {
 
 // Sends pending messages to newly joined nodes
 void heartbeater_impl::send_introducer_msg() {
-    unlocked<heartbeater_state> hb_state = hb_state_lock();
+    rw_unlocked<heartbeater_state> hb_state = hb_state_lock.write();
     std::vector<member> const& all_members = hb_state->mem_list.get_members();
 
+    // Large groups take several datagrams to introduce, each of which the new node can apply on its own
     hb_message intro_msg(our_id);
-    intro_msg.set_joined_nodes(all_members);
-    string msg_str = intro_msg.serialize();
-    assert(msg_str.length() > 0);
+    intro_msg.make_members_message(all_members);
+    std::vector<string> chunks = intro_msg.serialize_chunks();
+    assert(chunks.size() > 0);
 
     auto const& new_nodes = hb_state->new_nodes_queue.pop();
     auto const& updated = hb_state->new_nodes_queue.peek();
 
+    std::vector<string> new_hostnames;
     for (auto const& node : new_nodes) {
-        lg->debug("Sent introducer message to host at " + node.hostname + " with ID " + std::to_string(node.id));
-        client->send(node.hostname, config->get_hb_port(), msg_str);
+        lg->debug("Sent introducer message to host at ", node.hostname, " with ID ", node.id);
+        new_hostnames.push_back(node.hostname);
 
         // If this node isn't in new_nodes_queue anymore, we should now add it to joined_nodes_queue
         // so that it can be added to other nodes' membership lists
@@ -181,11 +188,14 @@ void heartbeater_impl::send_introducer_msg() {
             hb_state->joined_nodes_queue.push(node, message_redundancy);
         }
     }
+    for (string const& chunk : chunks) {
+        client->send_all(new_hostnames, config->get_hb_port(), chunk);
+    }
 }
 
 // Runs the provided function atomically with any functions that read or write to the membership list
 void heartbeater_impl::run_atomically_with_mem_list(std::function<void()> const& fn) const {
-    auto guard = hb_state_lock();
+    auto guard = hb_state_lock.write();
     fn();
 }
 
@@ -220,7 +230,7 @@ void heartbeater_impl::leave_group() {
     lg->info("Leaving the group");
 
     joined_group = false;
-    hb_state_lock()->left_nodes_queue.push(our_id, message_redundancy);
+    hb_state_lock.write()->left_nodes_queue.push(our_id, message_redundancy);
 }
 
 // Server thread function
@@ -228,8 +238,8 @@ void heartbeater_impl::server_thread_function() {
     lg->debug("Starting server thread");
     server->start_server(config->get_hb_port());
 
-    int size;
-    char buf[1024];
+    // Packets received in the last batch, which point into buffers owned by the server
+    std::vector<std::string_view> packets;
 
     // Code to listen for messages and handle them accordingly here
     while (true) {
@@ -247,122 +257,246 @@ void heartbeater_impl::server_thread_function() {
 
         // Vector of lambdas which call various handlers
         std::vector<std::function<void()>> handler_calls;
-        // Listen for messages and process each one
-        if ((size = server->recv(buf, 1024)) > 0) {
-            unlocked<heartbeater_state> hb_state = hb_state_lock();
+        // Listen for messages and process each batch under a single acquisition of the lock
+        if (server->recv_batch(packets) > 0) {
+            rw_unlocked<heartbeater_state> hb_state = hb_state_lock.write();
+            for (std::string_view packet : packets) {
+                if (packet.size() > 0) {
+                    process_message(*hb_state, packet, handler_calls);
+                }
+            }
+        }
+
+        for (auto handler_call : handler_calls) {
+            handler_call();
+        }
+    }
+}
 
-            hb_message msg(buf, size);
+// Applies a single heartbeat message to the state, queueing any handlers that should be called into handler_calls
+void heartbeater_impl::process_message(heartbeater_state &hb_state, std::string_view packet,
+    std::vector<std::function<void()>> &handler_calls)
+{
+    hb_message msg(packet.data(), packet.size());
 
-            if (!msg.is_well_formed()) {
-                lg->debug("Received malformed heartbeat message!");
-                continue;
-            }
+    if (!msg.is_well_formed()) {
+        lg->debug("Received malformed heartbeat message!");
+        return;
+    }
 
-            // If we are in the group and the message is not from within the group, ignore it
-            if (hb_state->mem_list.get_member_by_id(our_id).id == our_id &&
-                hb_state->mem_list.get_member_by_id(msg.get_id()).id != msg.get_id())
-            {
-                // Allow the message to be processed if it's a join request
-                if (msg.is_join_request()) {
-                    if (!nodes_can_join.load()) {
-                        lg->debug("Nodes cannot join because leader election is occurring!");
-                        continue;
-                    }
-                } else {
-                    lg->trace("Ignoring heartbeat message from " + std::to_string(msg.get_id()) + " because they are not in the group");
-                    continue;
-                }
+    // If we are in the group and the message is not from within the group, ignore it
+    // Introductions are let through, since the introducer may be in a chunk we have not received yet
+    if (hb_state.mem_list.has_member(our_id) && !hb_state.mem_list.has_member(msg.get_id()) &&
+        !msg.is_members_message())
+    {
+        // Allow the message to be processed if it's a join request
+        if (msg.is_join_request()) {
+            if (!nodes_can_join.load()) {
+                lg->debug("Nodes cannot join because leader election is occurring!");
+                return;
             }
+        } else {
+            lg->trace("Ignoring heartbeat message from ", msg.get_id(), " because they are not in the group");
+            return;
+        }
+    }
 
-            if (msg.is_join_request()) {
-                member const& m = msg.get_join_request();
+    if (msg.is_join_request()) {
+        member const& m = msg.get_join_request();
 
-                // Make sure this is a node we haven't seen yet
-                if (hb_state->joined_ids.find(m.id) == hb_state->joined_ids.end()) {
-                    hb_state->joined_ids.insert(m.id);
-                    hb_state->mem_list.add_member(m.hostname, m.id);
+        // Make sure this is a node we haven't seen yet
+        if (hb_state.joined_ids.find(m.id) == hb_state.joined_ids.end()) {
+            hb_state.joined_ids.insert(m.id);
+            hb_state.mem_list.add_member(m.hostname, m.id);
 
-                    lg->info("Received request to join group from (" + m.hostname + ", " + std::to_string(m.id) + ")");
-                    hb_state->new_nodes_queue.push(m, message_redundancy);
+            lg->info("Received request to join group from (" + m.hostname + ", " + std::to_string(m.id) + ")");
+            hb_state.new_nodes_queue.push(m, message_redundancy);
 
-                    // Queue join handlers to be called after adding this node
-                    for (auto const& handler : hb_state->on_join_handlers) {
-                        handler_calls.push_back([=] {handler(m);});
-                    }
-                }
+            // Queue join handlers to be called after adding this node
+            for (auto const& handler : hb_state.on_join_handlers) {
+                handler_calls.push_back([=] {handler(m);});
             }
+        }
+    }
 
-            for (member const& m : msg.get_joined_nodes()) {
-                assert(m.id != 0 && m.hostname != "");
+    if (msg.is_members_message()) {
+        add_introduced_members(hb_state, msg.get_joined_nodes(), handler_calls);
+        hb_state.mem_list.update_heartbeat(msg.get_id());
+        return;
+    }
 
-                // Only add and propagate information about this join if we've never seen this node
-                if (hb_state->joined_ids.find(m.id) == hb_state->joined_ids.end()) {
-                    hb_state->joined_ids.insert(m.id);
-                    hb_state->mem_list.add_member(m.hostname, m.id);
+    if (msg.is_sync_request()) {
+        send_missing_members(hb_state, msg);
+        return;
+    }
 
-                    // Check if the newly joined member is us
-                    if (m.id == our_id) {
-                        lg->info("Successfully joined group");
-                    }
+    if (!msg.is_join_request()) {
+        check_digest(hb_state, msg);
+    }
 
-                    hb_state->joined_nodes_queue.push(m, message_redundancy);
+    for (member const& m : msg.get_joined_nodes()) {
+        assert(m.id != 0 && m.hostname != "");
 
-                    for (auto const& handler : hb_state->on_join_handlers) {
-                        handler_calls.push_back([=] {handler(m);});
-                    }
-                }
+        // Only add and propagate information about this join if we've never seen this node
+        if (hb_state.joined_ids.find(m.id) == hb_state.joined_ids.end()) {
+            hb_state.joined_ids.insert(m.id);
+            hb_state.mem_list.add_member(m.hostname, m.id);
+
+            // Check if the newly joined member is us
+            if (m.id == our_id) {
+                lg->info("Successfully joined group");
             }
 
-            for (uint32_t id : msg.get_left_nodes()) {
-                // Only propagate this message if the member has not yet been removed
-                member const& mem = hb_state->mem_list.get_member_by_id(id);
-                if (mem.id == id) {
-                    hb_state->mem_list.remove_member(id);
-                    hb_state->left_nodes_queue.push(id, message_redundancy);
+            hb_state.joined_nodes_queue.push(m, message_redundancy);
 
-                    for (auto const& handler : hb_state->on_leave_handlers) {
-                        handler_calls.push_back([=] {handler(mem);});
-                    }
-                }
+            for (auto const& handler : hb_state.on_join_handlers) {
+                handler_calls.push_back([=] {handler(m);});
             }
+        }
+    }
 
-            for (uint32_t id : msg.get_failed_nodes()) {
-                // Only propagate this message if the member has not yet been removed
-                member const& mem = hb_state->mem_list.get_member_by_id(id);
-                if (mem.id == id) {
-                    hb_state->mem_list.remove_member(id);
-                    hb_state->failed_nodes_queue.push(id, message_redundancy);
+    for (uint32_t id : msg.get_left_nodes()) {
+        // Only propagate this message if the member has not yet been removed
+        member const& mem = hb_state.mem_list.get_member_by_id(id);
+        if (mem.id == id) {
+            hb_state.mem_list.remove_member(id);
+            hb_state.left_nodes_queue.push(id, message_redundancy);
 
-                    for (auto const& handler : hb_state->on_fail_handlers) {
-                        handler_calls.push_back([=] {handler(mem);});
-                    }
-                }
+            for (auto const& handler : hb_state.on_leave_handlers) {
+                handler_calls.push_back([=] {handler(mem);});
             }
+        }
+    }
+
+    for (uint32_t id : msg.get_failed_nodes()) {
+        // Only propagate this message if the member has not yet been removed
+        member const& mem = hb_state.mem_list.get_member_by_id(id);
+        if (mem.id == id) {
+            tr->event(trace_event::member_failed, {id, mem.hostname});
+            hb_state.mem_list.remove_member(id);
+            hb_state.failed_nodes_queue.push(id, message_redundancy);
 
-            hb_state->mem_list.update_heartbeat(msg.get_id());
+            for (auto const& handler : hb_state.on_fail_handlers) {
+                handler_calls.push_back([=] {handler(mem);});
+            }
         }
+    }
 
-        for (auto handler_call : handler_calls) {
-            handler_call();
+    tr->event(trace_event::heartbeat_received, {msg.get_id()});
+    hb_state.mem_list.update_heartbeat(msg.get_id());
+}
+
+// Adds members from an introduction or a sync reply that we have never seen
+// Our own introduction lists the whole group, which the rest of the group already knows of, so from it we only
+// announce ourselves rather than flooding our neighbors with every member. Any other members message only carries
+// members that joined recently or that were missed, which may be news to our neighbors as well
+void heartbeater_impl::add_introduced_members(heartbeater_state &hb_state, std::vector<member> const& members,
+    std::vector<std::function<void()>> &handler_calls)
+{
+    bool introducing_us = !hb_state.mem_list.has_member(our_id);
+
+    for (member const& m : members) {
+        if (hb_state.joined_ids.find(m.id) != hb_state.joined_ids.end()) {
+            continue;
+        }
+
+        hb_state.joined_ids.insert(m.id);
+        hb_state.mem_list.add_member(m.hostname, m.id);
+
+        if (m.id == our_id) {
+            lg->info("Successfully joined group");
+        }
+        if (!introducing_us || m.id == our_id) {
+            hb_state.joined_nodes_queue.push(m, message_redundancy);
+        }
+
+        for (auto const& handler : hb_state.on_join_handlers) {
+            handler_calls.push_back([=] {handler(m);});
+        }
+    }
+}
+
+// Requests a sync from the sender of a heartbeat if its membership list has differed from ours for too long
+void heartbeater_impl::check_digest(heartbeater_state &hb_state, hb_message const& msg) {
+    if (msg.get_digest() == hb_state.mem_list.digest()) {
+        hb_state.digest_mismatches.erase(msg.get_id());
+        return;
+    }
+
+    // Lists differ for a while whenever a change is still spreading, so only persistent differences are synced
+    unsigned &mismatches = hb_state.digest_mismatches[msg.get_id()];
+    if (++mismatches < sync_after_mismatches) {
+        return;
+    }
+    mismatches = 0;
+
+    member const* sender = hb_state.mem_list.find_member(msg.get_id());
+    if (sender == nullptr) {
+        return;
+    }
+
+    std::vector<uint32_t> ids;
+    for (member const& m : hb_state.mem_list.get_members()) {
+        ids.push_back(m.id);
+    }
+
+    lg->debug("Requesting sync from ", sender->hostname, " because our membership lists differ");
+    hb_message sync_req(our_id);
+    sync_req.make_sync_request(ids);
+    client->send(sender->hostname, config->get_hb_port(), sync_req.serialize());
+}
+
+// Replies to a sync request with the members we know of that the requester does not
+void heartbeater_impl::send_missing_members(heartbeater_state &hb_state, hb_message const& msg) {
+    member const* requester = hb_state.mem_list.find_member(msg.get_id());
+    if (requester == nullptr) {
+        return;
+    }
+
+    std::vector<uint32_t> known_ids = msg.get_sync_ids();
+    std::sort(known_ids.begin(), known_ids.end());
+
+    std::vector<member> missing;
+    for (member const& m : hb_state.mem_list.get_members()) {
+        if (!std::binary_search(known_ids.begin(), known_ids.end(), m.id)) {
+            missing.push_back(m);
         }
     }
+    if (missing.empty()) {
+        return;
+    }
+
+    hb_message reply(our_id);
+    reply.make_members_message(missing);
+    for (string const& chunk : reply.serialize_chunks()) {
+        client->send(requester->hostname, config->get_hb_port(), chunk);
+    }
 }
 
 // Adds a handler to the list of handlers that will be called when a node fails
 void heartbeater_impl::on_fail(std::function<void(member const&)> handler) {
     // Acquire mutex to prevent concurrent modification of vector
-    hb_state_lock()->on_fail_handlers.push_back(handler);
+    hb_state_lock.write()->on_fail_handlers.push_back(handler);
 }
 
 // Adds a handler to the list of handlers that will be called when a node leaves
 void heartbeater_impl::on_leave(std::function<void(member const&)> handler) {
-    hb_state_lock()->on_leave_handlers.push_back(handler);
+    hb_state_lock.write()->on_leave_handlers.push_back(handler);
 }
 
 // Adds a handler to the list of handlers that will be called when a node joins
 void heartbeater_impl::on_join(std::function<void(member const&)> handler) {
-    hb_state_lock()->on_join_handlers.push_back(handler);
+    hb_state_lock.write()->on_join_handlers.push_back(handler);
 }
 
 // Register the service
-register_auto<heartbeater, heartbeater_impl> register_heartbeater;
+// The failure detector is chosen by the configuration, which must be set before the heartbeater is first used
+auto make_heartbeater(environment &env) -> unique_ptr<service> {
+    if (env.get<configuration>()->uses_swim_heartbeater()) {
+        return make_unique<swim_heartbeater_impl>(env);
+    }
+    return make_unique<heartbeater_impl>(env);
+}
+
+register_service<heartbeater, heartbeater_impl> register_heartbeater(make_heartbeater);
+register_test_service<heartbeater, heartbeater_impl> register_test_heartbeater(make_heartbeater);
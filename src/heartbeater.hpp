@@ -5,15 +5,18 @@
 #include "member_list.h"
 #include "hb_messages.h"
 #include "udp.h"
+#include "timer_wheel.h"
 #include "redundant_queue.h"
 #include "environment.h"
 #include "configuration.h"
 #include "locking.h"
 
 #include <string>
+#include <string_view>
 #include <thread>
 #include <tuple>
 #include <set>
+#include <unordered_map>
 #include <functional>
 #include <atomic>
 
@@ -47,24 +50,40 @@ public:
     void on_join(std::function<void(member const&)>);
 
 private:
-    // Fuction that runs the client side code in its own thread
-    void client_thread_function();
+    // Sends a heartbeat to each of our neighbors, called periodically on the timer wheel
+    void send_heartbeats();
 
     // Function that runs the server side code in its own thread
     void server_thread_function();
 
+    struct heartbeater_state;
+
+    // Applies a single heartbeat message to the state, queueing any handlers that should be called into handler_calls
+    void process_message(heartbeater_state &hb_state, std::string_view packet,
+        std::vector<std::function<void()>> &handler_calls);
+
     // Scans through neighbors and marks those with a heartbeat past the timeout as failed
     void check_for_failed_neighbors();
 
     // Sends pending messages to newly joined nodes that joined using us as an introducer
     void send_introducer_msg();
 
+    // Adds members from an introduction or a sync reply that we have never seen
+    void add_introduced_members(heartbeater_state &hb_state, std::vector<member> const& members,
+        std::vector<std::function<void()>> &handler_calls);
+    // Requests a sync from the sender of a heartbeat if its membership list has differed from ours for too long
+    void check_digest(heartbeater_state &hb_state, hb_message const& msg);
+    // Replies to a sync request with the members we know of that the requester does not
+    void send_missing_members(heartbeater_state &hb_state, hb_message const& msg);
+
     // Number of times to send each message
     const int message_redundancy = 4;
     // Time between sending heartbeats (in ms)
     const uint64_t heartbeat_interval_ms = 250;
     // Time interval between received heartbeats in which node is marked as failed (in ms)
     const uint64_t timeout_interval_ms = 2000;
+    // Number of heartbeats in a row from a neighbor with a different membership list before we sync with it
+    const unsigned sync_after_mismatches = 12;
 
     // Information about current host
     uint32_t our_id;
@@ -72,9 +91,11 @@ private:
 
     // Services that the heartbeater uses
     std::unique_ptr<logger> lg;
+    std::unique_ptr<tracer> tr;
     configuration *config;
     std::unique_ptr<udp_client> client;
     std::unique_ptr<udp_server> server;
+    timer_wheel *tw;
 
     struct heartbeater_state {
         heartbeater_state(environment &env) : mem_list(env) {}
@@ -89,6 +110,9 @@ private:
         // Set containing all IDs that have ever joined
         std::set<uint32_t> joined_ids;
 
+        // The number of heartbeats in a row from each neighbor whose digest did not match ours
+        std::unordered_map<uint32_t, unsigned> digest_mismatches;
+
         // Membership list containing the known members of the cluster
         member_list mem_list;
 
@@ -97,10 +121,16 @@ private:
         std::vector<std::function<void(member const&)>> on_join_handlers;
         std::vector<std::function<void(member const&)>> on_leave_handlers;
     };
-    locked<heartbeater_state> hb_state_lock;
+    // Read by get_members and friends far more often than it is changed, so readers do not wait on each other
+    rw_locked<heartbeater_state> hb_state_lock;
 
     // Boolean indicating whether or not new nodes can join
     std::atomic<bool> nodes_can_join;
 
     std::atomic<bool> running;
+    timer_id client_timer;
+
+    // Reused for every heartbeat so that sending one does not need to allocate
+    std::string msg_buf;
+    std::vector<std::string> neighbor_hostnames;
 };
@@ -25,6 +25,7 @@ int main(int argc, char **argv) {
     int sdfs_internal_port;
     int sdfs_master_port;
     int juice_master_port;
+    bool persistent_exe;
     logger::log_level log_level = logger::log_level::level_off;
     partitioner::type partitioner_type = partitioner::type::round_robin;
 
@@ -37,6 +38,7 @@ int main(int argc, char **argv) {
     cli_parser.add_option<>("ip", "port", "The TCP port used for communication between nodes in SDFS", &sdfs_internal_port, 1234);
     cli_parser.add_option<>("mp", "port", "The TCP port used for communication between clients and the master node in SDFS", &sdfs_master_port, 1235);
     cli_parser.add_option<>("p", "port", "The TCP port used for communication with the Juice master", &juice_master_port, 1237);
+    cli_parser.add_option<>("e", "", "Run the exe as a persistent executor that is fed every key, as described in mj_executor.h", &persistent_exe, false);
 
     std::function<bool(std::string)> log_level_parser = [&log_level] (std::string str) {
         if (str == "OFF") {
@@ -82,7 +84,7 @@ int main(int argc, char **argv) {
 
     env.get<logger_factory>()->configure(log_level);
 
-    if (env.get<juice_client>()->run_job(juice_master, local_exe, juice_exe, num_juices, partitioner_type, sdfs_intermediate_filename_prefix, sdfs_dest_filename)) {
+    if (env.get<juice_client>()->run_job(juice_master, local_exe, juice_exe, num_juices, partitioner_type, sdfs_intermediate_filename_prefix, sdfs_dest_filename, persistent_exe)) {
         std::cout << "Juice job successfully completed" << std::endl;
     } else {
         std::cout << "Juice job failed to complete: " + env.get<juice_client>()->get_error() << std::endl;
@@ -16,7 +16,8 @@ public:
     auto get_error() const -> std::string;
 
     auto run_job(std::string const& juice_node, std::string const& local_exe, std::string const& juice_exe, int num_juices,
-        partitioner::type partitioner_type, std::string const& sdfs_src_dir, std::string const& sdfs_output_dir) -> bool;
+        partitioner::type partitioner_type, std::string const& sdfs_src_dir, std::string const& sdfs_output_dir,
+        bool persistent_exe) -> bool;
 
 private:
     std::string error = "";
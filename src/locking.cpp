@@ -0,0 +1,174 @@
+#include "locking.h"
+
+#ifdef LOCK_PROFILING
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+
+namespace lock_profiling {
+    // Bucket i of the hold time histogram counts holds of less than 2^i microseconds, and the last bucket the rest
+    const unsigned num_hold_buckets = 16;
+
+    struct site_stats {
+        uint64_t contended = 0;
+        uint64_t wait_ns = 0;
+    };
+
+    struct lock_stats {
+        std::atomic<uint64_t> acquisitions = 0;
+        std::atomic<uint64_t> contended = 0;
+        std::atomic<uint64_t> total_wait_ns = 0;
+        std::atomic<uint64_t> max_wait_ns = 0;
+        std::atomic<uint64_t> total_hold_ns = 0;
+        std::array<std::atomic<uint64_t>, num_hold_buckets> hold_histogram = {};
+
+        // Only the call sites that had to wait are recorded, so that uncontended acquisitions never take sites_mutex
+        std::mutex sites_mutex;
+        std::map<std::string, site_stats> sites;
+    };
+
+    namespace {
+        // Statistics are never freed, so that locks can keep pointers to them after a reset
+        std::mutex registry_mutex;
+        std::map<std::string, std::unique_ptr<lock_stats>> registry;
+
+        auto site_str(call_site site) -> std::string {
+            return std::string(site.file) + ":" + std::to_string(site.line);
+        }
+
+        auto get_stats(std::string const& name) -> lock_stats* {
+            std::lock_guard<std::mutex> guard(registry_mutex);
+            std::unique_ptr<lock_stats> &stats = registry[name];
+            if (!stats) {
+                stats = std::make_unique<lock_stats>();
+            }
+            return stats.get();
+        }
+
+        void reset_stats(lock_stats &stats) {
+            stats.acquisitions = 0;
+            stats.contended = 0;
+            stats.total_wait_ns = 0;
+            stats.max_wait_ns = 0;
+            stats.total_hold_ns = 0;
+            for (auto &bucket : stats.hold_histogram) {
+                bucket = 0;
+            }
+            std::lock_guard<std::mutex> guard(stats.sites_mutex);
+            stats.sites.clear();
+        }
+    }
+
+    void lock_profile::record_acquire(call_site site, bool contended, uint64_t wait_ns) {
+        lock_stats *s = stats.load(std::memory_order_acquire);
+        if (s == nullptr) {
+            lock_stats *resolved = get_stats(name ? name : site_str(site));
+            stats.compare_exchange_strong(s, resolved);
+            s = stats.load(std::memory_order_acquire);
+        }
+
+        s->acquisitions.fetch_add(1, std::memory_order_relaxed);
+        if (!contended) {
+            return;
+        }
+
+        s->contended.fetch_add(1, std::memory_order_relaxed);
+        s->total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+        uint64_t max_wait = s->max_wait_ns.load(std::memory_order_relaxed);
+        while (wait_ns > max_wait && !s->max_wait_ns.compare_exchange_weak(max_wait, wait_ns));
+
+        std::lock_guard<std::mutex> guard(s->sites_mutex);
+        site_stats &site_s = s->sites[site_str(site)];
+        site_s.contended++;
+        site_s.wait_ns += wait_ns;
+    }
+
+    void lock_profile::release(uint64_t acquired_ns) {
+        lock_stats *s = stats.load(std::memory_order_acquire);
+        uint64_t hold_ns = now_ns() - acquired_ns;
+        s->total_hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+
+        unsigned bucket = 0;
+        for (uint64_t hold_us = hold_ns / 1000; hold_us > 0 && bucket < num_hold_buckets - 1; hold_us >>= 1) {
+            bucket++;
+        }
+        s->hold_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto report(unsigned num_locks) -> std::string {
+        std::vector<std::pair<std::string, lock_stats*>> locks;
+        {
+            std::lock_guard<std::mutex> guard(registry_mutex);
+            for (auto const& [name, stats] : registry) {
+                locks.push_back({name, stats.get()});
+            }
+        }
+        std::sort(locks.begin(), locks.end(), [] (auto const& a, auto const& b) {
+            return a.second->total_wait_ns.load() > b.second->total_wait_ns.load();
+        });
+        locks.resize(std::min<size_t>(locks.size(), num_locks));
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(3);
+        out << "Top " << locks.size() << " locks by total wait time" << std::endl;
+        for (auto const& [name, s] : locks) {
+            uint64_t acquisitions = s->acquisitions.load();
+            out << name << std::endl;
+            out << "  acquisitions: " << acquisitions << ", contended: " << s->contended.load()
+                << ", total wait: " << s->total_wait_ns.load() / 1e6 << "ms"
+                << ", max wait: " << s->max_wait_ns.load() / 1e6 << "ms"
+                << ", mean hold: " << (acquisitions ? s->total_hold_ns.load() / 1e3 / acquisitions : 0) << "us" << std::endl;
+
+            out << "  hold time histogram:";
+            for (unsigned i = 0; i < num_hold_buckets; i++) {
+                uint64_t count = s->hold_histogram[i].load();
+                if (count > 0) {
+                    if (i == num_hold_buckets - 1) {
+                        out << " >=" << (1u << (i - 1)) << "us=" << count;
+                    } else {
+                        out << " <" << (1u << i) << "us=" << count;
+                    }
+                }
+            }
+            out << std::endl;
+
+            std::vector<std::pair<std::string, site_stats>> sites;
+            {
+                std::lock_guard<std::mutex> guard(s->sites_mutex);
+                sites.assign(s->sites.begin(), s->sites.end());
+            }
+            std::sort(sites.begin(), sites.end(), [] (auto const& a, auto const& b) {
+                return a.second.wait_ns > b.second.wait_ns;
+            });
+            for (auto const& [site, site_s] : sites) {
+                out << "  waited at " << site << ": " << site_s.contended << " times, "
+                    << site_s.wait_ns / 1e6 << "ms" << std::endl;
+            }
+        }
+        return out.str();
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> guard(registry_mutex);
+        for (auto const& [name, stats] : registry) {
+            reset_stats(*stats);
+        }
+    }
+}
+
+#else
+
+namespace lock_profiling {
+    auto report(unsigned num_locks) -> std::string {
+        return "Lock profiling is disabled, rebuild with make LOCK_PROFILING=1 to enable it\n";
+    }
+
+    void reset() {}
+}
+
+#endif
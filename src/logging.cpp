@@ -1,84 +1,293 @@
 #include "logging.h"
 #include "logging.hpp"
 
-#include <iostream>
+#include <algorithm>
 #include <chrono>
+#include <csignal>
+#include <cstdlib>
 #include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
 
 using std::string;
 using std::unique_ptr;
 using std::make_unique;
 
-std::mutex logger_factory_impl::log_mutex;
+auto log_writer::get() -> log_writer& {
+    // Never destroyed, so that threads that are still running at exit can keep logging
+    static log_writer *writer = new log_writer();
+    return *writer;
+}
 
-template <logger::log_level level>
-inline void logger_factory_impl::stdout_logger<level>::log(string const& data, string const& log_level_char) const {
-    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-    time_t tt = std::chrono::system_clock::to_time_t(now);
-    string time = string(ctime(&tt));
+auto log_writer::get_sink(string const& path) -> uint32_t {
+    std::lock_guard<std::mutex> guard(registry_mutex);
+    for (uint32_t i = 0; i < sinks.size(); i++) {
+        if (sinks[i].first == path) {
+            return i;
+        }
+    }
 
-    std::lock_guard<std::mutex> guard(log_mutex);
-    string msg = string("[") + time.substr(0, time.length() - 1) + string("] ") +
-        log_level_char + " " + prefix + string(": ") + data;
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    sinks.push_back({path, fd});
+    return sinks.size() - 1;
+}
 
-    std::cout << msg << std::endl;
+log_writer::ring_handle::~ring_handle() {
+    if (r) {
+        r->abandoned = true;
+    }
 }
 
-template <logger::log_level level>
-void logger_factory_impl::stdout_logger<level>::info(string const& data) const {
-    if (level == level_info || level == level_debug || level == level_trace) {
-        log(data, "I");
+auto log_writer::local_ring() -> ring& {
+    thread_local ring_handle handle;
+    if (!handle.r) {
+        handle.r = std::make_shared<ring>();
+
+        std::lock_guard<std::mutex> guard(registry_mutex);
+        rings.push_back(handle.r);
+        if (!running) {
+            running = true;
+            writer_thread = std::thread([this] {thread_fn();});
+            std::atexit([] {log_writer::get().stop();});
+
+            // Write out what has been logged before an assertion failure aborts the process
+            signal(SIGABRT, [] (int signum) {
+                log_writer &writer = log_writer::get();
+                if (writer.drain_mutex.try_lock()) {
+                    writer.drain();
+                    writer.drain_mutex.unlock();
+                }
+                signal(signum, SIG_DFL);
+                raise(signum);
+            });
+        }
     }
+    return *handle.r;
 }
 
-template <logger::log_level level>
-void logger_factory_impl::stdout_logger<level>::debug(string const& data) const {
-    if (level == level_debug || level == level_trace) {
-        log(data, "D");
+auto log_writer::timestamp() -> string const& {
+    thread_local time_t cached_time = -1;
+    thread_local string cached_str;
+
+    time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (now != cached_time) {
+        struct tm local;
+        localtime_r(&now, &local);
+        char buf[32];
+        size_t len = strftime(buf, sizeof(buf), "%a %b %e %H:%M:%S %Y", &local);
+        cached_str.assign(buf, len);
+        cached_time = now;
     }
+    return cached_str;
 }
 
-template <logger::log_level level>
-void logger_factory_impl::stdout_logger<level>::trace(string const& data) const {
-    if (level == level_trace) {
-        log(data, "T");
+void log_writer::log(uint32_t sink, char level_char, string const& prefix, string const& data, bool droppable) {
+    string const& time = timestamp();
+    // [time] L prefix: data
+    uint32_t len = 1 + time.size() + 2 + 1 + 1 + prefix.size() + 2 + data.size() + 1;
+
+    // Lines that would take up too much of the ring, and lines logged after the writer has stopped, are written out
+    // on the calling thread
+    if (len + header_size > ring_size / 4 || stopped.load()) {
+        write_direct(sink, "[" + time + "] " + level_char + " " + prefix + ": " + data + "\n");
+        return;
+    }
+
+    ring &r = local_ring();
+    uint64_t head = r.head.load(std::memory_order_relaxed);
+    std::chrono::steady_clock::time_point give_up_time;
+    bool waiting = false;
+    while (head + header_size + len - r.tail.load(std::memory_order_acquire) > ring_size) {
+        if (droppable) {
+            // Give the writer a bounded amount of time to make space before dropping the line
+            if (!waiting) {
+                give_up_time = std::chrono::steady_clock::now() + max_drop_wait;
+                waiting = true;
+            } else if (std::chrono::steady_clock::now() > give_up_time) {
+                r.dropped_sink.store(sink, std::memory_order_relaxed);
+                r.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        wake();
+        std::this_thread::yield();
+    }
+
+    uint64_t pos = head;
+    auto append = [&] (char const* src, size_t n) {
+        size_t offset = pos & (ring_size - 1);
+        size_t first = std::min<size_t>(n, ring_size - offset);
+        memcpy(r.buf.get() + offset, src, first);
+        memcpy(r.buf.get(), src + first, n - first);
+        pos += n;
+    };
+    append(reinterpret_cast<char const*>(&len), sizeof(len));
+    append(reinterpret_cast<char const*>(&sink), sizeof(sink));
+    append("[", 1);
+    append(time.data(), time.size());
+    append("] ", 2);
+    append(&level_char, 1);
+    append(" ", 1);
+    append(prefix.data(), prefix.size());
+    append(": ", 2);
+    append(data.data(), data.size());
+    append("\n", 1);
+    r.head.store(pos, std::memory_order_release);
+
+    // Don't wait for the writer to wake up on its own if the ring is starting to fill up
+    if (pos - r.tail.load(std::memory_order_relaxed) > ring_size / 2) {
+        wake();
     }
 }
 
-template <logger::log_level level>
-inline void logger_factory_impl::file_logger<level>::log(string const& data, string const& log_level_char) const {
-    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-    time_t tt = std::chrono::system_clock::to_time_t(now);
-    string time = string(ctime(&tt));
+void log_writer::write_direct(uint32_t sink, string const& line) {
+    int fd;
+    {
+        std::lock_guard<std::mutex> guard(registry_mutex);
+        fd = sinks[sink].second;
+    }
+    // Ignore failure, since there is nowhere left to report it
+    if (write(fd, line.data(), line.size())) {}
+}
 
-    std::lock_guard<std::mutex> guard(log_mutex);
-    string msg = string("[") + time.substr(0, time.length() - 1) + string("] ") +
-        log_level_char + " " + prefix + string(": ") + data;
+void log_writer::wake() {
+    if (!wake_requested.exchange(true)) {
+        wake_cv.notify_one();
+    }
+}
 
-    log_stream << msg << std::endl;
+void log_writer::flush() {
+    std::lock_guard<std::mutex> guard(drain_mutex);
+    drain();
+}
+
+void log_writer::drain() {
+    std::vector<std::shared_ptr<ring>> current_rings;
+    std::vector<int> fds;
+    {
+        std::lock_guard<std::mutex> guard(registry_mutex);
+        current_rings = rings;
+        for (auto const& [path, fd] : sinks) {
+            fds.push_back(fd);
+        }
+    }
+    sink_buffers.resize(fds.size());
+
+    std::vector<ring*> finished;
+    for (auto const& r : current_rings) {
+        // Check this first, since nothing can be added to the ring once its thread has exited
+        bool abandoned = r->abandoned.load();
+
+        uint64_t tail = r->tail.load(std::memory_order_relaxed);
+        uint64_t head = r->head.load(std::memory_order_acquire);
+        auto read = [&] (char *dest, size_t n) {
+            size_t offset = tail & (ring_size - 1);
+            size_t first = std::min<size_t>(n, ring_size - offset);
+            memcpy(dest, r->buf.get() + offset, first);
+            memcpy(dest + first, r->buf.get(), n - first);
+            tail += n;
+        };
+        while (tail < head) {
+            uint32_t len, sink;
+            read(reinterpret_cast<char*>(&len), sizeof(len));
+            read(reinterpret_cast<char*>(&sink), sizeof(sink));
+
+            string &buf = sink_buffers[sink];
+            size_t old_size = buf.size();
+            buf.resize(old_size + len);
+            read(&buf[old_size], len);
+        }
+        r->tail.store(tail, std::memory_order_release);
+
+        uint64_t dropped = r->dropped.exchange(0);
+        if (dropped > 0) {
+            sink_buffers[r->dropped_sink.load()] += "[" + timestamp() + "] I Logger: Dropped " +
+                std::to_string(dropped) + " debug and trace lines because the writer could not keep up\n";
+        }
+
+        if (abandoned) {
+            finished.push_back(r.get());
+        }
+    }
+
+    if (finished.size() > 0) {
+        std::lock_guard<std::mutex> guard(registry_mutex);
+        rings.erase(std::remove_if(rings.begin(), rings.end(), [&] (std::shared_ptr<ring> const& r) {
+            return std::find(finished.begin(), finished.end(), r.get()) != finished.end();
+        }), rings.end());
+    }
+
+    // Write out everything for each sink at once
+    for (uint32_t i = 0; i < sink_buffers.size(); i++) {
+        string &buf = sink_buffers[i];
+        size_t written = 0;
+        while (written < buf.size()) {
+            ssize_t n = write(fds[i], buf.data() + written, buf.size() - written);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            written += n;
+        }
+        buf.clear();
+    }
+}
+
+void log_writer::thread_fn() {
+    while (!stopped.load()) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            wake_cv.wait_for(lock, std::chrono::milliseconds(10), [&] {
+                return wake_requested.load() || stopped.load();
+            });
+            wake_requested = false;
+        }
+
+        flush();
+    }
+}
+
+void log_writer::stop() {
+    {
+        std::lock_guard<std::mutex> guard(wake_mutex);
+        stopped = true;
+    }
+    wake_cv.notify_one();
+    writer_thread.join();
+
+    // Write out anything that was logged while the writer was stopping
+    flush();
 }
 
 template <logger::log_level level>
-void logger_factory_impl::file_logger<level>::info(string const& data) const {
+void logger_factory_impl::buffered_logger<level>::info(string const& data) const {
     if (level == level_info || level == level_debug || level == level_trace) {
-        log(data, "I");
+        log_writer::get().log(sink, 'I', prefix, data, false);
     }
 }
 
 template <logger::log_level level>
-void logger_factory_impl::file_logger<level>::debug(string const& data) const {
+void logger_factory_impl::buffered_logger<level>::debug(string const& data) const {
     if (level == level_debug || level == level_trace) {
-        log(data, "D");
+        log_writer::get().log(sink, 'D', prefix, data, true);
     }
 }
 
 template <logger::log_level level>
-void logger_factory_impl::file_logger<level>::trace(string const& data) const {
+void logger_factory_impl::buffered_logger<level>::trace(string const& data) const {
     if (level == level_trace) {
-        log(data, "T");
+        log_writer::get().log(sink, 'T', prefix, data, true);
     }
 }
 
+logger_factory_impl::~logger_factory_impl() {
+    // Make sure that everything logged by the services in the environment is visible once it is gone
+    log_writer::get().flush();
+}
+
 void logger_factory_impl::configure(logger::log_level level_, string const& log_file_path_) {
     unlocked<logging_state> lg_state = lg_state_lock();
     lg_state->level = level_;
@@ -101,32 +310,30 @@ auto logger_factory_impl::get_logger(string const& prefix) const -> unique_ptr<l
     unlocked<logging_state> lg_state = lg_state_lock();
 
     string full_prefix = (lg_state->including_hostname) ? (config->get_hostname() + " " + prefix) : prefix;
-    if (lg_state->using_stdout) {
-        switch (lg_state->level) {
-            case logger::log_level::level_off:
-                return make_unique<stdout_logger<logger::log_level::level_off>>(full_prefix);
-            case logger::log_level::level_info:
-                return make_unique<stdout_logger<logger::log_level::level_info>>(full_prefix);
-            case logger::log_level::level_debug:
-                return make_unique<stdout_logger<logger::log_level::level_debug>>(full_prefix);
-            case logger::log_level::level_trace:
-                return make_unique<stdout_logger<logger::log_level::level_trace>>(full_prefix);
-            default: assert(false && "Invalid enum value");
-        }
-    } else {
-        switch (lg_state->level) {
-            case logger::log_level::level_off:
-                return make_unique<file_logger<logger::log_level::level_off>>(lg_state->log_file_path, full_prefix);
-            case logger::log_level::level_info:
-                return make_unique<file_logger<logger::log_level::level_info>>(lg_state->log_file_path, full_prefix);
-            case logger::log_level::level_debug:
-                return make_unique<file_logger<logger::log_level::level_debug>>(lg_state->log_file_path, full_prefix);
-            case logger::log_level::level_trace:
-                return make_unique<file_logger<logger::log_level::level_trace>>(lg_state->log_file_path, full_prefix);
-            default: assert(false && "Invalid enum value");
-        }
+    string sink_path = lg_state->using_stdout ? "" : ((lg_state->log_file_path == "") ? "/dev/null" : lg_state->log_file_path);
+    uint32_t sink = log_writer::get().get_sink(sink_path);
+    switch (lg_state->level) {
+        case logger::log_level::level_off:
+            return make_unique<buffered_logger<logger::log_level::level_off>>(sink, full_prefix);
+        case logger::log_level::level_info:
+            return make_unique<buffered_logger<logger::log_level::level_info>>(sink, full_prefix);
+        case logger::log_level::level_debug:
+            return make_unique<buffered_logger<logger::log_level::level_debug>>(sink, full_prefix);
+        case logger::log_level::level_trace:
+            return make_unique<buffered_logger<logger::log_level::level_trace>>(sink, full_prefix);
+        default: assert(false && "Invalid enum value");
     }
 }
 
+void logger_factory_impl::configure_tracing(string const& dir, uint64_t file_size, unsigned num_files) {
+    unlocked<logging_state> lg_state = lg_state_lock();
+    lg_state->tr_writer = std::make_shared<trace_writer>(dir, config->get_hostname(), file_size, num_files);
+}
+
+auto logger_factory_impl::get_tracer(trace_component component) const -> unique_ptr<tracer> {
+    unlocked<logging_state> lg_state = lg_state_lock();
+    return make_unique<trace_writer_tracer>(lg_state->tr_writer, component);
+}
+
 register_service<logger_factory, logger_factory_impl> register_logger_factory;
 register_test_service<logger_factory, test_logger_factory_impl> register_test_logger_factory;
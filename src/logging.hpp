@@ -5,23 +5,103 @@
 #include "environment.h"
 #include "service.h"
 #include "locking.h"
+#include "tracing.hpp"
 
 #include <string>
 #include <cstdio>
-#include <fstream>
 #include <mutex>
 #include <memory>
 #include <cassert>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Collects preformatted lines from every thread that logs and writes them out in batches on a background thread, so
+// that logging never waits on a lock or on the sink
+// Each thread appends to its own ring buffer, which only the writer thread reads from. When a thread's buffer is
+// full, info lines wait for the writer to make space, while debug and trace lines only wait up to max_drop_wait before
+// they are dropped and counted
+class log_writer {
+public:
+    // The writer shared by every logger in the process, which lives until the process exits
+    static auto get() -> log_writer&;
+
+    // Returns the ID of the sink that writes to the file at the given path, or to stdout if the path is empty
+    auto get_sink(std::string const& path) -> uint32_t;
+    void log(uint32_t sink, char level_char, std::string const& prefix, std::string const& data, bool droppable);
+    // Writes out every line that has been logged so far before returning
+    void flush();
+
+private:
+    log_writer() {}
+
+    // Must be a power of two
+    static constexpr uint64_t ring_size = 1 << 16;
+    // Each line in a ring is preceded by its length and sink
+    static constexpr uint64_t header_size = 2 * sizeof(uint32_t);
+    static constexpr std::chrono::microseconds max_drop_wait{1000};
+
+    struct ring {
+        std::unique_ptr<char[]> buf = std::make_unique<char[]>(ring_size);
+        // Only ever increase, and are taken modulo ring_size to index into buf
+        alignas(64) std::atomic<uint64_t> head = 0;
+        alignas(64) std::atomic<uint64_t> tail = 0;
+
+        std::atomic<uint64_t> dropped = 0;
+        std::atomic<uint32_t> dropped_sink = 0;
+        // Set when the thread that owns the ring exits, after which it is removed once it has been drained
+        std::atomic<bool> abandoned = false;
+    };
+
+    // Marks the calling thread's ring as abandoned when the thread exits
+    struct ring_handle {
+        ~ring_handle();
+        std::shared_ptr<ring> r;
+    };
+
+    auto local_ring() -> ring&;
+    // Formats the current time like ctime, reformatting it only when the second changes
+    static auto timestamp() -> std::string const&;
+    void write_direct(uint32_t sink, std::string const& line);
+    void wake();
+    // Moves everything in every ring into the sinks, which must be called with drain_mutex held
+    void drain();
+    void thread_fn();
+    void stop();
+
+    // Protects rings and sinks, and is only taken by threads logging for the first time
+    std::mutex registry_mutex;
+    std::vector<std::shared_ptr<ring>> rings;
+    std::vector<std::pair<std::string, int>> sinks = {{"", 1}};
+
+    // Only one thread drains the rings at a time, so each ring has a single consumer
+    std::mutex drain_mutex;
+    std::vector<std::string> sink_buffers;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    std::atomic<bool> wake_requested = false;
+    std::thread writer_thread;
+    // Once the writer has stopped at exit, lines are written directly
+    std::atomic<bool> stopped = false;
+    bool running = false;
+};
 
 class logger_factory_impl : public logger_factory, public service_impl<logger_factory_impl> {
 public:
     logger_factory_impl(environment &env)
         : config(env.get<configuration>()) {}
+    ~logger_factory_impl();
 
     void configure(logger::log_level level_, std::string const& log_file_path_);
     void configure(logger::log_level level_);
     void include_hostname();
     auto get_logger(std::string const& prefix) const -> std::unique_ptr<logger>;
+    void configure_tracing(std::string const& dir, uint64_t file_size, unsigned num_files);
+    auto get_tracer(trace_component component) const -> std::unique_ptr<tracer>;
 
 protected:
     struct logging_state {
@@ -29,44 +109,30 @@ protected:
         std::string log_file_path;
         bool using_stdout;
         bool including_hostname;
+        // Shared by the tracers of every component, or nullptr if tracing is not configured
+        std::shared_ptr<trace_writer> tr_writer;
     };
     locked<logging_state> lg_state_lock;
 
     configuration *config;
 
-    static std::mutex log_mutex;
-
-    template <logger::log_level level>
-    class stdout_logger : public logger {
-    public:
-        stdout_logger(std::string prefix_)
-            : prefix(prefix_) {}
-
-        void info(std::string const& data) const;
-        void debug(std::string const& data) const;
-        void trace(std::string const& data) const;
-
-    private:
-        inline void log(std::string const& data, std::string const& log_level_char) const;
-
-        std::string prefix;
-    };
-
+    // Formats lines on the calling thread and hands them to the shared log_writer
     template <logger::log_level level>
-    class file_logger : public logger {
+    class buffered_logger : public logger {
     public:
-        file_logger(std::string log_file_path_, std::string prefix_)
-            : prefix(prefix_), log_stream((log_file_path_ == "") ? "/dev/null" : log_file_path_) {}
+        buffered_logger(uint32_t sink_, std::string prefix_)
+            : sink(sink_), prefix(prefix_) {}
 
         void info(std::string const& data) const;
         void debug(std::string const& data) const;
         void trace(std::string const& data) const;
+        auto enabled(logger::log_level l) const -> bool {
+            return l != level_off && l <= level;
+        }
 
     private:
-        inline void log(std::string const& data, std::string const& log_level_char) const;
-
+        uint32_t sink;
         std::string prefix;
-        mutable std::ofstream log_stream;
     };
 };
 
@@ -24,6 +24,9 @@ int main(int argc, char **argv) {
     int sdfs_internal_port;
     int sdfs_master_port;
     int maple_master_port;
+    bool persistent_exe;
+    string local_combiner;
+    int memory_budget_mb;
     logger::log_level log_level = logger::log_level::level_off;
 
     cli_parser.add_argument<>("local_exe", "The path to the executable which performs map on individual files", &local_exe);
@@ -35,6 +38,9 @@ int main(int argc, char **argv) {
     cli_parser.add_option<>("ip", "port", "The TCP port used for communication between nodes in SDFS", &sdfs_internal_port, 1234);
     cli_parser.add_option<>("mp", "port", "The TCP port used for communication between clients and the master node in SDFS", &sdfs_master_port, 1235);
     cli_parser.add_option<>("p", "port", "The TCP port used for communication with the Maple master", &maple_master_port, 1237);
+    cli_parser.add_option<>("e", "", "Run the exe as a persistent executor that is fed every file, as described in mj_executor.h", &persistent_exe, false);
+    cli_parser.add_option<>("c", "local_combiner", "A plugin or persistent executor that combines the values of each key output from a file before they are appended", &local_combiner);
+    cli_parser.add_option<>("m", "memory_budget_mb", "The MB of output from each file to hold in memory before spilling it to disk, or 0 for no limit", &memory_budget_mb, 0);
 
     std::function<bool(std::string)> log_level_parser = [&log_level] (std::string str) {
         if (str == "OFF") {
@@ -66,7 +72,7 @@ int main(int argc, char **argv) {
 
     env.get<logger_factory>()->configure(log_level);
 
-    if (env.get<maple_client>()->run_job(maple_master, local_exe, maple_exe, num_maples, sdfs_intermediate_filename_prefix, sdfs_src_dir)) {
+    if (env.get<maple_client>()->run_job(maple_master, local_exe, maple_exe, num_maples, sdfs_intermediate_filename_prefix, sdfs_src_dir, persistent_exe, local_combiner, memory_budget_mb)) {
         std::cout << "Maple job successfully completed" << std::endl;
     } else {
         std::cout << "Maple job failed to complete: " + env.get<maple_client>()->get_error() << std::endl;
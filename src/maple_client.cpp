@@ -18,7 +18,8 @@ auto maple_client_impl::get_error() const -> string {
 }
 
 auto maple_client_impl::run_job(string const& mj_node, string const& local_exe, string const& maple_exe,
-    int num_maples, string const& sdfs_src_dir, string const& sdfs_output_dir) -> bool
+    int num_maples, string const& sdfs_src_dir, string const& sdfs_output_dir, bool persistent_exe,
+    string const& local_combiner, int memory_budget_mb) -> bool
 {
     do {
         lg->info("Starting job");
@@ -26,9 +27,15 @@ auto maple_client_impl::run_job(string const& mj_node, string const& local_exe,
         if (sdfsc->put(local_exe, maple_exe) != 0) {
             return false;
         }
+        // The combiner is stored alongside the exe
+        string combiner_exe = (local_combiner == "") ? "" : maple_exe + "_combiner";
+        if (combiner_exe != "" && sdfsc->put(local_combiner, combiner_exe) != 0) {
+            return false;
+        }
 
         mj_message msg(0, mj_start_job{maple_exe, num_maples, partitioner::type::round_robin,
-            sdfs_src_dir, processor::type::maple, sdfs_output_dir, 10, 50});
+            sdfs_src_dir, processor::type::maple, sdfs_output_dir, 10, 50, persistent_exe, combiner_exe,
+            memory_budget_mb});
 
         // Send the data to the node
         std::unique_ptr<tcp_client> client = fac->get_tcp_client(mj_node, config->get_mj_master_port());
@@ -64,7 +71,8 @@ auto maple_client_impl::run_job(string const& mj_node, string const& local_exe,
                 continue;
             } else {
                 lg->info("Contacted node was not the master, but told us that the master is at " + master_node);
-                return run_job(master_node, local_exe, maple_exe, num_maples, sdfs_src_dir, sdfs_output_dir);
+                return run_job(master_node, local_exe, maple_exe, num_maples, sdfs_src_dir, sdfs_output_dir, persistent_exe,
+                    local_combiner, memory_budget_mb);
             }
         } else if (response_msg.get_msg_type() == mj_message::mj_msg_type::JOB_END) {
             if (response_msg.get_msg_data<mj_job_end>().succeeded) {
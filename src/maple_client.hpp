@@ -16,7 +16,8 @@ public:
     auto get_error() const -> std::string;
 
     auto run_job(std::string const& maple_node, std::string const& local_exe, std::string const& maple_exe,
-        int num_maples, std::string const& sdfs_intermediate_filename_prefix, std::string const& sdfs_src_dir) -> bool;
+        int num_maples, std::string const& sdfs_intermediate_filename_prefix, std::string const& sdfs_src_dir,
+        bool persistent_exe, std::string const& local_combiner, int memory_budget_mb) -> bool;
 
 private:
     std::string error = "";
@@ -1,13 +1,16 @@
 #include "cli.h"
 #include "logging.h"
+#include "tracing.h"
 #include "environment.h"
 #include "configuration.h"
 #include "mj_worker.h"
 #include "test.h"
+#include "benchmark.h"
 #include "heartbeater.h"
 #include "sdfs_client.h"
 
 #include "threadpool.h"
+#include "locking.h"
 
 #include <string>
 #include <chrono>
@@ -29,14 +32,21 @@ int main(int argc, char **argv) {
     int sdfs_master_port;
     int mj_internal_port;
     int mj_master_port;
+    bool use_swim;
+    string trace_dir;
     logger::log_level log_level = logger::log_level::level_off;
     // Arguments for command maplejuice test ...
     int parallelism;
     string test_prefix;
+    // Arguments for command maplejuice bench ...
+    string bench_prefix;
+    // Arguments for command maplejuice decode ...
+    string decode_dir;
 
     cli_parser.add_required_option<>("h", "hostname", "The hostname of this node that other nodes can use", &local_hostname);
     cli_parser.add_option<>("i", "introducer", "The hostname of a node already in the group, or none if we are the first member", &introducer);
     cli_parser.add_option<>("hp", "port", "The UDP port to use for heartbeating", &hb_port, 1234);
+    cli_parser.add_option<>("swim", "", "Detect failures with the SWIM gossip protocol instead of heartbeating neighbors", &use_swim, false);
     cli_parser.add_option<>("ep", "port", "The UDP port to use for elections", &el_port, 1235);
     cli_parser.add_option<>("sip", "port", "The TCP port used for communication between nodes in SDFS", &sdfs_internal_port, 1234);
     cli_parser.add_option<>("smp", "port", "The TCP port used for communication between clients and the master node in SDFS", &sdfs_master_port, 1235);
@@ -50,6 +60,7 @@ int main(int argc, char **argv) {
         return true;
     };
     cli_parser.add_required_option<>("d", "dir", "The empty directory to store any files in, ending with a /", &dir_validator);
+    cli_parser.add_option<>("t", "trace_dir", "A directory ending with a / to record binary trace events in, which can be printed with decode", &trace_dir);
 
     std::function<bool(std::string)> log_level_parser = [&log_level] (std::string str) {
         if (str == "OFF") {
@@ -72,6 +83,13 @@ int main(int argc, char **argv) {
     test_parser->add_option<>("p", "prefix", "The prefix of the tests to run. By default all tests will be run", &test_prefix);
     test_parser->add_option<callback, none>("l", "log_level", "The logging level to use: either OFF, INFO, DEBUG, or TRACE", &log_level_parser);
 
+    cli_command *bench_parser = cli_parser.add_subcommand("bench");
+    bench_parser->add_option<>("p", "prefix", "The prefix of the benchmarks to run. By default all benchmarks will be run", &bench_prefix);
+    bench_parser->add_option<callback, none>("l", "log_level", "The logging level to use: either OFF, INFO, DEBUG, or TRACE", &log_level_parser);
+
+    cli_command *decode_parser = cli_parser.add_subcommand("decode");
+    decode_parser->add_argument<>("trace_dir", "The directory containing the trace files of any number of nodes, which are merged by time", &decode_dir);
+
     // Run CLI parser and exit on failure
     if (!cli_parser.parse("maplejuice", argc, argv)) {
         return 1;
@@ -82,6 +100,19 @@ int main(int argc, char **argv) {
         return 0;
     }
 
+    if (bench_parser->was_invoked()) {
+        benchmarking::run_benchmarks(bench_prefix, log_level);
+        return 0;
+    }
+
+    if (decode_parser->was_invoked()) {
+        for (decoded_trace_event const& ev : trace_decoder::read_dir(decode_dir)) {
+            std::cout << trace_decoder::format(ev) << "\n";
+        }
+        std::cout << std::flush;
+        return 0;
+    }
+
     if (!test_parser->was_invoked()) {
         environment env(false);
 
@@ -89,6 +120,7 @@ int main(int argc, char **argv) {
         config->set_hostname(local_hostname);
         config->set_first_node(introducer == "");
         config->set_hb_port(hb_port);
+        config->set_swim_heartbeater(use_swim);
         config->set_election_port(el_port);
         config->set_dir(dir);
         config->set_sdfs_subdir("sdfs");
@@ -100,6 +132,10 @@ int main(int argc, char **argv) {
         config->set_shared_config_subdir("shared_config");
 
         env.get<logger_factory>()->configure(log_level);
+        if (trace_dir != "") {
+            // Keep up to 4 files of 64MB each per node
+            env.get<logger_factory>()->configure_tracing(trace_dir, 64 * 1024 * 1024, 4);
+        }
 
         env.get<mj_worker>()->start();
         if (introducer != "") {
@@ -113,6 +149,10 @@ int main(int argc, char **argv) {
 
             string command, local_filename, sdfs_filename;
             std::cin >> command;
+            if (command == "locks") {
+                std::cout << lock_profiling::report();
+                continue;
+            }
             std::cin >> local_filename;
             std::cin >> sdfs_filename;
 
@@ -123,7 +163,7 @@ int main(int argc, char **argv) {
             } else if (command == "append") {
                 sdfsc->append(local_filename, sdfs_filename);
             } else {
-                std::cout << "Usage: put/get/append <local_filename> <sdfs_filename>" << std::endl;
+                std::cout << "Usage: put/get/append <local_filename> <sdfs_filename>, or locks to print lock contention" << std::endl;
             }
         }
     }
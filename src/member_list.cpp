@@ -10,34 +10,25 @@ const uint64_t new_member_heartbeat_slack = 2000;
 auto member_list::add_member(std::string const& hostname, uint32_t id) -> uint32_t {
     uint32_t original_size = num_members();
 
-    node *prev = nullptr;
-    node *cur = head;
-    // Find the insertion point
-    while (cur != nullptr) {
-        if (id < cur->m.id)
-            break;
-
-        prev = cur;
-        cur = cur->next;
-    }
-
-    // Create the new node
-    node *new_node = new node();
-    assert(new_node != nullptr);
-    new_node->next = cur;
-    new_node->m.id = id;
-    new_node->m.hostname = hostname;
-    new_node->m.last_heartbeat =
+    // Insert after any members with the same ID
+    auto pos = std::upper_bound(members.begin(), members.end(), id, [] (uint32_t id, member const& m) {
+        return id < m.id;
+    });
+
+    member new_member;
+    new_member.id = id;
+    new_member.hostname = hostname;
+    new_member.last_heartbeat =
         duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count() + new_member_heartbeat_slack;
+    members.insert(pos, std::move(new_member));
+    ids_hash += id_hash(id);
 
-    // Insert it into the correct position
-    if (prev == nullptr)
-        head = new_node;
-    else
-        prev->next = new_node;
+    if (hostname == local_hostname && (local_id == 0 || id < local_id)) {
+        local_id = id;
+    }
 
-    lg->debug("Added member at " + hostname + " with id " + std::to_string(id) + " at local time " +
-        std::to_string(duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count())  + " to membership list");
+    lg->debug("Added member at ", hostname, " with id ", id, " at local time ",
+        duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count(), " to membership list");
 
     assert(num_members() - original_size == 1);
 
@@ -46,12 +37,22 @@ auto member_list::add_member(std::string const& hostname, uint32_t id) -> uint32
 
 // Gets a member from the membership list by ID
 auto member_list::get_member_by_id(uint32_t id) const -> member {
-    for (node *cur = head; cur != nullptr; cur = cur->next) {
-        if (cur->m.id == id) {
-            return cur->m;
-        }
+    member const* m = find_member(id);
+    return m ? *m : member();
+}
+
+// Gets a pointer to the member with the given ID without copying it, or nullptr if there is no such member
+auto member_list::find_member(uint32_t id) const -> member const* {
+    size_t i = lower_bound(id);
+    if (i < members.size() && members[i].id == id) {
+        return &members[i];
     }
-    return member();
+    return nullptr;
+}
+
+// Whether or not there is a member with the given ID
+auto member_list::has_member(uint32_t id) const -> bool {
+    return find_member(id) != nullptr;
 }
 
 // Removes a member from the membership list
@@ -61,31 +62,28 @@ void member_list::remove_member(uint32_t id) {
     std::vector<member> initial_neighbors = get_neighbors();
 
     // First, just remove the member from the list
-    node *prev = nullptr;
-    node *cur = head;
-    while (cur != nullptr) {
-        if (cur->m.id == id) {
-            if (prev == nullptr) {
-                head = cur->next;
-            } else {
-                prev->next = cur->next;
-            }
-            lg->debug("Removed member at " + cur->m.hostname + " from list with id " + std::to_string(id));
-            delete cur;
-            break;
+    size_t i = lower_bound(id);
+    if (i < members.size() && members[i].id == id) {
+        lg->debug("Removed member at ", members[i].hostname, " from list with id ", id);
+        members.erase(members.begin() + i);
+        ids_hash -= id_hash(id);
+
+        // If that was us, we may still be in the list under a later ID
+        if (id == local_id) {
+            auto it = std::find_if(members.begin(), members.end(), [&] (member const& m) {
+                return m.hostname == local_hostname;
+            });
+            local_id = (it == members.end()) ? 0 : it->id;
         }
-
-        prev = cur;
-        cur = cur->next;
     }
 
     std::vector<member> new_neighbors = get_neighbors();
 
     // For the new members, reset their last heartbeat time to be now so that they aren't immediately marked failed
-    for (member m : new_neighbors) {
+    for (member const& m : new_neighbors) {
         // If we cannot find this neighbor m in the previous list of neighbors, it is new
         if (std::find_if(initial_neighbors.begin(), initial_neighbors.end(),
-                [=](member n) {return n.id == m.id;}) == initial_neighbors.end()) {
+                [&](member const& n) {return n.id == m.id;}) == initial_neighbors.end()) {
 
             update_heartbeat(m.id);
         }
@@ -96,11 +94,9 @@ void member_list::remove_member(uint32_t id) {
 
 // Updates the heartbeat for a member to the current time
 void member_list::update_heartbeat(uint32_t id) {
-    for (node *cur = head; cur != nullptr; cur = cur->next) {
-        if (cur->m.id == id) {
-            cur->m.last_heartbeat = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-            return;
-        }
+    size_t i = lower_bound(id);
+    if (i < members.size() && members[i].id == id) {
+        members[i].last_heartbeat = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
     }
 }
 
@@ -108,70 +104,27 @@ void member_list::update_heartbeat(uint32_t id) {
 auto member_list::get_neighbors() const -> std::vector<member> {
     std::vector<member> ret;
 
-    node *cur;
-
     if (!joined_list())
         return ret;
 
     // Add all the members other than ourselves if the total number of members is <=5
     if (num_members() <= 5) {
-        for (cur = head; cur != nullptr; cur = cur->next) {
-            if (cur->m.hostname != local_hostname)
-                ret.push_back(cur->m);
+        for (member const& m : members) {
+            if (m.hostname != local_hostname)
+                ret.push_back(m);
         }
         return ret;
     }
 
-    // Get the 2 predecessors
-    node *prev_2[2] = {nullptr, nullptr};
-    node *us = head;
-    cur = head;
-    while (cur != nullptr) {
-        if (cur->m.hostname == local_hostname) {
-            us = cur;
-            break;
-        }
-
-        prev_2[0] = prev_2[1];
-        prev_2[1] = cur;
-        cur = cur->next;
-    }
-
-    // Add them to the list
-    for (int i = 0; i < 2; i++) {
-        if (prev_2[i] != nullptr)
-            ret.push_back(prev_2[i]->m);
-    }
-
-    // If either 1 or 2 predecessors were not found we have to check at the end of the list
-    int num_preds_not_found = (prev_2[0] == nullptr) + (prev_2[1] == nullptr);
-    if (num_preds_not_found > 0) {
-        // Find the last 2 elements of the list
-        prev_2[0] = nullptr;
-        prev_2[1] = nullptr;
-        for (cur = head; cur != nullptr; cur = cur->next) {
-            prev_2[0] = prev_2[1];
-            prev_2[1] = cur;
-        }
+    // Take the 2 predecessors and 2 successors around us, wrapping around the ends of the list
+    size_t n = members.size();
+    size_t us = lower_bound(local_id);
+    ret.reserve(4);
+    ret.push_back(members[(us + n - 2) % n]);
+    ret.push_back(members[(us + n - 1) % n]);
+    ret.push_back(members[(us + 1) % n]);
+    ret.push_back(members[(us + 2) % n]);
 
-        // Add either 1 or 2 of those that were found to the list
-        for (int i = 0; i < num_preds_not_found; i++) {
-            ret.push_back(prev_2[1 - i]->m);
-        }
-    }
-
-    // Get the 2 successors starting from us
-    cur = us;
-    for (int i = 0; i < 2; i++) {
-        if (cur->next == nullptr)
-            cur = head;
-        else
-            cur = cur->next;
-
-        ret.push_back(cur->m);
-    }
-
-    assert(ret.size() == 4);
     for (int i = 0; i < 4; i++) {
         assert(ret[i].hostname != local_hostname);
         assert(ret[i].hostname != "");
@@ -183,43 +136,52 @@ auto member_list::get_neighbors() const -> std::vector<member> {
 
 // Get the number of members total
 auto member_list::num_members() const -> uint32_t {
-    uint32_t count = 0;
-    for (node *cur = head; cur != nullptr; cur = cur->next) {
-        count++;
-    }
-    return count;
+    return members.size();
+}
+
+// Gets the digest of the membership list
+auto member_list::digest() const -> membership_digest {
+    membership_digest d;
+    d.num_members = num_members();
+    d.hash = ids_hash;
+    return d;
+}
+
+// Mixes the bits of the ID so that lists differing in a few similar IDs still have different sums
+auto member_list::id_hash(uint32_t id) -> uint32_t {
+    id ^= id >> 16;
+    id *= 0x7feb352d;
+    id ^= id >> 15;
+    id *= 0x846ca68b;
+    id ^= id >> 16;
+    return id;
 }
 
 // Whether or not we are in the member list
 auto member_list::joined_list() const -> bool {
-    for (node *cur = head; cur != nullptr; cur = cur->next) {
-        if (cur->m.hostname == local_hostname)
-            return true;
-    }
-    return false;
+    return local_id != 0;
+}
+
+// Returns the index of the first member with an ID of at least id
+auto member_list::lower_bound(uint32_t id) const -> size_t {
+    auto it = std::lower_bound(members.begin(), members.end(), id, [] (member const& m, uint32_t id) {
+        return m.id < id;
+    });
+    return it - members.begin();
 }
 
 // Gets a list of all the members
 auto member_list::get_members() const -> std::vector<member> {
-    std::vector<member> list;
-    for (node *cur = head; cur != nullptr; cur = cur->next) {
-        list.push_back(cur->m);
-    }
-    return list;
+    return members;
 }
 
 // Gets the successor to the node with the given ID
 // Returns a member with ID 0 if the given ID was not found
 auto member_list::get_successor(uint32_t id) const -> member {
-    for (node *cur = head; cur != nullptr; cur = cur->next) {
-        if (cur->m.id == id) {
-            if (cur->next == nullptr) {
-                // Wrap around to the head for the successor
-                return head->m;
-            } else {
-                return cur->next->m;
-            }
-        }
+    size_t i = lower_bound(id);
+    if (i < members.size() && members[i].id == id) {
+        // Wrap around to the first member for the successor
+        return members[(i + 1) % members.size()];
     }
     // Node with given ID not found
     return member();
@@ -227,4 +189,4 @@ auto member_list::get_successor(uint32_t id) const -> member {
 
 auto member::operator==(const member &m) const -> bool {
     return hostname == m.hostname && id == m.id && last_heartbeat == m.last_heartbeat;
-}
\ No newline at end of file
+}
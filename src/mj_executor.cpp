@@ -0,0 +1,198 @@
+#include "mj_executor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+using std::string;
+using std::string_view;
+using emit_callback = std::function<void(string_view, string_view)>;
+
+namespace {
+const size_t record_header_size = sizeof(uint32_t) + sizeof(uint64_t);
+const size_t initial_buffer_size = 64 * 1024;
+}
+
+mj_executor::~mj_executor() {
+    // Closing stdin tells the executor to exit
+    close(in_fd);
+    close(out_fd);
+    waitpid(pid, nullptr, 0);
+}
+
+auto mj_executor::start(string const& path) -> std::unique_ptr<mj_executor> {
+    int in_pipe[2], out_pipe[2];
+    if (pipe2(in_pipe, O_CLOEXEC) != 0) {
+        return nullptr;
+    }
+    if (pipe2(out_pipe, O_CLOEXEC) != 0) {
+        close(in_pipe[0]);
+        close(in_pipe[1]);
+        return nullptr;
+    }
+
+    // The duplicated descriptors do not inherit O_CLOEXEC, so the executor only gets its own ends of the pipes
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+
+    pid_t pid;
+    char *argv[] = {const_cast<char*>(path.c_str()), nullptr};
+    int result = posix_spawn(&pid, path.c_str(), &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    if (result != 0) {
+        close(in_pipe[1]);
+        close(out_pipe[0]);
+        return nullptr;
+    }
+
+    // Writes must never block so that output can be read while a large input is still being written
+    fcntl(in_pipe[1], F_SETFL, fcntl(in_pipe[1], F_GETFL) | O_NONBLOCK);
+    return std::unique_ptr<mj_executor>(new mj_executor(pid, in_pipe[1], out_pipe[0]));
+}
+
+auto mj_executor::run(string_view key, string_view val, emit_callback const& emit) -> bool {
+    if (buffer.empty()) {
+        buffer.resize(initial_buffer_size);
+    }
+
+    char header[record_header_size];
+    uint32_t klen = key.size();
+    uint64_t vlen = val.size();
+    std::memcpy(header, &klen, sizeof(klen));
+    std::memcpy(header + sizeof(klen), &vlen, sizeof(vlen));
+
+    string_view parts[] = {string_view(header, record_header_size), key, val};
+    size_t total = record_header_size + klen + vlen;
+    size_t written = 0;
+
+    // The executor may write output before it has read all of the input, so both are done at once to avoid
+    // blocking on a full pipe in either direction
+    bool ended = false;
+    uint64_t status = 0;
+    while (!ended) {
+        pollfd fds[2] = {{out_fd, POLLIN, 0}, {in_fd, POLLOUT, 0}};
+        if (poll(fds, written < total ? 2 : 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        if (written < total && (fds[1].revents & (POLLOUT | POLLERR | POLLHUP))) {
+            iovec iov[3];
+            int iovcnt = 0;
+            size_t offset = written;
+            for (string_view part : parts) {
+                if (offset < part.size()) {
+                    iov[iovcnt++] = {const_cast<char*>(part.data() + offset), part.size() - offset};
+                    offset = 0;
+                } else {
+                    offset -= part.size();
+                }
+            }
+
+            ssize_t result = writev(in_fd, iov, iovcnt);
+            if (result < 0 && errno != EAGAIN && errno != EINTR) {
+                return false;
+            }
+            written += std::max<ssize_t>(result, 0);
+        }
+
+        if (!(fds[0].revents & (POLLIN | POLLERR | POLLHUP))) {
+            continue;
+        }
+
+        // Make room after the unread output and read as much as is available
+        if (buf_start > 0) {
+            std::memmove(buffer.data(), buffer.data() + buf_start, buf_end - buf_start);
+            buf_end -= buf_start;
+            buf_start = 0;
+        }
+        if (buf_end == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+        ssize_t bytes_read = read(out_fd, buffer.data() + buf_end, buffer.size() - buf_end);
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        // The executor exited before finishing the input
+        if (bytes_read <= 0) {
+            return false;
+        }
+        buf_end += bytes_read;
+
+        // Emit every complete record that has been read
+        while (buf_end - buf_start >= record_header_size) {
+            uint32_t out_klen;
+            uint64_t out_vlen;
+            std::memcpy(&out_klen, buffer.data() + buf_start, sizeof(out_klen));
+            std::memcpy(&out_vlen, buffer.data() + buf_start + sizeof(out_klen), sizeof(out_vlen));
+
+            if (out_klen == MJ_EXECUTOR_END_OF_INPUT) {
+                buf_start += record_header_size;
+                status = out_vlen;
+                ended = true;
+                break;
+            }
+
+            size_t record_size = record_header_size + out_klen + out_vlen;
+            if (buf_end - buf_start < record_size) {
+                if (buffer.size() < record_size) {
+                    buffer.resize(record_size);
+                }
+                break;
+            }
+
+            char const* record = buffer.data() + buf_start + record_header_size;
+            emit(string_view(record, out_klen), string_view(record + out_klen, out_vlen));
+            buf_start += record_size;
+        }
+    }
+
+    // An executor that ends an input before reading all of it is out of step with us
+    return written == total && buf_start == buf_end && status == 0;
+}
+
+auto mj_executor::run_file(string_view key, string const& path, emit_callback const& emit) -> bool {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Empty files cannot be mapped
+    if (st.st_size == 0) {
+        close(fd);
+        return run(key, string_view(), emit);
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    bool result = run(key, string_view(static_cast<char const*>(data), st.st_size), emit);
+    munmap(data, st.st_size);
+    return result;
+}
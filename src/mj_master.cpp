@@ -19,12 +19,18 @@ using std::unordered_set;
 mj_master_impl::mj_master_impl(environment &env)
     : mt(std::chrono::system_clock::now().time_since_epoch().count())
     , lg(env.get<logger_factory>()->get_logger("mj_master"))
+    , tr(env.get<logger_factory>()->get_tracer(trace_component::mj_master))
     , config(env.get<configuration>())
     , hb(env.get<heartbeater>())
     , el(env.get<election>())
     , fac(env.get<tcp_factory>())
     , sdfsm(env.get<sdfs_master>())
-    , tp_fac(env.get<threadpool_factory>()), running(false) {}
+    , tp_fac(env.get<threadpool_factory>())
+    , tw(env.get<timer_wheel>()), running(false), master_timer(0)
+{
+    node_states_lock.profile_as("mj_master::node_states_lock");
+    job_states_lock.profile_as("mj_master::job_states_lock");
+}
 
 void mj_master_impl::start() {
     if (running.load()) {
@@ -36,17 +42,20 @@ void mj_master_impl::start() {
     sdfsm->start();
     running = true;
 
-    std::thread election_thread([this] {
+    // Check once a second whether we have been elected master, and once we are, start handling the cluster
+    master_timer = tw->schedule_repeating(1000, [this] {
         bool is_master;
-        do {
-            el->wait_master_node([&] (member const& m) {
-                is_master = (m.id == hb->get_id());
-            });
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        } while (!is_master && running.load());
+        el->wait_master_node([&] (member const& m) {
+            is_master = (m.id == hb->get_id());
+        });
         if (!running.load()) {
+            tw->cancel(master_timer);
+            return;
+        }
+        if (!is_master) {
             return;
         }
+        tw->cancel(master_timer);
 
         // Add callbacks for nodes leaving or failing
         std::function<void(member const&)> callback = [this] (member const& m) {
@@ -60,19 +69,20 @@ void mj_master_impl::start() {
             assert(metadata.find("maplejuice") != metadata.end() && "SDFS master callback logic is incorrect");
             string const& mj_metadata = metadata.find("maplejuice")->second;
 
-            deserializer des(mj_metadata.c_str(), mj_metadata.length());
-            string input_file = des.get_string();
+            deserializer des(mj_metadata);
+            string input_file(des.get_string());
             int job_id = des.get_int();
 
-            unlocked<job_state_map> job_states = job_states_lock();
+            unlocked<job_state_map> job_states = job_states_lock(job_id);
+            if (job_states->find(job_id) == job_states->end()) {
+                return;
+            }
             (*job_states)[job_id].committed_outputs.insert({input_file, sdfs_path});
-            lg->trace("Marking " + input_file + ", " + sdfs_path + " as committed");
+            lg->trace("Marking ", input_file, ", ", sdfs_path, " as committed");
         });
     });
-    election_thread.detach();
 
-    std::thread master_thread([this] {run_master();});
-    master_thread.detach();
+    run_master();
 }
 
 void mj_master_impl::stop() {
@@ -82,205 +92,200 @@ void mj_master_impl::stop() {
 
     lg->info("Stopping MapleJuice master");
     running = false;
+    tw->cancel(master_timer);
 }
 
 void mj_master_impl::run_master() {
-    server = fac->get_tcp_server(config->get_mj_master_port());
+    // The server is kept across restarts, since it stops accepting work on its own while we are not running
+    if (server) {
+        return;
+    }
 
-    while (true) {
-        if (!running.load()) {
-            break;
-        }
+    server = fac->get_tcp_event_server(config->get_mj_master_port(), num_server_threads);
+    server->start([this] (int client, string const& msg_str) {
+        handle_message(client, msg_str);
+    });
+}
 
-        int fd = server->accept_connection();
-        if (fd < 0) {
-            continue;
-        }
+void mj_master_impl::handle_message(int client, string const& msg_str) {
+    if (!running.load()) {
+        server->close_connection(client);
+        return;
+    }
 
-        std::thread client_thread([this, fd] {
-            string msg_str = server->read_from_client(fd);
-            mj_message msg(msg_str.c_str(), msg_str.length());
+    mj_message msg(msg_str.c_str(), msg_str.length());
 
-            if (!msg.is_well_formed()) {
-                lg->debug("Received ill-formed message from client");
-                server->close_connection(fd);
-                return;
-            }
+    if (!msg.is_well_formed()) {
+        lg->debug("Received ill-formed message from client");
+        server->close_connection(client);
+        return;
+    }
 
-            // Make sure the message is coming from within the group (unless it's a START_JOB message)
-            if (hb->get_member_by_id(msg.get_id()).id != msg.get_id() && msg.get_msg_type() != mj_message::mj_msg_type::START_JOB) {
-                lg->trace("Received message from member outside of group");
-                server->close_connection(fd);
-                return;
-            }
+    // Make sure the message is coming from within the group (unless it's a START_JOB message)
+    if (hb->get_member_by_id(msg.get_id()).id != msg.get_id() && msg.get_msg_type() != mj_message::mj_msg_type::START_JOB) {
+        lg->trace("Received message from member outside of group");
+        server->close_connection(client);
+        return;
+    }
+
+    bool is_master;
+    string master_hostname;
+    el->wait_master_node([&] (member const& m) {
+        is_master = (m.id == hb->get_id());
+        master_hostname = m.hostname;
+    });
+
+    if (msg.get_msg_type() == mj_message::mj_msg_type::START_JOB) {
+        mj_start_job info = msg.get_msg_data<mj_start_job>();
 
-            bool is_master;
-            string master_hostname;
-            el->wait_master_node([&] (member const& m) {
-                is_master = (m.id == hb->get_id());
-                master_hostname = m.hostname;
+        if (is_master) {
+            // The job runs for a long time, so it should not occupy one of the server's handler threads
+            std::thread job_thread([this, client, info] {
+                handle_job(client, info);
             });
+            job_thread.detach();
+        } else {
+            lg->trace("Redirecting request to start job with executable ", info.exe, " to master node");
+
+            // Send a message to the client informing them of the actual master node
+            mj_message not_master_msg(hb->get_id(), mj_not_master{master_hostname});
+            server->write_to_client(client, not_master_msg.serialize());
+            server->close_connection(client);
+        }
+        return;
+    }
 
-            if (msg.get_msg_type() == mj_message::mj_msg_type::START_JOB) {
-                mj_start_job info = msg.get_msg_data<mj_start_job>();
+    if (!is_master) {
+        server->close_connection(client);
+        return;
+    }
 
-                if (is_master) {
-                    handle_job(fd, info);
-                } else {
-                    lg->trace("Redirecting request to start job with executable " + info.exe + " to master node");
+    if (msg.get_msg_type() == mj_message::mj_msg_type::JOB_FAILED) {
+        mj_job_failed info = msg.get_msg_data<mj_job_failed>();
 
-                    // Send a message to the client informing them of the actual master node
-                    mj_message not_master_msg(hb->get_id(), mj_not_master{master_hostname});
-                    server->write_to_client(fd, not_master_msg.serialize());
-                    server->close_connection(fd);
-                }
-                return;
-            }
+        lg->info("Received notice from worker node that job with ID " + std::to_string(info.job_id) + " failed, stopping job");
 
-            if (!is_master) {
-                server->close_connection(fd);
-                return;
-            }
+        // Mark the job as failed, which will automatically cause it to complete
+        unlocked<job_state_map> job_states = job_states_lock(info.job_id);
+        if (job_states->find(info.job_id) != job_states->end()) {
+            (*job_states)[info.job_id].progress.failed = true;
+            job_done_cv.notify_all();
+        }
+        return;
+    }
 
-            if (msg.get_msg_type() == mj_message::mj_msg_type::JOB_FAILED) {
-                mj_job_failed info = msg.get_msg_data<mj_job_failed>();
+    if (msg.get_msg_type() == mj_message::mj_msg_type::REQUEST_APPEND_PERM) {
+        mj_request_append_perm info = msg.get_msg_data<mj_request_append_perm>();
 
-                lg->info("Received notice from worker node that job with ID " + std::to_string(info.job_id) + " failed, stopping job");
+        bool allow_append;
+        {
+            unlocked<job_state_map> job_states = job_states_lock(info.job_id);
 
-                // Mark the job as failed, which will automatically cause it to complete
-                unlocked<job_state_map> job_states = job_states_lock();
-                if (job_states->find(info.job_id) != job_states->end()) {
-                    (*job_states)[info.job_id].failed = true;
-                }
-                return;
+            // Disallow appends for jobs that have already been stopped rather than recreating their state
+            if (job_states->find(info.job_id) == job_states->end()) {
+                allow_append = false;
+            } else {
+                unordered_set<std::pair<string, string>, string_pair_hash> &committed_outputs =
+                    (*job_states)[info.job_id].committed_outputs;
+                allow_append = (committed_outputs.find({info.input_file, info.output_file}) == committed_outputs.end());
             }
+        }
 
-            while (msg.get_msg_type() == mj_message::mj_msg_type::REQUEST_APPEND_PERM) {
-                mj_request_append_perm info = msg.get_msg_data<mj_request_append_perm>();
-
-                bool allow_append;
-                {
-                    unlocked<job_state_map> job_states = job_states_lock();
+        lg->trace("[Job ", info.job_id, "] Node at ", info.hostname,
+            " requested permission to append values to output file ", info.output_file,
+            " from input file ", info.input_file,
+            (allow_append ? ", allowing append" : ", disallowing append"));
+        tr->event(trace_event::append_permission,
+            {info.job_id, info.hostname, info.output_file, info.input_file, allow_append});
 
-                    unordered_set<std::pair<string, string>, string_pair_hash> &committed_outputs =
-                        (*job_states)[info.job_id].committed_outputs;
-                    allow_append = (committed_outputs.find({info.input_file, info.output_file}) == committed_outputs.end());
-                }
+        // Send the permission back to the node
+        mj_message perm_msg(hb->get_id(), mj_append_perm{allow_append});
+        server->write_to_client(client, perm_msg.serialize()); // Ignore failure, that will be handled in node_dropped
 
-                lg->trace("[Job " + std::to_string(info.job_id) + "] Node at " + info.hostname +
-                    " requested permission to append values to output file " + info.output_file +
-                    " from input file " + info.input_file +
-                    (allow_append ? ", allowing append" : ", disallowing append"));
+        // We do not mark the file as committed now, we will mark it when we get a callback from SDFS
+        // The connection is left open, since the node will send either another request or FILE_DONE on it
+        return;
+    }
 
-                // Send the permission back to the node
-                mj_message perm_msg(hb->get_id(), mj_append_perm{allow_append});
-                server->write_to_client(fd, perm_msg.serialize()); // Ignore failure, that will be handled in node_dropped
+    // Either this is a new connection OR the node has finished requesting permission to append
+    // Either way, we should close the connection with the client
+    server->close_connection(client);
+    if (msg.get_msg_type() == mj_message::mj_msg_type::FILE_DONE) {
+        mj_file_done info = msg.get_msg_data<mj_file_done>();
 
-                // We do not mark the file as committed now, we will mark it when we get a callback from SDFS
+        unlocked<node_state_map> node_states = node_states_lock();
+        unlocked<job_state_map> job_states = job_states_lock(info.job_id);
 
-                msg_str = server->read_from_client(fd);
-                msg = mj_message(msg_str.c_str(), msg_str.length());
-                if (!msg.is_well_formed()) {
-                    lg->trace("Received ill-formed message from client after it requested permission to append");
-                    server->close_connection(fd);
-                    return;
-                }
-                // Check if the client has left the group
-                if (hb->get_member_by_id(msg.get_id()).id != msg.get_id()) {
-                    lg->trace("Received message from member outside of group");
-                    server->close_connection(fd);
-                    return;
-                }
-            }
+        if (job_states->find(info.job_id) == job_states->end()) {
+            return;
+        }
 
-            // Either we arrived here from a new connection OR after a REQUEST_APPEND_PERM from the previous if block
-            // Either way, we should close the connection with the server
-            server->close_connection(fd);
-            if (msg.get_msg_type() == mj_message::mj_msg_type::FILE_DONE) {
-                mj_file_done info = msg.get_msg_data<mj_file_done>();
-
-                {
-                    unlocked<node_state_map> node_states = node_states_lock();
-                    unlocked<job_state_map> job_states = job_states_lock();
-
-                    if (job_states->find(info.job_id) == job_states->end()) {
-                        return;
-                    }
-
-                    unordered_set<string> &unprocessed_files = (*job_states)[info.job_id].unprocessed_files[info.hostname];
-                    unordered_set<string> &processed_files = (*job_states)[info.job_id].processed_files[info.hostname];
-                    lg->debug("Node at " + info.hostname + " completed processing file " + info.file +
-                        " for job with ID " + std::to_string(info.job_id));
-                    assert(unprocessed_files.find(info.file) != unprocessed_files.end() ||
-                           processed_files.find(info.file) != processed_files.end() ||
-                           !"File that node claims to have completed was not assigned to node");
-
-                    (*node_states)[info.hostname].num_files--;
-
-                    if (processed_files.find(info.file) == processed_files.end()) {
-                        unprocessed_files.erase(info.file);
-                        processed_files.insert(info.file);
-                    }
-                }
-                return;
+        unordered_set<string> &unprocessed_files = (*job_states)[info.job_id].unprocessed_files[info.hostname];
+        unordered_set<string> &processed_files = (*job_states)[info.job_id].processed_files[info.hostname];
+        lg->debug("Node at ", info.hostname, " completed processing file ", info.file,
+            " for job with ID ", info.job_id);
+        assert(unprocessed_files.find(info.file) != unprocessed_files.end() ||
+               processed_files.find(info.file) != processed_files.end() ||
+               !"File that node claims to have completed was not assigned to node");
+
+        (*node_states)[info.hostname].num_files--;
+
+        if (processed_files.find(info.file) == processed_files.end()) {
+            unprocessed_files.erase(info.file);
+            processed_files.insert(info.file);
+
+            mj_job_progress &progress = (*job_states)[info.job_id].progress;
+            progress.completed_files++;
+            lg->debug("[Job ", info.job_id, "] ", progress.completed_files, "/",
+                progress.total_files, " files completed");
+            tr->event(trace_event::file_done,
+                {info.job_id, info.hostname, info.file, progress.completed_files, progress.total_files});
+            if (progress.outstanding_files() == 0) {
+                job_done_cv.notify_all();
             }
-
-            lg->debug("Received unexpected message type from client");
-        });
-        client_thread.detach();
+        }
+        return;
     }
+
+    lg->debug("Received unexpected message type from client");
 }
 
-void mj_master_impl::handle_job(int fd, mj_start_job const& info)
+void mj_master_impl::handle_job(int client, mj_start_job const& info)
 {
     // Assign the appropriate nodes a partitioning of the input files based on the specified partitioner
     int job_id = assign_job(info);
 
-    // Wait for the job to actually complete
-    while (!job_complete(job_id)) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-    }
-
-    // Tell the client that the job is complete
+    // Wait for the last file to be completed or for the job to fail
     int succeeded;
     {
-        unlocked<job_state_map> job_states = job_states_lock();
+        unlocked<job_state_map> job_states = job_states_lock(job_id);
         assert(job_states->find(job_id) != job_states->end());
-        succeeded = (*job_states)[job_id].failed ? 0 : 1;
+
+        mj_job_progress const& progress = (*job_states)[job_id].progress;
+        job_done_cv.wait(job_states.unsafe_get_mutex(), [&] {
+            return progress.failed || progress.outstanding_files() == 0;
+        });
+        succeeded = progress.failed ? 0 : 1;
     }
+    tr->event(trace_event::job_ended, {job_id, succeeded});
+
+    // Tell the client that the job is complete
     mj_message msg(hb->get_id(), mj_job_end{succeeded});
-    server->write_to_client(fd, msg.serialize());
-    server->close_connection(fd);
+    server->write_to_client(client, msg.serialize());
+    server->close_connection(client);
 
     // Clean up all data and tell the worker nodes that the job is complete
     stop_job(job_id);
 }
 
-auto mj_master_impl::job_complete(int job_id) -> bool {
-    unlocked<job_state_map> job_states = job_states_lock();
-
-    assert(job_states->find(job_id) != job_states->end());
-
-    // If the job has failed, it has also completed
-    if ((*job_states)[job_id].failed) {
-        return true;
-    }
-
-    // Otherwise, check if there are no more files left in the job
-    job_state &state = (*job_states)[job_id];
-
-    unsigned num_files = 0;
-    for (auto const& pair : state.unprocessed_files) {
-        num_files += pair.second.size();
-    }
-    lg->info("Waiting on " + std::to_string(num_files) + " files");
-
-    for (auto const& pair : state.unprocessed_files) {
-        if (pair.second.size() > 0) {
-            return false;
+auto mj_master_impl::get_job_progress() const -> std::unordered_map<int, mj_job_progress> {
+    std::unordered_map<int, mj_job_progress> progress;
+    job_states_lock.for_each_shard([&] (job_state_map &job_states) {
+        for (auto const& [job_id, state] : job_states) {
+            progress[job_id] = state.progress;
         }
-    }
-    return true;
+    });
+    return progress;
 }
 
 void mj_master_impl::stop_job(int job_id) {
@@ -288,7 +293,7 @@ void mj_master_impl::stop_job(int job_id) {
     std::vector<string> workers;
     {
         unlocked<node_state_map> node_states = node_states_lock();
-        unlocked<job_state_map> job_states = job_states_lock();
+        unlocked<job_state_map> job_states = job_states_lock(job_id);
         if (job_states->find(job_id) == job_states->end()) {
             return;
         }
@@ -306,22 +311,19 @@ void mj_master_impl::stop_job(int job_id) {
     }
 
     // Tell all the nodes in parallel that the job is over
-    std::vector<std::thread> stop_threads;
-    for (string const& worker : workers) {
-        stop_threads.push_back(std::thread([=] {
-            mj_message done_msg(hb->get_id(), mj_job_end_worker{job_id});
+    mj_message done_msg(hb->get_id(), mj_job_end_worker{job_id});
+    string done_msg_str = done_msg.serialize();
 
-            std::unique_ptr<tcp_client> client = fac->get_tcp_client(worker, config->get_mj_internal_port());
-            if (client.get() == nullptr) {
-                return;
-            }
+    std::unique_ptr<threadpool> tp = tp_fac->get_threadpool(workers.size());
+    tp->parallel_for(0, workers.size(), [&] (size_t i) {
+        std::unique_ptr<tcp_client> client = fac->get_pooled_tcp_client(workers[i], config->get_mj_internal_port());
+        if (client.get() == nullptr) {
+            return;
+        }
 
-            client->write_to_server(done_msg.serialize());
-        }));
-    }
-    for (std::thread &t : stop_threads) {
-        t.join();
-    }
+        client->write_to_server(done_msg_str);
+    });
+    tp->finish();
 }
 
 auto mj_master_impl::assign_job(mj_start_job const& info) -> int {
@@ -331,7 +333,9 @@ auto mj_master_impl::assign_job(mj_start_job const& info) -> int {
         ", num_workers=" + std::to_string(info.num_workers) + ", partitioner=" + partitioner::print_type(info.partitioner_type) +
         ", sdfs_src_dir=" + info.sdfs_src_dir + ", processor=" + processor::print_type(info.processor_type) +
         ", sdfs_output_dir=" + info.sdfs_output_dir + ", num_files_parallel=" + std::to_string(info.num_files_parallel) +
-        ", num_appends_parallel=" + std::to_string(info.num_appends_parallel) + "]");
+        ", num_appends_parallel=" + std::to_string(info.num_appends_parallel) +
+        ", persistent_exe=" + std::to_string(info.persistent_exe) + ", combiner_exe=" + info.combiner_exe +
+        ", memory_budget_mb=" + std::to_string(info.memory_budget_mb) + "]");
 
     // Get the list of input files
     std::optional<std::vector<string>> input_files_opt = sdfsm->ls_files(info.sdfs_src_dir);
@@ -345,7 +349,7 @@ auto mj_master_impl::assign_job(mj_start_job const& info) -> int {
     unordered_map<string, unordered_set<string>> unprocessed_files_copy;
     {
         unlocked<node_state_map> node_states = node_states_lock();
-        unlocked<job_state_map> job_states = job_states_lock();
+        unlocked<job_state_map> job_states = job_states_lock(job_id);
 
         (*job_states)[job_id].exe = info.exe;
         (*job_states)[job_id].sdfs_src_dir = info.sdfs_src_dir;
@@ -353,12 +357,21 @@ auto mj_master_impl::assign_job(mj_start_job const& info) -> int {
         (*job_states)[job_id].processor_type = info.processor_type;
         (*job_states)[job_id].num_files_parallel = info.num_files_parallel;
         (*job_states)[job_id].num_appends_parallel = info.num_appends_parallel;
-        (*job_states)[job_id].failed = false;
+        (*job_states)[job_id].persistent_exe = info.persistent_exe;
+        (*job_states)[job_id].combiner_exe = info.combiner_exe;
+        (*job_states)[job_id].memory_budget_mb = info.memory_budget_mb;
 
         (*job_states)[job_id].unprocessed_files =
             partitioner_factory::get_partitioner(info.partitioner_type)->partition(hb->get_members(), info.num_workers, input_files);
         unprocessed_files_copy = (*job_states)[job_id].unprocessed_files;
 
+        mj_job_progress &progress = (*job_states)[job_id].progress;
+        progress = mj_job_progress();
+        for (auto const& [hostname, files] : unprocessed_files_copy) {
+            progress.total_files += files.size();
+        }
+        tr->event(trace_event::job_started, {job_id, info.exe, progress.total_files});
+
         string members_log_str = "Assigning job with ID " + std::to_string(job_id) + " to: ";
         for (auto const& pair : (*job_states)[job_id].unprocessed_files) {
             (*node_states)[pair.first].num_files += pair.second.size();
@@ -368,8 +381,8 @@ auto mj_master_impl::assign_job(mj_start_job const& info) -> int {
         lg->info(members_log_str);
     }
 
-    { // Print the files assigned to each node
-        unlocked<job_state_map> job_states = job_states_lock();
+    if (lg->enabled(logger::level_info)) { // Print the files assigned to each node
+        unlocked<job_state_map> job_states = job_states_lock(job_id);
         for (auto const& [hostname, files] : (*job_states)[job_id].unprocessed_files) {
             string log_str = "[Job " + std::to_string(job_id) + "] Files assigned to node at " + hostname + ": ";
             for (auto it = files.begin(); it != files.end(); ++it) {
@@ -384,8 +397,10 @@ auto mj_master_impl::assign_job(mj_start_job const& info) -> int {
 
     // Actually send the message to assign the job to each of the nodes
     std::unique_ptr<threadpool> tp = tp_fac->get_threadpool(unprocessed_files_copy.size());
-    for (auto const& [hostname, files] : unprocessed_files_copy) {
-        tp->enqueue([=] {assign_job_to_node(job_id, hostname, files);});
+    for (auto &[hostname, files] : unprocessed_files_copy) {
+        tp->enqueue([this, job_id, hostname = hostname, files = std::move(files)] {
+            assign_job_to_node(job_id, hostname, files);
+        });
     }
     tp->finish();
 
@@ -420,8 +435,11 @@ void mj_master_impl::assign_job_to_node(int job_id, string const& hostname, unor
     processor::type processor_type;
     int num_files_parallel;
     int num_appends_parallel;
+    int persistent_exe;
+    string combiner_exe;
+    int memory_budget_mb;
     { // Get the job information
-        unlocked<job_state_map> job_states = job_states_lock();
+        unlocked<job_state_map> job_states = job_states_lock(job_id);
         if (job_states->find(job_id) == job_states->end()) {
             return;
         }
@@ -431,18 +449,22 @@ void mj_master_impl::assign_job_to_node(int job_id, string const& hostname, unor
         processor_type = (*job_states)[job_id].processor_type;
         num_files_parallel = (*job_states)[job_id].num_files_parallel;
         num_appends_parallel = (*job_states)[job_id].num_appends_parallel;
+        persistent_exe = (*job_states)[job_id].persistent_exe;
+        combiner_exe = (*job_states)[job_id].combiner_exe;
+        memory_budget_mb = (*job_states)[job_id].memory_budget_mb;
     }
 
     std::vector<string> input_files_vec(input_files.begin(), input_files.end());
     mj_message msg(hb->get_id(), mj_assign_job{job_id, exe, sdfs_src_dir, input_files_vec,
-        processor_type, sdfs_output_dir, num_files_parallel, num_appends_parallel});
+        processor_type, sdfs_output_dir, num_files_parallel, num_appends_parallel, persistent_exe,
+        combiner_exe, memory_budget_mb});
 
-    std::unique_ptr<tcp_client> client = fac->get_tcp_client(hostname, config->get_mj_internal_port());
+    std::unique_ptr<tcp_client> client = fac->get_pooled_tcp_client(hostname, config->get_mj_internal_port());
     if (client.get() == nullptr || client->write_to_server(msg.serialize()) <= 0) {
         // The failure will be handled as normal by assigning the files for this node to another node
-        lg->trace("Failed to send ASSIGN_JOB message for job with id " + std::to_string(job_id) + " to node at " + hostname);
+        lg->trace("Failed to send ASSIGN_JOB message for job with id ", job_id, " to node at ", hostname);
     } else {
-        lg->debug("Sent ASSIGN_JOB message for job with id " + std::to_string(job_id) + " to node at " + hostname);
+        lg->debug("Sent ASSIGN_JOB message for job with id ", job_id, " to node at ", hostname);
 
         // Mark the job as assigned to this node
         unlocked<node_state_map> node_states = node_states_lock();
@@ -460,13 +482,14 @@ void mj_master_impl::node_dropped(string const& hostname) {
     unordered_map<int, std::tuple<string, unordered_set<string>>> assignments;
     {
         unlocked<node_state_map> node_states = node_states_lock();
-        unlocked<job_state_map> job_states = job_states_lock();
 
         // Save which jobs it was a part of then delete all information associated with the node
         unordered_set<int> jobs = (*node_states)[hostname].jobs;
         node_states->erase(hostname);
 
         for (int job_id : jobs) {
+            unlocked<job_state_map> job_states = job_states_lock(job_id);
+
             // Redistribute the work for this job to the least busy node
             string target = get_least_busy_node().hostname;
             assignments[job_id] = {target, (*job_states)[job_id].unprocessed_files[hostname]};
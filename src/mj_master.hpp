@@ -11,10 +11,12 @@
 #include "sdfs_master.h"
 #include "processor.h"
 #include "threadpool.h"
+#include "timer_wheel.h"
 #include "locking.h"
 
 #include <memory>
 #include <atomic>
+#include <condition_variable>
 #include <unordered_map>
 #include <string>
 
@@ -24,12 +26,15 @@ public:
 
     void start();
     void stop();
+    auto get_job_progress() const -> std::unordered_map<int, mj_job_progress>;
 
 private:
-    // Server thread which listens for incoming TCP messages as a master node
+    // Starts the server which listens for incoming TCP messages as a master node
     void run_master();
+    // Handles a single message received by the server from the given client
+    void handle_message(int client, std::string const& msg_str);
     // Initiates a new job, waits for it to complete, and informs the client that started the job
-    void handle_job(int fd, mj_start_job const& info);
+    void handle_job(int client, mj_start_job const& info);
     // Assigns files to nodes in the cluster, sends them a message assigning them work,
     // and returns the job ID, which is negative on failure
     auto assign_job(mj_start_job const& info) -> int;
@@ -39,8 +44,6 @@ private:
     auto get_least_busy_node() -> member;
     // Notifies all worker nodes to stop working on the specified job, and cleans up any related data
     void stop_job(int job_id);
-    // Checks whether or not a previously running job has completed
-    auto job_complete(int job_id) -> bool;
     // Callback called by heartbeater when a node goes down, which will redistribute its work to other nodes
     void node_dropped(std::string const& hostname);
 
@@ -66,6 +69,9 @@ private:
         processor::type processor_type;
         int num_files_parallel;
         int num_appends_parallel;
+        int persistent_exe;
+        std::string combiner_exe;
+        int memory_budget_mb;
 
         // A map from node hostname to the files assigned to it that have not yet been processed
         std::unordered_map<std::string, std::unordered_set<std::string>> unprocessed_files;
@@ -75,24 +81,37 @@ private:
         // TODO: this is actually not sufficient, since there might be multiple outputs from a given input file
         std::unordered_set<std::pair<std::string, std::string>, string_pair_hash> committed_outputs;
 
-        bool failed;
+        // Kept up to date as files are completed so that completion can be checked without going through every file
+        mj_job_progress progress;
     };
-    // A map from job ID to the state of the job
+    // A map from job ID to the state of the job, split across several locks so that messages for different jobs
+    // can be handled at the same time
+    // When both are needed, node_states_lock must be locked before job_states_lock
     using job_state_map = std::unordered_map<int, job_state>;
-    locked<job_state_map> job_states_lock;
+    sharded_locked<job_state_map> job_states_lock;
+    // Notified with the lock for a job held when the last outstanding file of the job is completed or the job
+    // fails, which handle_job waits on
+    std::condition_variable_any job_done_cv;
 
     // RNG to generate job IDs
     std::mt19937 mt;
 
     // Services that this depends on
     std::unique_ptr<logger> lg;
+    std::unique_ptr<tracer> tr;
     configuration *config;
     heartbeater *hb;
     election *el;
     tcp_factory *fac;
     sdfs_master *sdfsm;
-    std::unique_ptr<tcp_server> server;
+    std::unique_ptr<tcp_event_server> server;
     threadpool_factory *tp_fac;
+    timer_wheel *tw;
 
     std::atomic<bool> running;
+    // Checks whether we have become the master node until we have
+    timer_id master_timer;
+
+    // The number of threads that handle messages received by the server
+    const unsigned num_server_threads = 16;
 };
@@ -0,0 +1,67 @@
+#include "mj_plugin.h"
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string;
+using std::string_view;
+using emit_callback = std::function<void(string_view, string_view)>;
+
+mj_plugin::~mj_plugin() {
+    dlclose(handle);
+}
+
+auto mj_plugin::load(string const& path) -> std::unique_ptr<mj_plugin> {
+    // Executables cannot be opened with dlopen, so they fall through to being run as commands
+    void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        return nullptr;
+    }
+
+    mj_map_fn map_fn = reinterpret_cast<mj_map_fn>(dlsym(handle, MJ_PLUGIN_ENTRY_POINT));
+    if (map_fn == nullptr) {
+        dlclose(handle);
+        return nullptr;
+    }
+    return std::unique_ptr<mj_plugin>(new mj_plugin(handle, map_fn));
+}
+
+auto mj_plugin::run(string_view key, string_view val, emit_callback const& emit) const -> bool {
+    mj_emit_fn emit_fn = [] (void *emit_ctx, const char *k, size_t klen, const char *v, size_t vlen) {
+        (*static_cast<emit_callback const*>(emit_ctx))(string_view(k, klen), string_view(v, vlen));
+    };
+    return map_fn(key.data(), key.size(), val.data(), val.size(), emit_fn,
+        const_cast<void*>(static_cast<void const*>(&emit))) == 0;
+}
+
+auto mj_plugin::run_file(string_view key, string const& path, emit_callback const& emit) const -> bool {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Empty files cannot be mapped
+    if (st.st_size == 0) {
+        close(fd);
+        return run(key, string_view(), emit);
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    bool result = run(key, string_view(static_cast<char const*>(data), st.st_size), emit);
+    munmap(data, st.st_size);
+    return result;
+}
@@ -18,6 +18,7 @@ using std::function;
 
 mj_worker_impl::mj_worker_impl(environment &env)
     : lg(env.get<logger_factory>()->get_logger("mj_worker"))
+    , tr(env.get<logger_factory>()->get_tracer(trace_component::mj_worker))
     , config(env.get<configuration>())
     , fac(env.get<tcp_factory>())
     , hb(env.get<heartbeater>())
@@ -26,7 +27,10 @@ mj_worker_impl::mj_worker_impl(environment &env)
     , sdfsc(env.get<sdfs_client>())
     , sdfss(env.get<sdfs_server>())
     , sdfsm(env.get<sdfs_master>())
-    , tp_fac(env.get<threadpool_factory>()), running(false), mt(std::chrono::system_clock::now().time_since_epoch().count()) {}
+    , tp_fac(env.get<threadpool_factory>()), running(false), mt(std::chrono::system_clock::now().time_since_epoch().count())
+{
+    job_states_lock.profile_as("mj_worker::job_states_lock");
+}
 
 void mj_worker_impl::start() {
     if (running.load()) {
@@ -41,8 +45,7 @@ void mj_worker_impl::start() {
     sdfsm->start();
     running = true;
 
-    std::thread server_thread([this] {server_thread_function();});
-    server_thread.detach();
+    start_server();
 }
 
 void mj_worker_impl::stop() {
@@ -78,83 +81,87 @@ void mj_worker_impl::stop() {
     el->stop();
 }
 
-void mj_worker_impl::server_thread_function() {
-    server = fac->get_tcp_server(config->get_mj_internal_port());
+void mj_worker_impl::start_server() {
+    // The server is kept across restarts, since it ignores commands while we are not running
+    if (server) {
+        return;
+    }
 
-    while (true) {
-        // Wait for the master node to connect to us and assign us work
-        int fd = server->accept_connection();
+    server = fac->get_tcp_event_server(config->get_mj_internal_port(), num_server_threads);
+    server->start([this] (int client, string const& msg_str) {
+        handle_message(client, msg_str);
+    });
 
-        if (!running.load()) {
-            lg->debug("Exiting server");
-            return;
-        }
+    // Pooled connections to nodes that have left the group will never be useful again
+    std::function<void(member const&)> evict_callback = [this] (member const& m) {
+        fac->evict_pooled_connections(m.hostname);
+    };
+    hb->on_leave(evict_callback);
+    hb->on_fail(evict_callback);
+}
 
-        if (fd < 0) {
-            continue;
-        }
+void mj_worker_impl::handle_message(int client, string const& msg_str) {
+    // The master sends a single message per connection
+    server->close_connection(client);
 
-        std::thread client_thread([this, fd] {
-            // Get the message from the master and parse it
-            string msg_str = server->read_from_client(fd);
-            server->close_connection(fd);
+    if (!running.load()) {
+        lg->debug("Ignoring message from master since we are not running");
+        return;
+    }
 
-            mj_message msg(msg_str.c_str(), msg_str.length());
+    mj_message msg(msg_str.c_str(), msg_str.length());
 
-            // We only handle messages of the type ASSIGN_JOB or JOB_END_WORKER
-            if (!msg.is_well_formed() || (msg.get_msg_type() != mj_message::mj_msg_type::ASSIGN_JOB &&
-                msg.get_msg_type() != mj_message::mj_msg_type::JOB_END_WORKER))
-            {
-                lg->debug("Received malformed message from master, meaning master has most likely crashed");
-                return;
-            }
+    // We only handle messages of the type ASSIGN_JOB or JOB_END_WORKER
+    if (!msg.is_well_formed() || (msg.get_msg_type() != mj_message::mj_msg_type::ASSIGN_JOB &&
+        msg.get_msg_type() != mj_message::mj_msg_type::JOB_END_WORKER))
+    {
+        lg->debug("Received malformed message from master, meaning master has most likely crashed");
+        return;
+    }
 
-            if (msg.get_msg_type() == mj_message::mj_msg_type::ASSIGN_JOB) {
-                mj_assign_job data = msg.get_msg_data<mj_assign_job>();
-                int job_id = data.job_id;
-
-                bool already_running;
-                { // Start an atomic block to access the job_states map
-                    unlocked<job_state_map> job_states = job_states_lock();
-                    already_running = (job_states->find(job_id) != job_states->end());
-
-                    // Spin up a thread to process the job if it isn't already running
-                    if (!already_running) {
-                        start_job(std::move(job_states), job_id, data);
-                        std::thread monitor_thread([=] {
-                            monitor_job(job_id);
-                        });
-                        monitor_thread.detach();
-                        lg->info("Starting new job with ID " + std::to_string(job_id));
-                    } else {
-                        std::thread job_thread([=] {
-                            add_files_to_job(job_id, data.input_files);
-                        });
-                        job_thread.detach();
-                        lg->info("Accepting extra work due to loss of a node for job with ID " + std::to_string(job_id));
-                    }
-                }
+    if (msg.get_msg_type() == mj_message::mj_msg_type::ASSIGN_JOB) {
+        mj_assign_job data = msg.get_msg_data<mj_assign_job>();
+        int job_id = data.job_id;
+
+        bool already_running;
+        { // Start an atomic block to access the job_states map
+            unlocked<job_state_map> job_states = job_states_lock();
+            already_running = (job_states->find(job_id) != job_states->end());
+
+            // Spin up a thread to process the job if it isn't already running
+            if (!already_running) {
+                start_job(std::move(job_states), job_id, data);
+                std::thread monitor_thread([=] {
+                    monitor_job(job_id);
+                });
+                monitor_thread.detach();
+                lg->info("Starting new job with ID " + std::to_string(job_id));
+            } else {
+                std::thread job_thread([=] {
+                    add_files_to_job(job_id, data.input_files);
+                });
+                job_thread.detach();
+                lg->info("Accepting extra work due to loss of a node for job with ID " + std::to_string(job_id));
             }
+        }
+    }
 
-            if (msg.get_msg_type() == mj_message::mj_msg_type::JOB_END_WORKER) {
-                mj_job_end_worker data = msg.get_msg_data<mj_job_end_worker>();
+    if (msg.get_msg_type() == mj_message::mj_msg_type::JOB_END_WORKER) {
+        mj_job_end_worker data = msg.get_msg_data<mj_job_end_worker>();
 
-                { // Atomic block to access job_states map
-                    unlocked<job_state_map> job_states = job_states_lock();
+        { // Atomic block to access job_states map
+            unlocked<job_state_map> job_states = job_states_lock();
 
-                    int job_id = data.job_id;
-                    if (job_states->find(job_id) != job_states->end()) {
-                        unlocked<job_state> state = (*job_states)[job_id]();
+            int job_id = data.job_id;
+            if (job_states->find(job_id) != job_states->end()) {
+                unlocked<job_state> state = (*job_states)[job_id]();
 
-                        // Notify the condition variable that the job is over, which monitor_job is waiting on
-                        state->job_complete = true;
-                        state->cv_done.notify_all();
-                        lg->info("Master node has informed us that job with ID " + std::to_string(job_id) + " is done");
-                    }
-                }
+                // Notify the condition variable that the job is over, which monitor_job is waiting on
+                state->job_complete = true;
+                state->cv_done.notify_all();
+                lg->info("Master node has informed us that job with ID " + std::to_string(job_id) + " is done");
             }
-        });
-        client_thread.detach();
+        }
     }
 }
 
@@ -170,7 +177,10 @@ void mj_worker_impl::start_job(unlocked<job_state_map> &&job_states, int job_id,
     state->processor_type = data.processor_type;
     state->num_files_parallel = data.num_files_parallel;
     state->num_appends_parallel = data.num_appends_parallel;
-    state->tp = tp_fac->get_threadpool(data.num_files_parallel);
+    state->persistent_exe = data.persistent_exe;
+    state->has_combiner = (data.combiner_exe != "");
+    state->memory_budget = static_cast<uint64_t>(data.memory_budget_mb) << 20;
+    state->tp = tp_fac->get_work_stealing_threadpool(data.num_files_parallel);
 
     // Download exe from the SDFS
     utils::backoff([&] {
@@ -182,7 +192,29 @@ void mj_worker_impl::start_job(unlocked<job_state_map> &&job_states, int job_id,
     } catch (...) {
         assert(false && "Setting permissions failed, meaning the program is not being run with sufficient privileges");
     }
-    lg->debug("[Job " + std::to_string(job_id) + "] Downloaded executable " + state->exe + " from SDFS");
+    lg->debug("[Job ", job_id, "] Downloaded executable ", state->exe, " from SDFS");
+
+    // Load the exe once for the whole job if it is a plugin
+    state->plugin = mj_plugin::load(exe_path);
+    if (state->plugin) {
+        lg->debug("[Job ", job_id, "] Loaded ", state->exe, " as a plugin");
+    }
+
+    // Download and load the combiner in the same way, which is only used by Maple
+    if (state->has_combiner) {
+        string combiner_path = config->get_mj_dir() + "combiner_" + std::to_string(job_id);
+        utils::backoff([&] {
+            return sdfsc->get(combiner_path, data.combiner_exe) == 0;
+        });
+        try {
+            std::filesystem::permissions(combiner_path, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+        } catch (...) {
+            assert(false && "Setting permissions failed, meaning the program is not being run with sufficient privileges");
+        }
+        state->combiner_plugin = mj_plugin::load(combiner_path);
+        lg->debug("[Job ", job_id, "] Downloaded combiner ", data.combiner_exe, " from SDFS",
+            state->combiner_plugin ? " as a plugin" : " as a persistent executor");
+    }
 
     std::thread add_files_thread([=] {
         add_files_to_job(job_id, data.input_files);
@@ -226,6 +258,7 @@ void mj_worker_impl::monitor_job(int job_id) {
         utils::backoff([&] {
             return std::filesystem::remove(exe_path);
         });
+        std::filesystem::remove(config->get_mj_dir() + "combiner_" + std::to_string(job_id));
 
         // Delete the job
         unlocked<job_state_map> job_states = job_states_lock();
@@ -247,7 +280,7 @@ void mj_worker_impl::notify_job_failed(int job_id) {
         });
 
         // TODO: prevent clients from flooding master with requests immediately after election
-        std::unique_ptr<tcp_client> client = fac->get_tcp_client(master_hostname, config->get_mj_master_port());
+        std::unique_ptr<tcp_client> client = fac->get_pooled_tcp_client(master_hostname, config->get_mj_master_port());
         if (client.get() == nullptr) {
             continue;
         }
@@ -278,20 +311,28 @@ void mj_worker_impl::add_files_to_job(int job_id, std::vector<std::string> const
     processor::type processor_type = state->processor_type;
     string sdfs_output_dir = state->sdfs_output_dir;
     int num_appends_parallel = state->num_appends_parallel;
+    std::shared_ptr<mj_plugin> plugin = state->plugin;
+    bool persistent_exe = state->persistent_exe;
+    bool has_combiner = state->has_combiner && processor_type == processor::type::maple;
+    std::shared_ptr<mj_plugin> combiner_plugin = state->combiner_plugin;
+    uint64_t memory_budget = state->memory_budget;
 
     for (auto const& filename : new_files) {
-        lg->debug("[Job " + std::to_string(job_id) + "] Processing file " + filename);
+        lg->debug("[Job ", job_id, "] Processing file ", filename);
 
         // Enqueue a thread to download the file, run the exe on it, and write the results back to SDFS
         string sdfs_src_dir = state->sdfs_src_dir;
         state->tp->enqueue([=] {
-            process_file(job_id, filename, sdfs_src_dir, sdfs_output_dir, processor_type, num_appends_parallel);
+            process_file(job_id, filename, sdfs_src_dir, sdfs_output_dir, processor_type, num_appends_parallel, plugin, persistent_exe,
+                has_combiner, combiner_plugin, memory_budget);
         });
     }
 }
 
 void mj_worker_impl::process_file(int job_id, string const& filename, string const& sdfs_src_dir,
-    string const& sdfs_output_dir, processor::type processor_type, int num_appends_parallel)
+    string const& sdfs_output_dir, processor::type processor_type, int num_appends_parallel,
+    std::shared_ptr<mj_plugin> const& plugin, bool persistent_exe, bool has_combiner,
+    std::shared_ptr<mj_plugin> const& combiner_plugin, uint64_t memory_budget)
 {
     string sdfs_file_path = sdfs_src_dir + "/" + filename;
     string exe_path = config->get_mj_dir() + "exe_" + std::to_string(job_id);
@@ -304,16 +345,42 @@ void mj_worker_impl::process_file(int job_id, string const& filename, string con
     {
         return;
     }
-    lg->trace("[Job " + std::to_string(job_id) + "] Downloaded input file " + filename + " from SDFS");
+    lg->trace("[Job ", job_id, "] Downloaded input file ", filename, " from SDFS");
 
     // Construct the processor object which will process the output of the command and determine where in SDFS it goes
-    std::unique_ptr<processor> proc = processor_factory::get_processor(processor_type);
-
-    // Actually run the program on the input file, processing it line by line
-    lg->trace("[Job " + std::to_string(job_id) + "] Running command " + exe_path + " " + local_file_path);
-    bool success = run_command(exe_path + " " + local_file_path + " " + filename, [&] (string line) {
-        return proc->process_line(line);
-    });
+    // Output beyond the memory budget is spilled to the MapleJuice directory
+    std::unique_ptr<processor> proc = processor_factory::get_processor(processor_type, memory_budget, config->get_mj_dir());
+
+    bool success;
+    if (plugin) {
+        // Hand the file to the plugin, which emits its output directly into the processor
+        lg->trace("[Job ", job_id, "] Running plugin ", exe_path, " on ", local_file_path);
+        success = plugin->run_file(filename, local_file_path, [&] (std::string_view key, std::string_view value) {
+            proc->process_pair(key, value);
+        });
+    } else if (persistent_exe) {
+        lg->trace("[Job ", job_id, "] Sending ", local_file_path, " to a persistent executor");
+        success = run_executor(job_id, false, [&] (mj_executor *executor) {
+            return executor->run_file(filename, local_file_path, [&] (std::string_view key, std::string_view value) {
+                proc->process_pair(key, value);
+            });
+        });
+    } else {
+        // Actually run the program on the input file, processing it line by line
+        lg->trace("[Job ", job_id, "] Running command ", exe_path, " ", local_file_path);
+        success = run_command(exe_path + " " + local_file_path + " " + filename, [&] (std::string_view line) {
+            return proc->process_line(line);
+        });
+    }
+    tr->event(trace_event::file_processed, {job_id, filename, success});
+
+    // Combine the values of each key so that fewer of them have to be appended
+    if (success && has_combiner) {
+        std::unique_ptr<processor> combined =
+            processor_factory::get_processor(processor_type, memory_budget, config->get_mj_dir());
+        success = combine(job_id, proc.get(), combined.get(), combiner_plugin);
+        proc = std::move(combined);
+    }
 
     // The provided executable was not valid
     if (!success) {
@@ -332,6 +399,65 @@ void mj_worker_impl::process_file(int job_id, string const& filename, string con
     });
 }
 
+auto mj_worker_impl::run_executor(int job_id, bool combiner, function<bool(mj_executor*)> const& run) -> bool {
+    string exe_path = config->get_mj_dir() + (combiner ? "combiner_" : "exe_") + std::to_string(job_id);
+
+    std::unique_ptr<mj_executor> executor;
+    {
+        unlocked<job_state> state = (*job_states_lock())[job_id]();
+        std::vector<std::unique_ptr<mj_executor>> &idle = combiner ? state->idle_combiners : state->idle_executors;
+        if (!idle.empty()) {
+            executor = std::move(idle.back());
+            idle.pop_back();
+        }
+    }
+
+    if (!executor) {
+        executor = mj_executor::start(exe_path);
+        if (!executor) {
+            return false;
+        }
+        lg->debug("[Job ", job_id, "] Started a persistent ", combiner ? "combiner" : "executor");
+    }
+
+    // An executor that failed may have stopped partway through its input, so it is not reused
+    bool success = run(executor.get());
+    if (success) {
+        unlocked<job_state> state = (*job_states_lock())[job_id]();
+        (combiner ? state->idle_combiners : state->idle_executors).push_back(std::move(executor));
+    }
+    return success;
+}
+
+auto mj_worker_impl::combine(int job_id, processor *proc, processor *combined,
+    std::shared_ptr<mj_plugin> const& combiner_plugin) -> bool
+{
+    auto emit = [&] (std::string_view key, std::string_view value) {
+        combined->process_pair(key, value);
+    };
+
+    // The combiner is given the values of a key one per line, just like Juice
+    string values;
+    unsigned num_values = 0;
+    for (auto const& [key, vals] : *proc) {
+        values.clear();
+        for (string const& val : vals) {
+            values.append(val).append("\n");
+        }
+        num_values += vals.size();
+
+        bool success = combiner_plugin ? combiner_plugin->run(key, values, emit) :
+            run_executor(job_id, true, [&] (mj_executor *executor) {
+                return executor->run(key, values, emit);
+            });
+        if (!success) {
+            return false;
+        }
+    }
+    lg->trace("[Job ", job_id, "] Combined ", num_values, " values");
+    return true;
+}
+
 void mj_worker_impl::append_output(int job_id, processor *proc, string const& input_file,
     string const& sdfs_output_dir, int num_appends_parallel)
 {
@@ -339,11 +465,11 @@ void mj_worker_impl::append_output(int job_id, processor *proc, string const& in
         // First, get the master hostname from the election service
         string master_hostname = "";
         el->wait_master_node([this, &master_hostname, job_id] (member const& master) {
-            lg->trace("[Job " + std::to_string(job_id) + "] Got master node at " + master.hostname + " from election");
+            lg->trace("[Job ", job_id, "] Got master node at ", master.hostname, " from election");
             master_hostname = master.hostname;
         });
 
-        std::unique_ptr<tcp_client> client = fac->get_tcp_client(master_hostname, config->get_mj_master_port());
+        std::unique_ptr<tcp_client> client = fac->get_pooled_tcp_client(master_hostname, config->get_mj_master_port());
         if (client.get() == nullptr) {
             continue;
         }
@@ -356,11 +482,11 @@ void mj_worker_impl::append_output(int job_id, processor *proc, string const& in
                 break;
             }
 
-            optional<function<void()>> append_lambda =
+            optional<task> append_task =
                 append_lines(job_id, client.get(), input_file, sdfs_output_dir + "/" + output_filename, vals, &master_down);
 
-            if (append_lambda) {
-                tp->enqueue(append_lambda.value());
+            if (append_task) {
+                tp->enqueue(std::move(append_task.value()));
             }
         }
 
@@ -387,7 +513,7 @@ void mj_worker_impl::append_output(int job_id, processor *proc, string const& in
 }
 
 auto mj_worker_impl::append_lines(int job_id, tcp_client *client, string const& input_file,
-    string const& output_file_path, std::vector<string> const& vals, std::atomic<bool> *master_down) -> optional<function<void()>>
+    string const& output_file_path, std::vector<string> const& vals, std::atomic<bool> *master_down) -> optional<task>
 {
     // Then, construct the message requesting permission to append
     mj_message msg(hb->get_id(), mj_request_append_perm{job_id, config->get_hostname(), input_file, output_file_path});
@@ -395,7 +521,7 @@ auto mj_worker_impl::append_lines(int job_id, tcp_client *client, string const&
 
     // Connect to the master and send the message, and wait for either a yes or no response
     if (client->write_to_server(msg_str) <= 0) {
-        lg->trace("[Job " + std::to_string(job_id) + "] Request to append to output file " + output_file_path + " failed to send to master");
+        lg->trace("[Job ", job_id, "] Request to append to output file ", output_file_path, " failed to send to master");
         *master_down = true;
         return std::nullopt;
     }
@@ -404,18 +530,18 @@ auto mj_worker_impl::append_lines(int job_id, tcp_client *client, string const&
 
     mj_message response(response_str.c_str(), response_str.length());
     if (!response.is_well_formed() || response.get_msg_type() != mj_message::mj_msg_type::APPEND_PERM) {
-        lg->trace("[Job " + std::to_string(job_id) + "] Lost connection with master node while " +
-            "requesting permission to append to output file " + output_file_path);
+        lg->trace("[Job ", job_id, "] Lost connection with master node while ",
+            "requesting permission to append to output file ", output_file_path);
         *master_down = true;
         return std::nullopt;
     }
 
     bool got_permission = (response.get_msg_data<mj_append_perm>().allowed != 0);
-    lg->trace("[Job " + std::to_string(job_id) + "] " + (got_permission ? "Received " : "Did not receive ") +
-        "permission to append to output file " + output_file_path);
+    lg->trace("[Job ", job_id, "] ", (got_permission ? "Received " : "Did not receive "),
+        "permission to append to output file ", output_file_path);
 
     if (got_permission) {
-        return optional<function<void()>>([=] {
+        return optional<task>([=] {
             // Append the values to the output file using sdfs_client
             string append;
             for (auto const& val : vals) {
@@ -423,10 +549,9 @@ auto mj_worker_impl::append_lines(int job_id, tcp_client *client, string const&
             }
 
             // TODO: create a type for Maplejuice metadata instead of adhoc serialization
-            serializer ser;
-            ser.add_field(input_file);
-            ser.add_field(job_id);
-            string metadata_val = ser.serialize();
+            string metadata_val;
+            serializer ser(metadata_val);
+            ser.add_fields(input_file, job_id);
 
             // Include the metadata {maplejuice: input_file} so the master can record the append as successful
             utils::backoff([&] {
@@ -441,50 +566,30 @@ auto mj_worker_impl::append_lines(int job_id, tcp_client *client, string const&
                 }), output_file_path, {{"maplejuice", metadata_val}}) == 0;
             }, [&] {return !running.load();});
 
-            lg->debug("[Job " + std::to_string(job_id) + "] Appended values to output file " + output_file_path + " from input file " + input_file);
+            lg->debug("[Job ", job_id, "] Appended values to output file ", output_file_path, " from input file ", input_file);
         });
     } else {
-        lg->debug("[Job " + std::to_string(job_id) + "] Not appending values to output file " + output_file_path + " from input file " + input_file);
+        lg->debug("[Job ", job_id, "] Not appending values to output file ", output_file_path, " from input file ", input_file);
         return std::nullopt;
     }
 }
 
-auto mj_worker_impl::run_command(string const& command, function<bool(string const&)> const& callback) const -> bool {
-    char buffer[1024];
+auto mj_worker_impl::run_command(string const& command, function<bool(std::string_view)> const& callback) const -> bool {
     FILE *stream = popen(command.c_str(), "r");
     if (stream) {
-        string cur_line = "";
-        while (!feof(stream)) {
-            size_t bytes_read = fread(static_cast<void*>(buffer), 1, 1024, stream);
-            if (bytes_read == 1024 || (feof(stream) && bytes_read > 0)) {
-                cur_line += string(buffer, bytes_read);
-
-                while (true) {
-                    int newline_pos = -1;
-                    for (size_t i = 0; i < cur_line.length(); i++) {
-                        if (cur_line.at(i) == '\n') {
-                            newline_pos = i;
-                            break;
-                        }
-                    }
+        // Lines are split straight out of the pipe without going through the FILE's buffer
+        bool callback_failed = false;
+        bool read_all = utils::read_lines(fileno(stream), [&] (std::string_view line) {
+            callback_failed = !callback(line);
+            return !callback_failed;
+        });
 
-                    // Check if we encountered a \n, which means we should call the callback
-                    if (newline_pos >= 0) {
-                        if (!callback(cur_line.substr(0, newline_pos))) {
-                            lg->debug("Callback has indicated failure");
-                            pclose(stream);
-                            return false;
-                        }
-                        cur_line = cur_line.substr(newline_pos + 1);
-                    } else {
-                        break;
-                    }
-                }
-            } else {
-                lg->debug("Error occurred while processing output of command");
-            }
+        if (callback_failed) {
+            lg->debug("Callback has indicated failure");
+        } else if (!read_all) {
+            lg->debug("Error occurred while processing output of command");
         }
-        return pclose(stream) == 0;
+        return pclose(stream) == 0 && read_all;
     } else {
         return false;
     }
@@ -18,6 +18,8 @@
 #include "threadpool.h"
 #include "mj_messages.h"
 #include "locking.h"
+#include "mj_plugin.h"
+#include "mj_executor.h"
 
 #include <memory>
 #include <atomic>
@@ -45,6 +47,19 @@ private:
         int num_files_parallel;
         int num_appends_parallel;
         std::unique_ptr<threadpool> tp;
+        // The loaded plugin if the job's exe is a plugin rather than an executable
+        std::shared_ptr<mj_plugin> plugin;
+        bool persistent_exe;
+        // Persistent executors that are not currently running a file, which are reused by the worker threads until
+        // the job is removed
+        std::vector<std::unique_ptr<mj_executor>> idle_executors;
+        // The combiner that Maple output is passed through before it is appended, which is either a plugin or a
+        // persistent executor, and otherwise there is none
+        bool has_combiner;
+        std::shared_ptr<mj_plugin> combiner_plugin;
+        std::vector<std::unique_ptr<mj_executor>> idle_combiners;
+        // The bytes of Maple output from each file to keep in memory before spilling it to disk, or 0 for no limit
+        uint64_t memory_budget;
 
         // Condition variable and indicator for when the job completes (successfully or unsuccessfully)
         mutable std::condition_variable_any cv_done;
@@ -55,10 +70,13 @@ private:
     using job_state_map = std::unordered_map<int, locked<job_state>>;
     locked<job_state_map> job_states_lock;
 
-    // Runs continuously waiting for commands from the master
-    void server_thread_function();
+    // Starts the server which waits for commands from the master
+    void start_server();
+    // Handles a single command received from the master
+    void handle_message(int client, std::string const& msg_str);
     // Runs a Linux command and feeds the results line by line to the callback
-    auto run_command(std::string const& command, std::function<bool(std::string const&)> const& callback) const -> bool;
+    // The lines passed to the callback are only valid until it returns
+    auto run_command(std::string const& command, std::function<bool(std::string_view)> const& callback) const -> bool;
     // Starts a new job, filling in its job_state struct and starting work on the initial set of files
     void start_job(unlocked<job_state_map> &&job_states, int job_id, mj_assign_job const& data);
     // Monitors the progress of a job, informing the master on failure and ending the job when master says it's over
@@ -68,21 +86,30 @@ private:
     // Adds the provided files to the queue of files to be processed for the specified job
     void add_files_to_job(int job_id, std::vector<std::string> const& files);
     // Processes a specified file, sending the results into the specified processor, and appending its output into the SDFS
+    // The file is passed to the plugin if there is one or to a persistent executor if the job uses them, and
+    // otherwise the exe is run on it
     void process_file(int job_id, std::string const& filename, std::string const& sdfs_src_dir,
-        std::string const& sdfs_output_dir, processor::type processor_type, int num_appends_parallel);
+        std::string const& sdfs_output_dir, processor::type processor_type, int num_appends_parallel,
+        std::shared_ptr<mj_plugin> const& plugin, bool persistent_exe, bool has_combiner,
+        std::shared_ptr<mj_plugin> const& combiner_plugin, uint64_t memory_budget);
+    // Passes one of the job's idle persistent executors (or combiners) to run, starting a new one if there are none
+    auto run_executor(int job_id, bool combiner, std::function<bool(mj_executor*)> const& run) -> bool;
+    // Runs the combiner on the values of each key in proc, sending the combined values into combined
+    auto combine(int job_id, processor *proc, processor *combined, std::shared_ptr<mj_plugin> const& combiner_plugin) -> bool;
     // Appends the output accumulated in the provided processor to files in the SDFS
     void append_output(int job_id, processor *proc, std::string const& input_file,
         std::string const& sdfs_output_dir, int num_appends_parallel);
     // Appends the lines from a single input file to the specified output file after getting permission from the master node
-    // Returns either a lambda that will perform the appends or nothing if the master denied permission
-    std::optional<std::function<void()>> append_lines(int job_id, tcp_client *client, std::string const& input_file,
+    // Returns either a task that will perform the appends or nothing if the master denied permission
+    std::optional<task> append_lines(int job_id, tcp_client *client, std::string const& input_file,
         std::string const& output_file_path, std::vector<std::string> const& vals, std::atomic<bool> *master_down);
 
     // Services that this service depends on
     std::unique_ptr<logger> lg;
+    std::unique_ptr<tracer> tr;
     configuration *config;
     tcp_factory *fac;
-    std::unique_ptr<tcp_server> server;
+    std::unique_ptr<tcp_event_server> server;
     heartbeater *hb;
     election *el;
     mj_master *mm;
@@ -93,4 +120,7 @@ private:
 
     std::atomic<bool> running;
     locked<std::mt19937> mt;
+
+    // The number of threads that handle commands received from the master
+    const unsigned num_server_threads = 4;
 };
\ No newline at end of file
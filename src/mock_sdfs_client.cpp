@@ -5,6 +5,8 @@
 #include <fstream>
 #include <algorithm>
 #include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
 
 using std::string;
 using std::unique_ptr;
@@ -161,7 +163,7 @@ void mock_sdfs_client::mark_transaction_completed(uint64_t timestamp) {
     if (tx_timestamps->set.find(0) != tx_timestamps->set.end()) {
         assert(false);
     }
-    return;
+    tx_completed_cv.notify_all();
 }
 
 auto mock_sdfs_client::get_earliest_transaction() const -> uint32_t {
@@ -175,13 +177,13 @@ auto mock_sdfs_client::get_earliest_transaction() const -> uint32_t {
 
 void mock_sdfs_client::wait_transactions() const {
     uint32_t cur_time = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-    while (true) {
+
+    // Woken up by each transaction that completes, so that we return as soon as the last one we wait on is done
+    unlocked<transaction_timestamps> tx_timestamps = tx_timestamps_lock();
+    tx_completed_cv.wait(tx_timestamps.unsafe_get_mutex(), [&] {
         uint32_t earliest_transaction = get_earliest_transaction();
-        if (earliest_transaction > cur_time || earliest_transaction == 0) {
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    }
+        return earliest_transaction > cur_time || earliest_transaction == 0;
+    });
 }
 
 auto mock_sdfs_client::write(string const& local_filename, string const& sdfs_path, sdfs_metadata const& metadata, bool is_append) -> int {
@@ -277,18 +279,24 @@ auto mock_sdfs_client::get(string const& local_filename, string const& sdfs_path
 
     string sdfs_root_dir = get_sdfs_root_dir();
     return access_helper(sdfs_path, [&] (unlocked<file_state> &f_state, master_callback_type const& master_callback) {
-        std::ofstream dest(local_filename, std::ios::binary);
-        if (!dest) {
+        // The file may be an executable that is about to be run, so it is opened with O_CLOEXEC to keep children
+        // forked by other threads from inheriting a writable descriptor to it, which would make exec fail with ETXTBSY
+        int dest = open(local_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (dest < 0) {
             mark_transaction_completed(timestamp);
             return false;
         }
-        for (unsigned i = 0; i < f_state->num_pieces; i++) {
+        bool good = true;
+        for (unsigned i = 0; i < f_state->num_pieces && good; i++) {
             std::ifstream src(sdfs_root_dir + sdfs::convert_path(sdfs_path).path + "." + std::to_string(i), std::ios::binary);
-            dest << src.rdbuf();
+            char buf[4096];
+            while (good && src.read(buf, sizeof(buf)).gcount() > 0) {
+                good = (::write(dest, buf, src.gcount()) == src.gcount());
+            }
         }
-        dest.close();
+        close(dest);
 
-        if (!dest.good()) {
+        if (!good) {
             mark_transaction_completed(timestamp);
             return false;
         }
@@ -5,6 +5,7 @@
 #include <chrono>
 #include <cstring>
 #include <iostream>
+#include <unistd.h>
 
 using std::string;
 using std::unique_ptr;
@@ -24,6 +25,12 @@ auto mock_tcp_factory::get_tcp_server(int port) -> unique_ptr<tcp_server> {
     return unique_ptr<tcp_server>(static_cast<tcp_server*>(retval));
 }
 
+auto mock_tcp_factory::get_tcp_event_server(int port, unsigned num_handlers) -> unique_ptr<tcp_event_server> {
+    unique_ptr<mock_tcp_server> server = make_unique<mock_tcp_server>(get_mock_udp_factory(), config->get_hostname());
+    server->setup_server(port);
+    return unique_ptr<tcp_event_server>(new mock_tcp_event_server(std::move(server)));
+}
+
 auto mock_tcp_factory::get_mock_udp_factory() -> mock_udp_factory* {
     // Create mock_udp_env if it has not yet been created
     unlocked<environment> mock_udp_env = mock_udp_env_lock();
@@ -111,6 +118,11 @@ void mock_tcp_factory::mock_tcp_server::setup_server(int port_) {
 }
 
 void mock_tcp_factory::mock_tcp_server::stop_server() {
+    // The server may have already been stopped by a wrapping mock_tcp_event_server
+    if (!running.load()) {
+        return;
+    }
+
     assert(serv_state_lock()->client_hostnames.size() == 0 && "Not all connections closed before stopping server");
 
     running = false;
@@ -234,6 +246,75 @@ auto mock_tcp_factory::mock_tcp_server::write_to_client(int client_fd, string co
     return data.size();
 }
 
+auto mock_tcp_factory::mock_tcp_server::write_file_to_client(int client_fd, int fd, size_t size) -> ssize_t {
+    return write_file([&] (string const& data) {return write_to_client(client_fd, data);}, fd, size);
+}
+
+auto mock_tcp_factory::mock_tcp_server::read_file_from_client(int client_fd, int fd) -> ssize_t {
+    return read_file([&] {return read_from_client(client_fd);}, fd);
+}
+
+void mock_tcp_factory::mock_tcp_event_server::start(message_handler const& handler_) {
+    if (running.load()) {
+        return;
+    }
+
+    handler = handler_;
+    running = true;
+
+    accept_thread = std::thread([this] {
+        while (running.load()) {
+            int client = server->accept_connection();
+            if (client < 0) {
+                continue;
+            }
+
+            clients_lock()->insert(client);
+            client_threads_lock()->push_back(std::thread([this, client] {
+                // read_from_client returns an empty string once the connection is closed by either side
+                for (string msg; (msg = server->read_from_client(client)) != "";) {
+                    handler(client, msg);
+                }
+                clients_lock()->erase(client);
+            }));
+        }
+    });
+}
+
+void mock_tcp_factory::mock_tcp_event_server::stop() {
+    if (!running.load()) {
+        return;
+    }
+    running = false;
+
+    // Close all remaining connections, since the mock TCP server requires that before stopping
+    std::vector<int> clients;
+    {
+        unlocked<std::unordered_set<int>> clients_set = clients_lock();
+        clients.insert(clients.end(), clients_set->begin(), clients_set->end());
+    }
+    for (int client : clients) {
+        server->close_connection(client);
+    }
+
+    server->stop_server();
+    accept_thread.join();
+
+    unlocked<std::vector<std::thread>> client_threads = client_threads_lock();
+    for (std::thread &t : *client_threads) {
+        t.join();
+    }
+    client_threads->clear();
+}
+
+void mock_tcp_factory::mock_tcp_event_server::close_connection(int client) {
+    server->close_connection(client);
+}
+
+auto mock_tcp_factory::mock_tcp_event_server::write_to_client(int client, string const& data) -> ssize_t {
+    return server->write_to_client(client, data);
+}
+
 auto mock_tcp_factory::mock_tcp_client::setup_connection(string const& host, int port) -> int {
     uint32_t server_id;
 
@@ -382,6 +463,14 @@ auto mock_tcp_factory::mock_tcp_client::write_to_server(string const& data) -> s
     return data.size();
 }
 
+auto mock_tcp_factory::mock_tcp_client::write_file_to_server(int fd, size_t size) -> ssize_t {
+    return write_file([&] (string const& data) {return write_to_server(data);}, fd, size);
+}
+
+auto mock_tcp_factory::mock_tcp_client::read_file_from_server(int fd) -> ssize_t {
+    return read_file([&] {return read_from_server();}, fd);
+}
+
 void mock_tcp_factory::mock_tcp_client::close_connection() {
     unlocked<client_state> cl_state = cl_state_lock();
 
@@ -447,3 +536,42 @@ void mock_tcp_factory::mock_tcp_client::delete_connection(int socket) {
 }
 
 register_test_service<tcp_factory, mock_tcp_factory> register_mock_tcp_factory;
+
+auto mock_tcp_factory::write_file(std::function<ssize_t(string const&)> const& write, int fd, size_t size) -> ssize_t {
+    string contents(size, '\0');
+    if (pread(fd, &contents[0], size, 0) != static_cast<ssize_t>(size)) {
+        return -1;
+    }
+
+    if (write(std::to_string(size)) <= 0) {
+        return -1;
+    }
+
+    // The contents are skipped for empty files, since an empty message would look like a disconnect
+    if (size > 0 && write(contents) <= 0) {
+        return -1;
+    }
+    return size;
+}
+
+auto mock_tcp_factory::read_file(std::function<string()> const& read, int fd) -> ssize_t {
+    string size_str = read();
+    if (size_str == "") {
+        return -1;
+    }
+
+    size_t size = std::stoul(size_str);
+    if (size == 0) {
+        return 0;
+    }
+
+    string contents = read();
+    if (contents.length() != size) {
+        return -1;
+    }
+
+    if (pwrite(fd, contents.c_str(), size, 0) != static_cast<ssize_t>(size)) {
+        return -1;
+    }
+    return size;
+}
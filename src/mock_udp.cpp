@@ -79,20 +79,8 @@ void mock_udp_factory::mock_udp_coordinator::notify_waiting(host const& h, notif
 // Reads a packet (non-blocking) after notify_waiting was called and flag was set to true
 auto mock_udp_factory::mock_udp_coordinator::recv(host const& h, char *buf, unsigned length) -> int {
     string msg;
-    {
-        unlocked<coordinator_state> coord_state = coord_state_lock();
-
-        if (coord_state->msg_queues.find(h) == coord_state->msg_queues.end()) {
-            return 0;
-        }
-
-        auto &messages = coord_state->msg_queues[h];
-        if (messages.size() == 0) {
-            return 0;
-        }
-
-        msg = std::move(messages.front());
-        messages.pop();
+    if (!try_recv(h, msg)) {
+        return 0;
     }
 
     unsigned i;
@@ -103,6 +91,24 @@ auto mock_udp_factory::mock_udp_coordinator::recv(host const& h, char *buf, unsi
     return static_cast<int>(i);
 }
 
+// Moves the next packet for h into msg without blocking, returning false if there is none
+auto mock_udp_factory::mock_udp_coordinator::try_recv(host const& h, string &msg) -> bool {
+    unlocked<coordinator_state> coord_state = coord_state_lock();
+
+    if (coord_state->msg_queues.find(h) == coord_state->msg_queues.end()) {
+        return false;
+    }
+
+    auto &messages = coord_state->msg_queues[h];
+    if (messages.size() == 0) {
+        return false;
+    }
+
+    msg = std::move(messages.front());
+    messages.pop();
+    return true;
+}
+
 // Sends a packet to the specified destination
 void mock_udp_factory::mock_udp_coordinator::send(host const& dest, char const* msg_buf, unsigned length) {
     assert(msg_buf != nullptr);
@@ -168,6 +174,13 @@ void mock_udp_factory::mock_udp_client::send(string const& dest, int port, strin
     }
 }
 
+// Sends the same UDP packet to each of the destinations
+void mock_udp_factory::mock_udp_client::send_all(std::vector<string> const& hosts, int port, string const& msg) {
+    for (string const& dest : hosts) {
+        send(dest, port, msg);
+    }
+}
+
 // Starts the server on the machine with the given hostname on the given port
 void mock_udp_factory::mock_udp_server::start_server(int port) {
     {
@@ -187,8 +200,8 @@ void mock_udp_factory::mock_udp_server::stop_server() {
     cv_msg.notify_one();
 }
 
-// Wrapper function around recv that handles errors
-auto mock_udp_factory::mock_udp_server::recv(char *buf, unsigned length) -> int {
+// Waits until there is a packet for this server or the server is stopped
+auto mock_udp_factory::mock_udp_server::wait_for_packet() -> int {
     bool flag = false;
 
     // Notify the coordinator that we are waiting for a message
@@ -196,18 +209,40 @@ auto mock_udp_factory::mock_udp_server::recv(char *buf, unsigned length) -> int
     coordinator->notify_waiting(host(hostname, port), notify_state(serv_state_lock.unsafe_get_mutex(), cv_msg, flag));
 
     // Wait for a message to arrive or for the server to stop
-    {
-        unlocked<server_state> serv_state = serv_state_lock();
-        cv_msg.wait(serv_state.unsafe_get_mutex(), [&] {
-            return serv_state->port == 0 || flag;
-        });
+    unlocked<server_state> serv_state = serv_state_lock();
+    cv_msg.wait(serv_state.unsafe_get_mutex(), [&] {
+        return serv_state->port == 0 || flag;
+    });
 
-        if (serv_state->port == 0) {
-            return 0;
-        }
+    return serv_state->port == 0 ? 0 : port;
+}
+
+// Wrapper function around recv that handles errors
+auto mock_udp_factory::mock_udp_server::recv(char *buf, unsigned length) -> int {
+    int port = wait_for_packet();
+    if (port == 0) {
+        return 0;
     }
 
     return coordinator->recv(host(hostname, port), buf, length);
 }
 
+// Waits for a packet, then receives it along with any others already queued
+auto mock_udp_factory::mock_udp_server::recv_batch(std::vector<std::string_view> &packets) -> int {
+    packets.clear();
+
+    int port = wait_for_packet();
+    if (port == 0) {
+        return 0;
+    }
+
+    batch.resize(max_batch_size);
+    unsigned n = 0;
+    while (n < max_batch_size && coordinator->try_recv(host(hostname, port), batch[n])) {
+        packets.push_back(batch[n]);
+        n++;
+    }
+    return static_cast<int>(n);
+}
+
 register_test_service<udp_factory, mock_udp_factory> register_mock_udp_factory;
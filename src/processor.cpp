@@ -1,43 +1,216 @@
 #include "processor.h"
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
+#include <stdlib.h>
+#include <unistd.h>
 
 using std::string;
 
-auto processor_factory::get_processor(processor::type type) -> std::unique_ptr<processor> {
+namespace {
+// Rough costs of a key and of a value in kv_pairs beyond their characters, for estimating its memory use
+const uint64_t key_overhead = 64;
+const uint64_t value_overhead = sizeof(string);
+const size_t run_buffer_size = 64 * 1024;
+}
+
+auto processor_factory::get_processor(processor::type type, uint64_t memory_budget, string const& spill_dir)
+    -> std::unique_ptr<processor>
+{
     switch (type) {
-        case processor::type::maple: return std::make_unique<maple_processor>();
+        case processor::type::maple: return std::make_unique<maple_processor>(memory_budget, spill_dir);
         case processor::type::juice: return std::make_unique<juice_processor>();
         default: assert(false); return nullptr;
     }
 }
 
-maple_processor::maple_processor()
+// Reads a run written by spill, which holds each key in sorted order as:
+//   uint32 key length | key | uint32 # values | each value as a uint32 length and its characters
+class maple_processor::run_reader {
+public:
+    run_reader(string const& path) : stream(fopen(path.c_str(), "r")) {
+        if (stream) {
+            setvbuf(stream, nullptr, _IOFBF, run_buffer_size);
+        }
+    }
+
+    ~run_reader() {
+        if (stream) {
+            fclose(stream);
+        }
+    }
+
+    // Reads the next key and its values, returning false at the end of the run
+    auto advance() -> bool {
+        uint32_t num_values;
+        if (!stream || !read_string(key) || fread(&num_values, sizeof(num_values), 1, stream) != 1) {
+            return false;
+        }
+        values.resize(num_values);
+        for (string &value : values) {
+            if (!read_string(value)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    string key;
+    std::vector<string> values;
+
+private:
+    auto read_string(string &str) -> bool {
+        uint32_t len;
+        if (fread(&len, sizeof(len), 1, stream) != 1) {
+            return false;
+        }
+        str.resize(len);
+        return fread(str.data(), 1, len, stream) == len;
+    }
+
+    FILE *stream;
+};
+
+maple_processor::maple_processor(uint64_t memory_budget_, string const& spill_dir_)
     : inputter([this] () -> std::optional<std::pair<std::string, std::vector<std::string>>> {
+        if (!run_paths.empty()) {
+            return next_merged();
+        }
+
         if (kv_pairs.size() == 0) {
             return std::nullopt;
         } else {
             auto it = kv_pairs.begin();
-            auto retval = *it;
+            std::pair<std::string, std::vector<std::string>> retval(it->first, std::move(it->second));
             kv_pairs.erase(it);
             return retval;
         }
-    }) {}
+    }), memory_budget(memory_budget_), spill_dir(spill_dir_) {}
+
+maple_processor::~maple_processor() {
+    remove_runs();
+}
 
-auto maple_processor::process_line(string const& line) -> bool {
+auto maple_processor::process_line(std::string_view line) -> bool {
     // The input has the format "<key> <value>", where <key> doesn't contain spaces and <value> doesn't contain \n
-    size_t space_index = line.find(" ");
-    if (space_index == string::npos) {
+    size_t space_index = line.find(' ');
+    if (space_index == std::string_view::npos) {
         return false;
     }
-    string key = line.substr(0, space_index);
-    string value = line.substr(space_index + 1);
-    kv_pairs[key].push_back(value);
+    process_pair(line.substr(0, space_index), line.substr(space_index + 1));
     return true;
 }
 
+void maple_processor::process_pair(std::string_view key, std::string_view value) {
+    auto [it, inserted] = kv_pairs.try_emplace(string(key));
+    if (inserted) {
+        buffered_bytes += key.size() + key_overhead;
+    }
+    it->second.emplace_back(value);
+    buffered_bytes += value.size() + value_overhead;
+
+    if (memory_budget > 0 && buffered_bytes > memory_budget) {
+        spill();
+    }
+}
+
 void maple_processor::reset() {
     kv_pairs.clear();
+    buffered_bytes = 0;
+    remove_runs();
+}
+
+auto maple_processor::num_spilled_runs() const -> unsigned {
+    return run_paths.size();
+}
+
+void maple_processor::spill() {
+    string path = spill_dir + "spill_XXXXXX";
+    int fd = mkstemp(path.data());
+    assert(fd >= 0 && "Failed to create a file to spill Maple output to");
+    FILE *stream = fdopen(fd, "w");
+    setvbuf(stream, nullptr, _IOFBF, run_buffer_size);
+
+    std::vector<std::unordered_map<string, std::vector<string>>::iterator> sorted;
+    sorted.reserve(kv_pairs.size());
+    for (auto it = kv_pairs.begin(); it != kv_pairs.end(); ++it) {
+        sorted.push_back(it);
+    }
+    std::sort(sorted.begin(), sorted.end(), [] (auto const& a, auto const& b) {
+        return a->first < b->first;
+    });
+
+    auto write_string = [&] (string const& str) {
+        uint32_t len = str.size();
+        fwrite(&len, sizeof(len), 1, stream);
+        fwrite(str.data(), 1, len, stream);
+    };
+    for (auto const& it : sorted) {
+        write_string(it->first);
+        uint32_t num_values = it->second.size();
+        fwrite(&num_values, sizeof(num_values), 1, stream);
+        for (string const& value : it->second) {
+            write_string(value);
+        }
+    }
+
+    bool written = !ferror(stream);
+    written = (fclose(stream) == 0) && written;
+    assert(written && "Failed to spill Maple output to disk");
+
+    run_paths.push_back(path);
+    kv_pairs.clear();
+    buffered_bytes = 0;
+}
+
+auto maple_processor::next_merged() -> std::optional<std::pair<std::string, std::vector<std::string>>> {
+    auto greater_key = [] (std::unique_ptr<run_reader> const& a, std::unique_ptr<run_reader> const& b) {
+        return a->key > b->key;
+    };
+
+    // Move what is left in memory into a run as well so that every key is merged the same way
+    if (!merging) {
+        merging = true;
+        if (!kv_pairs.empty()) {
+            spill();
+        }
+        for (string const& path : run_paths) {
+            std::unique_ptr<run_reader> reader = std::make_unique<run_reader>(path);
+            if (reader->advance()) {
+                readers.push_back(std::move(reader));
+            }
+        }
+        std::make_heap(readers.begin(), readers.end(), greater_key);
+    }
+
+    if (readers.empty()) {
+        return std::nullopt;
+    }
+
+    // Take the values of the smallest key from every run that has it
+    std::pair<std::string, std::vector<std::string>> retval(readers.front()->key, {});
+    while (!readers.empty() && readers.front()->key == retval.first) {
+        std::pop_heap(readers.begin(), readers.end(), greater_key);
+        run_reader &reader = *readers.back();
+        std::move(reader.values.begin(), reader.values.end(), std::back_inserter(retval.second));
+
+        if (reader.advance()) {
+            std::push_heap(readers.begin(), readers.end(), greater_key);
+        } else {
+            readers.pop_back();
+        }
+    }
+    return retval;
+}
+
+void maple_processor::remove_runs() {
+    readers.clear();
+    for (string const& path : run_paths) {
+        unlink(path.c_str());
+    }
+    run_paths.clear();
+    merging = false;
 }
 
 juice_processor::juice_processor()
@@ -53,12 +226,19 @@ juice_processor::juice_processor()
         }
     }) {}
 
-auto juice_processor::process_line(string const& line) -> bool {
+auto juice_processor::process_line(std::string_view line) -> bool {
     // We assume the juice executable already emits the format <key> <value>
-    values.push_back(line);
+    values.emplace_back(line);
     return true;
 }
 
+void juice_processor::process_pair(std::string_view key, std::string_view value) {
+    string line;
+    line.reserve(key.size() + 1 + value.size());
+    line.append(key).append(" ").append(value);
+    values.push_back(std::move(line));
+}
+
 void juice_processor::reset() {
     values.clear();
 }
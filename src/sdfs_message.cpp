@@ -1,7 +1,7 @@
 #include "sdfs_message.h"
 #include "serialization.h"
 
-sdfs_message::sdfs_message(char *buf, unsigned length) {
+sdfs_message::sdfs_message(const char *buf, unsigned length) {
     // do deserialization here
     deserializer des(buf, length);
 
@@ -55,14 +55,18 @@ sdfs_message::sdfs_message(char *buf, unsigned length) {
 }
 
 auto sdfs_message::serialize() const -> std::string {
-    // do some serialization here
+    std::string buf;
+    serialize(buf);
+    return buf;
+}
+
+void sdfs_message::serialize(std::string &buf) const {
     if (type == msg_type::empty) {
-        return "";
+        return;
     }
 
-    serializer ser;
+    serializer ser(buf);
 
-    ser.add_field(static_cast<uint32_t>(type));
     switch (type) {
         case msg_type::put:
         case msg_type::get:
@@ -70,39 +74,35 @@ auto sdfs_message::serialize() const -> std::string {
         case msg_type::del:
         case msg_type::ls:
         case msg_type::gidx:
-            ser.add_field(sdfs_filename);
+            ser.add_fields(type, sdfs_filename);
             break;
         case msg_type::mn_put:
         case msg_type::mn_get:
         case msg_type::mn_gmd:
-            ser.add_field(sdfs_hostname);
+            ser.add_fields(type, sdfs_hostname);
             break;
         case msg_type::mn_ls:
-            ser.add_field(data);
+            ser.add_fields(type, data);
             break;
         case msg_type::files:
-            ser.add_field(sdfs_hostname);
-            ser.add_field(data);
+            ser.add_fields(type, sdfs_hostname, data);
             break;
         case msg_type::ack:
         case msg_type::fail:
         case msg_type::success:
+            ser.add_fields(type);
             break;
         case msg_type::rep:
         case msg_type::mn_append:
-            ser.add_field(sdfs_hostname);
-            ser.add_field(sdfs_filename);
+            ser.add_fields(type, sdfs_hostname, sdfs_filename);
             break;
         case msg_type::append:
         case msg_type::mn_gidx:
-            ser.add_field(sdfs_filename);
-            ser.add_field(data);
+            ser.add_fields(type, sdfs_filename, data);
             break;
         default:
             assert(false && "Memory corruption caused msg_type to be invalid");
     }
-
-    return ser.serialize();
 }
 
 auto sdfs_message::get_type_as_string() const -> std::string {
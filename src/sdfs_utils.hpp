@@ -3,6 +3,7 @@
 #include "sdfs_message.h"
 
 #include <cstring>
+#include <functional>
 
 // Defining the return value for failed operations
 #define SDFS_FAILURE -1
@@ -23,6 +24,11 @@ public:
 
     static auto write_first_line_to_socket(tcp_server *server, int socket, std::string const& filename) -> ssize_t;
 private:
+    // Locks the file and passes it to send_file along with its size, returning the result
+    static auto write_file(std::string const& filename, std::function<ssize_t(int, size_t)> const& send_file) -> ssize_t;
+    // Locks the file and passes it to receive_file, then truncates it to the size returned
+    static auto read_file(std::string const& filename, std::function<ssize_t(int)> const& receive_file) -> ssize_t;
+
     static auto acquire_lock(int fd, int operation) -> int;
     static auto release_lock(int fd) -> int;
 };
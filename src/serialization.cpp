@@ -1,54 +1,14 @@
 #include "serialization.h"
 
-#include <cstring>
-#include <cassert>
-#include <iostream>
-
-using std::unique_ptr;
-using std::make_unique;
-
-void serializer::add_field(field const& f) {
-    fields.push_back(f);
+void serializer::add_field(uint32_t n) {
+    char int_buf[sizeof(uint32_t)];
+    write_uint32_to_char_buf(n, int_buf);
+    buf.append(int_buf, sizeof(uint32_t));
 }
 
-auto serializer::serialize() const -> std::string {
-    // First, compute the length
-    unsigned length = 0;
-    for (field f : fields) {
-        if (std::holds_alternative<uint32_t>(f)) {
-            length += sizeof(uint32_t);
-        }
-
-        if (std::holds_alternative<std::string>(f)) {
-            length += sizeof(uint32_t) + std::get<std::string>(f).size();
-        }
-    }
-
-    // Create the buffer to contain the serialized data
-    unique_ptr<char[]> buf = make_unique<char[]>(length);
-
-    // Loop through all the fields and insert them into the buffer
-    unsigned pos = 0;
-    for (field f : fields) {
-        if (std::holds_alternative<uint32_t>(f)) {
-            write_uint32_to_char_buf(std::get<uint32_t>(f), buf.get() + pos);
-            pos += sizeof(uint32_t);
-        }
-
-        if (std::holds_alternative<std::string>(f)) {
-            std::string str = std::get<std::string>(f);
-
-            write_uint32_to_char_buf(str.size(), buf.get() + pos);
-            pos += sizeof(uint32_t);
-
-            std::memcpy(buf.get() + pos, str.c_str(), str.size());
-            pos += str.size();
-        }
-    }
-
-    assert(pos == length && "Position does not match length of buffer and memory corruption may have occurred!");
-
-    return std::string(buf.get(), length);
+void serializer::add_field(std::string_view str) {
+    add_field(static_cast<uint32_t>(str.size()));
+    buf.append(str.data(), str.size());
 }
 
 void serializer::write_uint32_to_char_buf(uint32_t n, char *buf) {
@@ -69,7 +29,7 @@ auto deserializer::get_int() -> uint32_t {
     return val;
 }
 
-auto deserializer::get_string() -> std::string {
+auto deserializer::get_string() -> std::string_view {
     if (length - pos < sizeof(uint32_t)) {
         throw "Could not extract string from buffer";
     }
@@ -86,11 +46,10 @@ auto deserializer::get_string() -> std::string {
         throw "Could not extract string from buffer";
     }
 
-    unique_ptr<char[]> str_buf = make_unique<char[]>(size);
-    std::memcpy(str_buf.get(), buf + pos, size);
+    std::string_view str(buf + pos, size);
     pos += size;
 
-    return std::string(str_buf.get(), size);
+    return str;
 }
 
 void deserializer::done() {
@@ -12,6 +12,8 @@ using std::optional;
 shared_configuration_impl::shared_configuration_impl(environment &env)
     : sdfsc(env.get<sdfs_client>())
     , config(env.get<configuration>())
+    , tw(env.get<timer_wheel>())
+    , tp_fac(env.get<threadpool_factory>())
     , lg(env.get<logger_factory>()->get_logger("shared_configuration")) {}
 
 void shared_configuration_impl::start() {
@@ -20,42 +22,57 @@ void shared_configuration_impl::start() {
     }
 
     running = true;
-    completed = false;
 
     sdfsc->start();
     // TODO: verify that the failure of the mkdir is due to the directory already existing, otherwise, retry
     sdfsc->mkdir(CONFIG_DIR);
 
+    poll_state_lock()->poll_pool = tp_fac->get_threadpool(1);
+
     // TODO: switch from a polling implementation to a non-polling implementation
-    std::thread watch_thread([this] {
-        while (running.load()) {
-            {
-                unlocked<callback_map> cb_map = cb_map_lock();
-                for (auto const& [key, callbacks] : *cb_map) {
-                    optional<string> value_opt = get_value(key);
-
-                    if (!value_opt) continue;
-                    if (cached_values[key] == value_opt.value()) continue;
-
-                    string &value = value_opt.value();
-                    for (auto const& callback : callbacks) {
-                        callback(value);
-                    }
-                    cached_values[key] = std::move(value);
-                }
-            }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    // Reading the values goes through SDFS and may take a while, so it is handed off to the pool rather than run
+    // on the timer thread, and a poll is skipped if the last one has not yet finished
+    poll_timer = tw->schedule_repeating(500, [this] {
+        unlocked<poll_state> p_state = poll_state_lock();
+        if (!p_state->poll_pool || p_state->polling) {
+            return;
         }
-        completed = true;
+        p_state->polling = true;
+
+        p_state->poll_pool->enqueue([this] {
+            poll_values();
+            poll_state_lock()->polling = false;
+        });
     });
-    watch_thread.detach();
 }
 
 void shared_configuration_impl::stop() {
+    if (!running.load()) {
+        return;
+    }
+
     running = false;
-    while (!completed.load()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    tw->cancel(poll_timer);
+
+    // Once the pool is taken out of the state, the timer cannot enqueue anything more onto it
+    std::unique_ptr<threadpool> poll_pool = std::move(poll_state_lock()->poll_pool);
+    poll_pool->finish();
+}
+
+// Calls the callbacks for every watched value that has changed since the last poll
+void shared_configuration_impl::poll_values() {
+    unlocked<callback_map> cb_map = cb_map_lock();
+    for (auto const& [key, callbacks] : *cb_map) {
+        optional<string> value_opt = get_value(key);
+
+        if (!value_opt) continue;
+        if (cached_values[key] == value_opt.value()) continue;
+
+        string &value = value_opt.value();
+        for (auto const& callback : callbacks) {
+            callback(value);
+        }
+        cached_values[key] = std::move(value);
     }
 }
 
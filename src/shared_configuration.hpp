@@ -8,6 +8,8 @@
 #include "logging.h"
 #include "locking.h"
 #include "configuration.h"
+#include "timer_wheel.h"
+#include "threadpool.h"
 
 #include <string>
 #include <optional>
@@ -25,7 +27,17 @@ public:
     void watch_value(std::string const& key, std::function<void(std::string const&)> const& callback);
 
 private:
-    std::atomic<bool> running, completed;
+    void poll_values();
+
+    std::atomic<bool> running{false};
+    timer_id poll_timer = 0;
+
+    struct poll_state {
+        // Only exists while we are running
+        std::unique_ptr<threadpool> poll_pool;
+        bool polling = false;
+    };
+    locked<poll_state> poll_state_lock;
 
     using callback_map = std::unordered_map<std::string, std::vector<std::function<void(std::string const&)>>>;
     locked<callback_map> cb_map_lock;
@@ -34,5 +46,7 @@ private:
 
     sdfs_client *sdfsc;
     configuration *config;
+    timer_wheel *tw;
+    threadpool_factory *tp_fac;
     std::unique_ptr<logger> lg;
 };
\ No newline at end of file
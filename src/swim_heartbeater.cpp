@@ -0,0 +1,569 @@
+#include "swim_heartbeater.hpp"
+#include "logging.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <thread>
+
+using namespace std::chrono;
+using std::string;
+
+namespace {
+    auto now_ms() -> uint64_t {
+        return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+    }
+}
+
+swim_heartbeater_impl::swim_heartbeater_impl(environment &env)
+    : our_id(0), joined_group(false),
+      lg(env.get<logger_factory>()->get_logger("swim_heartbeater")),
+      config(env.get<configuration>()),
+      client(env.get<udp_factory>()->get_udp_client()),
+      server(env.get<udp_factory>()->get_udp_server()),
+      swim_state_lock(env), nodes_can_join(true), running(false)
+{
+    swim_state_lock.profile_as("swim_heartbeater::swim_state_lock");
+    rw_unlocked<swim_state> state = swim_state_lock.write();
+    state->mt.seed(std::hash<string>()(config->get_hostname()) ^ now_ms());
+
+    if (config->is_first_node()) {
+        int join_time = now_ms();
+        our_id = std::hash<string>()(config->get_hostname()) ^ std::hash<int>()(join_time);
+
+        state->mem_list.add_member(config->get_hostname(), our_id);
+        state->member_states[our_id] = member_state();
+        joined_group = true;
+    }
+}
+
+// Starts the heartbeater
+void swim_heartbeater_impl::start() {
+    if (running.load()) {
+        return;
+    }
+
+    lg->info("Starting SWIM heartbeater");
+
+    running = true;
+
+    std::thread server_thread([this] {server_thread_function();});
+    server_thread.detach();
+
+    std::thread client_thread([this] {client_thread_function();});
+    client_thread.detach();
+}
+
+// Stops the heartbeater synchronously
+void swim_heartbeater_impl::stop() {
+    if (!running.load()) {
+        return;
+    }
+
+    lg->info("Stopping SWIM heartbeater");
+
+    server->stop_server();
+    running = false;
+
+    // Sleep for enough time for the threads to stop
+    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+}
+
+// Returns the list of members of the group that this node is aware of
+auto swim_heartbeater_impl::get_members() const -> std::vector<member> {
+    return swim_state_lock.read()->mem_list.get_members();
+}
+
+// Gets the member object corresponding to the provided ID
+auto swim_heartbeater_impl::get_member_by_id(uint32_t id) const -> member {
+    return swim_state_lock.read()->mem_list.get_member_by_id(id);
+}
+
+// Returns the next node after this one in the membership list
+auto swim_heartbeater_impl::get_successor() const -> member {
+    return swim_state_lock.read()->mem_list.get_successor(our_id);
+}
+
+// Runs the provided function atomically with any functions that read or write to the membership list
+void swim_heartbeater_impl::run_atomically_with_mem_list(std::function<void()> const& fn) const {
+    auto guard = swim_state_lock.write();
+    fn();
+}
+
+// Initiates an async request to join the group by sending a JOIN to a node in the group
+void swim_heartbeater_impl::join_group(string const& node) {
+    if (config->is_first_node()) {
+        return;
+    }
+
+    lg->info("Requesting node at " + node + " to join group");
+
+    int join_time = now_ms();
+    our_id = std::hash<string>()(config->get_hostname()) ^ std::hash<int>()(join_time);
+
+    swim_message join_req;
+    join_req.type = swim_message::JOIN;
+    join_req.sender_id = our_id;
+    join_req.sender_hostname = config->get_hostname();
+    join_req.seq = 0;
+    join_req.target_id = 0;
+    join_req.relay_for = 0;
+    join_req.updates.push_back(swim_update{swim_update::ALIVE, our_id, 0, config->get_hostname()});
+
+    joined_group = true;
+    for (int i = 0; i < message_redundancy; i++) {
+        send(node, join_req);
+    }
+}
+
+// Gossips that we are leaving the group
+void swim_heartbeater_impl::leave_group() {
+    lg->info("Leaving the group");
+
+    rw_unlocked<swim_state> state = swim_state_lock.write();
+    uint32_t incarnation = state->member_states[our_id].incarnation;
+    queue_update(*state, swim_update{swim_update::LEFT, our_id, incarnation, config->get_hostname()});
+
+    // We stop probing once we leave, so tell a few members directly instead of waiting for probes to carry it
+    swim_message msg = make_message(*state, swim_message::PING, 0);
+    for (member const& m : random_members(*state, retransmit_limit(*state), 0)) {
+        send(m.hostname, msg);
+    }
+
+    joined_group = false;
+}
+
+// Runs the probe loop, one protocol period at a time
+void swim_heartbeater_impl::client_thread_function() {
+    while (running.load()) {
+        auto period_end = steady_clock::now() + milliseconds(protocol_period_ms);
+
+        // Only members of the group probe other members
+        if (!joined_group.load()) {
+            std::this_thread::sleep_until(period_end);
+            continue;
+        }
+
+        std::vector<std::function<void()>> handler_calls;
+        uint32_t target = 0;
+        string target_hostname;
+        swim_message ping;
+        {
+            rw_unlocked<swim_state> state = swim_state_lock.write();
+            check_suspects(*state, handler_calls);
+
+            target = next_probe_target(*state);
+            if (target != 0) {
+                target_hostname = state->mem_list.find_member(target)->hostname;
+                ping = make_message(*state, swim_message::PING, target);
+            }
+        }
+
+        if (target != 0) {
+            {
+                std::lock_guard<std::mutex> guard(ack_mutex);
+                ping.seq = ++probe_seq;
+                probe_target = target;
+                probe_acked = false;
+            }
+            send(target_hostname, ping);
+
+            bool acked = wait_for_ack(ping.seq, steady_clock::now() + milliseconds(ping_timeout_ms));
+
+            // Ask other members to probe the target in case the problem is only between us and it
+            if (!acked) {
+                rw_unlocked<swim_state> state = swim_state_lock.write();
+                swim_message ping_req = make_message(*state, swim_message::PING_REQ, 0);
+                ping_req.seq = ping.seq;
+                ping_req.target_id = target;
+                for (member const& m : random_members(*state, num_indirect_probes, target)) {
+                    send(m.hostname, ping_req);
+                }
+            }
+
+            if (!acked && !wait_for_ack(ping.seq, period_end)) {
+                rw_unlocked<swim_state> state = swim_state_lock.write();
+                auto it = state->member_states.find(target);
+                if (it != state->member_states.end() && !it->second.suspect) {
+                    lg->debug("Suspecting node at ", target_hostname, " with id ", target,
+                        " after it did not answer a probe");
+                    apply_update(*state, swim_update{swim_update::SUSPECT, target, it->second.incarnation, target_hostname},
+                        true, handler_calls);
+                }
+            }
+        }
+
+        for (auto const& handler_call : handler_calls) {
+            handler_call();
+        }
+
+        std::this_thread::sleep_until(period_end);
+    }
+}
+
+// Receives and handles messages
+void swim_heartbeater_impl::server_thread_function() {
+    lg->debug("Starting server thread");
+    server->start_server(config->get_hb_port());
+
+    // Packets received in the last batch, which point into buffers owned by the server
+    std::vector<std::string_view> packets;
+
+    while (true) {
+        // If the server is not running, stop everything and exit
+        if (!running.load()) {
+            lg->debug("Exiting server thread");
+            break;
+        }
+
+        // If we are not in the group, do not listen for messages
+        if (!joined_group.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            continue;
+        }
+
+        std::vector<std::function<void()>> handler_calls;
+        if (server->recv_batch(packets) > 0) {
+            rw_unlocked<swim_state> state = swim_state_lock.write();
+            for (std::string_view packet : packets) {
+                process_message(*state, packet, handler_calls);
+            }
+        }
+
+        for (auto const& handler_call : handler_calls) {
+            handler_call();
+        }
+    }
+}
+
+// Handles a single message, queueing any handlers that should be called into handler_calls
+void swim_heartbeater_impl::process_message(swim_state &state, std::string_view packet,
+    std::vector<std::function<void()>> &handler_calls)
+{
+    swim_message msg;
+    if (!msg.parse(packet)) {
+        lg->debug("Received malformed SWIM message!");
+        return;
+    }
+
+    if (msg.type == swim_message::JOIN) {
+        // Only members of the group can introduce new members
+        if (!state.mem_list.has_member(our_id)) {
+            return;
+        }
+        if (!nodes_can_join.load()) {
+            lg->debug("Nodes cannot join because leader election is occurring!");
+            return;
+        }
+
+        lg->info("Received request to join group from (" + msg.sender_hostname + ", " + std::to_string(msg.sender_id) + ")");
+        for (swim_update const& u : msg.updates) {
+            apply_update(state, u, true, handler_calls);
+        }
+
+        // The joining member learns the whole group at once, while everyone else learns of it through gossip
+        swim_message intro = make_message(state, swim_message::INTRO, msg.sender_id);
+        for (member const& m : state.mem_list.get_members()) {
+            intro.updates.push_back(
+                swim_update{swim_update::ALIVE, m.id, state.member_states[m.id].incarnation, m.hostname});
+        }
+        send(msg.sender_hostname, intro);
+        return;
+    }
+
+    // The introduction is already known to everyone else, so it is not gossiped any further
+    for (swim_update const& u : msg.updates) {
+        apply_update(state, u, msg.type != swim_message::INTRO, handler_calls);
+    }
+
+    // Hearing from a member proves it is alive, which catches us up on joins whose gossip never reached us
+    if (state.mem_list.has_member(our_id) && !state.mem_list.has_member(msg.sender_id)) {
+        apply_update(state, swim_update{swim_update::ALIVE, msg.sender_id, 0, msg.sender_hostname}, false, handler_calls);
+    }
+
+    switch (msg.type) {
+        case swim_message::PING: {
+            swim_message ack = make_message(state, swim_message::ACK, msg.sender_id);
+            ack.seq = msg.seq;
+            ack.target_id = our_id;
+            ack.relay_for = msg.relay_for;
+            send(msg.sender_hostname, ack);
+            break;
+        }
+        case swim_message::ACK: {
+            // Relay the ACK back to the member that asked us to probe for it
+            if (msg.relay_for != 0 && msg.relay_for != our_id) {
+                member const* requester = state.mem_list.find_member(msg.relay_for);
+                if (requester != nullptr) {
+                    swim_message relayed = make_message(state, swim_message::ACK, msg.relay_for);
+                    relayed.seq = msg.seq;
+                    relayed.target_id = msg.target_id;
+                    send(requester->hostname, relayed);
+                }
+                break;
+            }
+
+            std::lock_guard<std::mutex> guard(ack_mutex);
+            if (msg.seq == probe_seq && msg.target_id == probe_target) {
+                probe_acked = true;
+                ack_cv.notify_all();
+            }
+            break;
+        }
+        case swim_message::PING_REQ: {
+            member const* target = state.mem_list.find_member(msg.target_id);
+            if (target != nullptr) {
+                swim_message ping = make_message(state, swim_message::PING, msg.target_id);
+                ping.seq = msg.seq;
+                ping.relay_for = msg.sender_id;
+                send(target->hostname, ping);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+// Applies an update to the state if it is newer than what we know, and if gossip is true, queues it to be
+// piggybacked onto our messages
+void swim_heartbeater_impl::apply_update(swim_state &state, swim_update const& u, bool gossip,
+    std::vector<std::function<void()>> &handler_calls)
+{
+    auto it = state.member_states.find(u.id);
+    bool known = (it != state.member_states.end());
+    bool changed = false;
+
+    switch (u.type) {
+        case swim_update::ALIVE: {
+            if (state.dead_ids.find(u.id) != state.dead_ids.end()) {
+                return;
+            }
+
+            if (!known) {
+                // This is how we join the group as well, when the introduction that lists us arrives
+                state.mem_list.add_member(u.hostname, u.id);
+                state.member_states[u.id].incarnation = u.incarnation;
+                if (u.id == our_id) {
+                    lg->info("Successfully joined group");
+                }
+
+                member m = state.mem_list.get_member_by_id(u.id);
+                for (auto const& handler : state.on_join_handlers) {
+                    handler_calls.push_back([=] {handler(m);});
+                }
+                changed = true;
+            } else if (u.id != our_id && u.incarnation > it->second.incarnation) {
+                it->second.incarnation = u.incarnation;
+                it->second.suspect = false;
+                changed = true;
+            }
+            break;
+        }
+        case swim_update::SUSPECT: {
+            if (!known) {
+                return;
+            }
+
+            if (u.id == our_id) {
+                // Refute the suspicion with an incarnation that overrides it
+                if (u.incarnation >= it->second.incarnation) {
+                    it->second.incarnation = u.incarnation + 1;
+                    lg->debug("Refuting suspicion with incarnation ", it->second.incarnation);
+                    queue_update(state,
+                        swim_update{swim_update::ALIVE, our_id, it->second.incarnation, config->get_hostname()});
+                }
+                return;
+            }
+
+            if (u.incarnation > it->second.incarnation || (u.incarnation == it->second.incarnation && !it->second.suspect)) {
+                it->second.incarnation = u.incarnation;
+                if (!it->second.suspect) {
+                    it->second.suspect = true;
+                    it->second.suspect_since = now_ms();
+                }
+                changed = true;
+            }
+            break;
+        }
+        case swim_update::CONFIRM:
+        case swim_update::LEFT: {
+            if (u.id == our_id) {
+                if (u.type == swim_update::CONFIRM && joined_group.load()) {
+                    lg->info("The group has declared us failed");
+                }
+                return;
+            }
+
+            if (!known) {
+                state.dead_ids.insert(u.id);
+                return;
+            }
+
+            lg->info("Node with id " + std::to_string(u.id) + (u.type == swim_update::LEFT ? " left" : " failed"));
+            remove_member(state, u.id,
+                u.type == swim_update::LEFT ? state.on_leave_handlers : state.on_fail_handlers, handler_calls);
+            changed = true;
+            break;
+        }
+    }
+
+    if (changed && gossip) {
+        queue_update(state, u);
+    }
+}
+
+// Removes a failed or departed member, queueing the given handlers to be called for it
+void swim_heartbeater_impl::remove_member(swim_state &state, uint32_t id,
+    std::vector<std::function<void(member const&)>> const& handlers, std::vector<std::function<void()>> &handler_calls)
+{
+    member m = state.mem_list.get_member_by_id(id);
+    state.mem_list.remove_member(id);
+    state.member_states.erase(id);
+    state.dead_ids.insert(id);
+
+    for (auto const& handler : handlers) {
+        handler_calls.push_back([=] {handler(m);});
+    }
+}
+
+// Declares every member whose suspicion timeout has passed failed
+void swim_heartbeater_impl::check_suspects(swim_state &state, std::vector<std::function<void()>> &handler_calls) {
+    uint64_t current_time = now_ms();
+    uint64_t timeout = suspicion_timeout_ms(state);
+
+    std::vector<swim_update> confirms;
+    for (auto const& [id, ms] : state.member_states) {
+        if (ms.suspect && current_time > ms.suspect_since + timeout) {
+            confirms.push_back(swim_update{swim_update::CONFIRM, id, ms.incarnation, ""});
+        }
+    }
+
+    for (swim_update const& u : confirms) {
+        lg->info("Node with id " + std::to_string(u.id) + " timed out!");
+        apply_update(state, u, true, handler_calls);
+    }
+}
+
+// Queues an update to be piggybacked, replacing any older update about the same member
+void swim_heartbeater_impl::queue_update(swim_state &state, swim_update const& u) {
+    for (pending_update &p : state.updates) {
+        if (p.update.id == u.id) {
+            p.update = u;
+            p.transmissions = 0;
+            return;
+        }
+    }
+    state.updates.push_back(pending_update{u, 0});
+}
+
+// Creates a message of the given type from us to recipient (or 0 for any member), with as many pending updates
+// as fit piggybacked onto it
+auto swim_heartbeater_impl::make_message(swim_state &state, swim_message::msg_type type, uint32_t recipient)
+    -> swim_message
+{
+    swim_message msg;
+    msg.type = type;
+    msg.sender_id = our_id;
+    msg.sender_hostname = config->get_hostname();
+    msg.seq = 0;
+    msg.target_id = 0;
+    msg.relay_for = 0;
+
+    // The updates that have been sent the fewest times go first, so that new updates spread quickly
+    std::sort(state.updates.begin(), state.updates.end(), [] (pending_update const& a, pending_update const& b) {
+        return a.transmissions < b.transmissions;
+    });
+    // A suspected member can only refute the suspicion once it hears of it, so it is told first
+    std::stable_partition(state.updates.begin(), state.updates.end(), [=] (pending_update const& p) {
+        return p.update.id == recipient;
+    });
+
+    unsigned limit = retransmit_limit(state);
+    unsigned num_updates = std::min<size_t>(state.updates.size(), max_piggybacked_updates);
+    for (unsigned i = 0; i < num_updates; i++) {
+        msg.updates.push_back(state.updates[i].update);
+        state.updates[i].transmissions++;
+    }
+    state.updates.erase(std::remove_if(state.updates.begin(), state.updates.end(), [=] (pending_update const& p) {
+        return p.transmissions >= limit;
+    }), state.updates.end());
+
+    return msg;
+}
+
+// Serializes and sends a message to the given host
+void swim_heartbeater_impl::send(string const& hostname, swim_message const& msg) {
+    string buf;
+    msg.serialize(buf);
+    client->send(hostname, config->get_hb_port(), buf);
+}
+
+// Waits until the probe with the given seq is acknowledged or the deadline passes, returning whether it was
+auto swim_heartbeater_impl::wait_for_ack(uint32_t seq, steady_clock::time_point deadline) -> bool {
+    std::unique_lock<std::mutex> guard(ack_mutex);
+    return ack_cv.wait_until(guard, deadline, [&] {
+        return probe_seq == seq && probe_acked;
+    });
+}
+
+// Returns the next member to probe, or 0 if there are no other members
+auto swim_heartbeater_impl::next_probe_target(swim_state &state) -> uint32_t {
+    // Members are probed in a random order that visits each of them once, which bounds the time to detect a failure
+    for (int pass = 0; pass < 2; pass++) {
+        while (state.probe_index < state.probe_order.size()) {
+            uint32_t id = state.probe_order[state.probe_index++];
+            if (id != our_id && state.mem_list.has_member(id)) {
+                return id;
+            }
+        }
+
+        state.probe_order.clear();
+        for (member const& m : state.mem_list.get_members()) {
+            state.probe_order.push_back(m.id);
+        }
+        std::shuffle(state.probe_order.begin(), state.probe_order.end(), state.mt);
+        state.probe_index = 0;
+    }
+    return 0;
+}
+
+// Returns up to n random members other than us and excluded
+auto swim_heartbeater_impl::random_members(swim_state &state, unsigned n, uint32_t excluded) -> std::vector<member> {
+    std::vector<member> members = state.mem_list.get_members();
+    members.erase(std::remove_if(members.begin(), members.end(), [&] (member const& m) {
+        return m.id == our_id || m.id == excluded;
+    }), members.end());
+
+    std::shuffle(members.begin(), members.end(), state.mt);
+    if (members.size() > n) {
+        members.resize(n);
+    }
+    return members;
+}
+
+// The number of times each update is piggybacked
+auto swim_heartbeater_impl::retransmit_limit(swim_state const& state) const -> unsigned {
+    return retransmit_mult * static_cast<unsigned>(std::ceil(std::log2(state.mem_list.num_members() + 1)));
+}
+
+// The time a suspected member has to refute the suspicion before it is declared failed
+auto swim_heartbeater_impl::suspicion_timeout_ms(swim_state const& state) const -> uint64_t {
+    double scale = std::max(1.0, std::log10(static_cast<double>(state.mem_list.num_members())));
+    return static_cast<uint64_t>(suspicion_mult * scale * protocol_period_ms);
+}
+
+// Adds a handler to the list of handlers that will be called when a node fails
+void swim_heartbeater_impl::on_fail(std::function<void(member const&)> handler) {
+    swim_state_lock.write()->on_fail_handlers.push_back(handler);
+}
+
+// Adds a handler to the list of handlers that will be called when a node leaves
+void swim_heartbeater_impl::on_leave(std::function<void(member const&)> handler) {
+    swim_state_lock.write()->on_leave_handlers.push_back(handler);
+}
+
+// Adds a handler to the list of handlers that will be called when a node joins
+void swim_heartbeater_impl::on_join(std::function<void(member const&)> handler) {
+    swim_state_lock.write()->on_join_handlers.push_back(handler);
+}
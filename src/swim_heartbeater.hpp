@@ -0,0 +1,170 @@
+#pragma once
+
+#include "heartbeater.h"
+#include "service.h"
+#include "member_list.h"
+#include "swim_messages.h"
+#include "udp.h"
+#include "environment.h"
+#include "configuration.h"
+#include "locking.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <chrono>
+
+// A heartbeater that detects failures with the SWIM protocol instead of heartbeating neighbors
+// Every protocol period, each member probes one other member, chosen in a shuffled round robin order, with a PING.
+// If no ACK arrives, it asks a few other members to probe the target for it with PING_REQs, and if there is still
+// no ACK by the end of the period, the target becomes suspected. A suspected member that does not refute the
+// suspicion (by gossiping an ALIVE update with a higher incarnation) before the suspicion timeout is declared failed
+// Membership updates are piggybacked on probe messages, each being sent a number of times that grows with log(n)
+class swim_heartbeater_impl : public heartbeater, public service_impl<swim_heartbeater_impl> {
+public:
+    swim_heartbeater_impl(environment &env);
+
+    void start();
+    void stop();
+    auto get_members() const -> std::vector<member>;
+    auto get_member_by_id(uint32_t id) const -> member;
+    auto get_successor() const -> member;
+    void run_atomically_with_mem_list(std::function<void()> const& fn) const;
+    void join_group(std::string const& node);
+    void leave_group();
+
+    auto get_id() const -> uint32_t {
+        return our_id.load();
+    }
+
+    void lock_new_joins() {
+        nodes_can_join = false;
+    }
+
+    void unlock_new_joins() {
+        nodes_can_join = true;
+    }
+
+    void on_fail(std::function<void(member const&)>);
+    void on_leave(std::function<void(member const&)>);
+    void on_join(std::function<void(member const&)>);
+
+private:
+    // The SWIM state of a member beyond what member_list holds
+    struct member_state {
+        uint32_t incarnation = 0;
+        bool suspect = false;
+        // The time at which the member became suspected, in ms
+        uint64_t suspect_since = 0;
+    };
+
+    // An update waiting to be piggybacked, along with the number of times it has been sent so far
+    struct pending_update {
+        swim_update update;
+        unsigned transmissions;
+    };
+
+    struct swim_state {
+        swim_state(environment &env) : mem_list(env) {}
+
+        member_list mem_list;
+        // The SWIM state of every member, including us, where we increment our own incarnation to refute suspicion
+        std::unordered_map<uint32_t, member_state> member_states;
+        // Members that failed or left, which stale ALIVE updates must not bring back
+        std::unordered_set<uint32_t> dead_ids;
+
+        // Updates to piggyback on outgoing messages, at most one per member
+        std::vector<pending_update> updates;
+
+        // The order in which members are probed, which is reshuffled every time it is exhausted
+        std::vector<uint32_t> probe_order;
+        unsigned probe_index = 0;
+        std::mt19937 mt;
+
+        // Handlers that will be called when the membership list changes
+        std::vector<std::function<void(member const&)>> on_fail_handlers;
+        std::vector<std::function<void(member const&)>> on_join_handlers;
+        std::vector<std::function<void(member const&)>> on_leave_handlers;
+    };
+
+    // Runs the probe loop, one protocol period at a time
+    void client_thread_function();
+    // Receives and handles messages
+    void server_thread_function();
+
+    // Handles a single message, queueing any handlers that should be called into handler_calls
+    void process_message(swim_state &state, std::string_view packet, std::vector<std::function<void()>> &handler_calls);
+    // Applies an update to the state if it is newer than what we know, and if gossip is true, queues it to be
+    // piggybacked onto our messages
+    void apply_update(swim_state &state, swim_update const& u, bool gossip,
+        std::vector<std::function<void()>> &handler_calls);
+    // Removes a failed or departed member, queueing the given handlers to be called for it
+    void remove_member(swim_state &state, uint32_t id, std::vector<std::function<void(member const&)>> const& handlers,
+        std::vector<std::function<void()>> &handler_calls);
+    // Declares every member whose suspicion timeout has passed failed
+    void check_suspects(swim_state &state, std::vector<std::function<void()>> &handler_calls);
+
+    // Queues an update to be piggybacked, replacing any older update about the same member
+    void queue_update(swim_state &state, swim_update const& u);
+    // Creates a message of the given type from us to recipient (or 0 for any member), with as many pending updates
+    // as fit piggybacked onto it
+    auto make_message(swim_state &state, swim_message::msg_type type, uint32_t recipient) -> swim_message;
+    // Serializes and sends a message to the given host
+    void send(std::string const& hostname, swim_message const& msg);
+    // Waits until the probe with the given seq is acknowledged or the deadline passes, returning whether it was
+    auto wait_for_ack(uint32_t seq, std::chrono::steady_clock::time_point deadline) -> bool;
+
+    // Returns the next member to probe, or 0 if there are no other members
+    auto next_probe_target(swim_state &state) -> uint32_t;
+    // Returns up to n random members other than us and excluded
+    auto random_members(swim_state &state, unsigned n, uint32_t excluded) -> std::vector<member>;
+    // The number of times each update is piggybacked, and the number of periods a suspicion lasts, scale with log(n)
+    auto retransmit_limit(swim_state const& state) const -> unsigned;
+    auto suspicion_timeout_ms(swim_state const& state) const -> uint64_t;
+
+    // Time between probes (in ms)
+    const uint64_t protocol_period_ms = 250;
+    // Time to wait for an ACK to a direct PING before sending PING_REQs (in ms)
+    const uint64_t ping_timeout_ms = 80;
+    // The number of members asked to probe a target that did not answer a direct PING
+    const unsigned num_indirect_probes = 3;
+    // Each update is piggybacked retransmit_mult * log2(n + 1) times
+    const unsigned retransmit_mult = 3;
+    // Suspicions last suspicion_mult * max(1, log10(n)) protocol periods
+    const unsigned suspicion_mult = 4;
+    // The most updates piggybacked onto a single probe message
+    const unsigned max_piggybacked_updates = 8;
+    // Number of times to send each join request
+    const int message_redundancy = 4;
+
+    // Information about current host
+    std::atomic<uint32_t> our_id;
+    std::atomic<bool> joined_group;
+
+    // Services that the heartbeater uses
+    std::unique_ptr<logger> lg;
+    configuration *config;
+    std::unique_ptr<udp_client> client;
+    std::unique_ptr<udp_server> server;
+
+    rw_locked<swim_state> swim_state_lock;
+
+    // The probe that is waiting for an ACK, which the server thread marks as acknowledged
+    std::mutex ack_mutex;
+    std::condition_variable ack_cv;
+    uint32_t probe_seq = 0;
+    uint32_t probe_target = 0;
+    bool probe_acked = false;
+
+    // Boolean indicating whether or not new nodes can join
+    std::atomic<bool> nodes_can_join;
+
+    std::atomic<bool> running;
+};
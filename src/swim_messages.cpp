@@ -0,0 +1,31 @@
+#include "swim_messages.h"
+#include "serialization.h"
+
+// Parses a message, returning false if it is malformed
+auto swim_message::parse(std::string_view buf) -> bool {
+    deserializer des(buf);
+    updates.clear();
+
+    try {
+        des.get_fields(*this);
+        des.done();
+    } catch (...) {
+        return false;
+    }
+
+    if (type > INTRO) {
+        return false;
+    }
+    for (swim_update const& u : updates) {
+        if (u.type > swim_update::LEFT) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Appends the serialized message to the end of buf
+void swim_message::serialize(std::string &buf) const {
+    serializer ser(buf);
+    ser.add_fields(*this);
+}
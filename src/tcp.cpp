@@ -2,6 +2,7 @@
 #include "tcp.hpp"
 
 #include <memory>
+#include <algorithm>
 #include <signal.h>
 
 using std::string;
@@ -12,12 +13,16 @@ void signal_handler(int signum) {}
 
 tcp_factory_impl::tcp_factory_impl(environment &env)
     : lg_fac(env.get<logger_factory>())
+    , tp_fac(env.get<threadpool_factory>())
+    , nodelay(true)
+    , cork(false)
 {
     signal(SIGPIPE, signal_handler);
 }
 
 auto tcp_factory_impl::get_tcp_client(string const& host, int port) -> unique_ptr<tcp_client> {
     tcp_client_impl *retval = new tcp_client_impl(lg_fac->get_logger("tcp_client"));
+    retval->set_socket_options(get_socket_options());
     if (retval->setup_connection(host, port) < 0) {
         return nullptr;
     } else {
@@ -27,18 +32,147 @@ auto tcp_factory_impl::get_tcp_client(string const& host, int port) -> unique_pt
 
 auto tcp_factory_impl::get_tcp_server(int port) -> unique_ptr<tcp_server> {
     tcp_server_impl *retval = new tcp_server_impl(lg_fac->get_logger("tcp_server"));
+    retval->set_socket_options(get_socket_options());
     retval->setup_server(port);
     return unique_ptr<tcp_server>(static_cast<tcp_server*>(retval));
 }
 
+auto tcp_factory_impl::get_tcp_event_server(int port, unsigned num_handlers) -> unique_ptr<tcp_event_server> {
+    tcp_event_server_impl *retval = new tcp_event_server_impl(lg_fac->get_logger("tcp_event_server"),
+        tp_fac->get_threadpool(num_handlers));
+    retval->set_socket_options(get_socket_options());
+    retval->setup_server(port);
+    return unique_ptr<tcp_event_server>(static_cast<tcp_event_server*>(retval));
+}
+
+auto tcp_factory_impl::get_pooled_tcp_client(string const& host, int port) -> unique_ptr<tcp_client> {
+    std::shared_ptr<tcp_mux_connection> conn;
+    {
+        unlocked<connection_pool> pool = pool_lock();
+        std::shared_ptr<tcp_mux_connection> &cached = (*pool)[host][port];
+        if (cached && cached->is_alive()) {
+            conn = cached;
+        }
+    }
+
+    // Connect without holding the lock so that connecting to one host does not block clients of other hosts
+    if (!conn) {
+        unique_ptr<logger> lg = lg_fac->get_logger("tcp_mux_connection");
+        int fd = tcp_utils::open_connection(lg.get(), host, port);
+        if (fd < 0) {
+            return nullptr;
+        }
+        tcp_utils::apply_socket_options(fd, get_socket_options());
+        conn = std::make_shared<tcp_mux_connection>(std::move(lg), fd);
+
+        unlocked<connection_pool> pool = pool_lock();
+        std::shared_ptr<tcp_mux_connection> &cached = (*pool)[host][port];
+        if (cached && cached->is_alive()) {
+            conn = cached; // Another client connected at the same time as us
+        } else {
+            cached = conn;
+        }
+    }
+
+    return unique_ptr<tcp_client>(new tcp_pooled_client_impl(conn));
+}
+
+void tcp_factory_impl::evict_pooled_connections(string const& host) {
+    unlocked<connection_pool> pool = pool_lock();
+    if (pool->find(host) == pool->end()) {
+        return;
+    }
+
+    // Clients still holding the connections will see them fail, and the connections are freed once they are done
+    for (auto const& [port, conn] : (*pool)[host]) {
+        conn->shutdown_connection();
+    }
+    pool->erase(host);
+}
+
+void tcp_factory_impl::configure(bool nodelay_, bool cork_) {
+    nodelay = nodelay_;
+    cork = cork_;
+}
+
+auto tcp_factory_impl::get_socket_options() -> tcp_utils::socket_options {
+    tcp_utils::socket_options options;
+    options.nodelay = nodelay.load();
+    options.cork = cork.load();
+    return options;
+}
+
+auto tcp_utils::decode_message_size(const char *buf) -> size_t {
+    uint32_t size;
+    memcpy(&size, buf, sizeof(uint32_t));
+    return (size_t) ntohl(size);
+}
+
+auto tcp_utils::encode_mux_header(uint32_t stream, size_t size, bool fin) -> string {
+    uint32_t header[2];
+    header[0] = htonl(static_cast<uint32_t>(size) | MUX_FLAG | (fin ? FIN_FLAG : 0));
+    header[1] = htonl(stream);
+    return string(reinterpret_cast<char*>(header), MUX_HEADER_LEN);
+}
+
+auto tcp_utils::open_connection(logger *lg, string const& host, int port) -> int {
+    struct addrinfo info, *res;
+    memset(&info, 0, sizeof(info));
+
+    info.ai_family = AF_INET;
+    info.ai_socktype = SOCK_STREAM;
+
+    int s = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &info, &res);
+    if (s != 0) {
+        // Get the error using gai
+        lg->info("getaddrinfo failed -- " + string(gai_strerror(s)));
+        return -1;
+    }
+
+    // Get a socket for the client
+    int client_socket = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+    if (client_socket == -1) {
+        lg->info("socket failed -- " + string(strerror(errno)));
+        freeaddrinfo(res);
+        return -1;
+    }
+
+    // Connect the client to the server
+    int connected = connect(client_socket, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (connected == -1) {
+        lg->info("connect failed -- " + string(strerror(errno)));
+        close(client_socket);
+        return -1;
+    }
+
+    return client_socket;
+}
+
+void tcp_utils::apply_socket_options(int socket, socket_options const& options) {
+    int optval = options.nodelay ? 1 : 0;
+    setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
+}
+
+void tcp_utils::set_socket_options(socket_options const& options_) {
+    options = options_;
+}
+
+void tcp_utils::set_corked(int socket, bool corked) {
+    if (options.cork) {
+        int optval = corked ? 1 : 0;
+        setsockopt(socket, IPPROTO_TCP, TCP_CORK, &optval, sizeof(optval));
+    }
+}
+
 auto tcp_utils::get_message_size(int socket) -> ssize_t {
-    int32_t size;
+    char size_buf[MESSAGE_SIZE_LEN];
     ssize_t read_bytes =
-        read_all_from_socket(socket, (char *) &size, sizeof(int32_t));
+        read_all_from_socket(socket, size_buf, MESSAGE_SIZE_LEN);
     if (read_bytes == 0 || read_bytes == -1)
         return read_bytes;
 
-    return (ssize_t) ntohl(size);
+    return (ssize_t) decode_message_size(size_buf);
 }
 
 auto tcp_utils::write_message_size(size_t size, int socket) -> ssize_t {
@@ -83,6 +217,140 @@ auto tcp_utils::write_all_to_socket(int socket, const char *buffer, size_t count
     return total;
 }
 
+auto tcp_utils::write_all_to_socket(int socket, struct iovec *iov, int iovcnt) -> ssize_t {
+    size_t total = 0;
+    ssize_t r = 0;
+    while (iovcnt > 0 && (r = writev(socket, iov, iovcnt))) {
+        if (r == -1 && EINTR == errno) {
+            continue;
+        }
+
+        if (r == -1) return -1;
+
+        total += r;
+
+        // Skip past the buffers that were written completely, and the written part of the first one that wasn't
+        for (; iovcnt > 0 && static_cast<size_t>(r) >= iov->iov_len; iov++, iovcnt--) {
+            r -= iov->iov_len;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + r;
+            iov->iov_len -= r;
+        }
+    }
+
+    return total;
+}
+
+auto tcp_utils::write_messages(int socket, std::vector<std::string_view> const& messages) -> ssize_t {
+    // Each message takes up two buffers, and writev accepts at most IOV_MAX buffers per call
+    const size_t max_batch = IOV_MAX / 2;
+
+    std::vector<uint32_t> sizes(std::min(messages.size(), max_batch));
+    std::vector<struct iovec> iov(2 * sizes.size());
+    ssize_t total = 0;
+
+    set_corked(socket, true);
+    for (size_t start = 0; start < messages.size(); start += max_batch) {
+        size_t batch = std::min(messages.size() - start, max_batch);
+        size_t expected = 0;
+        for (size_t i = 0; i < batch; i++) {
+            std::string_view const& msg = messages[start + i];
+            sizes[i] = htonl(msg.length());
+            iov[2 * i].iov_base = &sizes[i];
+            iov[2 * i].iov_len = MESSAGE_SIZE_LEN;
+            iov[2 * i + 1].iov_base = const_cast<char*>(msg.data());
+            iov[2 * i + 1].iov_len = msg.length();
+            expected += MESSAGE_SIZE_LEN + msg.length();
+        }
+
+        ssize_t written = write_all_to_socket(socket, iov.data(), 2 * batch);
+        if (written != static_cast<ssize_t>(expected)) {
+            set_corked(socket, false);
+            return written == -1 ? -1 : 0;
+        }
+        total += expected - batch * MESSAGE_SIZE_LEN;
+    }
+    set_corked(socket, false);
+
+    return total;
+}
+
+auto tcp_utils::write_file_to_socket(int socket, int fd, size_t size) -> ssize_t {
+    // Corking lets the header share a packet with the start of the file
+    set_corked(socket, true);
+
+    uint64_t nsize = htobe64(size);
+    ssize_t retval = size;
+    if (write_all_to_socket(socket, reinterpret_cast<char*>(&nsize), FILE_SIZE_LEN) != static_cast<ssize_t>(FILE_SIZE_LEN))
+        retval = -1;
+
+    // sendfile advances offset itself and leaves the file offset of fd untouched
+    off_t offset = 0;
+    while (retval != -1 && static_cast<size_t>(offset) < size) {
+        ssize_t r = sendfile(socket, fd, &offset, std::min(size - offset, FILE_CHUNK_SIZE));
+        if (r == -1 && EINTR == errno) {
+            continue;
+        }
+
+        // Either the socket failed or the file is shorter than promised, and the receiver can't recover either way
+        if (r <= 0) retval = -1;
+    }
+
+    set_corked(socket, false);
+    return retval;
+}
+
+auto tcp_utils::read_file_from_socket(int socket, int fd) -> ssize_t {
+    char size_buf[FILE_SIZE_LEN];
+    if (read_all_from_socket(socket, size_buf, FILE_SIZE_LEN) != static_cast<ssize_t>(FILE_SIZE_LEN))
+        return -1;
+
+    uint64_t size;
+    memcpy(&size, size_buf, FILE_SIZE_LEN);
+    size = be64toh(size);
+
+    // splice can only move data between two descriptors if one of them is a pipe
+    int pipe_fds[2];
+    if (pipe2(pipe_fds, O_CLOEXEC) == -1)
+        return -1;
+    // A larger pipe means fewer round trips through the kernel, but the default size still works if this fails
+    fcntl(pipe_fds[1], F_SETPIPE_SZ, FILE_CHUNK_SIZE);
+
+    loff_t offset = 0;
+    ssize_t result = size;
+    while (static_cast<uint64_t>(offset) < size && result != -1) {
+        ssize_t in_pipe = splice(socket, NULL, pipe_fds[1], NULL,
+            std::min<uint64_t>(size - offset, FILE_CHUNK_SIZE), SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (in_pipe == -1 && EINTR == errno) {
+            continue;
+        }
+
+        if (in_pipe <= 0) {
+            result = -1;
+            break;
+        }
+
+        // Empty the pipe into the file before reading any more from the socket
+        while (in_pipe > 0) {
+            ssize_t out = splice(pipe_fds[0], NULL, fd, &offset, in_pipe, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (out == -1 && EINTR == errno) {
+                continue;
+            }
+
+            if (out <= 0) {
+                result = -1;
+                break;
+            }
+            in_pipe -= out;
+        }
+    }
+
+    close(pipe_fds[0]);
+    close(pipe_fds[1]);
+    return result;
+}
+
 tcp_server_impl::~tcp_server_impl() {
     stop_server();
 }
@@ -139,6 +407,7 @@ auto tcp_server_impl::accept_connection() -> int {
         return -1;
     }
 
+    apply_socket_options(client_fd, options);
     return client_fd;
 }
 
@@ -160,10 +429,15 @@ auto tcp_server_impl::read_from_client(int client) -> string {
 }
 
 auto tcp_server_impl::write_to_client(int client, string const& data) -> ssize_t {
-    size_t size = (size_t) data.length();
-    if (write_message_size(size, client) == -1) return -1;
+    return write_messages(client, {data});
+}
 
-    return write_all_to_socket(client, data.c_str(), data.length());
+auto tcp_server_impl::write_file_to_client(int client, int fd, size_t size) -> ssize_t {
+    return write_file_to_socket(client, fd, size);
+}
+
+auto tcp_server_impl::read_file_from_client(int client, int fd) -> ssize_t {
+    return read_file_from_socket(client, fd);
 }
 
 tcp_client_impl::~tcp_client_impl() {
@@ -171,63 +445,601 @@ tcp_client_impl::~tcp_client_impl() {
 }
 
 auto tcp_client_impl::setup_connection(string const& host, int port) -> int {
+    fixed_socket = open_connection(lg.get(), host, port);
+    if (fixed_socket >= 0) {
+        apply_socket_options(fixed_socket, options);
+    }
+    return fixed_socket;
+}
+
+auto tcp_client_impl::read_from_server() -> string {
+    ssize_t message_size;
+    if ((message_size = get_message_size(fixed_socket)) == -1)
+        return "";
+
+    unique_ptr<char[]> buf = make_unique<char[]>(message_size);
+    if (read_all_from_socket(fixed_socket, buf.get(), message_size) == -1)
+        return "";
+
+    return string(buf.get(), message_size);
+}
+
+auto tcp_client_impl::write_to_server(string const& data) -> ssize_t {
+    return write_messages(fixed_socket, {data});
+}
+
+auto tcp_client_impl::write_file_to_server(int fd, size_t size) -> ssize_t {
+    return write_file_to_socket(fixed_socket, fd, size);
+}
+
+auto tcp_client_impl::read_file_from_server(int fd) -> ssize_t {
+    return read_file_from_socket(fixed_socket, fd);
+}
+
+void tcp_client_impl::close_connection() {
+    // No internal state being managed so this is fine
+    close(fixed_socket);
+}
+
+tcp_event_server_impl::~tcp_event_server_impl() {
+    stop();
+
+    if (server_fd >= 0) {
+        shutdown(server_fd, SHUT_RDWR);
+        close(server_fd);
+    }
+    if (epoll_fd >= 0) close(epoll_fd);
+    if (wakeup_fd >= 0) close(wakeup_fd);
+}
+
+void tcp_event_server_impl::setup_server(int port) {
     struct addrinfo info, *res;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    int optval = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+
     memset(&info, 0, sizeof(info));
 
     info.ai_family = AF_INET;
     info.ai_socktype = SOCK_STREAM;
+    info.ai_flags = AI_PASSIVE;
 
-    int s = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &info, &res);
+    int s = getaddrinfo(NULL, std::to_string(port).c_str(), &info, &res);
     if (s != 0) {
-        // Get the error using gai
         lg->info("getaddrinfo failed -- " + string(gai_strerror(s)));
-        fixed_socket = -1;
-        return fixed_socket;
+        exit(1);
     }
 
-    // Get a socket for the client
-    int client_socket = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (client_socket == -1) {
-        lg->info("socket failed -- " + string(strerror(errno)));
-        fixed_socket = -1;
-        return fixed_socket;
+    if (bind(fd, res->ai_addr, res->ai_addrlen) != 0) {
+        lg->info("bind failed -- " + string(strerror(errno)));
+        freeaddrinfo(res);
+        exit(1);
     }
+    freeaddrinfo(res);
 
-    // Connect the client to the server
-    int connected = connect(client_socket, res->ai_addr, res->ai_addrlen);
-    if (connected == -1) {
-        lg->info("connect failed -- " + string(strerror(errno)));
-        fixed_socket = -1;
-        return fixed_socket;
+    // Since connections are cheap for us, allow as many pending connections as the kernel will
+    if (listen(fd, SOMAXCONN) != 0) {
+        lg->info("listen failed -- " + string(strerror(errno)));
+        exit(1);
     }
 
-    fixed_socket = client_socket;
-    return fixed_socket;
+    server_fd = fd;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wakeup_fd < 0) {
+        lg->info("Failed to create event loop -- " + string(strerror(errno)));
+        exit(1);
+    }
+
+    // The listening socket is level triggered so that connections we fail to accept are retried
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = LISTENER_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &ev);
+
+    ev.events = EPOLLIN;
+    ev.data.fd = WAKEUP_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev);
 }
 
-auto tcp_client_impl::read_from_server() -> string {
-    ssize_t message_size;
-    if ((message_size = get_message_size(fixed_socket)) == -1)
-        return "";
+void tcp_event_server_impl::start(message_handler const& handler_) {
+    if (running.load()) {
+        return;
+    }
 
-    unique_ptr<char[]> buf = make_unique<char[]>(message_size);
-    if (read_all_from_socket(fixed_socket, buf.get(), message_size) == -1)
+    handler = handler_;
+    running = true;
+    loop_thread = std::thread([this] {event_loop();});
+}
+
+void tcp_event_server_impl::stop() {
+    if (running.load()) {
+        running = false;
+
+        // Wake up the event loop so that it notices it should exit
+        uint64_t one = 1;
+        ssize_t written = write(wakeup_fd, &one, sizeof(one));
+        (void) written;
+        loop_thread.join();
+
+        // Let any handlers that are running finish before we close their connections
+        tp->finish();
+    }
+
+    unlocked<server_state> state = state_lock();
+    for (auto const& [conn_id, conn] : state->conns) {
+        close(conn.fd);
+    }
+    state->conns.clear();
+    state->channels.clear();
+}
+
+void tcp_event_server_impl::event_loop() {
+    struct epoll_event events[MAX_EVENTS];
+
+    while (running.load()) {
+        int num_events = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        if (num_events < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            lg->info("epoll_wait failed -- " + string(strerror(errno)));
+            break;
+        }
+
+        for (int i = 0; i < num_events; i++) {
+            int conn_id = events[i].data.fd;
+
+            if (conn_id == WAKEUP_ID) {
+                continue;
+            }
+
+            if (conn_id == LISTENER_ID) {
+                accept_connections();
+                continue;
+            }
+
+            unlocked<server_state> state = state_lock();
+            if (state->conns.find(conn_id) == state->conns.end()) {
+                continue;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                handle_readable(state, conn_id);
+            }
+
+            if ((events[i].events & EPOLLOUT) && !flush_writes(state->conns[conn_id])) {
+                destroy_connection(state, conn_id);
+                continue;
+            }
+
+            update_connection(state, conn_id);
+        }
+    }
+
+    lg->debug("Exiting event loop");
+}
+
+void tcp_event_server_impl::accept_connections() {
+    while (true) {
+        // Sockets are closed on exec so that child processes cannot keep connections open after we close them
+        int fd = accept4(server_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                lg->debug("accept failed -- ", strerror(errno));
+            }
+            return;
+        }
+
+        apply_socket_options(fd, options);
+
+        unlocked<server_state> state = state_lock();
+        int conn_id = state->next_id;
+        int chan_id = (conn_id + 1) & 0x7FFFFFFF;
+        state->next_id = (chan_id + 1) & 0x7FFFFFFF;
+
+        connection &conn = state->conns[conn_id];
+        conn.fd = fd;
+        conn.plain_channel = chan_id;
+        state->channels[chan_id].conn = conn_id;
+        state->channels[chan_id].stream = 0;
+
+        // Client sockets are edge triggered, so each event must be serviced until the socket would block
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.fd = conn_id;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            lg->debug("Failed to add client to event loop -- ", strerror(errno));
+            close(fd);
+            state->conns.erase(conn_id);
+            state->channels.erase(chan_id);
+        }
+    }
+}
+
+void tcp_event_server_impl::handle_readable(unlocked<server_state> &state, int conn_id) {
+    connection &conn = state->conns[conn_id];
+
+    char buf[READ_CHUNK_SIZE];
+    while (true) {
+        ssize_t r = read(conn.fd, buf, READ_CHUNK_SIZE);
+        if (r > 0) {
+            conn.read_buf.append(buf, r);
+            continue;
+        }
+
+        if (r == -1 && errno == EINTR) {
+            continue;
+        }
+
+        // Either the peer closed the connection or the socket failed
+        if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            conn.peer_closed = true;
+        }
+        break;
+    }
+
+    // Split off every complete frame, leaving any partial frame in the buffer
+    size_t pos = 0;
+    while (conn.read_buf.length() - pos >= MESSAGE_SIZE_LEN) {
+        uint32_t header = decode_message_size(conn.read_buf.data() + pos);
+
+        size_t header_len = MESSAGE_SIZE_LEN;
+        size_t size = header;
+        uint32_t stream = 0;
+        if (header & MUX_FLAG) {
+            if (conn.read_buf.length() - pos < MUX_HEADER_LEN) {
+                break;
+            }
+            header_len = MUX_HEADER_LEN;
+            size = header & MUX_SIZE_MASK;
+            stream = decode_message_size(conn.read_buf.data() + pos + MESSAGE_SIZE_LEN);
+        }
+
+        if (conn.read_buf.length() - pos - header_len < size) {
+            break;
+        }
+
+        receive_message(state, conn_id, stream, (header & MUX_FLAG) && (header & FIN_FLAG),
+            string(conn.read_buf, pos + header_len, size));
+        pos += header_len + size;
+    }
+    conn.read_buf.erase(0, pos);
+
+    // No more messages will arrive on any of the connection's channels
+    if (conn.peer_closed) {
+        state->channels[conn.plain_channel].peer_closed = true;
+        for (auto const& [stream, chan_id] : conn.streams) {
+            state->channels[chan_id].peer_closed = true;
+        }
+    }
+}
+
+void tcp_event_server_impl::receive_message(unlocked<server_state> &state, int conn_id,
+    uint32_t stream, bool fin, string &&msg)
+{
+    connection &conn = state->conns[conn_id];
+
+    int chan_id = conn.plain_channel;
+    if (stream != 0) {
+        if (conn.streams.find(stream) == conn.streams.end()) {
+            // Ignore anything that arrives for a stream after we closed it
+            if (fin || stream <= conn.max_stream) {
+                return;
+            }
+
+            chan_id = state->next_id;
+            state->next_id = (chan_id + 1) & 0x7FFFFFFF;
+            state->channels[chan_id].conn = conn_id;
+            state->channels[chan_id].stream = stream;
+            conn.streams[stream] = chan_id;
+            conn.max_stream = stream;
+        } else {
+            chan_id = conn.streams[stream];
+        }
+    }
+
+    channel &chan = state->channels[chan_id];
+    if (fin) {
+        chan.peer_closed = true;
+    } else if (!chan.closing) {
+        chan.messages.push_back(std::move(msg));
+    }
+}
+
+auto tcp_event_server_impl::flush_writes(connection &conn) -> bool {
+    while (conn.write_pos < conn.write_buf.length()) {
+        ssize_t w = send(conn.fd, conn.write_buf.data() + conn.write_pos,
+            conn.write_buf.length() - conn.write_pos, MSG_NOSIGNAL);
+        if (w > 0) {
+            conn.write_pos += w;
+            continue;
+        }
+
+        if (w == -1 && errno == EINTR) {
+            continue;
+        }
+
+        // The rest will be written when the event loop sees that the socket is writable again
+        if (w == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+
+        return false;
+    }
+
+    conn.write_buf.clear();
+    conn.write_pos = 0;
+    return true;
+}
+
+void tcp_event_server_impl::update_connection(unlocked<server_state> &state, int conn_id) {
+    connection &conn = state->conns[conn_id];
+
+    std::vector<int> chan_ids = {conn.plain_channel};
+    for (auto const& [stream, chan_id] : conn.streams) {
+        chan_ids.push_back(chan_id);
+    }
+
+    bool channels_idle = true;
+    for (int chan_id : chan_ids) {
+        dispatch(state, chan_id);
+
+        channel &chan = state->channels[chan_id];
+        if (!is_finished(chan)) {
+            channels_idle = false;
+        } else if (chan.stream != 0) {
+            // Streams are removed as soon as they are done, while the plain channel lives as long as the connection
+            conn.streams.erase(chan.stream);
+            state->channels.erase(chan_id);
+        }
+    }
+
+    // The connection is done once nothing more can be read or handled and everything has been written
+    bool plain_idle = !state->channels[conn.plain_channel].dispatched && state->channels[conn.plain_channel].messages.empty();
+    if ((conn.closing && plain_idle) || (conn.peer_closed && channels_idle)) {
+        if (conn.write_pos == conn.write_buf.length()) {
+            destroy_connection(state, conn_id);
+        }
+    }
+}
+
+void tcp_event_server_impl::dispatch(unlocked<server_state> &state, int client) {
+    channel &chan = state->channels[client];
+    if (chan.dispatched || chan.closing || chan.messages.empty()) {
+        return;
+    }
+
+    chan.dispatched = true;
+    tp->enqueue([this, client] {
+        drain_messages(client);
+    });
+}
+
+void tcp_event_server_impl::drain_messages(int client) {
+    while (true) {
+        string msg;
+        { // Atomically take the next message, giving up ownership of the queue if it is empty
+            unlocked<server_state> state = state_lock();
+            if (state->channels.find(client) == state->channels.end()) {
+                return;
+            }
+
+            channel &chan = state->channels[client];
+            if (chan.closing || chan.messages.empty()) {
+                chan.dispatched = false;
+                update_connection(state, chan.conn);
+                return;
+            }
+
+            msg = std::move(chan.messages.front());
+            chan.messages.pop_front();
+        }
+
+        handler(client, msg);
+    }
+}
+
+auto tcp_event_server_impl::is_finished(channel const& chan) const -> bool {
+    return (chan.closing || chan.peer_closed) && !chan.dispatched && chan.messages.empty();
+}
+
+void tcp_event_server_impl::destroy_connection(unlocked<server_state> &state, int conn_id) {
+    connection &conn = state->conns[conn_id];
+    state->channels.erase(conn.plain_channel);
+    for (auto const& [stream, chan_id] : conn.streams) {
+        state->channels.erase(chan_id);
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, NULL);
+    close(conn.fd);
+    state->conns.erase(conn_id);
+}
+
+void tcp_event_server_impl::close_connection(int client) {
+    unlocked<server_state> state = state_lock();
+    if (state->channels.find(client) == state->channels.end() || state->channels[client].closing) {
+        return;
+    }
+
+    channel &chan = state->channels[client];
+    chan.closing = true;
+    chan.messages.clear();
+
+    connection &conn = state->conns[chan.conn];
+    if (chan.stream == 0) {
+        // Closing the plain channel closes the connection itself
+        conn.closing = true;
+    } else if (!conn.peer_closed) {
+        // Tell the client that the stream is over
+        conn.write_buf.append(encode_mux_header(chan.stream, 0, true));
+        if (!flush_writes(conn)) {
+            destroy_connection(state, chan.conn);
+            return;
+        }
+    }
+
+    update_connection(state, chan.conn);
+}
+
+auto tcp_event_server_impl::write_to_client(int client, string const& data) -> ssize_t {
+    unlocked<server_state> state = state_lock();
+    if (state->channels.find(client) == state->channels.end() || state->channels[client].closing) {
+        return 0;
+    }
+
+    channel &chan = state->channels[client];
+    connection &conn = state->conns[chan.conn];
+    if (conn.closing) {
+        return 0;
+    }
+
+    if (chan.stream == 0) {
+        uint32_t nsize = htonl(data.length());
+        conn.write_buf.append((char *) &nsize, MESSAGE_SIZE_LEN);
+    } else {
+        conn.write_buf.append(encode_mux_header(chan.stream, data.length(), false));
+    }
+    conn.write_buf.append(data);
+
+    if (!flush_writes(conn)) {
+        destroy_connection(state, chan.conn);
+        return -1;
+    }
+
+    return data.length();
+}
+
+tcp_mux_connection::tcp_mux_connection(unique_ptr<logger> lg_, int fd_)
+    : lg(std::move(lg_)), fd(fd_)
+{
+    reader_thread = std::thread([this] {read_loop();});
+}
+
+tcp_mux_connection::~tcp_mux_connection() {
+    shutdown_connection();
+    reader_thread.join();
+    close(fd);
+}
+
+auto tcp_mux_connection::open_stream() -> uint32_t {
+    unlocked<mux_state> state = mux_state_lock();
+    uint32_t stream = state->next_stream++;
+    state->streams[stream].closed = !state->alive;
+    return stream;
+}
+
+void tcp_mux_connection::close_stream(uint32_t stream) {
+    bool closed;
+    {
+        unlocked<mux_state> state = mux_state_lock();
+        closed = state->streams[stream].closed;
+        state->streams.erase(stream);
+    }
+
+    // Only tell the server the stream is over if it has not already told us the same
+    if (!closed) {
+        string header = encode_mux_header(stream, 0, true);
+        std::lock_guard<std::mutex> guard(write_mutex);
+        write_all_to_socket(fd, header.c_str(), header.length());
+    }
+}
+
+auto tcp_mux_connection::read_from_stream(uint32_t stream) -> string {
+    unlocked<mux_state> state = mux_state_lock();
+    cv_messages.wait(state.unsafe_get_mutex(), [&] {
+        return state->streams[stream].messages.size() > 0 || state->streams[stream].closed;
+    });
+
+    std::queue<string> &messages = state->streams[stream].messages;
+    if (messages.size() == 0) {
         return "";
+    }
 
-    return string(buf.get(), message_size);
+    string msg = std::move(messages.front());
+    messages.pop();
+    return msg;
 }
 
-auto tcp_client_impl::write_to_server(string const& data) -> ssize_t {
-    size_t size = (size_t) data.length();
-    if (write_message_size(size, fixed_socket) == -1)
+auto tcp_mux_connection::write_to_stream(uint32_t stream, string const& data) -> ssize_t {
+    {
+        unlocked<mux_state> state = mux_state_lock();
+        if (state->streams[stream].closed) {
+            return 0;
+        }
+    }
+
+    string header = encode_mux_header(stream, data.length(), false);
+    struct iovec iov[2];
+    iov[0].iov_base = &header[0];
+    iov[0].iov_len = header.length();
+    iov[1].iov_base = const_cast<char*>(data.c_str());
+    iov[1].iov_len = data.length();
+
+    std::lock_guard<std::mutex> guard(write_mutex);
+    ssize_t written = write_all_to_socket(fd, iov, 2);
+    if (written != static_cast<ssize_t>(header.length() + data.length())) {
+        // Wake up the reader so that every stream learns the connection is broken
+        shutdown(fd, SHUT_RDWR);
         return -1;
+    }
+    return data.length();
+}
 
-    return write_all_to_socket(fixed_socket, data.c_str(), data.length());
+auto tcp_mux_connection::is_alive() -> bool {
+    return mux_state_lock()->alive;
 }
 
-void tcp_client_impl::close_connection() {
-    // No internal state being managed so this is fine
-    close(fixed_socket);
+void tcp_mux_connection::shutdown_connection() {
+    shutdown(fd, SHUT_RDWR);
+}
+
+void tcp_mux_connection::read_loop() {
+    char header_buf[MUX_HEADER_LEN];
+    while (true) {
+        // Every frame sent to pooled clients is multiplexed
+        if (read_all_from_socket(fd, header_buf, MUX_HEADER_LEN) != static_cast<ssize_t>(MUX_HEADER_LEN)) {
+            break;
+        }
+
+        uint32_t header = decode_message_size(header_buf);
+        uint32_t stream = decode_message_size(header_buf + MESSAGE_SIZE_LEN);
+        if (!(header & MUX_FLAG)) {
+            lg->debug("Received unmultiplexed message on pooled connection");
+            break;
+        }
+
+        size_t size = header & MUX_SIZE_MASK;
+        unique_ptr<char[]> buf = make_unique<char[]>(size);
+        if (size > 0 && read_all_from_socket(fd, buf.get(), size) != static_cast<ssize_t>(size)) {
+            break;
+        }
+
+        unlocked<mux_state> state = mux_state_lock();
+        // Drop anything for streams that the client has already closed
+        if (state->streams.find(stream) == state->streams.end()) {
+            continue;
+        }
+
+        if (header & FIN_FLAG) {
+            state->streams[stream].closed = true;
+        } else {
+            state->streams[stream].messages.push(string(buf.get(), size));
+        }
+        cv_messages.notify_all();
+    }
+
+    // The connection failed or was shut down, so fail every stream on it
+    unlocked<mux_state> state = mux_state_lock();
+    state->alive = false;
+    for (auto &[stream, stream_state] : state->streams) {
+        stream_state.closed = true;
+    }
+    cv_messages.notify_all();
 }
 
 register_service<tcp_factory, tcp_factory_impl> register_tcp_factory;
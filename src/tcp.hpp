@@ -4,8 +4,11 @@
 #include "environment.h"
 #include "service.h"
 #include "logging.h"
+#include "threadpool.h"
+#include "locking.h"
 
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,14 +20,65 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <endian.h>
 
 #include <queue>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
 #include <string>
 #include <iostream>
 #include <memory>
+#include <string_view>
+#include <vector>
 
 class tcp_utils {
 public:
+    // Options set on every connection made or accepted, as chosen with tcp_factory::configure
+    struct socket_options {
+        bool nodelay = true;
+        bool cork = false;
+    };
+
+    // The number of bytes in the length prefix of every message
+    static const size_t MESSAGE_SIZE_LEN = sizeof(uint32_t);
+
+    // Multiplexed frames set MUX_FLAG in the length prefix, which is then followed by a 4 byte stream ID
+    // Frames that end a stream additionally set FIN_FLAG and carry no message
+    static const uint32_t MUX_FLAG = 0x80000000;
+    static const uint32_t FIN_FLAG = 0x40000000;
+    static const uint32_t MUX_SIZE_MASK = 0x3FFFFFFF;
+    static const size_t MUX_HEADER_LEN = 2 * sizeof(uint32_t);
+
+    // Files are sent raw after a single header holding their 64 bit length
+    static constexpr size_t FILE_SIZE_LEN = sizeof(uint64_t);
+    // The most bytes moved per call to sendfile or splice, which is also the requested pipe capacity
+    static constexpr size_t FILE_CHUNK_SIZE = 1 << 20;
+
+    // Transforms the first four bytes of buf (the length prefix of a message) into the size of the message
+    static auto decode_message_size(const char *buf) -> size_t;
+
+    // Returns the header for a multiplexed frame carrying a message of the given size on the given stream
+    static auto encode_mux_header(uint32_t stream, size_t size, bool fin) -> std::string;
+
+    // Opens a TCP connection to the given host and port
+    // Returns the connected socket, or -1 on failure
+    static auto open_connection(logger *lg, std::string const& host, int port) -> int;
+
+    // Applies the options to a connected socket
+    static void apply_socket_options(int socket, socket_options const& options);
+
+    // Sets the options used by this client or server for the connections it makes or accepts
+    void set_socket_options(socket_options const& options_);
+
     // Read the first four bytes from socket and transform it into ssize_t
     // Returns the size of the incomming message, 0 if socket is disconnected, -1 on failure
     auto get_message_size(int socket) -> ssize_t;
@@ -41,13 +95,29 @@ public:
     // Returns the number of bytes written, 0 if socket is disconnected, or -1 on failure.
     auto write_all_to_socket(int socket, const char *buffer, size_t count) -> ssize_t;
 
-    // Attempts to write entire file over socket
-    // Returns the number of bytes written
-    auto write_file_to_socket(int socket, std::string filename) -> ssize_t;
+    // Attempts to write all of the iovcnt buffers in iov to socket, resuming writev after partial writes
+    // The contents of iov are modified to track progress
+    // Returns the number of bytes written, 0 if socket is disconnected, or -1 on failure.
+    auto write_all_to_socket(int socket, struct iovec *iov, int iovcnt) -> ssize_t;
+
+    // Writes each message behind its length prefix, gathering as many messages as possible into each writev
+    // Returns the number of message bytes written, 0 if socket is disconnected, or -1 on failure
+    auto write_messages(int socket, std::vector<std::string_view> const& messages) -> ssize_t;
 
-    // Attempts to read entire file over socket
-    // Returns the number of bytes read
-    auto read_file_from_socket(int socket, std::string filename) -> ssize_t;
+    // Writes a length header followed by the first size bytes of the file fd to socket using sendfile
+    // Returns the number of bytes of the file written, or -1 on failure or disconnection
+    auto write_file_to_socket(int socket, int fd, size_t size) -> ssize_t;
+
+    // Reads a file written by write_file_to_socket from socket into the start of the file fd,
+    // splicing it through a pipe so that the contents never enter user space
+    // Returns the number of bytes of the file read, or -1 on failure or disconnection
+    auto read_file_from_socket(int socket, int fd) -> ssize_t;
+
+protected:
+    // Holds back partial packets on socket until uncorked, if corking is enabled
+    void set_corked(int socket, bool corked);
+
+    socket_options options;
 };
 
 class tcp_server_impl : public tcp_server, public tcp_utils {
@@ -60,6 +130,8 @@ public:
     void close_connection(int client_socket);
     auto read_from_client(int client) -> std::string;
     auto write_to_client(int client, std::string const& data) -> ssize_t;
+    auto write_file_to_client(int client, int fd, size_t size) -> ssize_t;
+    auto read_file_from_client(int client, int fd) -> ssize_t;
 private:
     std::unique_ptr<logger> lg;
     int server_fd;
@@ -74,18 +146,194 @@ public:
     void close_connection();
     auto read_from_server() -> std::string;
     auto write_to_server(std::string const& data) -> ssize_t;
+    auto write_file_to_server(int fd, size_t size) -> ssize_t;
+    auto read_file_from_server(int fd) -> ssize_t;
 private:
     std::unique_ptr<logger> lg;
     int fixed_socket;
 };
 
+class tcp_event_server_impl : public tcp_event_server, public tcp_utils {
+public:
+    tcp_event_server_impl(std::unique_ptr<logger> lg_, std::unique_ptr<threadpool> tp_)
+        : lg(std::move(lg_)), tp(std::move(tp_)), server_fd(-1), epoll_fd(-1), wakeup_fd(-1), running(false) {}
+    ~tcp_event_server_impl();
+    void setup_server(int port);
+    void start(message_handler const& handler_);
+    void stop();
+    void close_connection(int client);
+    auto write_to_client(int client, std::string const& data) -> ssize_t;
+private:
+    // The maximum number of events handled per call to epoll_wait
+    static const int MAX_EVENTS = 256;
+    // The number of bytes read from a socket per call to read
+    static const size_t READ_CHUNK_SIZE = 65536;
+    // Values of epoll_event.data.fd that do not correspond to connections
+    static const int LISTENER_ID = -1;
+    static const int WAKEUP_ID = -2;
+
+    struct connection {
+        int fd;
+        // Bytes received that do not yet form a complete message
+        std::string read_buf;
+        // Bytes (including headers) waiting for the socket to become writable, starting at write_pos
+        std::string write_buf;
+        size_t write_pos = 0;
+        // The channel for unmultiplexed messages, and the channels for each open stream by stream ID
+        int plain_channel;
+        std::unordered_map<uint32_t, int> streams;
+        // Streams are opened in increasing order, so any stream ID at most this that is not open has been closed
+        uint32_t max_stream = 0;
+        // Whether the peer closed its end, or we are closing once write_buf drains
+        bool peer_closed = false;
+        bool closing = false;
+    };
+    // Messages are handed to handlers per channel, which is either the unmultiplexed messages on a connection
+    // or a single stream on a multiplexed connection, and each channel appears to the handler as a separate client
+    struct channel {
+        int conn;
+        // The stream ID of the channel, which is 0 for the unmultiplexed channel
+        uint32_t stream;
+        // Complete messages waiting to be given to the handler
+        std::deque<std::string> messages;
+        // Whether or not a handler thread currently owns the messages queue
+        bool dispatched = false;
+        // Whether the peer ended the channel, or we closed it
+        bool peer_closed = false;
+        bool closing = false;
+    };
+    // Connection and channel IDs share a counter and are never reused,
+    // so a stale ID held by a handler can never refer to a newer connection
+    struct server_state {
+        std::unordered_map<int, connection> conns;
+        std::unordered_map<int, channel> channels;
+        int next_id = 0;
+    };
+
+    // Waits for events on all sockets and services them until stopped
+    void event_loop();
+    // Accepts every pending connection on the listening socket
+    void accept_connections();
+    // Reads everything available from the connection and splits it into complete messages
+    void handle_readable(unlocked<server_state> &state, int conn_id);
+    // Adds a message received on the connection to the queue for its channel, opening or ending streams as needed
+    void receive_message(unlocked<server_state> &state, int conn_id, uint32_t stream, bool fin, std::string &&msg);
+    // Writes as much of the pending output for the connection as the socket will accept
+    // Returns false if the socket failed
+    auto flush_writes(connection &conn) -> bool;
+    // Dispatches queued messages and cleans up the channels of the connection, and the connection itself if done
+    void update_connection(unlocked<server_state> &state, int conn_id);
+    // Hands the channel's queued messages to a handler thread if none currently owns them
+    void dispatch(unlocked<server_state> &state, int client);
+    // Returns true if the handler will not be given any more messages from the channel
+    auto is_finished(channel const& chan) const -> bool;
+    // Runs the handler on each of the channel's queued messages in order until the queue is empty
+    void drain_messages(int client);
+    // Removes the connection and its channels from the event loop and closes its socket
+    void destroy_connection(unlocked<server_state> &state, int conn_id);
+
+    std::unique_ptr<logger> lg;
+    std::unique_ptr<threadpool> tp;
+    message_handler handler;
+
+    int server_fd;
+    int epoll_fd;
+    // An eventfd used to wake up the event loop when the server is stopped
+    int wakeup_fd;
+
+    locked<server_state> state_lock;
+
+    std::atomic<bool> running;
+    std::thread loop_thread;
+};
+
+// A persistent connection to a tcp_event_server which is shared by many pooled clients, each with its own stream
+class tcp_mux_connection : public tcp_utils {
+public:
+    tcp_mux_connection(std::unique_ptr<logger> lg_, int fd_);
+    ~tcp_mux_connection();
+    // Returns the ID of a newly opened stream
+    auto open_stream() -> uint32_t;
+    // Ends the stream and discards any messages received on it
+    void close_stream(uint32_t stream);
+    // Waits for the next message on the stream, returning an empty string if the stream or connection closed
+    auto read_from_stream(uint32_t stream) -> std::string;
+    // Returns number of bytes written, 0 if the stream is closed, and -1 on failure
+    auto write_to_stream(uint32_t stream, std::string const& data) -> ssize_t;
+    // Returns false once the connection has failed or been shut down
+    auto is_alive() -> bool;
+    // Fails the connection and all streams on it
+    void shutdown_connection();
+private:
+    // Receives messages and hands them to their streams until the connection fails
+    void read_loop();
+
+    struct stream_state {
+        std::queue<std::string> messages;
+        bool closed = false;
+    };
+    struct mux_state {
+        std::unordered_map<uint32_t, stream_state> streams;
+        uint32_t next_stream = 1; // Stream 0 is reserved for unmultiplexed messages
+        bool alive = true;
+    };
+    locked<mux_state> mux_state_lock;
+    std::condition_variable_any cv_messages;
+    // Held while writing a single frame so that frames from different streams are not interleaved
+    std::mutex write_mutex;
+
+    std::unique_ptr<logger> lg;
+    int fd;
+    std::thread reader_thread;
+};
+
+// A client that sends and receives messages on a single stream of a shared tcp_mux_connection
+class tcp_pooled_client_impl : public tcp_client {
+public:
+    tcp_pooled_client_impl(std::shared_ptr<tcp_mux_connection> conn_)
+        : conn(conn_), stream(conn->open_stream()) {}
+    ~tcp_pooled_client_impl() {
+        conn->close_stream(stream);
+    }
+    auto read_from_server() -> std::string {
+        return conn->read_from_stream(stream);
+    }
+    auto write_to_server(std::string const& data) -> ssize_t {
+        return conn->write_to_stream(stream, data);
+    }
+    auto write_file_to_server(int fd, size_t size) -> ssize_t {
+        return -1;
+    }
+    auto read_file_from_server(int fd) -> ssize_t {
+        return -1;
+    }
+private:
+    std::shared_ptr<tcp_mux_connection> conn;
+    uint32_t stream;
+};
+
 class tcp_factory_impl : public tcp_factory, public service_impl<tcp_factory_impl> {
 public:
     tcp_factory_impl(environment &env);
 
     auto get_tcp_client(std::string const& host, int port) -> std::unique_ptr<tcp_client>;
     auto get_tcp_server(int port) -> std::unique_ptr<tcp_server>;
+    auto get_tcp_event_server(int port, unsigned num_handlers) -> std::unique_ptr<tcp_event_server>;
+    auto get_pooled_tcp_client(std::string const& host, int port) -> std::unique_ptr<tcp_client>;
+    void evict_pooled_connections(std::string const& host);
+    void configure(bool nodelay, bool cork);
 
 private:
+    // Returns the options currently configured for new connections
+    auto get_socket_options() -> tcp_utils::socket_options;
+
     logger_factory *lg_fac;
+    threadpool_factory *tp_fac;
+
+    std::atomic<bool> nodelay;
+    std::atomic<bool> cork;
+
+    // A map from hostname to port to the pooled connection to that server
+    using connection_pool = std::unordered_map<std::string, std::unordered_map<int, std::shared_ptr<tcp_mux_connection>>>;
+    locked<connection_pool> pool_lock;
 };
\ No newline at end of file
@@ -7,10 +7,15 @@ auto threadpool_factory_impl::get_threadpool(unsigned num_threads) const -> std:
     return std::unique_ptr<threadpool>(new threadpool_impl(env, num_threads));
 }
 
+auto threadpool_factory_impl::get_work_stealing_threadpool(unsigned num_threads) const -> std::unique_ptr<threadpool> {
+    return std::unique_ptr<threadpool>(new work_stealing_threadpool_impl(env, num_threads));
+}
+
 threadpool_impl::threadpool_impl(environment &env, unsigned num_threads_)
     : num_threads(num_threads_)
     , lg(env.get<logger_factory>()->get_logger("threadpool"))
 {
+    tp_state_lock.profile_as("threadpool::tp_state_lock");
     unlocked<threadpool_state> tp_state = tp_state_lock();
 
     tp_state->running = true;
@@ -47,8 +52,8 @@ void threadpool_impl::finish() {
     }
 }
 
-void threadpool_impl::enqueue(std::function<void()> const& task) {
-    tp_state_lock()->tasks.push(task);
+void threadpool_impl::enqueue(task t) {
+    tp_state_lock()->tasks.push(std::move(t));
     cv_task.notify_one();
 }
 
@@ -57,7 +62,7 @@ void threadpool_impl::thread_fn(unsigned thread_index) {
     cv_started.notify_one();
 
     while (true) {
-        std::function<void()> task;
+        task t;
         {
             unlocked<threadpool_state> tp_state = tp_state_lock();
             cv_task.wait(tp_state.unsafe_get_mutex(), [&] {
@@ -68,15 +73,228 @@ void threadpool_impl::thread_fn(unsigned thread_index) {
                 break;
             }
 
-            task = tp_state->tasks.front();
+            t = std::move(tp_state->tasks.front());
             tp_state->tasks.pop();
             tp_state->working++;
         }
 
-        task();
+        t();
+        // Destroy the task's captures before finish can return
+        t = task();
         tp_state_lock()->working--;
         cv_finished.notify_all();
     }
 }
 
+template <typename T>
+work_stealing_deque<T>::work_stealing_deque() : top(0), bottom(0) {
+    rings.emplace_back(new ring(256));
+    items.store(rings.back().get(), std::memory_order_relaxed);
+}
+
+template <typename T>
+void work_stealing_deque<T>::push(T *item) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    ring *r = items.load(std::memory_order_relaxed);
+    if (b - t > r->capacity - 1) {
+        r = grow(r, b, t);
+    }
+    r->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+template <typename T>
+auto work_stealing_deque<T>::take() -> T* {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    ring *r = items.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        // The deque was empty
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    T *item = r->get(b);
+    if (t == b) {
+        // This is the last item, so we are racing against thieves for it
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            item = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return item;
+}
+
+template <typename T>
+auto work_stealing_deque<T>::steal() -> T* {
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+
+    if (t >= b) {
+        return nullptr;
+    }
+
+    T *item = items.load(std::memory_order_acquire)->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return item;
+}
+
+template <typename T>
+auto work_stealing_deque<T>::grow(ring *old_ring, int64_t b, int64_t t) -> ring* {
+    rings.emplace_back(new ring(old_ring->capacity * 2));
+    ring *new_ring = rings.back().get();
+    for (int64_t i = t; i < b; i++) {
+        new_ring->put(i, old_ring->get(i));
+    }
+    items.store(new_ring, std::memory_order_release);
+    return new_ring;
+}
+
+namespace {
+    // The work stealing threadpool and index of the thread running the current task, if there is one
+    thread_local work_stealing_threadpool_impl *current_pool = nullptr;
+    thread_local unsigned current_index = 0;
+}
+
+work_stealing_threadpool_impl::work_stealing_threadpool_impl(environment &env, unsigned num_threads_)
+    : num_threads(num_threads_), injected(nullptr), queued(0), pending(0), num_sleeping(0), running(true)
+    , lg(env.get<logger_factory>()->get_logger("work_stealing_threadpool"))
+{
+    for (unsigned i = 0; i < num_threads; i++) {
+        deques.emplace_back(new work_stealing_deque<task_node>());
+    }
+    for (unsigned i = 0; i < num_threads; i++) {
+        threads.push_back(std::thread([this, i] {
+            thread_fn(i);
+        }));
+    }
+}
+
+work_stealing_threadpool_impl::~work_stealing_threadpool_impl() {
+    if (running.load()) {
+        finish();
+    }
+
+    // Free any tasks that were enqueued after finish and never run
+    for (task_node *node = injected.exchange(nullptr); node != nullptr;) {
+        task_node *next = node->next;
+        delete node;
+        node = next;
+    }
+    for (auto &deque : deques) {
+        while (task_node *node = deque->take()) {
+            delete node;
+        }
+    }
+}
+
+void work_stealing_threadpool_impl::finish() {
+    {
+        std::unique_lock<std::mutex> guard(sleep_mutex);
+        cv_finished.wait(guard, [&] {
+            return pending.load() == 0;
+        });
+        running = false;
+    }
+    cv_task.notify_all();
+    for (unsigned i = 0; i < num_threads; i++) {
+        threads[i].join();
+    }
+}
+
+void work_stealing_threadpool_impl::enqueue(task t) {
+    task_node *node = new task_node{std::move(t), nullptr};
+    pending++;
+    queued++;
+
+    if (current_pool == this) {
+        deques[current_index]->push(node);
+    } else {
+        node->next = injected.load(std::memory_order_relaxed);
+        while (!injected.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Only wake up a thread if one is asleep, which it could only be if it saw queued == 0 before we incremented it
+    if (num_sleeping.load() > 0) {
+        { std::lock_guard<std::mutex> guard(sleep_mutex); }
+        cv_task.notify_one();
+    }
+}
+
+auto work_stealing_threadpool_impl::take_injected(unsigned thread_index) -> task_node* {
+    task_node *node = injected.exchange(nullptr, std::memory_order_acquire);
+    if (node == nullptr) {
+        return nullptr;
+    }
+
+    // The stack is ordered from newest to oldest, so push everything but the oldest task onto our own deque
+    // and run the oldest task now
+    for (; node->next != nullptr; node = node->next) {
+        deques[thread_index]->push(node);
+    }
+    return node;
+}
+
+auto work_stealing_threadpool_impl::steal(unsigned thread_index) -> task_node* {
+    for (unsigned i = 1; i < num_threads; i++) {
+        if (task_node *node = deques[(thread_index + i) % num_threads]->steal()) {
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+void work_stealing_threadpool_impl::thread_fn(unsigned thread_index) {
+    current_pool = this;
+    current_index = thread_index;
+
+    while (true) {
+        task_node *task = deques[thread_index]->take();
+        if (task == nullptr) {
+            task = take_injected(thread_index);
+        }
+        if (task == nullptr) {
+            task = steal(thread_index);
+        }
+
+        if (task == nullptr) {
+            // A task was enqueued but we lost the race for it or it is not yet visible, so try again
+            if (queued.load() > 0) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(sleep_mutex);
+            num_sleeping++;
+            cv_task.wait(guard, [&] {
+                return queued.load() > 0 || !running.load();
+            });
+            num_sleeping--;
+
+            if (!running.load() && queued.load() == 0) {
+                break;
+            }
+            continue;
+        }
+
+        queued--;
+        task->fn();
+        delete task;
+
+        // Only take the lock to wake up finish when the last pending task completes
+        if (pending.fetch_sub(1) == 1) {
+            { std::lock_guard<std::mutex> guard(sleep_mutex); }
+            cv_finished.notify_all();
+        }
+    }
+}
+
 register_auto<threadpool_factory, threadpool_factory_impl> register_threadpool_factory;
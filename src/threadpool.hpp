@@ -11,6 +11,8 @@
 #include <condition_variable>
 #include <atomic>
 #include <memory>
+#include <mutex>
+#include <cstdint>
 
 class threadpool_impl : public threadpool {
 public:
@@ -19,7 +21,7 @@ public:
 
     // Must be called before destructor and completely after any calls to enqueue
     void finish();
-    void enqueue(std::function<void()> const& task);
+    void enqueue(task t);
 
 private:
     void thread_fn(unsigned thread_index);
@@ -30,7 +32,7 @@ private:
     struct threadpool_state {
         bool running;
         unsigned num_started;
-        std::queue<std::function<void()>> tasks;
+        std::queue<task> tasks;
         unsigned working;
     };
     locked<threadpool_state> tp_state_lock;
@@ -39,11 +41,89 @@ private:
     std::unique_ptr<logger> lg;
 };
 
+// A Chase-Lev deque of tasks, where the owning thread pushes and takes from the bottom and any other thread can
+// steal from the top without taking a lock
+template <typename T>
+class work_stealing_deque {
+public:
+    work_stealing_deque();
+
+    // Must only be called by the owning thread
+    void push(T *item);
+    auto take() -> T*;
+
+    // May be called by any thread, returns nullptr if the deque is empty or another thread won the race
+    auto steal() -> T*;
+
+private:
+    struct ring {
+        ring(int64_t capacity_) : capacity(capacity_), items(new std::atomic<T*>[capacity_]) {}
+
+        auto get(int64_t i) const -> T* {
+            return items[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+        void put(int64_t i, T *item) {
+            items[i & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+
+        int64_t capacity;
+        std::unique_ptr<std::atomic<T*>[]> items;
+    };
+
+    auto grow(ring *old_ring, int64_t bottom, int64_t top) -> ring*;
+
+    std::atomic<int64_t> top, bottom;
+    std::atomic<ring*> items;
+    // Rings that have been outgrown are kept until the deque is destroyed, since a thief may still be reading one
+    std::vector<std::unique_ptr<ring>> rings;
+};
+
+class work_stealing_threadpool_impl : public threadpool {
+public:
+    work_stealing_threadpool_impl(environment &env, unsigned num_threads_);
+    ~work_stealing_threadpool_impl();
+
+    // Must be called before destructor and completely after any calls to enqueue from outside the threadpool
+    void finish();
+    // Tasks enqueued by a task running in the threadpool go onto the deque of the thread running it
+    void enqueue(task t);
+
+private:
+    struct task_node {
+        task fn;
+        task_node *next;
+    };
+
+    void thread_fn(unsigned thread_index);
+    // Moves everything in the injection queue into the deque of the given thread and takes the oldest task
+    auto take_injected(unsigned thread_index) -> task_node*;
+    auto steal(unsigned thread_index) -> task_node*;
+
+    unsigned num_threads;
+    std::vector<std::thread> threads;
+    std::vector<std::unique_ptr<work_stealing_deque<task_node>>> deques;
+
+    // Tasks enqueued from outside the threadpool are pushed onto a lock-free stack, which the threads empty all
+    // at once so that there is no ABA problem
+    std::atomic<task_node*> injected;
+
+    // The number of tasks that have been enqueued but not started, and enqueued but not completed
+    std::atomic<unsigned> queued, pending;
+    std::atomic<unsigned> num_sleeping;
+    std::atomic<bool> running;
+    // Only used to put threads to sleep when there is nothing to do, and to wait for pending to reach 0
+    std::mutex sleep_mutex;
+    std::condition_variable cv_task, cv_finished;
+
+    std::unique_ptr<logger> lg;
+};
+
 class threadpool_factory_impl : public threadpool_factory, public service_impl<threadpool_factory_impl> {
 public:
     threadpool_factory_impl(environment &env_) : env(env_) {}
 
     auto get_threadpool(unsigned num_threads) const -> std::unique_ptr<threadpool>;
+    auto get_work_stealing_threadpool(unsigned num_threads) const -> std::unique_ptr<threadpool>;
 
 private:
     environment &env;
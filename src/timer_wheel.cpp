@@ -0,0 +1,259 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+timer_wheel_impl::timer_wheel_impl(environment &env)
+    : start_time(std::chrono::steady_clock::now())
+    , lg(env.get<logger_factory>()->get_logger("timer_wheel"))
+{
+    wh_state_lock.profile_as("timer_wheel::wh_state_lock");
+}
+
+timer_wheel_impl::~timer_wheel_impl() {
+    bool started;
+    {
+        unlocked<wheel_state> wh_state = wh_state_lock();
+        wh_state->running = false;
+        started = wh_state->started;
+    }
+    cv.notify_all();
+    if (started) {
+        timer_thread.join();
+    }
+
+    unlocked<wheel_state> wh_state = wh_state_lock();
+    for (auto const& [id, entry] : wh_state->timers) {
+        delete entry;
+    }
+}
+
+auto timer_wheel_impl::schedule(uint64_t delay_ms, task fn) -> timer_id {
+    return add_timer(delay_ms, 0, std::move(fn));
+}
+
+auto timer_wheel_impl::schedule_repeating(uint64_t interval_ms, task fn) -> timer_id {
+    // An interval of 0 would keep the timer thread calling the callback forever
+    return add_timer(interval_ms, std::max<uint64_t>(interval_ms, 1), std::move(fn));
+}
+
+auto timer_wheel_impl::cancel(timer_id id) -> bool {
+    unlocked<wheel_state> wh_state = wh_state_lock();
+
+    auto it = wh_state->timers.find(id);
+    if (it == wh_state->timers.end()) {
+        return false;
+    }
+
+    timer_entry *entry = it->second;
+    if (entry->list != nullptr) {
+        unlink(entry);
+        wh_state->timers.erase(it);
+        delete entry;
+        return true;
+    }
+
+    // The entry is being called right now, so the timer thread will free it once the call finishes
+    bool was_cancelled = entry->cancelled;
+    entry->cancelled = true;
+    return !was_cancelled && entry->interval_ms > 0;
+}
+
+auto timer_wheel_impl::add_timer(uint64_t delay_ms, uint64_t interval_ms, task fn) -> timer_id {
+    timer_id id;
+    bool needs_thread = false;
+    {
+        unlocked<wheel_state> wh_state = wh_state_lock();
+
+        // The delay is measured from now rather than from the last tick the timer thread processed, which may be
+        // up to a whole rotation of the first level ago if the thread is asleep
+        uint64_t now = now_tick();
+        if (wh_state->current_tick > now) {
+            now = wh_state->current_tick;
+        }
+
+        timer_entry *entry = new timer_entry{wh_state->next_id++, now + delay_ms, interval_ms,
+            std::move(fn), nullptr, nullptr, nullptr, false};
+        id = entry->id;
+        wh_state->timers[id] = entry;
+        insert(*wh_state, entry);
+
+        if (!wh_state->started) {
+            wh_state->started = true;
+            needs_thread = true;
+        }
+    }
+
+    if (needs_thread) {
+        timer_thread = std::thread([this] {
+            thread_fn();
+        });
+    }
+    cv.notify_all();
+    return id;
+}
+
+void timer_wheel_impl::insert(wheel_state &state, timer_entry *entry) {
+    // Entries that are already due go into the slot for the current tick so they are called at the next tick
+    uint64_t expiry = std::max(entry->expiry, state.current_tick);
+    uint64_t delta = expiry - state.current_tick;
+
+    timer_entry **list;
+    if (delta < first_level_size) {
+        list = &state.first_level[expiry & (first_level_size - 1)];
+    } else {
+        list = &state.overflow;
+        for (unsigned level = 0; level < num_levels - 1; level++) {
+            unsigned shift = first_level_bits + (level + 1) * level_bits;
+            if (delta < (uint64_t(1) << shift)) {
+                unsigned index = (expiry >> (shift - level_bits)) & (level_size - 1);
+                list = &state.levels[level][index];
+                break;
+            }
+        }
+    }
+
+    entry->list = list;
+    entry->prev = nullptr;
+    entry->next = *list;
+    if (*list != nullptr) {
+        (*list)->prev = entry;
+    }
+    *list = entry;
+}
+
+void timer_wheel_impl::unlink(timer_entry *entry) {
+    if (entry->prev != nullptr) {
+        entry->prev->next = entry->next;
+    } else {
+        *entry->list = entry->next;
+    }
+    if (entry->next != nullptr) {
+        entry->next->prev = entry->prev;
+    }
+    entry->list = nullptr;
+    entry->prev = nullptr;
+    entry->next = nullptr;
+}
+
+void timer_wheel_impl::cascade(wheel_state &state, timer_entry *&list) {
+    timer_entry *entry = list;
+    list = nullptr;
+    while (entry != nullptr) {
+        timer_entry *next = entry->next;
+        insert(state, entry);
+        entry = next;
+    }
+}
+
+void timer_wheel_impl::advance(wheel_state &state, std::vector<timer_entry*> &due) {
+    uint64_t tick = state.current_tick;
+
+    // When the first level wraps around, refill it from the next slot of the level above, and likewise for each level
+    if ((tick & (first_level_size - 1)) == 0) {
+        bool cascaded_all = true;
+        for (unsigned level = 0; level < num_levels - 1; level++) {
+            unsigned shift = first_level_bits + level * level_bits;
+            unsigned index = (tick >> shift) & (level_size - 1);
+            cascade(state, state.levels[level][index]);
+            if (index != 0) {
+                cascaded_all = false;
+                break;
+            }
+        }
+        if (cascaded_all) {
+            cascade(state, state.overflow);
+        }
+    }
+
+    timer_entry *&slot = state.first_level[tick & (first_level_size - 1)];
+    for (timer_entry *entry = slot; entry != nullptr; entry = entry->next) {
+        assert(entry->expiry <= tick);
+        entry->list = nullptr;
+        due.push_back(entry);
+    }
+    slot = nullptr;
+
+    state.current_tick++;
+}
+
+auto timer_wheel_impl::next_wakeup(wheel_state const& state) const -> uint64_t {
+    // Every entry not in the first level will next move at the start of a rotation of the first level
+    if ((state.current_tick & (first_level_size - 1)) == 0) {
+        return state.current_tick;
+    }
+    uint64_t next_rotation = (state.current_tick | (first_level_size - 1)) + 1;
+    for (uint64_t tick = state.current_tick; tick < next_rotation; tick++) {
+        if (state.first_level[tick & (first_level_size - 1)] != nullptr) {
+            return tick;
+        }
+    }
+    return next_rotation;
+}
+
+auto timer_wheel_impl::now_tick() const -> uint64_t {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+}
+
+void timer_wheel_impl::thread_fn() {
+    std::vector<timer_entry*> due;
+
+    while (true) {
+        {
+            unlocked<wheel_state> wh_state = wh_state_lock();
+            while (wh_state->running && due.empty()) {
+                if (wh_state->timers.empty()) {
+                    cv.wait(wh_state.unsafe_get_mutex());
+                    continue;
+                }
+
+                uint64_t now = now_tick();
+                if (wh_state->current_tick > now) {
+                    // Sleep until the next tick that has anything to do, or until a new timer is scheduled
+                    uint64_t wakeup = next_wakeup(*wh_state);
+                    cv.wait_until(wh_state.unsafe_get_mutex(), start_time + std::chrono::milliseconds(wakeup));
+                    continue;
+                }
+
+                // Process every tick up to and including the current one, skipping empty stretches of the first level
+                while (wh_state->current_tick <= now) {
+                    uint64_t next = std::min(next_wakeup(*wh_state), now + 1);
+                    wh_state->current_tick = next;
+                    if (next <= now) {
+                        advance(*wh_state, due);
+                    }
+                }
+            }
+
+            if (!wh_state->running) {
+                // The destructor frees the entries that are due along with all the others
+                return;
+            }
+        }
+
+        // Call the callbacks without holding the lock so that they can schedule and cancel timers
+        for (timer_entry *entry : due) {
+            try {
+                entry->fn();
+            } catch (...) {
+                lg->info("Timer callback threw an exception");
+            }
+        }
+
+        unlocked<wheel_state> wh_state = wh_state_lock();
+        for (timer_entry *entry : due) {
+            if (entry->interval_ms > 0 && !entry->cancelled) {
+                // Schedule the next call relative to when this one was due so that repeating timers do not drift
+                entry->expiry = std::max(entry->expiry + entry->interval_ms, wh_state->current_tick);
+                insert(*wh_state, entry);
+            } else {
+                wh_state->timers.erase(entry->id);
+                delete entry;
+            }
+        }
+        due.clear();
+    }
+}
+
+register_auto<timer_wheel, timer_wheel_impl> register_timer_wheel;
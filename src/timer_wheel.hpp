@@ -0,0 +1,89 @@
+#pragma once
+
+#include "timer_wheel.h"
+#include "environment.h"
+#include "service.h"
+#include "logging.h"
+#include "locking.h"
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// A hierarchical timer wheel with a resolution of 1ms
+// The first level has a slot for each of the next 256 ticks, and each slot in a higher level covers all of the
+// level below it. When the first level wraps around, the next slot of the level above is cascaded down into the
+// levels below, so scheduling and cancelling take constant time no matter how many timers there are
+// Timers further out than the last level can reach wait in an overflow list until they come into range
+class timer_wheel_impl : public timer_wheel, public service_impl<timer_wheel_impl> {
+public:
+    timer_wheel_impl(environment &env);
+    ~timer_wheel_impl();
+
+    auto schedule(uint64_t delay_ms, task fn) -> timer_id;
+    auto schedule_repeating(uint64_t interval_ms, task fn) -> timer_id;
+    auto cancel(timer_id id) -> bool;
+
+private:
+    static constexpr unsigned first_level_bits = 8;
+    static constexpr unsigned level_bits = 6;
+    static constexpr unsigned num_levels = 4;
+    static constexpr uint64_t first_level_size = 1 << first_level_bits;
+    static constexpr uint64_t level_size = 1 << level_bits;
+
+    struct timer_entry {
+        timer_id id;
+        // The tick at which the callback is due
+        uint64_t expiry;
+        // The time between calls of a repeating callback, or 0 for a callback that is only called once
+        uint64_t interval_ms;
+        task fn;
+
+        // The list the entry is in while it is waiting in the wheel, or nullptr once it is due
+        timer_entry **list;
+        timer_entry *prev;
+        timer_entry *next;
+        // Set when the entry is cancelled after it has been taken out of the wheel to be called
+        bool cancelled;
+    };
+
+    struct wheel_state {
+        // Every tick before this one has been processed
+        uint64_t current_tick = 0;
+        std::array<timer_entry*, first_level_size> first_level{};
+        std::array<std::array<timer_entry*, level_size>, num_levels - 1> levels{};
+        timer_entry *overflow = nullptr;
+
+        // Every entry that has not finished being called for the last time, by ID
+        std::unordered_map<timer_id, timer_entry*> timers;
+        timer_id next_id = 1;
+
+        bool started = false;
+        bool running = true;
+    };
+
+    auto add_timer(uint64_t delay_ms, uint64_t interval_ms, task fn) -> timer_id;
+    // Links the entry into the list for its expiry relative to the current tick
+    void insert(wheel_state &state, timer_entry *entry);
+    void unlink(timer_entry *entry);
+    // Moves every entry in the list back into the wheel relative to the current tick
+    void cascade(wheel_state &state, timer_entry *&list);
+    // Processes the tick at current_tick, moving every entry that is due into due
+    void advance(wheel_state &state, std::vector<timer_entry*> &due);
+    // The tick at which the thread next needs to wake up to process the wheel
+    auto next_wakeup(wheel_state const& state) const -> uint64_t;
+
+    auto now_tick() const -> uint64_t;
+    void thread_fn();
+
+    std::chrono::steady_clock::time_point start_time;
+    std::unique_ptr<logger> lg;
+
+    locked<wheel_state> wh_state_lock;
+    std::condition_variable_any cv;
+    std::thread timer_thread;
+};
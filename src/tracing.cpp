@@ -0,0 +1,285 @@
+#include "tracing.h"
+#include "tracing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using std::string;
+
+trace_writer::trace_writer(string const& dir_, string const& hostname_, uint64_t file_size_, unsigned num_files_)
+    : dir(dir_), hostname(hostname_), file_size(file_size_), num_files(std::max(num_files_, 1u))
+{
+    // Delete the files from any previous run, so that they are not mixed up with the new ones
+    DIR *d = opendir(dir.c_str());
+    if (d != nullptr) {
+        string prefix = hostname + ".";
+        for (struct dirent *entry = readdir(d); entry != nullptr; entry = readdir(d)) {
+            string name = entry->d_name;
+            if (name.size() <= prefix.size() + 6 || name.compare(0, prefix.size(), prefix) != 0 ||
+                name.compare(name.size() - 6, 6, ".trace") != 0)
+            {
+                continue;
+            }
+            string seq = name.substr(prefix.size(), name.size() - 6 - prefix.size());
+            if (std::all_of(seq.begin(), seq.end(), [] (char c) {return c >= '0' && c <= '9';})) {
+                unlink((dir + name).c_str());
+            }
+        }
+        closedir(d);
+    }
+
+    std::atomic_store(&current, open_segment(sequence));
+}
+
+trace_writer::segment::~segment() {
+    if (data) {
+        munmap(data, capacity);
+    }
+    if (fd >= 0) {
+        // Cut off the part of the file that was never written to
+        if (ftruncate(fd, std::min(offset.load(), capacity))) {}
+        close(fd);
+    }
+}
+
+auto trace_writer::segment_path(uint64_t seq) const -> string {
+    return dir + hostname + "." + std::to_string(seq) + ".trace";
+}
+
+auto trace_writer::open_segment(uint64_t seq) -> std::shared_ptr<segment> {
+    std::shared_ptr<segment> seg = std::make_shared<segment>();
+
+    string path = segment_path(seq);
+    seg->fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (seg->fd < 0 || ftruncate(seg->fd, file_size) != 0) {
+        // Leave the segment with no space, so that every event is dropped
+        return seg;
+    }
+
+    void *data = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+    if (data == MAP_FAILED) {
+        return seg;
+    }
+    seg->data = static_cast<char*>(data);
+    seg->capacity = file_size;
+
+    // Write the header, which leaves the offset pointing at the first event
+    uint32_t hostname_len = hostname.size();
+    memcpy(seg->data, magic, sizeof(magic));
+    memcpy(seg->data + sizeof(magic), &hostname_len, sizeof(hostname_len));
+    memcpy(seg->data + sizeof(magic) + sizeof(hostname_len), hostname.data(), hostname_len);
+    seg->offset = sizeof(magic) + sizeof(hostname_len) + hostname_len;
+    return seg;
+}
+
+void trace_writer::write(trace_component component, trace_event ev, std::initializer_list<trace_arg> args) {
+    uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    uint32_t size = event_header_size;
+    for (trace_arg const& arg : args) {
+        size += 1 + (arg.is_string ? sizeof(uint32_t) + arg.string_value.size() : sizeof(int64_t));
+    }
+    // An event that could never fit in a file is dropped
+    if (size > file_size / 2) {
+        return;
+    }
+
+    while (true) {
+        std::shared_ptr<segment> seg = std::atomic_load(&current);
+        if (seg->capacity == 0) {
+            return;
+        }
+
+        uint64_t off = seg->offset.fetch_add(size);
+        if (off + size > seg->capacity) {
+            rotate(seg);
+            continue;
+        }
+
+        char *pos = seg->data + off;
+        auto put = [&] (void const* src, size_t n) {
+            memcpy(pos, src, n);
+            pos += n;
+        };
+        uint16_t component_id = static_cast<uint16_t>(component);
+        uint16_t event_id = static_cast<uint16_t>(ev);
+        uint8_t num_args = args.size();
+        put(&size, sizeof(size));
+        put(&timestamp, sizeof(timestamp));
+        put(&component_id, sizeof(component_id));
+        put(&event_id, sizeof(event_id));
+        put(&num_args, sizeof(num_args));
+        for (trace_arg const& arg : args) {
+            uint8_t type = arg.is_string ? string_arg : int_arg;
+            put(&type, sizeof(type));
+            if (arg.is_string) {
+                uint32_t len = arg.string_value.size();
+                put(&len, sizeof(len));
+                put(arg.string_value.data(), len);
+            } else {
+                put(&arg.int_value, sizeof(arg.int_value));
+            }
+        }
+        return;
+    }
+}
+
+void trace_writer::rotate(std::shared_ptr<segment> const& full) {
+    std::lock_guard<std::mutex> guard(rotate_mutex);
+    if (std::atomic_load(&current) != full) {
+        return;
+    }
+
+    sequence++;
+    std::atomic_store(&current, open_segment(sequence));
+    if (sequence >= num_files) {
+        unlink(segment_path(sequence - num_files).c_str());
+    }
+}
+
+namespace {
+// Reads the events of a single trace file into events, stopping at the end of the file or at the first event that was
+// never completely written
+void read_file(string const& path, std::vector<decoded_trace_event> &events) {
+    std::ifstream stream(path, std::ios::binary);
+    string contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+
+    size_t pos = 0;
+    auto get = [&] (void *dest, size_t n) -> bool {
+        if (pos + n > contents.size()) {
+            return false;
+        }
+        memcpy(dest, contents.data() + pos, n);
+        pos += n;
+        return true;
+    };
+
+    char magic[sizeof(trace_writer::magic)];
+    uint32_t hostname_len;
+    if (!get(magic, sizeof(magic)) || memcmp(magic, trace_writer::magic, sizeof(magic)) != 0 ||
+        !get(&hostname_len, sizeof(hostname_len)) || pos + hostname_len > contents.size())
+    {
+        return;
+    }
+    string hostname = contents.substr(pos, hostname_len);
+    pos += hostname_len;
+
+    while (true) {
+        size_t start = pos;
+        uint32_t size;
+        decoded_trace_event ev;
+        uint16_t component_id, event_id;
+        uint8_t num_args;
+        if (!get(&size, sizeof(size)) || size < trace_writer::event_header_size || start + size > contents.size() ||
+            !get(&ev.timestamp_ns, sizeof(ev.timestamp_ns)) || !get(&component_id, sizeof(component_id)) ||
+            !get(&event_id, sizeof(event_id)) || !get(&num_args, sizeof(num_args)) ||
+            component_id >= static_cast<uint16_t>(trace_component::num_components) ||
+            event_id >= static_cast<uint16_t>(trace_event::num_events))
+        {
+            return;
+        }
+        ev.hostname = hostname;
+        ev.component = static_cast<trace_component>(component_id);
+        ev.event = static_cast<trace_event>(event_id);
+
+        for (unsigned i = 0; i < num_args; i++) {
+            uint8_t type;
+            if (!get(&type, sizeof(type))) {
+                return;
+            }
+            if (type == trace_writer::string_arg) {
+                uint32_t len;
+                if (!get(&len, sizeof(len)) || pos + len > start + size) {
+                    return;
+                }
+                ev.args.push_back(contents.substr(pos, len));
+                pos += len;
+            } else {
+                int64_t value;
+                if (!get(&value, sizeof(value))) {
+                    return;
+                }
+                ev.args.push_back(value);
+            }
+        }
+        if (pos != start + size) {
+            return;
+        }
+        events.push_back(std::move(ev));
+    }
+}
+}
+
+auto trace_decoder::read_dir(string const& dir) -> std::vector<decoded_trace_event> {
+    std::vector<decoded_trace_event> events;
+
+    DIR *d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return events;
+    }
+    std::vector<string> paths;
+    for (struct dirent *entry = readdir(d); entry != nullptr; entry = readdir(d)) {
+        string name = entry->d_name;
+        if (name.size() > 6 && name.compare(name.size() - 6, 6, ".trace") == 0) {
+            paths.push_back(dir + (dir.back() == '/' ? "" : "/") + name);
+        }
+    }
+    closedir(d);
+
+    // Read each node's files in the order they were written, so that events with the same timestamp stay in order
+    auto sequence_of = [] (string const& path) {
+        size_t end = path.size() - 6;
+        size_t start = path.rfind('.', end - 1) + 1;
+        return std::make_pair(path.substr(0, start), std::strtoull(path.c_str() + start, nullptr, 10));
+    };
+    std::sort(paths.begin(), paths.end(), [&] (string const& a, string const& b) {
+        return sequence_of(a) < sequence_of(b);
+    });
+    for (string const& path : paths) {
+        read_file(path, events);
+    }
+    std::stable_sort(events.begin(), events.end(), [] (decoded_trace_event const& a, decoded_trace_event const& b) {
+        return a.timestamp_ns < b.timestamp_ns;
+    });
+    return events;
+}
+
+auto trace_decoder::format(decoded_trace_event const& ev) -> string {
+    time_t seconds = ev.timestamp_ns / 1000000000;
+    struct tm local;
+    localtime_r(&seconds, &local);
+    char time_buf[32];
+    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &local);
+    char ns_buf[16];
+    snprintf(ns_buf, sizeof(ns_buf), ".%09lu", static_cast<unsigned long>(ev.timestamp_ns % 1000000000));
+
+    trace_event_schema const& schema = trace_event_schemas[static_cast<uint16_t>(ev.event)];
+    string line = string("[") + time_buf + ns_buf + "] " + ev.hostname + " " +
+        trace_component_names[static_cast<uint16_t>(ev.component)] + " " + schema.name;
+
+    for (unsigned i = 0; i < ev.args.size(); i++) {
+        // Arguments past the ones in the schema come from a newer version of the schema
+        bool named = true;
+        for (unsigned j = 0; j <= i; j++) {
+            named = named && j < std::size(schema.args) && schema.args[j] != nullptr;
+        }
+        line += " " + (named ? string(schema.args[i]) : "arg" + std::to_string(i)) + "=";
+
+        if (std::holds_alternative<int64_t>(ev.args[i])) {
+            line += std::to_string(std::get<int64_t>(ev.args[i]));
+        } else {
+            line += std::get<string>(ev.args[i]);
+        }
+    }
+    return line;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "tracing.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Writes trace events into a memory mapped file, moving on to a new file when it fills up
+// Writers reserve space for an event with a single atomic add and then copy it into the mapping, so events from
+// different threads never wait on each other except when the file is being rotated
+// Files are named <dir><hostname>.<sequence number>.trace and each starts with a header holding the hostname
+// Each event is laid out as:
+//   uint32 size of the event | uint64 timestamp in ns since the epoch | uint16 component | uint16 event | uint8 # args
+// followed by each argument as a uint8 type and then an int64, or a uint32 length and the characters of a string
+class trace_writer {
+public:
+    trace_writer(std::string const& dir_, std::string const& hostname_, uint64_t file_size_, unsigned num_files_);
+
+    void write(trace_component component, trace_event ev, std::initializer_list<trace_arg> args);
+
+    static constexpr char magic[8] = {'M', 'J', 'T', 'R', 'A', 'C', 'E', '1'};
+    static constexpr uint64_t event_header_size = sizeof(uint32_t) + sizeof(uint64_t) + 2 * sizeof(uint16_t) + 1;
+    enum arg_type : uint8_t {int_arg, string_arg};
+
+private:
+    struct segment {
+        ~segment();
+
+        int fd = -1;
+        char *data = nullptr;
+        uint64_t capacity = 0;
+        // The offset that the next event will be written at, which may go past capacity once the file is full
+        std::atomic<uint64_t> offset = 0;
+    };
+
+    auto open_segment(uint64_t sequence) -> std::shared_ptr<segment>;
+    auto segment_path(uint64_t sequence) const -> std::string;
+    // Replaces the full segment with a new one, unless another thread already has
+    void rotate(std::shared_ptr<segment> const& full);
+
+    std::string dir;
+    std::string hostname;
+    uint64_t file_size;
+    unsigned num_files;
+
+    // Accessed with std::atomic_load and std::atomic_store, so that writers can keep using a segment while it is
+    // being replaced, and it is only unmapped once the last of them is done
+    std::shared_ptr<segment> current;
+    std::mutex rotate_mutex;
+    uint64_t sequence = 0;
+};
+
+class trace_writer_tracer : public tracer {
+public:
+    trace_writer_tracer(std::shared_ptr<trace_writer> writer_, trace_component component_)
+        : writer(writer_), component(component_) {}
+
+    auto enabled() const -> bool {
+        return writer != nullptr;
+    }
+
+    void event(trace_event ev, std::initializer_list<trace_arg> args) const {
+        if (writer) {
+            writer->write(component, ev, args);
+        }
+    }
+
+private:
+    std::shared_ptr<trace_writer> writer;
+    trace_component component;
+};
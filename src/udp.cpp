@@ -7,6 +7,19 @@ extern int errno;
 
 using std::string;
 
+udp_server_impl::udp_server_impl(environment &env)
+    : batch_buffers(new char[max_batch_size * max_packet_size]), lg(env.get<logger_factory>()->get_logger("udp_server"))
+{
+    // The message headers always point at the same buffers, so they only need to be set up once
+    memset(batch_msgs, 0, sizeof(batch_msgs));
+    for (unsigned i = 0; i < max_batch_size; i++) {
+        batch_iovs[i].iov_base = batch_buffers.get() + i * max_packet_size;
+        batch_iovs[i].iov_len = max_packet_size;
+        batch_msgs[i].msg_hdr.msg_iov = &batch_iovs[i];
+        batch_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
 // Starts the server on the given port
 void udp_server_impl::start_server(int port) {
     server_fd = create_udp_server(port);
@@ -24,12 +37,29 @@ auto udp_server_impl::recv(char *buf, unsigned length) -> int {
 
     int msg_size = recvfrom(server_fd, buf, length, 0, (struct sockaddr*)&client_sa, &client_len);
     if (msg_size < 0) {
-        lg->trace("Unexpected error in receiving UDP packet, errno " + std::to_string(errno));
+        lg->trace("Unexpected error in receiving UDP packet, errno ", errno);
     }
 
     return msg_size;
 }
 
+// Blocks until a packet arrives, then receives it along with any others that are already waiting
+auto udp_server_impl::recv_batch(std::vector<std::string_view> &packets) -> int {
+    packets.clear();
+
+    // Block for the first packet only, and take whatever else has arrived by then
+    int n = recvmmsg(server_fd, batch_msgs, max_batch_size, MSG_WAITFORONE, NULL);
+    if (n < 0) {
+        lg->trace("Unexpected error in receiving UDP packets, errno ", errno);
+        return n;
+    }
+
+    for (int i = 0; i < n; i++) {
+        packets.push_back(std::string_view(static_cast<char*>(batch_iovs[i].iov_base), batch_msgs[i].msg_len));
+    }
+    return n;
+}
+
 // Creates fd to receive incoming messages sent via UDP
 // Returns a socket fd, otherwise -1 on failure.
 auto udp_server_impl::create_udp_server(int port) -> int {
@@ -54,21 +84,82 @@ auto udp_server_impl::create_udp_server(int port) -> int {
     return server_fd;
 }
 
+udp_client_impl::udp_client_impl(environment &env) : lg(env.get<logger_factory>()->get_logger("udp_client")) {
+    client_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (client_socket == -1) {
+        perror("socket failed");
+        exit(1);
+    }
+}
+
+udp_client_impl::~udp_client_impl() {
+    close(client_socket);
+}
+
 // Sends a UDP packet to the specified destination
 void udp_client_impl::send(string const& host, int port, string const& msg) {
-    udp_client_info conn = create_udp_client(host, std::to_string(port));
-    if (conn.client_socket == -1) return;
+    struct sockaddr_in addr;
+    if (!resolve(host, port, addr)) {
+        return;
+    }
 
-    // Send the message and close the connection
-    sendto(conn.client_socket, msg.c_str(), msg.length(), 0, &conn.addr, sizeof(conn.addr));
-    close(conn.client_socket);
+    sendto(client_socket, msg.c_str(), msg.length(), 0, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
 }
 
-// Creates a UDP connection to a given host and port.
-// Returns a socket fd to the host, otherwise crashes on failure.
-auto udp_client_impl::create_udp_client(string const& host, string const& port) -> udp_client_info {
-    int client_socket;
-    udp_client_info ret;
+// Sends the same UDP packet to each of the destinations, in as few system calls as possible
+void udp_client_impl::send_all(std::vector<string> const& hosts, int port, string const& msg) {
+    struct sockaddr_in addrs[max_batch_size];
+    struct mmsghdr msgs[max_batch_size];
+    // Every packet shares the same buffer, which sendmmsg only reads
+    struct iovec iov;
+    iov.iov_base = const_cast<char*>(msg.c_str());
+    iov.iov_len = msg.length();
+
+    auto it = hosts.begin();
+    while (it != hosts.end()) {
+        unsigned batch_size = 0;
+        for (; it != hosts.end() && batch_size < max_batch_size; ++it) {
+            if (!resolve(*it, port, addrs[batch_size])) {
+                continue;
+            }
+
+            memset(&msgs[batch_size], 0, sizeof(struct mmsghdr));
+            msgs[batch_size].msg_hdr.msg_name = &addrs[batch_size];
+            msgs[batch_size].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msgs[batch_size].msg_hdr.msg_iov = &iov;
+            msgs[batch_size].msg_hdr.msg_iovlen = 1;
+            batch_size++;
+        }
+
+        // sendmmsg may stop early, in which case the rest of the batch is sent with another call
+        unsigned sent = 0;
+        while (sent < batch_size) {
+            int n = sendmmsg(client_socket, msgs + sent, batch_size - sent, 0);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                // The packet that failed is dropped, as a failed sendto would drop it
+                lg->trace("sendmmsg failed with errno ", errno);
+                n = 1;
+            }
+            sent += n;
+        }
+    }
+}
+
+// Resolves the address of host with the given port, using the cached address if it was resolved before
+// Returns false if the host could not be resolved
+auto udp_client_impl::resolve(string const& host, int port, struct sockaddr_in &addr) -> bool {
+    {
+        unlocked<std::unordered_map<string, struct sockaddr_in>> addr_cache = addr_cache_lock();
+        auto it = addr_cache->find(host);
+        if (it != addr_cache->end()) {
+            addr = it->second;
+            addr.sin_port = htons(port);
+            return true;
+        }
+    }
 
     struct addrinfo info, *res;
 
@@ -78,25 +169,21 @@ auto udp_client_impl::create_udp_client(string const& host, string const& port)
     info.ai_socktype = SOCK_DGRAM;
     info.ai_protocol = IPPROTO_UDP;
 
-    int s = getaddrinfo(host.c_str(), port.c_str(), &info, &res);
+    // Resolve without holding the lock, since the lookup may block on DNS
+    int s = getaddrinfo(host.c_str(), NULL, &info, &res);
     if (s != 0) {
-        // get the error using gai
-        lg->debug("getaddrinfo failed for host " + host + " on port " + port);
-        ret.client_socket = -1;
-        return ret;
+        // Failures are not cached, so that the host is looked up again next time
+        lg->debug("getaddrinfo failed for host ", host);
+        return false;
     }
 
-    // get a socket for the client
-    client_socket = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-    if (client_socket == -1) {
-        perror("socket failed");
-        exit(1);
-    }
+    memcpy(&addr, res->ai_addr, sizeof(struct sockaddr_in));
+    freeaddrinfo(res);
+    addr.sin_port = 0;
+    (*addr_cache_lock())[host] = addr;
 
-    ret.client_socket = client_socket;
-    ret.addr_len = res->ai_addrlen;
-    ret.addr = *(res->ai_addr);
-    return ret;
+    addr.sin_port = htons(port);
+    return true;
 }
 
 register_service<udp_factory, udp_factory_impl> register_udp_factory;
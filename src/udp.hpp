@@ -4,8 +4,10 @@
 #include "logging.h"
 #include "member_list.h"
 #include "environment.h"
+#include "locking.h"
 
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <memory>
 #include <string.h>
@@ -13,43 +15,59 @@
 #include <errno.h>
 #include <netdb.h>
 #include <vector>
+#include <unordered_map>
 #include <sys/types.h>
 #include <sys/socket.h>
-
-typedef struct udp_client_info {
-    int client_socket;
-    socklen_t addr_len;
-    struct sockaddr addr;
-} udp_client_info;
+#include <sys/uio.h>
+#include <netinet/in.h>
 
 class udp_server_impl : public udp_server {
 public:
-    udp_server_impl(environment &env) : lg(env.get<logger_factory>()->get_logger("udp_server")) {}
+    udp_server_impl(environment &env);
     ~udp_server_impl() {}
 
     void start_server(int port);
     void stop_server();
     auto recv(char *buf, unsigned length) -> int;
+    auto recv_batch(std::vector<std::string_view> &packets) -> int;
 private:
+    // The most packets received by a single call to recvmmsg
+    static const unsigned max_batch_size = 64;
+    // The largest possible UDP payload, so that no packet is ever truncated
+    static const unsigned max_packet_size = 65507;
+
     // Creates fd to receive incoming messages sent via UDP
     // Returns a socket fd, otherwise -1 on failure.
     auto create_udp_server(int port) -> int;
 
     int server_fd;
+    // Buffers for recv_batch, one per packet in a batch, allocated once and left uninitialized so that only
+    // the pages that packets are actually written to take up memory
+    std::unique_ptr<char[]> batch_buffers;
+    struct iovec batch_iovs[max_batch_size];
+    struct mmsghdr batch_msgs[max_batch_size];
     std::unique_ptr<logger> lg;
 };
 
+// A UDP client that sends every packet through a single socket, and resolves each hostname only once
 class udp_client_impl : public udp_client {
 public:
-    udp_client_impl(environment &env) : lg(env.get<logger_factory>()->get_logger("udp_client")) {}
-    ~udp_client_impl() {}
+    udp_client_impl(environment &env);
+    ~udp_client_impl();
 
     void send(std::string const& host, int port, std::string const& msg);
+    void send_all(std::vector<std::string> const& hosts, int port, std::string const& msg);
 private:
-    // Creates a UDP connection to a given host and port.
-    // Returns a socket fd to the host, otherwise -1 on failure.
-    auto create_udp_client(std::string const& host, std::string const& port) -> udp_client_info;
+    // The most packets passed to a single call to sendmmsg
+    static const unsigned max_batch_size = 64;
 
+    // Resolves the address of host with the given port, using the cached address if it was resolved before
+    // Returns false if the host could not be resolved
+    auto resolve(std::string const& host, int port, struct sockaddr_in &addr) -> bool;
+
+    int client_socket;
+    // Resolved addresses by hostname, with the port left unset
+    locked<std::unordered_map<std::string, struct sockaddr_in>> addr_cache_lock;
     std::unique_ptr<logger> lg;
 };
 
@@ -6,6 +6,10 @@
 #include <iostream>
 #include <string>
 #include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
 
 namespace utils {
     bool backoff(std::function<bool()> const& callback, std::function<bool()> const& give_up) {
@@ -24,4 +28,51 @@ namespace utils {
         }
         return true;
     }
+
+    bool read_lines(int fd, std::function<bool(std::string_view)> const& callback) {
+        // Grows to fit the longest line seen by this thread, and is kept for the next call
+        thread_local std::vector<char> buffer(64 * 1024);
+
+        // The bytes in [start, end) have been read but not passed to the callback, and those before scanned have
+        // already been searched for a newline
+        size_t start = 0;
+        size_t scanned = 0;
+        size_t end = 0;
+        while (true) {
+            // Make room for more data, moving the partial line to the front or growing the buffer if it fills it
+            if (end == buffer.size()) {
+                if (start > 0) {
+                    std::memmove(buffer.data(), buffer.data() + start, end - start);
+                    scanned -= start;
+                    end -= start;
+                    start = 0;
+                } else {
+                    buffer.resize(buffer.size() * 2);
+                }
+            }
+
+            ssize_t bytes_read = read(fd, buffer.data() + end, buffer.size() - end);
+            if (bytes_read < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes_read <= 0) {
+                return bytes_read == 0;
+            }
+            end += bytes_read;
+
+            char *data = buffer.data();
+            for (char *newline; (newline = static_cast<char*>(std::memchr(data + scanned, '\n', end - scanned)));) {
+                if (!callback(std::string_view(data + start, newline - (data + start)))) {
+                    return false;
+                }
+                start = scanned = newline - data + 1;
+            }
+            scanned = end;
+
+            // Start from the front of the buffer again once every line in it has been handled
+            if (start == end) {
+                start = scanned = end = 0;
+            }
+        }
+    }
 }
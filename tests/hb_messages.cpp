@@ -0,0 +1,109 @@
+#include "test.h"
+#include "hb_messages.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+testing::register_test member_chunks("hb_messages.member_chunks",
+    "Tests that large membership lists are split into datagrams that each parse on their own into the original members",
+    1, [] (logger::log_level level)
+{
+    std::vector<member> members;
+    for (uint32_t i = 1; i <= 1000; i++) {
+        member m;
+        m.id = i * 2654435761u;
+        // Mix in a few domains and hostnames without a domain, along with the usual numbered hostnames
+        if (i % 100 == 0) {
+            m.hostname = "node" + std::to_string(i);
+        } else {
+            m.hostname = "fa19-cs425-g01-" + std::to_string(i) + (i % 3 == 0 ? ".cs.illinois.edu" : ".ews.illinois.edu");
+        }
+        members.push_back(m);
+    }
+
+    hb_message msg(1234);
+    msg.make_members_message(members);
+    std::vector<std::string> chunks = msg.serialize_chunks();
+    assert(chunks.size() > 1);
+
+    std::vector<member> received;
+    size_t total_size = 0;
+    for (std::string const& chunk : chunks) {
+        // Every chunk should fit in a datagram that will not be fragmented
+        assert(chunk.size() <= 1500);
+        total_size += chunk.size();
+
+        hb_message parsed(chunk.c_str(), chunk.size());
+        assert(parsed.is_well_formed());
+        assert(parsed.is_members_message());
+        assert(parsed.get_id() == 1234);
+        for (member const& m : parsed.get_joined_nodes()) {
+            received.push_back(m);
+        }
+    }
+
+    // The encoding should take far less space than the hostnames do
+    size_t hostnames_size = 0;
+    for (member const& m : members) {
+        hostnames_size += m.hostname.size();
+    }
+    assert(total_size < hostnames_size / 2);
+
+    auto by_id = [] (member const& a, member const& b) {return a.id < b.id;};
+    std::sort(members.begin(), members.end(), by_id);
+    std::sort(received.begin(), received.end(), by_id);
+    assert(received.size() == members.size());
+    for (unsigned i = 0; i < members.size(); i++) {
+        assert(received[i].id == members[i].id);
+        assert(received[i].hostname == members[i].hostname);
+    }
+
+    // A truncated chunk should be rejected rather than partially applied
+    hb_message truncated(chunks[0].c_str(), chunks[0].size() - 3);
+    assert(!truncated.is_well_formed());
+    assert(truncated.get_joined_nodes().empty());
+});
+
+testing::register_test heartbeat_round_trip("hb_messages.heartbeat_round_trip",
+    "Tests that heartbeats, join requests, and sync requests carry their contents through serialization",
+    1, [] (logger::log_level level)
+{
+    member joined;
+    joined.id = 77;
+    joined.hostname = "fa19-cs425-g01-07.cs.illinois.edu";
+
+    membership_digest digest;
+    digest.num_members = 5;
+    digest.hash = 0xDEADBEEF;
+
+    hb_message heartbeat(1);
+    heartbeat.set_failed_nodes({2, 3});
+    heartbeat.set_left_nodes({4});
+    heartbeat.set_joined_nodes({joined});
+    heartbeat.set_digest(digest);
+    std::string buf = heartbeat.serialize();
+
+    hb_message parsed(buf.c_str(), buf.size());
+    assert(parsed.is_well_formed());
+    assert(!parsed.is_join_request() && !parsed.is_members_message() && !parsed.is_sync_request());
+    assert(parsed.get_failed_nodes() == std::vector<uint32_t>({2, 3}));
+    assert(parsed.get_left_nodes() == std::vector<uint32_t>({4}));
+    assert(parsed.get_joined_nodes().size() == 1);
+    assert(parsed.get_joined_nodes()[0].id == 77 && parsed.get_joined_nodes()[0].hostname == joined.hostname);
+    assert(parsed.get_digest() == digest);
+
+    hb_message join_req(77);
+    join_req.make_join_request(joined);
+    buf = join_req.serialize();
+    hb_message parsed_join(buf.c_str(), buf.size());
+    assert(parsed_join.is_join_request());
+    assert(parsed_join.get_join_request().hostname == joined.hostname);
+
+    hb_message sync_req(1);
+    sync_req.make_sync_request({5, 6, 7});
+    buf = sync_req.serialize();
+    hb_message parsed_sync(buf.c_str(), buf.size());
+    assert(parsed_sync.is_sync_request());
+    assert(parsed_sync.get_sync_ids() == std::vector<uint32_t>({5, 6, 7}));
+});
@@ -4,6 +4,7 @@
 #include "environment.h"
 #include "configuration.h"
 #include "logging.h"
+#include "locking.h"
 
 #include <memory>
 #include <set>
@@ -13,7 +14,7 @@
 using std::unique_ptr;
 using std::make_unique;
 
-template <bool UseRandomIntroducers>
+template <bool UseRandomIntroducers, bool UseSwim>
 std::function<void(logger::log_level)> test_fn([] (logger::log_level level) {
     const int NUM_NODES = 10;
     bool show_packets = false;
@@ -29,6 +30,7 @@ std::function<void(logger::log_level)> test_fn([] (logger::log_level level) {
         config->set_hostname("h" + std::to_string(i));
         config->set_hb_port(1234);
         config->set_first_node(i == 0);
+        config->set_swim_heartbeater(UseSwim);
 
         mock_udp_factory *fac = dynamic_cast<mock_udp_factory*>(envs[i]->get<udp_factory>());
         fac->configure(show_packets, drop_probability);
@@ -103,9 +105,90 @@ std::function<void(logger::log_level)> test_fn([] (logger::log_level level) {
 testing::register_test joining_group("heartbeater.joining_group",
     "Tests that 10 nodes can successfully join and remain in the group",
     30,
-    test_fn<false>);
+    test_fn<false, false>);
 
 testing::register_test joining_group_random_introducer("heartbeater.random_introducer",
     "Tests that 10 nodes can successfully join and remain in the group using any node as the introducer",
     30,
-    test_fn<true>);
+    test_fn<true, false>);
+
+testing::register_test swim_joining_group("heartbeater.swim_joining_group",
+    "Tests that 10 nodes can successfully join and remain in the group using the SWIM heartbeater",
+    30,
+    test_fn<true, true>);
+
+testing::register_test swim_failure_detection("heartbeater.swim_failure_detection",
+    "Tests that the SWIM heartbeater removes a failed node from every membership list without removing any other node",
+    40,
+    [] (logger::log_level level)
+{
+    const int NUM_NODES = 8;
+    double drop_probability = 0.1;
+
+    environment_group env_group(true);
+    std::vector<unique_ptr<environment>> envs = env_group.get_envs(NUM_NODES);
+
+    for (int i = 0; i < NUM_NODES; i++) {
+        configuration *config = envs[i]->get<configuration>();
+        config->set_hostname("h" + std::to_string(i));
+        config->set_hb_port(1234);
+        config->set_first_node(i == 0);
+        config->set_swim_heartbeater(true);
+
+        mock_udp_factory *fac = dynamic_cast<mock_udp_factory*>(envs[i]->get<udp_factory>());
+        fac->configure(false, drop_probability);
+
+        envs[i]->get<logger_factory>()->configure(level);
+    }
+
+    std::vector<heartbeater*> hbs;
+    for (int i = 0; i < NUM_NODES; i++) {
+        hbs.push_back(envs[i]->get<heartbeater>());
+    }
+
+    // Handlers run on the heartbeater threads, which may outlive the test
+    auto failed_hostnames_lock = std::make_shared<locked<std::set<std::string>>>();
+    for (int i = 0; i < NUM_NODES; i++) {
+        hbs[i]->on_fail([failed_hostnames_lock] (member const& m) {
+            (*failed_hostnames_lock)()->insert(m.hostname);
+        });
+    }
+
+    hbs[0]->start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+
+    for (unsigned i = 1; i < NUM_NODES; i++) {
+        hbs[i]->start();
+        hbs[i]->join_group("h0");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        assert(hbs[i]->get_members().size() == NUM_NODES && "Change drop_probability to 0 to confirm test failure");
+    }
+
+    // Fail the last node without it leaving, which takes 2 seconds, and give the rest time to detect it
+    hbs[NUM_NODES - 1]->stop();
+    std::this_thread::sleep_for(std::chrono::milliseconds(4000));
+
+    for (unsigned i = 0; i < NUM_NODES - 1; i++) {
+        std::vector<member> members = hbs[i]->get_members();
+        assert(members.size() == NUM_NODES - 1);
+        for (member const& m : members) {
+            assert(m.hostname != "h" + std::to_string(NUM_NODES - 1));
+        }
+    }
+    {
+        unlocked<std::set<std::string>> failed_hostnames = (*failed_hostnames_lock)();
+        assert(failed_hostnames->size() == 1 && failed_hostnames->count("h" + std::to_string(NUM_NODES - 1)) == 1);
+    }
+
+    for (unsigned i = 0; i < NUM_NODES - 1; i++) {
+        std::thread stop_thread([&hbs, i] {
+            hbs[i]->stop();
+        });
+        stop_thread.detach();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+});
@@ -0,0 +1,80 @@
+#include "test.h"
+#include "locking.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+testing::register_test rw_locked_reentrant("locking.rw_locked",
+    "Tests that rw_locked lets readers share the lock, and lets the writer read without deadlocking",
+    1, [] (logger::log_level level)
+{
+    rw_locked<int> value(0);
+
+    // Two readers must be able to hold the lock at the same time
+    {
+        rw_unlocked<int const> first = value.read();
+        std::atomic<bool> second_read = false;
+        std::thread reader([&] {
+            rw_unlocked<int const> second = value.read();
+            second_read = true;
+        });
+        reader.join();
+        assert(second_read.load());
+    }
+
+    // The writer can take the lock again, as a reader or a writer, as code holding a locked<T> can
+    {
+        rw_unlocked<int> writer = value.write();
+        *writer = 1;
+        assert(*value.read() == 1);
+        *value.write() = 2;
+        assert(*writer == 2);
+    }
+
+    // Other threads must wait for the writer
+    std::atomic<bool> reader_done = false;
+    std::thread reader;
+    {
+        rw_unlocked<int> writer = value.write();
+        reader = std::thread([&] {
+            assert(*value.read() == 3);
+            reader_done = true;
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        assert(!reader_done.load());
+        *writer = 3;
+    }
+    reader.join();
+    assert(reader_done.load());
+});
+
+testing::register_test sharded_locked_map("locking.sharded_locked",
+    "Tests that sharded_locked always returns the same shard for a key, and for_each_shard visits every entry",
+    1, [] (logger::log_level level)
+{
+    sharded_locked<std::unordered_map<int, int>> map;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.push_back(std::thread([&] {
+            for (int i = 0; i < 1000; i++) {
+                (*map(i))[i]++;
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    unsigned num_entries = 0;
+    map.for_each_shard([&] (std::unordered_map<int, int> &shard) {
+        for (auto const& [key, count] : shard) {
+            assert(count == 4);
+            num_entries++;
+        }
+    });
+    assert(num_entries == 1000);
+});
@@ -11,7 +11,10 @@
 #include "mock_sdfs_client.h"
 #include "partitioner.h"
 #include "juice_client.h"
+#include "mj_master.h"
 
+#include <atomic>
+#include <fstream>
 #include <memory>
 #include <stdlib.h>
 #include <string>
@@ -240,7 +243,26 @@ testing::register_test multiple_nodes("maplejuice.multiple_nodes",
     // Have node_envs[0] initiate the job and send it to node instead of master
     std::this_thread::sleep_for(std::chrono::milliseconds(3000)); // Wait for master to be ready (TODO: remove this after standardizing start/stop)
     maple_client *mclient = node_envs[0]->get<maple_client>();
+
+    // Watch the progress of the job on the master while it runs, which should only ever move forwards
+    std::atomic<bool> maple_done = false;
+    unsigned max_completed = 0;
+    std::thread progress_thread([&] {
+        mj_master *master = master_env->get<mj_master>();
+        while (!maple_done.load()) {
+            for (auto const& [job_id, progress] : master->get_job_progress()) {
+                assert(progress.total_files == input_files.size());
+                assert(progress.completed_files <= progress.total_files);
+                assert(progress.completed_files >= max_completed);
+                assert(!progress.failed);
+                max_completed = progress.completed_files;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
     assert(mclient->run_job("mster", "./mje/wc_maple", "wc_maple", 5, "wc_hitchhiker", "intermediate"));
+    maple_done = true;
+    progress_thread.join();
 
     juice_client *jclient = node_envs[0]->get<juice_client>();
     assert(jclient->run_job("mster", "./mje/wc_juice", "wc_juice", 5,
@@ -264,6 +286,197 @@ testing::register_test multiple_nodes("maplejuice.multiple_nodes",
     }
 });
 
+testing::register_test plugins("maplejuice.plugins",
+    "Tests running a job (word count) with plugins that are loaded into the workers instead of executables",
+    130, [] (logger::log_level level)
+{
+    environment_group env_group(true);
+
+    unsigned NUM_NODES = 4;
+
+    std::unique_ptr<environment> master_env = env_group.get_env();
+    std::vector<std::unique_ptr<environment>> node_envs = env_group.get_envs(NUM_NODES);
+
+    maplejuice_test::setup_env(*master_env, level, "mster", "", true);
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        maplejuice_test::setup_env(*node_envs[i], level, "node" + std::to_string(i), "mster", false);
+    }
+
+    // Wait for all services to get set up
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+    // Put the input files into the SDFS
+    sdfs_client *sdfsc = node_envs[0]->get<sdfs_client>();
+    assert(sdfsc->mkdir("wc_hitchhiker") == 0);
+
+    std::vector<string> input_files = maplejuice_test::ls("./mje/test_files/wc_hitchhiker_full");
+    for (string file : input_files) {
+        assert(sdfsc->put("./mje/test_files/wc_hitchhiker_full/" + file, "wc_hitchhiker/" + file) == 0);
+    }
+
+    // Create output directories
+    assert(sdfsc->mkdir("intermediate") == 0);
+    assert(sdfsc->mkdir("hitchhiker_wordcount") == 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(3000)); // Wait for master to be ready (TODO: remove this after standardizing start/stop)
+
+    // The plugins should produce exactly the same output as the executables they replace
+    maple_client *mclient = node_envs[0]->get<maple_client>();
+    assert(mclient->run_job("mster", "./mje/wc_maple.so", "wc_maple", 5, "wc_hitchhiker", "intermediate"));
+
+    juice_client *jclient = node_envs[0]->get<juice_client>();
+    assert(jclient->run_job("mster", "./mje/wc_juice.so", "wc_juice", 5,
+        partitioner::type::range, "intermediate", "hitchhiker_wordcount"));
+
+    // Get the file and check its validity
+    string temp_dir = node_envs[0]->get<configuration>()->get_mj_dir();
+    assert(node_envs[0]->get<sdfs_client>()->get(temp_dir + "result", "hitchhiker_wordcount/output") == 0);
+    pclose(popen(const_cast<char*>(("cat " + temp_dir + "result | sort > " + temp_dir + "results_sorted").c_str()), "r"));
+    maplejuice_test::delete_file(temp_dir + "result");
+    maplejuice_test::diff_files(temp_dir + "results_sorted", "./mje/test_files/wc_hitchhiker_results");
+    maplejuice_test::delete_file(temp_dir + "results_sorted");
+
+    std::vector<std::thread> stop_nodes;
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        stop_nodes.push_back(std::thread([&, i] {node_envs[i]->get<mj_worker>()->stop();}));
+    }
+    master_env->get<mj_worker>()->stop();
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        stop_nodes[i].join();
+    }
+});
+
+testing::register_test combiner("maplejuice.combiner",
+    "Tests running a job (word count) with a combiner that sums the counts from each file before they are appended",
+    130, [] (logger::log_level level)
+{
+    environment_group env_group(true);
+
+    unsigned NUM_NODES = 4;
+
+    std::unique_ptr<environment> master_env = env_group.get_env();
+    std::vector<std::unique_ptr<environment>> node_envs = env_group.get_envs(NUM_NODES);
+
+    maplejuice_test::setup_env(*master_env, level, "mster", "", true);
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        maplejuice_test::setup_env(*node_envs[i], level, "node" + std::to_string(i), "mster", false);
+    }
+
+    // Wait for all services to get set up
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+    // Put the input files into the SDFS
+    sdfs_client *sdfsc = node_envs[0]->get<sdfs_client>();
+    assert(sdfsc->mkdir("wc_hitchhiker") == 0);
+
+    std::vector<string> input_files = maplejuice_test::ls("./mje/test_files/wc_hitchhiker_full");
+    for (string file : input_files) {
+        assert(sdfsc->put("./mje/test_files/wc_hitchhiker_full/" + file, "wc_hitchhiker/" + file) == 0);
+    }
+
+    // Create output directories
+    assert(sdfsc->mkdir("intermediate") == 0);
+    assert(sdfsc->mkdir("hitchhiker_wordcount") == 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(3000)); // Wait for master to be ready (TODO: remove this after standardizing start/stop)
+
+    // Use Juice as the combiner, which should give exactly the same result as not combining
+    maple_client *mclient = node_envs[0]->get<maple_client>();
+    assert(mclient->run_job("mster", "./mje/wc_maple.so", "wc_maple", 5, "wc_hitchhiker", "intermediate",
+        false, "./mje/wc_juice_executor"));
+
+    // Each file should have appended at most one count for each word
+    string temp_dir = node_envs[0]->get<configuration>()->get_mj_dir();
+    assert(sdfsc->get(temp_dir + "the", "intermediate/the") == 0);
+    std::ifstream counts_stream(temp_dir + "the");
+    unsigned num_counts = 0;
+    for (string line; std::getline(counts_stream, line);) {
+        num_counts++;
+    }
+    assert(num_counts > 0 && num_counts <= input_files.size());
+    maplejuice_test::delete_file(temp_dir + "the");
+
+    juice_client *jclient = node_envs[0]->get<juice_client>();
+    assert(jclient->run_job("mster", "./mje/wc_juice.so", "wc_juice", 5,
+        partitioner::type::range, "intermediate", "hitchhiker_wordcount"));
+
+    // Get the file and check its validity
+    assert(node_envs[0]->get<sdfs_client>()->get(temp_dir + "result", "hitchhiker_wordcount/output") == 0);
+    pclose(popen(const_cast<char*>(("cat " + temp_dir + "result | sort > " + temp_dir + "results_sorted").c_str()), "r"));
+    maplejuice_test::delete_file(temp_dir + "result");
+    maplejuice_test::diff_files(temp_dir + "results_sorted", "./mje/test_files/wc_hitchhiker_results");
+    maplejuice_test::delete_file(temp_dir + "results_sorted");
+
+    std::vector<std::thread> stop_nodes;
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        stop_nodes.push_back(std::thread([&, i] {node_envs[i]->get<mj_worker>()->stop();}));
+    }
+    master_env->get<mj_worker>()->stop();
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        stop_nodes[i].join();
+    }
+});
+
+testing::register_test executors("maplejuice.executors",
+    "Tests running a job (word count) with persistent executors that are fed every file instead of being run per file",
+    130, [] (logger::log_level level)
+{
+    environment_group env_group(true);
+
+    unsigned NUM_NODES = 4;
+
+    std::unique_ptr<environment> master_env = env_group.get_env();
+    std::vector<std::unique_ptr<environment>> node_envs = env_group.get_envs(NUM_NODES);
+
+    maplejuice_test::setup_env(*master_env, level, "mster", "", true);
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        maplejuice_test::setup_env(*node_envs[i], level, "node" + std::to_string(i), "mster", false);
+    }
+
+    // Wait for all services to get set up
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+    // Put the input files into the SDFS
+    sdfs_client *sdfsc = node_envs[0]->get<sdfs_client>();
+    assert(sdfsc->mkdir("wc_hitchhiker") == 0);
+
+    std::vector<string> input_files = maplejuice_test::ls("./mje/test_files/wc_hitchhiker_full");
+    for (string file : input_files) {
+        assert(sdfsc->put("./mje/test_files/wc_hitchhiker_full/" + file, "wc_hitchhiker/" + file) == 0);
+    }
+
+    // Create output directories
+    assert(sdfsc->mkdir("intermediate") == 0);
+    assert(sdfsc->mkdir("hitchhiker_wordcount") == 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(3000)); // Wait for master to be ready (TODO: remove this after standardizing start/stop)
+
+    // The executors should produce exactly the same output as the executables they replace
+    maple_client *mclient = node_envs[0]->get<maple_client>();
+    assert(mclient->run_job("mster", "./mje/wc_maple_executor", "wc_maple", 5, "wc_hitchhiker", "intermediate", true));
+
+    juice_client *jclient = node_envs[0]->get<juice_client>();
+    assert(jclient->run_job("mster", "./mje/wc_juice_executor", "wc_juice", 5,
+        partitioner::type::range, "intermediate", "hitchhiker_wordcount", true));
+
+    // Get the file and check its validity
+    string temp_dir = node_envs[0]->get<configuration>()->get_mj_dir();
+    assert(node_envs[0]->get<sdfs_client>()->get(temp_dir + "result", "hitchhiker_wordcount/output") == 0);
+    pclose(popen(const_cast<char*>(("cat " + temp_dir + "result | sort > " + temp_dir + "results_sorted").c_str()), "r"));
+    maplejuice_test::delete_file(temp_dir + "result");
+    maplejuice_test::diff_files(temp_dir + "results_sorted", "./mje/test_files/wc_hitchhiker_results");
+    maplejuice_test::delete_file(temp_dir + "results_sorted");
+
+    std::vector<std::thread> stop_nodes;
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        stop_nodes.push_back(std::thread([&, i] {node_envs[i]->get<mj_worker>()->stop();}));
+    }
+    master_env->get<mj_worker>()->stop();
+    for (unsigned i = 0; i < NUM_NODES; i++) {
+        stop_nodes[i].join();
+    }
+});
+
 testing::register_test drop_maple("maplejuice.drop_maple",
     "Tests assigning a job (word count) to multiple nodes, with a node failing during the Maple portion",
     150, [] (logger::log_level level)
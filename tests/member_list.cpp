@@ -114,3 +114,41 @@ testing::register_test removing("member_list.removing_large",
     std::vector<member> neighbors = ml.get_neighbors();
     assert(neighbors.size() == 3);
 });
+
+testing::register_test lookups("member_list.lookups",
+    "Tests looking up members by ID, successors wrapping around the end of the list, and neighbors of the first member",
+    1, [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<configuration>()->set_hostname("local");
+    env.get<logger_factory>()->configure(level);
+
+    member_list ml(env);
+    for (uint32_t id = 10; id <= 100; id += 10) {
+        ml.add_member(id == 10 ? "local" : std::to_string(id), id);
+    }
+
+    assert(ml.has_member(50));
+    assert(!ml.has_member(55));
+    assert(ml.find_member(55) == nullptr);
+    assert(ml.find_member(70)->hostname == "70");
+    assert(ml.get_member_by_id(30).hostname == "30");
+    assert(ml.get_member_by_id(35).id == 0);
+
+    assert(ml.get_successor(50).id == 60);
+    assert(ml.get_successor(100).id == 10);
+    assert(ml.get_successor(55).id == 0);
+
+    // We are first in the list, so our predecessors wrap around to the end
+    std::vector<uint32_t> neighbor_ids;
+    for (member const& m : ml.get_neighbors()) {
+        neighbor_ids.push_back(m.id);
+    }
+    std::sort(neighbor_ids.begin(), neighbor_ids.end());
+    assert((neighbor_ids == std::vector<uint32_t>{20, 30, 90, 100}));
+
+    // Once we are removed, we have no neighbors
+    ml.remove_member(10);
+    assert(ml.get_neighbors().size() == 0);
+    assert(ml.num_members() == 9);
+});
@@ -7,6 +7,7 @@
 #include <thread>
 #include <chrono>
 #include <cassert>
+#include <vector>
 
 using std::unique_ptr;
 using std::make_unique;
@@ -440,3 +441,54 @@ testing::register_test ephemeral_ports("mock_tcp.ephemeral_ports",
         assert(clients_complete[i]);
     }
 });
+
+testing::register_test event_server("mock_tcp.event_server",
+    "Tests that an event server handles messages from multiple clients in order and can close connections",
+    4, [] (logger::log_level level)
+{
+    const unsigned NUM_CLIENTS = 3;
+
+    environment_group env_group(true);
+    unique_ptr<environment> server_env = env_group.get_env();
+    server_env->get<configuration>()->set_hostname("server");
+    server_env->get<logger_factory>()->configure(level);
+
+    std::vector<unique_ptr<environment>> client_envs;
+    for (unsigned i = 0; i < NUM_CLIENTS; i++) {
+        client_envs.push_back(env_group.get_env());
+        client_envs[i]->get<configuration>()->set_hostname("client" + std::to_string(i));
+        client_envs[i]->get<logger_factory>()->configure(level);
+    }
+
+    unique_ptr<tcp_event_server> server = server_env->get<tcp_factory>()->get_tcp_event_server(1234, 2);
+
+    // Echo every message back, and close the connection when asked to
+    server->start([&server] (int client, std::string const& msg) {
+        if (msg == "close") {
+            server->close_connection(client);
+        } else {
+            server->write_to_client(client, msg);
+        }
+    });
+
+    std::vector<std::thread> client_threads;
+    for (unsigned i = 0; i < NUM_CLIENTS; i++) {
+        client_threads.push_back(std::thread([&client_envs, i] {
+            unique_ptr<tcp_client> client = client_envs[i]->get<tcp_factory>()->get_tcp_client("server", 1234);
+            for (int j = 0; j < 10; j++) {
+                client->write_to_server(std::to_string(j));
+            }
+            for (int j = 0; j < 10; j++) {
+                assert(client->read_from_server() == std::to_string(j));
+            }
+
+            client->write_to_server("close");
+            assert(client->read_from_server() == "");
+        }));
+    }
+
+    for (std::thread &t : client_threads) {
+        t.join();
+    }
+    server->stop();
+});
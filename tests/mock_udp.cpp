@@ -8,6 +8,9 @@
 #include <iostream>
 #include <chrono>
 #include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
 
 using std::unique_ptr;
 using std::make_unique;
@@ -94,3 +97,37 @@ testing::register_test mock_udp("mock_udp.mock_udp",
 
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
 });
+
+testing::register_test mock_udp_recv_batch("mock_udp.recv_batch",
+    "Tests that recv_batch returns every queued packet in order without truncating large ones",
+    1, [] (logger::log_level level)
+{
+    environment_group env_group(true);
+    unique_ptr<environment> env1 = env_group.get_env();
+    unique_ptr<environment> env2 = env_group.get_env();
+
+    env1->get<configuration>()->set_hostname("h1");
+    env2->get<configuration>()->set_hostname("h2");
+    env1->get<logger_factory>()->configure(level);
+    env2->get<logger_factory>()->configure(level);
+
+    unique_ptr<udp_client> h1_client = env1->get<udp_factory>()->get_udp_client();
+    unique_ptr<udp_server> h2_server = env2->get<udp_factory>()->get_udp_server();
+    h2_server->start_server(1234);
+
+    // Queue up all the packets before receiving any, including one larger than the old 1 KB receive buffer
+    std::vector<std::string> sent;
+    for (int i = 0; i < 10; i++) {
+        sent.push_back(std::string(i == 5 ? 4000 : 10, 'a' + i));
+        h1_client->send("h2", 1234, sent.back());
+    }
+
+    std::vector<std::string_view> packets;
+    assert(h2_server->recv_batch(packets) == 10);
+    assert(packets.size() == 10);
+    for (int i = 0; i < 10; i++) {
+        assert(packets[i] == sent[i]);
+    }
+
+    h2_server->stop_server();
+});
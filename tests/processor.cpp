@@ -0,0 +1,79 @@
+#include "test.h"
+#include "processor.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <map>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using std::string;
+
+namespace {
+auto count_files(string const& dir) -> unsigned {
+    unsigned count = 0;
+    DIR *d = opendir(dir.c_str());
+    for (struct dirent *entry = readdir(d); entry != nullptr; entry = readdir(d)) {
+        if (string(entry->d_name) != "." && string(entry->d_name) != "..") {
+            count++;
+        }
+    }
+    closedir(d);
+    return count;
+}
+}
+
+testing::register_test processor_spill("processor.spill",
+    "Tests that Maple output beyond the memory budget is spilled to disk and merged back with each key output once",
+    5, [] (logger::log_level level)
+{
+    char dir_template[] = "/tmp/processor_testXXXXXX";
+    string dir = string(mkdtemp(dir_template)) + "/";
+
+    const unsigned num_keys = 500;
+    const unsigned num_values = 20000;
+    std::map<string, std::vector<string>> expected;
+    {
+        maple_processor proc(16 * 1024, dir);
+        for (unsigned i = 0; i < num_values; i++) {
+            string key = "key_" + std::to_string((i * 7919) % num_keys);
+            string value = std::to_string(i);
+            assert(proc.process_line(key + " " + value));
+            expected[key].push_back(value);
+        }
+        assert(proc.num_spilled_runs() > 1);
+        assert(count_files(dir) == proc.num_spilled_runs());
+
+        // Each key should come out once, in order, with all of its values from every run
+        std::map<string, std::vector<string>> output;
+        string last_key = "";
+        for (auto const& [key, vals] : proc) {
+            assert(output.find(key) == output.end());
+            assert(last_key < key);
+            last_key = key;
+            output[key] = vals;
+        }
+        assert(output.size() == num_keys);
+        for (auto &[key, vals] : output) {
+            std::vector<string> &expected_vals = expected[key];
+            std::sort(vals.begin(), vals.end());
+            std::sort(expected_vals.begin(), expected_vals.end());
+            assert(vals == expected_vals);
+        }
+    }
+
+    // The runs should be deleted along with the processor
+    assert(count_files(dir) == 0);
+
+    // Without a budget, nothing is spilled
+    maple_processor unlimited;
+    for (unsigned i = 0; i < num_values; i++) {
+        unlimited.process_pair("key_" + std::to_string(i % num_keys), std::to_string(i));
+    }
+    assert(unlimited.num_spilled_runs() == 0);
+
+    rmdir(dir.c_str());
+});
@@ -0,0 +1,169 @@
+#include "test.h"
+#include "tcp.h"
+#include "environment.h"
+#include "configuration.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <unistd.h>
+
+using std::unique_ptr;
+
+testing::register_test pooled_clients("tcp.pooled_clients",
+    "Tests that pooled clients multiplex streams over a shared connection and recover from eviction",
+    2, [] (logger::log_level level)
+{
+    const unsigned NUM_CLIENTS = 8;
+
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    tcp_factory *fac = env.get<tcp_factory>();
+
+    // Echo every message back on the stream it arrived on, and end the stream when asked to
+    unique_ptr<tcp_event_server> server = fac->get_tcp_event_server(15100, 4);
+    server->start([&server] (int client, std::string const& msg) {
+        if (msg == "close") {
+            server->close_connection(client);
+        } else {
+            server->write_to_client(client, msg);
+        }
+    });
+
+    std::vector<std::thread> client_threads;
+    for (unsigned i = 0; i < NUM_CLIENTS; i++) {
+        client_threads.push_back(std::thread([fac, i] {
+            unique_ptr<tcp_client> client = fac->get_pooled_tcp_client("127.0.0.1", 15100);
+            assert(client.get() != nullptr);
+
+            for (int j = 0; j < 20; j++) {
+                std::string msg = std::to_string(i) + ":" + std::to_string(j);
+                assert(client->write_to_server(msg) == static_cast<ssize_t>(msg.length()));
+                assert(client->read_from_server() == msg);
+            }
+
+            // Closing the stream from the server side should only end this client's stream
+            client->write_to_server("close");
+            assert(client->read_from_server() == "");
+            assert(client->write_to_server("closed") == 0);
+        }));
+    }
+    for (std::thread &t : client_threads) {
+        t.join();
+    }
+
+    // Evicting the host should fail clients that are using the connection, but new clients should reconnect
+    unique_ptr<tcp_client> old_client = fac->get_pooled_tcp_client("127.0.0.1", 15100);
+    fac->evict_pooled_connections("127.0.0.1");
+    assert(old_client->read_from_server() == "");
+
+    unique_ptr<tcp_client> new_client = fac->get_pooled_tcp_client("127.0.0.1", 15100);
+    assert(new_client->write_to_server("after eviction") > 0);
+    assert(new_client->read_from_server() == "after eviction");
+
+    old_client.reset();
+    new_client.reset();
+    server->stop();
+});
+
+testing::register_test file_transfer("tcp.file_transfer",
+    "Tests that files sent with sendfile and received with splice arrive intact in both directions",
+    2, [] (logger::log_level level)
+{
+    const size_t FILE_SIZE = 5 * 1024 * 1024 + 17;
+
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    tcp_factory *fac = env.get<tcp_factory>();
+
+    // Anonymous temporary files which disappear once closed
+    auto make_file = [] () -> int {
+        char path[] = "/tmp/tcp_file_transferXXXXXX";
+        int fd = mkstemp(path);
+        assert(fd >= 0);
+        unlink(path);
+        return fd;
+    };
+    auto read_contents = [] (int fd) -> std::string {
+        std::string contents(lseek(fd, 0, SEEK_END), '\0');
+        assert(pread(fd, &contents[0], contents.length(), 0) == static_cast<ssize_t>(contents.length()));
+        return contents;
+    };
+
+    std::string contents(FILE_SIZE, '\0');
+    for (size_t i = 0; i < FILE_SIZE; i++) {
+        contents[i] = static_cast<char>(i * 31 + i / 4096);
+    }
+    int src_fd = make_file();
+    assert(pwrite(src_fd, contents.c_str(), FILE_SIZE, 0) == static_cast<ssize_t>(FILE_SIZE));
+
+    // The server receives the file, acknowledges it with a regular message, and then sends it back
+    unique_ptr<tcp_server> server = fac->get_tcp_server(15101);
+    std::thread server_thread([&] {
+        int client = server->accept_connection();
+        assert(client >= 0);
+
+        int server_fd = make_file();
+        assert(server->read_file_from_client(client, server_fd) == static_cast<ssize_t>(FILE_SIZE));
+        assert(server->write_to_client(client, "received") > 0);
+        assert(server->write_file_to_client(client, server_fd, FILE_SIZE) == static_cast<ssize_t>(FILE_SIZE));
+
+        close(server_fd);
+        server->close_connection(client);
+    });
+
+    unique_ptr<tcp_client> client = fac->get_tcp_client("127.0.0.1", 15101);
+    assert(client.get() != nullptr);
+    assert(client->write_file_to_server(src_fd, FILE_SIZE) == static_cast<ssize_t>(FILE_SIZE));
+    assert(client->read_from_server() == "received");
+
+    // Receiving into a file with existing contents should overwrite it from the start
+    int dest_fd = make_file();
+    assert(pwrite(dest_fd, "stale", 5, 0) == 5);
+    assert(client->read_file_from_server(dest_fd) == static_cast<ssize_t>(FILE_SIZE));
+    assert(read_contents(dest_fd) == contents);
+
+    // Once the server has hung up, receiving a file should fail instead of producing an empty file
+    server_thread.join();
+    assert(client->read_file_from_server(dest_fd) == -1);
+
+    close(src_fd);
+    close(dest_fd);
+});
+
+testing::register_test corked_messages("tcp.corked_messages",
+    "Tests that gathered message writes arrive intact with Nagle's algorithm enabled and corking on",
+    2, [] (logger::log_level level)
+{
+    environment env(false);
+    env.get<configuration>()->set_hostname("127.0.0.1");
+    env.get<logger_factory>()->configure(level);
+    tcp_factory *fac = env.get<tcp_factory>();
+    fac->configure(false, true);
+
+    // Echo every message back until the client hangs up
+    unique_ptr<tcp_server> server = fac->get_tcp_server(15102);
+    std::thread server_thread([&] {
+        int client = server->accept_connection();
+        for (std::string msg; (msg = server->read_from_client(client)) != "";) {
+            assert(server->write_to_client(client, msg) == static_cast<ssize_t>(msg.length()));
+        }
+        server->close_connection(client);
+    });
+
+    // Sizes from a single byte up to messages that need several partial writes
+    unique_ptr<tcp_client> client = fac->get_tcp_client("127.0.0.1", 15102);
+    for (size_t size = 1; size <= 4 * 1024 * 1024; size *= 7) {
+        std::string msg(size, static_cast<char>('a' + size % 26));
+        assert(client->write_to_server(msg) == static_cast<ssize_t>(size));
+        assert(client->read_from_server() == msg);
+    }
+
+    client.reset();
+    server_thread.join();
+});
@@ -0,0 +1,82 @@
+#include "test.h"
+#include "threadpool.h"
+#include "environment.h"
+
+#include <array>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+
+testing::register_test work_stealing_threadpool("threadpool.work_stealing",
+    "Tests that the work stealing threadpool runs every task, including tasks enqueued by other tasks, before finishing",
+    1, [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(level);
+    threadpool_factory *tp_fac = env.get<threadpool_factory>();
+
+    for (unsigned num_threads : {1, 4, 16}) {
+        std::unique_ptr<threadpool> tp = tp_fac->get_work_stealing_threadpool(num_threads);
+        threadpool *tp_ptr = tp.get();
+
+        // Each outer task enqueues several inner tasks onto its own deque, which the other threads must steal
+        const unsigned num_outer = 2000, num_inner = 10;
+        std::vector<std::atomic<unsigned>> runs(num_outer * (num_inner + 1));
+        for (unsigned i = 0; i < num_outer; i++) {
+            tp->enqueue([&, i] {
+                runs[i * (num_inner + 1)]++;
+                for (unsigned j = 1; j <= num_inner; j++) {
+                    tp_ptr->enqueue([&, i, j] {
+                        runs[i * (num_inner + 1) + j]++;
+                    });
+                }
+            });
+        }
+        tp->finish();
+
+        for (auto const& count : runs) {
+            assert(count.load() == 1);
+        }
+    }
+});
+
+testing::register_test threadpool_futures("threadpool.futures",
+    "Tests submitting move-only tasks and waiting on their results with when_all and parallel_for",
+    1, [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(level);
+    threadpool_factory *tp_fac = env.get<threadpool_factory>();
+
+    std::unique_ptr<threadpool> pools[] = {tp_fac->get_threadpool(4), tp_fac->get_work_stealing_threadpool(4)};
+    for (auto &tp : pools) {
+        // Tasks that can only be moved, both small enough to be stored inline and too large to be
+        std::vector<std::future<int>> futures;
+        for (int i = 0; i < 100; i++) {
+            futures.push_back(tp->submit([p = std::make_unique<int>(i)] {
+                return *p * 2;
+            }));
+            std::array<int, 64> large;
+            large.fill(i);
+            futures.push_back(tp->submit([p = std::make_unique<int>(i), large] {
+                return *p + large[63];
+            }));
+        }
+        std::vector<int> results = when_all(futures);
+        for (int i = 0; i < 100; i++) {
+            assert(results[2 * i] == 2 * i);
+            assert(results[2 * i + 1] == 2 * i);
+        }
+
+        std::vector<std::atomic<unsigned>> runs(1000);
+        tp->parallel_for(0, runs.size(), [&] (size_t i) {
+            runs[i]++;
+        });
+        for (auto const& count : runs) {
+            assert(count.load() == 1);
+        }
+
+        tp->finish();
+    }
+});
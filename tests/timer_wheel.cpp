@@ -0,0 +1,106 @@
+#include "test.h"
+#include "timer_wheel.h"
+#include "environment.h"
+#include "locking.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono;
+
+testing::register_test timer_wheel_ordering("timer_wheel.ordering",
+    "Tests that one shot timers are called once each, in order of their delays and no earlier than their delays",
+    3, [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(level);
+    timer_wheel *tw = env.get<timer_wheel>();
+
+    auto start = steady_clock::now();
+    // Delays that land in the first level, and ones far enough out that they must be cascaded down into it
+    std::vector<uint64_t> delays = {1100, 5, 700, 260, 0, 1500, 40, 255, 256, 900};
+
+    locked<std::vector<std::pair<uint64_t, uint64_t>>> calls_lock;
+    for (uint64_t delay : delays) {
+        tw->schedule(delay, [&, delay] {
+            uint64_t elapsed = duration_cast<milliseconds>(steady_clock::now() - start).count();
+            calls_lock()->push_back({delay, elapsed});
+        });
+    }
+
+    std::this_thread::sleep_for(milliseconds(2000));
+
+    unlocked<std::vector<std::pair<uint64_t, uint64_t>>> calls = calls_lock();
+    assert(calls->size() == delays.size());
+    for (unsigned i = 0; i < calls->size(); i++) {
+        auto [delay, elapsed] = (*calls)[i];
+        assert(elapsed >= delay);
+        if (i > 0) {
+            assert((*calls)[i - 1].first <= delay);
+        }
+    }
+});
+
+testing::register_test timer_wheel_cancel("timer_wheel.cancel",
+    "Tests that cancelled timers are never called and that cancelling reports whether there was a call to prevent",
+    3, [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(level);
+    timer_wheel *tw = env.get<timer_wheel>();
+
+    std::atomic<unsigned> near_calls = 0, far_calls = 0, kept_calls = 0;
+    timer_id near = tw->schedule(100, [&] {near_calls++;});
+    timer_id far = tw->schedule(600, [&] {far_calls++;});
+    timer_id kept = tw->schedule(50, [&] {kept_calls++;});
+
+    assert(tw->cancel(near));
+    assert(!tw->cancel(near));
+    assert(tw->cancel(far));
+    assert(!tw->cancel(0));
+
+    std::this_thread::sleep_for(milliseconds(1000));
+    assert(near_calls == 0);
+    assert(far_calls == 0);
+    assert(kept_calls == 1);
+    // A timer that has already been called cannot be cancelled
+    assert(!tw->cancel(kept));
+});
+
+testing::register_test timer_wheel_repeating("timer_wheel.repeating",
+    "Tests that repeating timers keep being called at their interval until cancelled, including by themselves",
+    3, [] (logger::log_level level)
+{
+    environment env(true);
+    env.get<logger_factory>()->configure(level);
+    timer_wheel *tw = env.get<timer_wheel>();
+
+    std::atomic<unsigned> fast_calls = 0, slow_calls = 0, self_calls = 0;
+    timer_id fast = tw->schedule_repeating(20, [&] {fast_calls++;});
+    timer_id slow = tw->schedule_repeating(300, [&] {slow_calls++;});
+
+    std::atomic<timer_id> self_id = 0;
+    self_id = tw->schedule_repeating(10, [&] {
+        if (++self_calls == 5) {
+            assert(tw->cancel(self_id.load()));
+        }
+    });
+
+    std::this_thread::sleep_for(milliseconds(1000));
+    assert(tw->cancel(fast));
+    assert(tw->cancel(slow));
+    unsigned fast_after_cancel = fast_calls.load();
+    unsigned slow_after_cancel = slow_calls.load();
+
+    // Repeating timers are scheduled relative to when they were due, so they should not drift much
+    assert(fast_after_cancel >= 30 && fast_after_cancel <= 51);
+    assert(slow_after_cancel == 3);
+    assert(self_calls == 5);
+
+    std::this_thread::sleep_for(milliseconds(500));
+    assert(fast_calls == fast_after_cancel);
+    assert(slow_calls == slow_after_cancel);
+    assert(self_calls == 5);
+});
@@ -0,0 +1,107 @@
+#include "test.h"
+#include "tracing.h"
+#include "logging.h"
+#include "environment.h"
+#include "configuration.h"
+
+#include <dirent.h>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using std::string;
+using std::unique_ptr;
+
+namespace {
+auto list_dir(string const& dir) -> std::vector<string> {
+    std::vector<string> names;
+    DIR *d = opendir(dir.c_str());
+    for (struct dirent *entry = readdir(d); entry != nullptr; entry = readdir(d)) {
+        if (string(entry->d_name) != "." && string(entry->d_name) != "..") {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(d);
+    return names;
+}
+}
+
+testing::register_test tracing_merge("tracing.merge",
+    "Tests that trace events from multiple nodes are merged by time and that old trace files are deleted on rotation",
+    1, [] (logger::log_level level)
+{
+    char dir_template[] = "/tmp/tracing_testXXXXXX";
+    string dir = string(mkdtemp(dir_template)) + "/";
+
+    const unsigned num_nodes = 2;
+    const unsigned num_events = 400;
+    const unsigned num_files = 3;
+    {
+        environment_group env_group(true);
+        std::vector<unique_ptr<environment>> envs = env_group.get_envs(num_nodes);
+
+        std::vector<unique_ptr<tracer>> tracers;
+        for (unsigned i = 0; i < num_nodes; i++) {
+            envs[i]->get<configuration>()->set_hostname("h" + std::to_string(i));
+            envs[i]->get<logger_factory>()->configure(level);
+            // Small enough that each node goes through several files
+            envs[i]->get<logger_factory>()->configure_tracing(dir, 4096, num_files);
+            tracers.push_back(envs[i]->get<logger_factory>()->get_tracer(trace_component::mj_master));
+            assert(tracers[i]->enabled());
+        }
+
+        // Unconfigured environments get tracers that do nothing
+        environment untraced_env(true);
+        assert(!untraced_env.get<logger_factory>()->get_tracer(trace_component::mj_worker)->enabled());
+
+        string filename = "wc_hitchhiker/file";
+        for (unsigned j = 0; j < num_events; j++) {
+            for (unsigned i = 0; i < num_nodes; i++) {
+                tracers[i]->event(trace_event::file_done, {i, "h" + std::to_string(i), filename, j, num_events});
+            }
+        }
+    }
+
+    // Each node should have kept only its latest files
+    std::vector<string> files = list_dir(dir);
+    assert(files.size() == num_nodes * num_files);
+
+    std::vector<decoded_trace_event> events = trace_decoder::read_dir(dir);
+    assert(events.size() > 0 && events.size() < num_nodes * num_events);
+
+    // Events should be in order of time, and each node's events should be the last ones it recorded, in order
+    std::vector<int64_t> last_event(num_nodes, -1);
+    for (unsigned k = 0; k < events.size(); k++) {
+        decoded_trace_event const& ev = events[k];
+        assert(k == 0 || events[k - 1].timestamp_ns <= ev.timestamp_ns);
+        assert(ev.component == trace_component::mj_master && ev.event == trace_event::file_done);
+        assert(ev.args.size() == 5);
+
+        int64_t node = std::get<int64_t>(ev.args[0]);
+        int64_t j = std::get<int64_t>(ev.args[3]);
+        assert(ev.hostname == "h" + std::to_string(node));
+        assert(std::get<string>(ev.args[1]) == ev.hostname);
+        assert(std::get<string>(ev.args[2]) == "wc_hitchhiker/file");
+        assert(std::get<int64_t>(ev.args[4]) == num_events);
+        assert(last_event[node] == -1 || j == last_event[node] + 1);
+        last_event[node] = j;
+    }
+    for (unsigned i = 0; i < num_nodes; i++) {
+        assert(last_event[i] == num_events - 1);
+    }
+
+    string expected_line = " h1 mj_master file_done job=1 hostname=h1 file=wc_hitchhiker/file completed=" +
+        std::to_string(num_events - 1) + " total=" + std::to_string(num_events);
+    bool found_line = false;
+    for (decoded_trace_event const& ev : events) {
+        found_line = found_line || trace_decoder::format(ev).find(expected_line) != string::npos;
+    }
+    assert(found_line);
+
+    for (string const& file : files) {
+        unlink((dir + file).c_str());
+    }
+    rmdir(dir.c_str());
+});